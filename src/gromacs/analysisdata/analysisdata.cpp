@@ -51,6 +51,7 @@
 #include "gromacs/analysisdata/paralleloptions.h"
 #include "gromacs/utility/exceptions.h"
 #include "gromacs/utility/gmxassert.h"
+#include "gromacs/utility/mutex.h"
 
 namespace gmx
 {
@@ -107,6 +108,14 @@ public:
      * to these objects.
      */
     HandleList handles_;
+    /*! \brief
+     * Serializes access to the storage from handles used in different
+     * threads.
+     *
+     * Values are set into frames without locking, as each frame is only
+     * built by one handle.
+     */
+    Mutex mutex_;
 };
 
 /********************************************************************
@@ -150,6 +159,7 @@ int AnalysisData::frameCount() const
 
 AnalysisDataHandle AnalysisData::startData(const AnalysisDataParallelOptions& opt)
 {
+    lock_guard<Mutex> lock(impl_->mutex_);
     GMX_RELEASE_ASSERT(impl_->handles_.size() < static_cast<unsigned>(opt.parallelizationFactor()),
                        "Too many calls to startData() compared to provided options");
     if (impl_->handles_.empty())
@@ -165,12 +175,14 @@ AnalysisDataHandle AnalysisData::startData(const AnalysisDataParallelOptions& op
 
 void AnalysisData::finishFrameSerial(int frameIndex)
 {
+    lock_guard<Mutex> lock(impl_->mutex_);
     impl_->storage_.finishFrameSerial(frameIndex);
 }
 
 
 void AnalysisData::finishData(AnalysisDataHandle handle)
 {
+    lock_guard<Mutex>          lock(impl_->mutex_);
     Impl::HandleList::iterator i;
 
     for (i = impl_->handles_.begin(); i != impl_->handles_.end(); ++i)
@@ -218,6 +230,7 @@ void AnalysisDataHandle::startFrame(int index, real x, real dx)
     GMX_RELEASE_ASSERT(impl_ != nullptr, "Invalid data handle used");
     GMX_RELEASE_ASSERT(impl_->currentFrame_ == nullptr,
                        "startFrame() called twice without calling finishFrame()");
+    lock_guard<Mutex> lock(impl_->data_.impl_->mutex_);
     impl_->currentFrame_ = &impl_->data_.impl_->storage_.startFrame(index, x, dx);
 }
 
@@ -268,6 +281,7 @@ void AnalysisDataHandle::finishPointSet()
                        "finishPointSet() called for non-multipoint data");
     GMX_RELEASE_ASSERT(impl_->currentFrame_ != nullptr,
                        "finishPointSet() called without calling startFrame()");
+    lock_guard<Mutex> lock(impl_->data_.impl_->mutex_);
     impl_->currentFrame_->finishPointSet();
 }
 
@@ -279,6 +293,7 @@ void AnalysisDataHandle::finishFrame()
                        "finishFrame() called without calling startFrame()");
     AnalysisDataStorageFrame* frame = impl_->currentFrame_;
     impl_->currentFrame_            = nullptr;
+    lock_guard<Mutex>         lock(impl_->data_.impl_->mutex_);
     frame->finishFrame();
 }
 
@@ -79,6 +79,36 @@ void AnalysisDataFrameAverager::addPoints(const AnalysisDataPointSetRef& points)
     }
 }
 
+void AnalysisDataFrameAverager::merge(const AnalysisDataFrameAverager& other)
+{
+    GMX_RELEASE_ASSERT(other.columnCount() == columnCount(),
+                       "Cannot merge averagers with different column counts");
+    GMX_ASSERT(!bFinished_, "Cannot merge after finish() has been called");
+    // Combines the partial averages and sums of squared deviations using the
+    // pairwise formula of Chan et al., which keeps the stability of the
+    // incremental updates in addValue().
+    for (int i = 0; i < columnCount(); ++i)
+    {
+        const AverageItem& src = other.values_[i];
+        if (src.samples == 0)
+        {
+            continue;
+        }
+        AverageItem& dest = values_[i];
+        if (dest.samples == 0)
+        {
+            dest = src;
+            continue;
+        }
+        const double delta   = src.average - dest.average;
+        const int    samples = dest.samples + src.samples;
+        const double weight  = static_cast<double>(src.samples) / samples;
+        dest.average += delta * weight;
+        dest.squaredSum += src.squaredSum + delta * delta * dest.samples * weight;
+        dest.samples = samples;
+    }
+}
+
 void AnalysisDataFrameAverager::finish()
 {
     bFinished_ = true;
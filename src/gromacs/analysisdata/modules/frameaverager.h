@@ -64,9 +64,12 @@ class AnalysisDataPointSetRef;
  * This class takes care of accumulating the values and computing their
  * variance.  It allows different number of samples for each input column.
  * Accumulation is always in double precision and uses a formula that is
- * relatively stable numerically.  For now, does nothing fancy,
- * but provides ground for other implementation (e.g., related to
- * parallelization) that would benefit all such modules.
+ * relatively stable numerically.
+ *
+ * Separate averagers can be combined with merge(), which allows modules to
+ * accumulate into independent averagers for concurrently processed frames and
+ * combine them at the end.  The result is deterministic as long as the merge
+ * order is.
  *
  * Methods in this class do not throw unless otherwise indicated.
  *
@@ -110,6 +113,17 @@ public:
      * does not need to be called for every frame.
      */
     void addPoints(const AnalysisDataPointSetRef& points);
+    /*! \brief
+     * Merges the samples from another averager into this one.
+     *
+     * \param[in] other  Averager to merge; must have the same number of
+     *     columns.
+     *
+     * The result is the same as if all the values added to \p other had
+     * been added to this averager (up to rounding errors).
+     * Must be called before finish().
+     */
+    void merge(const AnalysisDataFrameAverager& other);
     /*! \brief
      * Finalizes the calculation of the averages and variances.
      *
@@ -151,7 +165,7 @@ public:
      */
     int sampleCount(int index) const
     {
-        GMX_ASSERT(index >= 0 && index <= ssize(values_), "Invalid column index");
+        GMX_ASSERT(index >= 0 && index < columnCount(), "Invalid column index");
         GMX_ASSERT(bFinished_, "Values available only after finished() has been called");
         return values_[index].samples;
     }
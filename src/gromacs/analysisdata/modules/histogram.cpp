@@ -865,8 +865,14 @@ public:
 
     //! Histogram settings.
     AnalysisHistogramSettings settings_;
-    //! Averaging helper objects for each input data set.
-    std::vector<AnalysisDataFrameAverager> averagers_;
+    /*! \brief
+     * Averaging helper objects for each input data set.
+     *
+     * There is one set for each frame that can be processed concurrently,
+     * indexed by the frame index modulo the parallelization factor, so
+     * pointsAdded() for different frames never touches the same object.
+     */
+    std::vector<std::vector<AnalysisDataFrameAverager>> averagers_;
 };
 
 AnalysisDataBinAverageModule::AnalysisDataBinAverageModule() : impl_(new Impl())
@@ -906,14 +912,20 @@ int AnalysisDataBinAverageModule::flags() const
 }
 
 
-void AnalysisDataBinAverageModule::dataStarted(AbstractAnalysisData* data)
+bool AnalysisDataBinAverageModule::parallelDataStarted(AbstractAnalysisData*              data,
+                                                       const AnalysisDataParallelOptions& options)
 {
     setColumnCount(data->dataSetCount());
-    impl_->averagers_.resize(data->dataSetCount());
-    for (int i = 0; i < data->dataSetCount(); ++i)
+    impl_->averagers_.resize(options.parallelizationFactor());
+    for (auto& frameAveragers : impl_->averagers_)
     {
-        impl_->averagers_[i].setColumnCount(rowCount());
+        frameAveragers.resize(data->dataSetCount());
+        for (AnalysisDataFrameAverager& averager : frameAveragers)
+        {
+            averager.setColumnCount(rowCount());
+        }
     }
+    return true;
 }
 
 
@@ -929,7 +941,9 @@ void AnalysisDataBinAverageModule::pointsAdded(const AnalysisDataPointSetRef& po
     int bin = settings().findBin(points.y(0));
     if (bin != -1)
     {
-        AnalysisDataFrameAverager& averager = impl_->averagers_[points.dataSetIndex()];
+        const int                  frameSlot = points.frameIndex() % impl_->averagers_.size();
+        AnalysisDataFrameAverager& averager =
+                impl_->averagers_[frameSlot][points.dataSetIndex()];
         for (int i = 1; i < points.columnCount(); ++i)
         {
             averager.addValue(bin, points.y(i));
@@ -941,18 +955,27 @@ void AnalysisDataBinAverageModule::pointsAdded(const AnalysisDataPointSetRef& po
 void AnalysisDataBinAverageModule::frameFinished(const AnalysisDataFrameHeader& /*header*/) {}
 
 
+void AnalysisDataBinAverageModule::frameFinishedSerial(int /*frameIndex*/) {}
+
+
 void AnalysisDataBinAverageModule::dataFinished()
 {
     allocateValues();
     for (int i = 0; i < columnCount(); ++i)
     {
-        AnalysisDataFrameAverager& averager = impl_->averagers_[i];
+        // Merge in a fixed order to get reproducible results.
+        AnalysisDataFrameAverager& averager = impl_->averagers_[0][i];
+        for (size_t j = 1; j < impl_->averagers_.size(); ++j)
+        {
+            averager.merge(impl_->averagers_[j][i]);
+        }
         averager.finish();
         for (int j = 0; j < rowCount(); ++j)
         {
             value(j, i).setValue(averager.average(j), std::sqrt(averager.variance(j)));
         }
     }
+    impl_->averagers_.clear();
     valuesReady();
 }
 
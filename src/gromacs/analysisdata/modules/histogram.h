@@ -506,10 +506,15 @@ private:
  * columns should be added at the same time).
  * All input columns for a data set are averaged into the same histogram.
  *
+ * The module supports parallel data: each of the concurrently processed
+ * frames accumulates into its own set of averagers, which are merged in a
+ * fixed order when the data is finished, so the result does not depend on
+ * thread timing.
+ *
  * \inpublicapi
  * \ingroup module_analysisdata
  */
-class AnalysisDataBinAverageModule : public AbstractAnalysisArrayData, public AnalysisDataModuleSerial
+class AnalysisDataBinAverageModule : public AbstractAnalysisArrayData, public AnalysisDataModuleParallel
 {
 public:
     //! \copydoc AnalysisDataSimpleHistogramModule::AnalysisDataSimpleHistogramModule()
@@ -526,10 +531,11 @@ public:
 
     int flags() const override;
 
-    void dataStarted(AbstractAnalysisData* data) override;
+    bool parallelDataStarted(AbstractAnalysisData* data, const AnalysisDataParallelOptions& options) override;
     void frameStarted(const AnalysisDataFrameHeader& header) override;
     void pointsAdded(const AnalysisDataPointSetRef& points) override;
     void frameFinished(const AnalysisDataFrameHeader& header) override;
+    void frameFinishedSerial(int frameIndex) override;
     void dataFinished() override;
 
 private:
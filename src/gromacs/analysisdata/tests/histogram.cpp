@@ -53,6 +53,7 @@
 #include <gtest/gtest.h>
 
 #include "gromacs/analysisdata/analysisdata.h"
+#include "gromacs/analysisdata/paralleloptions.h"
 
 #include "gromacs/analysisdata/tests/datatest.h"
 #include "testutils/testasserts.h"
@@ -402,6 +403,35 @@ TEST_F(BinAverageModuleTest, ComputesCorrectlyWithAll)
 }
 
 
+TEST_F(BinAverageModuleTest, ComputesCorrectlyWithParallelFrames)
+{
+    const AnalysisDataTestInput& input = WeightedSimpleInputData::get();
+    gmx::AnalysisData            data;
+    ASSERT_NO_THROW_GMX(setupDataObject(input, &data));
+
+    gmx::AnalysisDataBinAverageModulePointer module(
+            new gmx::AnalysisDataBinAverageModule(gmx::histogramFromRange(1.0, 3.0).binCount(4)));
+    data.addModule(module);
+
+    ASSERT_NO_THROW_GMX(addStaticCheckerModule(input, &data));
+    ASSERT_NO_THROW_GMX(addReferenceCheckerModule("InputData", &data));
+    ASSERT_NO_THROW_GMX(addReferenceCheckerModule("HistogramAverage", module.get()));
+    gmx::AnalysisDataHandle          handle1;
+    gmx::AnalysisDataHandle          handle2;
+    gmx::AnalysisDataParallelOptions options(2);
+    ASSERT_NO_THROW_GMX(handle1 = data.startData(options));
+    ASSERT_NO_THROW_GMX(handle2 = data.startData(options));
+    ASSERT_NO_THROW_GMX(presentDataFrame(input, 1, handle1));
+    ASSERT_NO_THROW_GMX(presentDataFrame(input, 0, handle2));
+    ASSERT_NO_THROW_GMX(data.finishFrameSerial(0));
+    ASSERT_NO_THROW_GMX(data.finishFrameSerial(1));
+    ASSERT_NO_THROW_GMX(presentDataFrame(input, 2, handle1));
+    ASSERT_NO_THROW_GMX(data.finishFrameSerial(2));
+    ASSERT_NO_THROW_GMX(handle1.finishData());
+    ASSERT_NO_THROW_GMX(handle2.finishData());
+}
+
+
 TEST_F(BinAverageModuleTest, HandlesMultipleDataSets)
 {
     const AnalysisDataTestInput& input = WeightedDataSetInputData::get();
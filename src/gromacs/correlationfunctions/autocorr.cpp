@@ -83,50 +83,6 @@ static gmx_bool bACFinit = FALSE;
 /*! \brief Data structure for storing command line variables. */
 static t_acf acf;
 
-enum
-{
-    enNorm,
-    enCos,
-    enSin
-};
-
-/*! \brief Routine to compute ACF using FFT. */
-static void low_do_four_core(int nframes, real c1[], real cfour[], int nCos)
-{
-    int                            i = 0;
-    std::vector<std::vector<real>> data;
-    data.resize(1);
-    data[0].resize(nframes, 0);
-    switch (nCos)
-    {
-        case enNorm:
-            for (i = 0; (i < nframes); i++)
-            {
-                data[0][i] = c1[i];
-            }
-            break;
-        case enCos:
-            for (i = 0; (i < nframes); i++)
-            {
-                data[0][i] = cos(c1[i]);
-            }
-            break;
-        case enSin:
-            for (i = 0; (i < nframes); i++)
-            {
-                data[0][i] = sin(c1[i]);
-            }
-            break;
-        default: gmx_fatal(FARGS, "nCos = %d, %s %d", nCos, __FILE__, __LINE__);
-    }
-
-    many_auto_correl(&data);
-    for (i = 0; (i < nframes); i++)
-    {
-        cfour[i] = data[0][i];
-    }
-}
-
 /*! \brief Routine to comput ACF without FFT. */
 static void do_ac_core(int nframes, int nout, real corr[], real c1[], int nrestart, unsigned long mode)
 {
@@ -305,226 +261,130 @@ static void average_acf(gmx_bool bVerbose, int n, int nitem, real** c1)
     }
 }
 
-/*! \brief Normalize ACFs. */
-static void norm_and_scale_vectors(int nframes, real c1[], real scale)
+/*! \brief Number of FFT autocorrelations needed per item for \p mode. */
+static int fourSeriesPerItem(unsigned long mode)
 {
-    int   j, m;
-    real* rij;
-
-    for (j = 0; (j < nframes); j++)
+    if (MODE(eacNormal))
     {
-        rij = &(c1[j * DIM]);
-        unitv(rij, rij);
-        for (m = 0; (m < DIM); m++)
-        {
-            rij[m] *= scale;
-        }
+        return 1;
     }
-}
-
-/*! \brief Debugging */
-static void dump_tmp(char* s, int n, real c[])
-{
-    FILE* fp;
-    int   i;
-
-    fp = gmx_ffopen(s, "w");
-    for (i = 0; (i < n); i++)
+    else if (MODE(eacCos))
     {
-        fprintf(fp, "%10d  %10g\n", i, c[i]);
+        return 2;
     }
-    gmx_ffclose(fp);
-}
-
-/*! \brief High level ACF routine. */
-static void do_four_core(unsigned long mode, int nframes, real c1[], real csum[], real ctmp[])
-{
-    real* cfour;
-    char  buf[32];
-    real  fac;
-    int   j, m, m1;
-
-    snew(cfour, nframes);
-
-    if (MODE(eacNormal))
+    else if (MODE(eacP2))
     {
-        /********************************************
-         *  N O R M A L
-         ********************************************/
-        low_do_four_core(nframes, c1, csum, enNorm);
+        return 2 * DIM;
     }
-    else if (MODE(eacCos))
+    else if (MODE(eacP1) || MODE(eacVector))
     {
-        /***************************************************
-         * C O S I N E
-         ***************************************************/
-        /* Copy the data to temp array. Since we need it twice
-         * we can't overwrite original.
-         */
-        for (j = 0; (j < nframes); j++)
-        {
-            ctmp[j] = c1[j];
-        }
+        return DIM;
+    }
+    gmx_fatal(FARGS, "\nUnknown mode in do_autocorr (%lu)", mode);
+}
 
-        /* Cosine term of AC function */
-        low_do_four_core(nframes, ctmp, cfour, enCos);
-        for (j = 0; (j < nframes); j++)
-        {
-            c1[j] = cfour[j];
-        }
+/*! \brief High level ACF routine.
+ *
+ * Computes the ACFs of all \p nitem items using FFTs, batched over items
+ * by many_auto_correl_batched(). Each mode is decomposed into a number of
+ * scalar autocorrelations:
+ *  - normal: the data itself,
+ *  - cosine: cos and sin of the angle, which are summed,
+ *  - vector and P1: the x, y and z components, which are summed,
+ *    after normalizing the vectors for P1,
+ *  - P2: for unit vectors u,
+ *    P2(u(0),u(t)) = [3 * (uX(0) uX(t) + uY(0) uY(t) + uZ(0) uZ(t))^2 - 1]/2
+ *                  = (3/2) * (<uX^2> + <uY^2> + <uZ^2> +
+ *                             2<uXuY> + 2<uXuZ> + 2<uYuZ>) - 0.5,
+ *    so we correlate the three squared components and the three products
+ *    uX uY, uY uZ and uZ uX.
+ *
+ * The result, normalized by the number of time origins, overwrites the
+ * first \p nframes elements of c1[i].
+ */
+static void do_four_core(unsigned long mode, int nframes, int nitem, real** c1)
+{
+    const int  nseries           = fourSeriesPerItem(mode);
+    const bool bNormalizeVectors = (MODE(eacP1) || MODE(eacP2));
 
-        /* Sine term of AC function */
-        low_do_four_core(nframes, ctmp, cfour, enSin);
-        for (j = 0; (j < nframes); j++)
+    auto fillSeries = [mode, nframes, bNormalizeVectors, c1](int i, gmx::ArrayRef<real> series) {
+        const real* data = c1[i];
+        if (MODE(eacNormal))
         {
-            c1[j] += cfour[j];
-            csum[j] = c1[j];
+            std::copy(data, data + nframes, series.begin());
         }
-    }
-    else if (MODE(eacP2))
-    {
-        /***************************************************
-         * Legendre polynomials
-         ***************************************************/
-        /* First normalize the vectors */
-        norm_and_scale_vectors(nframes, c1, 1.0);
-
-        /* For P2 thingies we have to do six FFT based correls
-         * First for XX^2, then for YY^2, then for ZZ^2
-         * Then we have to do XY, YZ and XZ (counting these twice)
-         * After that we sum them and normalise
-         * P2(x) = (3 * cos^2 (x) - 1)/2
-         * for unit vectors u and v we compute the cosine as the inner product
-         * cos(u,v) = uX vX + uY vY + uZ vZ
-         *
-         *        oo
-         *        /
-         * C(t) = |  (3 cos^2(u(t'),u(t'+t)) - 1)/2 dt'
-         *        /
-         *        0
-         *
-         * For ACF we need:
-         * P2(u(0),u(t)) = [3 * (uX(0) uX(t) +
-         *                       uY(0) uY(t) +
-         *                       uZ(0) uZ(t))^2 - 1]/2
-         *               = [3 * ((uX(0) uX(t))^2 +
-         *                       (uY(0) uY(t))^2 +
-         *                       (uZ(0) uZ(t))^2 +
-         *                 2(uX(0) uY(0) uX(t) uY(t)) +
-         *                 2(uX(0) uZ(0) uX(t) uZ(t)) +
-         *                 2(uY(0) uZ(0) uY(t) uZ(t))) - 1]/2
-         *
-         *               = [(3/2) * (<uX^2> + <uY^2> + <uZ^2> +
-         *                         2<uXuY> + 2<uXuZ> + 2<uYuZ>) - 0.5]
-         *
-         */
-
-        /* Because of normalization the number of -0.5 to subtract
-         * depends on the number of data points!
-         */
-        for (j = 0; (j < nframes); j++)
+        else if (MODE(eacCos))
         {
-            csum[j] = -0.5 * (nframes - j);
-        }
-
-        /***** DIAGONAL ELEMENTS ************/
-        for (m = 0; (m < DIM); m++)
-        {
-            /* Copy the vector data in a linear array */
-            for (j = 0; (j < nframes); j++)
-            {
-                ctmp[j] = gmx::square(c1[DIM * j + m]);
-            }
-            if (debug)
-            {
-                sprintf(buf, "c1diag%d.xvg", m);
-                dump_tmp(buf, nframes, ctmp);
-            }
-
-            low_do_four_core(nframes, ctmp, cfour, enNorm);
-
-            if (debug)
+            for (int j = 0; j < nframes; j++)
             {
-                sprintf(buf, "c1dfout%d.xvg", m);
-                dump_tmp(buf, nframes, cfour);
-            }
-            fac = 1.5;
-            for (j = 0; (j < nframes); j++)
-            {
-                csum[j] += fac * (cfour[j]);
+                series[j]           = std::cos(data[j]);
+                series[nframes + j] = std::sin(data[j]);
             }
         }
-        /******* OFF-DIAGONAL ELEMENTS **********/
-        for (m = 0; (m < DIM); m++)
+        else
         {
-            /* Copy the vector data in a linear array */
-            m1 = (m + 1) % DIM;
-            for (j = 0; (j < nframes); j++)
-            {
-                ctmp[j] = c1[DIM * j + m] * c1[DIM * j + m1];
-            }
-
-            if (debug)
+            for (int j = 0; j < nframes; j++)
             {
-                sprintf(buf, "c1off%d.xvg", m);
-                dump_tmp(buf, nframes, ctmp);
+                rvec u;
+                copy_rvec(&data[DIM * j], u);
+                if (bNormalizeVectors)
+                {
+                    unitv(u, u);
+                }
+                for (int m = 0; m < DIM; m++)
+                {
+                    if (MODE(eacP2))
+                    {
+                        series[m * nframes + j]         = gmx::square(u[m]);
+                        series[(DIM + m) * nframes + j] = u[m] * u[(m + 1) % DIM];
+                    }
+                    else
+                    {
+                        series[m * nframes + j] = u[m];
+                    }
+                }
             }
-            low_do_four_core(nframes, ctmp, cfour, enNorm);
-            if (debug)
+        }
+    };
+    auto useCorrelations = [mode, nframes, c1](int i, gmx::ArrayRef<const real> corr) {
+        for (int j = 0; j < nframes; j++)
+        {
+            real csum;
+            if (MODE(eacNormal))
             {
-                sprintf(buf, "c1ofout%d.xvg", m);
-                dump_tmp(buf, nframes, cfour);
+                csum = corr[j];
             }
-            fac = 3.0;
-            for (j = 0; (j < nframes); j++)
+            else if (MODE(eacCos))
             {
-                csum[j] += fac * cfour[j];
+                csum = corr[j] + corr[nframes + j];
             }
-        }
-    }
-    else if (MODE(eacP1) || MODE(eacVector))
-    {
-        /***************************************************
-         * V E C T O R & P1
-         ***************************************************/
-        if (MODE(eacP1))
-        {
-            /* First normalize the vectors */
-            norm_and_scale_vectors(nframes, c1, 1.0);
-        }
-
-        /* For vector thingies we have to do three FFT based correls
-         * First for XX, then for YY, then for ZZ
-         * After that we sum them and normalise
-         */
-        for (j = 0; (j < nframes); j++)
-        {
-            csum[j] = 0.0;
-        }
-        for (m = 0; (m < DIM); m++)
-        {
-            /* Copy the vector data in a linear array */
-            for (j = 0; (j < nframes); j++)
+            else if (MODE(eacP2))
             {
-                ctmp[j] = c1[DIM * j + m];
+                /* Because of normalization the number of -0.5 to subtract
+                 * depends on the number of data points!
+                 */
+                csum = -0.5 * (nframes - j);
+                for (int m = 0; m < DIM; m++)
+                {
+                    csum += 1.5 * corr[m * nframes + j];
+                }
+                for (int m = 0; m < DIM; m++)
+                {
+                    csum += 3.0 * corr[(DIM + m) * nframes + j];
+                }
             }
-            low_do_four_core(nframes, ctmp, cfour, enNorm);
-            for (j = 0; (j < nframes); j++)
+            else
             {
-                csum[j] += cfour[j];
+                csum = 0;
+                for (int m = 0; m < DIM; m++)
+                {
+                    csum += corr[m * nframes + j];
+                }
             }
+            c1[i][j] = csum / static_cast<real>(nframes - j);
         }
-    }
-    else
-    {
-        gmx_fatal(FARGS, "\nUnknown mode in do_autocorr (%lu)", mode);
-    }
-
-    sfree(cfour);
-    for (j = 0; (j < nframes); j++)
-    {
-        c1[j] = csum[j] / static_cast<real>(nframes - j);
-    }
+    };
+    many_auto_correl_batched(nitem, nseries, nframes, fillSeries, useCorrelations);
 }
 
 void low_do_autocorr(const char*             fn,
@@ -546,7 +406,6 @@ void low_do_autocorr(const char*             fn,
 {
     FILE *   fp, *gp = nullptr;
     int      i;
-    real*    csum;
     real *   ctmp, *fit;
     real     sum, Ct2av, Ctav;
     gmx_bool bFour = acf.bFour;
@@ -589,36 +448,33 @@ void low_do_autocorr(const char*             fn,
         printf("mode = %lu, dt = %g, nrestart = %d\n", mode, dt, nrestart);
     }
     /* Allocate temp arrays */
-    snew(csum, nframes);
     snew(ctmp, nframes);
 
     /* Loop over items (e.g. molecules or dihedrals)
      * In this loop the actual correlation functions are computed, but without
      * normalizing them.
      */
-    for (int i = 0; i < nitem; i++)
+    if (bFour)
     {
-        if (bVerbose && (((i % 100) == 0) || (i == nitem - 1)))
-        {
-            fprintf(stderr, "\rThingie %d", i + 1);
-            fflush(stderr);
-        }
-
-        if (bFour)
+        do_four_core(mode, nframes, nitem, c1);
+    }
+    else
+    {
+        for (int i = 0; i < nitem; i++)
         {
-            do_four_core(mode, nframes, c1[i], csum, ctmp);
+            if (bVerbose && (((i % 100) == 0) || (i == nitem - 1)))
+            {
+                fprintf(stderr, "\rThingie %d", i + 1);
+                fflush(stderr);
+            }
+            do_ac_core(nframes, nout, ctmp, c1[i], nrestart, mode);
         }
-        else
+        if (bVerbose)
         {
-            do_ac_core(nframes, nout, ctmp, c1[i], nrestart, mode);
+            fprintf(stderr, "\n");
         }
     }
-    if (bVerbose)
-    {
-        fprintf(stderr, "\n");
-    }
     sfree(ctmp);
-    sfree(csum);
 
     if (fn)
     {
@@ -46,85 +46,175 @@
 #include <algorithm>
 
 #include "gromacs/fft/fft.h"
+#include "gromacs/utility/arrayref.h"
 #include "gromacs/utility/exceptions.h"
-#include "gromacs/utility/gmxomp.h"
 
-int many_auto_correl(std::vector<std::vector<real>>* c)
+namespace
 {
-    size_t nfunc = (*c).size();
-    if (nfunc == 0)
+
+//! Approximate size of the series in a batch, chosen to stay in the L2 cache.
+constexpr size_t c_batchSizeInBytes = 256 * 1024;
+
+/*! \brief
+ * Computes the autocorrelation of two real series with one complex FFT.
+ *
+ * The series are packed as z = x + i y. Since the power spectra of x and y are
+ * real and even, the back transform of |X|^2 + i |Y|^2 gives the
+ * autocorrelation of x in the real part and that of y in the imaginary part.
+ *
+ * \param[in]  fft   Complex FFT setup for \p nfft points.
+ * \param[in]  nfft  Transform length, including zero padding.
+ * \param[in]  x     First series.
+ * \param[in]  y     Second series, or empty.
+ * \param[out] cx    Autocorrelation of \p x.
+ * \param[out] cy    Autocorrelation of \p y, if \p y is not empty.
+ * \param      in    Work array of \p nfft complex values.
+ * \param      out   Work array of \p nfft complex values.
+ */
+void autoCorrelatePair(gmx_fft_t                 fft,
+                       int                       nfft,
+                       gmx::ArrayRef<const real> x,
+                       gmx::ArrayRef<const real> y,
+                       gmx::ArrayRef<real>       cx,
+                       gmx::ArrayRef<real>       cy,
+                       std::vector<t_complex>*   in,
+                       std::vector<t_complex>*   out)
+{
+    const int ndata = x.size();
+    for (int j = 0; j < ndata; j++)
     {
-        GMX_THROW(gmx::InconsistentInputError("Empty array of vectors supplied"));
+        (*in)[j].re = x[j];
+        (*in)[j].im = y.empty() ? 0 : y[j];
     }
-    size_t ndata = (*c)[0].size();
-    if (ndata == 0)
+    std::fill(in->begin() + ndata, in->end(), t_complex{ 0, 0 });
+    gmx_fft_1d(fft, GMX_FFT_FORWARD, in->data(), out->data());
+    const real scale = 0.25 / nfft;
+    for (int k = 0; k < nfft; k++)
     {
-        GMX_THROW(gmx::InconsistentInputError("Empty vector supplied"));
+        const t_complex& zk  = (*out)[k];
+        const t_complex& zmk = (*out)[(nfft - k) % nfft];
+        // X_k = (Z_k + conj(Z_-k))/2 and Y_k = (Z_k - conj(Z_-k))/(2i)
+        const real xre = zk.re + zmk.re;
+        const real xim = zk.im - zmk.im;
+        const real yre = zk.re - zmk.re;
+        const real yim = zk.im + zmk.im;
+        (*in)[k].re    = scale * (xre * xre + xim * xim);
+        (*in)[k].im    = scale * (yre * yre + yim * yim);
     }
-#ifndef NDEBUG
-    for (size_t i = 1; i < nfunc; i++)
+    gmx_fft_1d(fft, GMX_FFT_BACKWARD, in->data(), out->data());
+    for (int j = 0; j < ndata; j++)
     {
-        if ((*c)[i].size() != ndata)
+        cx[j] = (*out)[j].re;
+    }
+    if (!y.empty())
+    {
+        for (int j = 0; j < ndata; j++)
         {
-            char buf[256];
-            snprintf(buf, sizeof(buf), "Vectors of different lengths supplied (%d %d)",
-                     static_cast<int>((*c)[i].size()), static_cast<int>(ndata));
-            GMX_THROW(gmx::InconsistentInputError(buf));
+            cy[j] = (*out)[j].im;
         }
     }
-#endif
-    // Add buffer size to the arrays.
-    size_t nfft = (3 * ndata / 2) + 1;
-    // Pad arrays with zeros
-    for (auto& i : *c)
+}
+
+} // namespace
+
+void many_auto_correl_batched(int                                                         nitem,
+                              int                                                         nseries,
+                              int                                                         ndata,
+                              const std::function<void(int, gmx::ArrayRef<real>)>&       fillSeries,
+                              const std::function<void(int, gmx::ArrayRef<const real>)>& useCorrelations)
+{
+    if (nitem <= 0 || nseries <= 0 || ndata <= 0)
     {
-        i.resize(nfft, 0);
+        GMX_THROW(gmx::InconsistentInputError("Empty data supplied for autocorrelation"));
     }
+    // Same zero padding as has always been used by many_auto_correl()
+    const int    nfft         = (3 * ndata / 2) + 1;
+    const size_t itemSize     = static_cast<size_t>(nseries) * ndata;
+    const int    itemsInBatch = static_cast<int>(
+            std::max<size_t>(1, c_batchSizeInBytes / (itemSize * sizeof(real))));
+    const int nbatch = (nitem + itemsInBatch - 1) / itemsInBatch;
+
 #pragma omp parallel
     {
         try
         {
-            gmx_fft_t         fft1;
-            std::vector<real> in, out;
-
-            int nthreads  = gmx_omp_get_max_threads();
-            int thread_id = gmx_omp_get_thread_num();
-            int i0        = (thread_id * nfunc) / nthreads;
-            int i1        = std::min(nfunc, ((thread_id + 1) * nfunc) / nthreads);
+            gmx_fft_t fft;
+            gmx_fft_init_1d(&fft, nfft, GMX_FFT_FLAG_CONSERVATIVE);
+            std::vector<t_complex> in(nfft), out(nfft);
+            std::vector<real>      series(itemsInBatch * itemSize);
+            std::vector<real>      correlations(itemsInBatch * itemSize);
 
-            gmx_fft_init_1d(&fft1, nfft, GMX_FFT_FLAG_CONSERVATIVE);
-            /* Allocate temporary arrays */
-            in.resize(2 * nfft, 0);
-            out.resize(2 * nfft, 0);
-            for (int i = i0; (i < i1); i++)
+#pragma omp for schedule(dynamic)
+            for (int batch = 0; batch < nbatch; batch++)
             {
-                for (size_t j = 0; j < ndata; j++)
+                const int firstItem = batch * itemsInBatch;
+                const int numItems  = std::min(itemsInBatch, nitem - firstItem);
+                gmx::ArrayRef<real> batchSeries = gmx::arrayRefFromArray(series.data(), numItems * itemSize);
+                gmx::ArrayRef<real> batchCorrelations =
+                        gmx::arrayRefFromArray(correlations.data(), numItems * itemSize);
+                for (int i = 0; i < numItems; i++)
                 {
-                    in[2 * j + 0] = (*c)[i][j];
-                    in[2 * j + 1] = 0;
+                    fillSeries(firstItem + i, batchSeries.subArray(i * itemSize, itemSize));
                 }
-                gmx_fft_1d(fft1, GMX_FFT_BACKWARD, in.data(), out.data());
-                for (size_t j = 0; j < nfft; j++)
+                // All series in the batch are transformed in pairs,
+                // independent of the items they belong to.
+                const int numSeries = numItems * nseries;
+                for (int s = 0; s < numSeries; s += 2)
                 {
-                    in[2 * j + 0] =
-                            (out[2 * j + 0] * out[2 * j + 0] + out[2 * j + 1] * out[2 * j + 1]) / nfft;
-                    in[2 * j + 1] = 0;
+                    const bool          havePair = (s + 1 < numSeries);
+                    gmx::ArrayRef<real> y;
+                    gmx::ArrayRef<real> cy;
+                    if (havePair)
+                    {
+                        y  = batchSeries.subArray((s + 1) * ndata, ndata);
+                        cy = batchCorrelations.subArray((s + 1) * ndata, ndata);
+                    }
+                    autoCorrelatePair(fft, nfft, batchSeries.subArray(s * ndata, ndata), y,
+                                      batchCorrelations.subArray(s * ndata, ndata), cy, &in, &out);
                 }
-                gmx_fft_1d(fft1, GMX_FFT_FORWARD, in.data(), out.data());
-                for (size_t j = 0; (j < nfft); j++)
+                for (int i = 0; i < numItems; i++)
                 {
-                    (*c)[i][j] = out[2 * j + 0];
+                    useCorrelations(firstItem + i, batchCorrelations.subArray(i * itemSize, itemSize));
                 }
             }
-            /* Free the memory */
-            gmx_fft_destroy(fft1);
+            gmx_fft_destroy(fft);
         }
         GMX_CATCH_ALL_AND_EXIT_WITH_FATAL_ERROR
     }
-    for (auto& i : *c)
+}
+
+int many_auto_correl(std::vector<std::vector<real>>* c)
+{
+    size_t nfunc = (*c).size();
+    if (nfunc == 0)
+    {
+        GMX_THROW(gmx::InconsistentInputError("Empty array of vectors supplied"));
+    }
+    size_t ndata = (*c)[0].size();
+    if (ndata == 0)
+    {
+        GMX_THROW(gmx::InconsistentInputError("Empty vector supplied"));
+    }
+#ifndef NDEBUG
+    for (size_t i = 1; i < nfunc; i++)
     {
-        i.resize(ndata);
+        if ((*c)[i].size() != ndata)
+        {
+            char buf[256];
+            snprintf(buf, sizeof(buf), "Vectors of different lengths supplied (%d %d)",
+                     static_cast<int>((*c)[i].size()), static_cast<int>(ndata));
+            GMX_THROW(gmx::InconsistentInputError(buf));
+        }
     }
+#endif
+    many_auto_correl_batched(
+            nfunc, 1, ndata,
+            [c](int i, gmx::ArrayRef<real> series) {
+                std::copy((*c)[i].begin(), (*c)[i].end(), series.begin());
+            },
+            [c](int i, gmx::ArrayRef<const real> correlation) {
+                std::copy(correlation.begin(), correlation.end(), (*c)[i].begin());
+            });
 
     return 0;
 }
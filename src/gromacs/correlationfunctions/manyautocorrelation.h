@@ -44,9 +44,11 @@
 #ifndef GMX_MANYAUTOCORRELATION_H
 #define GMX_MANYAUTOCORRELATION_H
 
+#include <functional>
 #include <vector>
 
 #include "gromacs/fft/fft.h"
+#include "gromacs/utility/arrayref.h"
 #include "gromacs/utility/real.h"
 
 /*! \brief
@@ -62,7 +64,8 @@
  * The c arrays will be extend and filled with zero beyond ndata before
  * computing the correlation.
  *
- * The functions uses OpenMP parallellization.
+ * The functions uses OpenMP parallellization, see
+ * many_auto_correl_batched().
  *
  * \param[inout] c Data array
  * \return fft error code, or zero if everything went fine (see fft/fft.h)
@@ -70,4 +73,36 @@
  */
 int many_auto_correl(std::vector<std::vector<real>>* c);
 
+/*! \brief
+ * Perform autocorrelation calculations for many items in batches.
+ *
+ * Each of the \p nitem items consists of \p nseries real series of
+ * length \p ndata. \p fillSeries is called to write the series of an
+ * item to a buffer of nseries*ndata values, one series after the other.
+ * \p useCorrelations is then called with the autocorrelation functions of
+ * these series in the same layout. The functions are not normalized, i.e.,
+ * element j is the sum over k of x[k]*x[k+j]. The same zero padding as
+ * in many_auto_correl() is used, so this is exact for j <= ndata/2, and
+ * longer lags are affected by periodicity.
+ *
+ * The items are processed in batches that fit in cache, and the batches
+ * are divided over OpenMP threads. Each thread sets up its FFT and work
+ * arrays only once, and transforms two real series with one complex FFT.
+ * The callbacks are called concurrently for different items, but for
+ * each item from a single thread, first \p fillSeries and then
+ * \p useCorrelations.
+ *
+ * \param[in] nitem            Number of items.
+ * \param[in] nseries          Number of series per item.
+ * \param[in] ndata            Length of each series.
+ * \param[in] fillSeries       Writes the series for an item.
+ * \param[in] useCorrelations  Receives the autocorrelations for an item.
+ * \throws gmx::InconsistentInputError if the input is empty.
+ */
+void many_auto_correl_batched(int                                                         nitem,
+                              int                                                         nseries,
+                              int                                                         ndata,
+                              const std::function<void(int, gmx::ArrayRef<real>)>&       fillSeries,
+                              const std::function<void(int, gmx::ArrayRef<const real>)>& useCorrelations);
+
 #endif
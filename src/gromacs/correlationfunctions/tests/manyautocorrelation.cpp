@@ -46,9 +46,11 @@
 #include <cmath>
 
 #include <memory>
+#include <vector>
 
 #include <gtest/gtest.h>
 
+#include "gromacs/utility/arrayref.h"
 #include "gromacs/utility/exceptions.h"
 
 #include "testutils/testasserts.h"
@@ -61,6 +63,31 @@ namespace
 
 class ManyAutocorrelationTest : public ::testing::Test
 {
+public:
+    //! Returns a deterministic, non-trivial value for element \p j of series \p s.
+    static real seriesValue(int s, int j) { return std::sin(0.1 * j * (s + 1) + s) + 0.01 * s; }
+
+    /*! \brief Number of lags for which the FFT result is exact.
+     *
+     * With the zero padding used, longer lags are affected by periodicity.
+     */
+    static int exactLags(int ndata) { return ndata / 2 + 1; }
+
+    //! Computes the unnormalized autocorrelation of series \p s by direct summation.
+    static std::vector<real> referenceCorrelation(int s, int ndata)
+    {
+        std::vector<real> result(ndata);
+        for (int j = 0; j < ndata; j++)
+        {
+            double sum = 0;
+            for (int k = 0; k + j < ndata; k++)
+            {
+                sum += seriesValue(s, k) * seriesValue(s, k + j);
+            }
+            result[j] = sum;
+        }
+        return result;
+    }
 };
 
 TEST_F(ManyAutocorrelationTest, Empty)
@@ -69,6 +96,80 @@ TEST_F(ManyAutocorrelationTest, Empty)
     EXPECT_THROW_GMX(many_auto_correl(&c), gmx::InconsistentInputError);
 }
 
+TEST_F(ManyAutocorrelationTest, ComputesCorrelations)
+{
+    // An odd number of series, so that one series is transformed alone
+    const int                      nfunc = 3;
+    const int                      ndata = 101;
+    std::vector<std::vector<real>> c(nfunc, std::vector<real>(ndata));
+    for (int s = 0; s < nfunc; s++)
+    {
+        for (int j = 0; j < ndata; j++)
+        {
+            c[s][j] = seriesValue(s, j);
+        }
+    }
+    many_auto_correl(&c);
+    const test::FloatingPointTolerance tolerance = test::absoluteTolerance(ndata * 1e-4);
+    for (int s = 0; s < nfunc; s++)
+    {
+        std::vector<real> reference = referenceCorrelation(s, ndata);
+        for (int j = 0; j < exactLags(ndata); j++)
+        {
+            EXPECT_REAL_EQ_TOL(reference[j], c[s][j], tolerance) << "series " << s << " j " << j;
+        }
+    }
+}
+
+TEST_F(ManyAutocorrelationTest, ComputesCorrelationsInBatches)
+{
+    // Enough items to fill several batches, with an odd number of series in each
+    const int                      nitem   = 80;
+    const int                      nseries = 3;
+    const int                      ndata   = 500;
+    std::vector<std::vector<real>> reference(nitem * nseries);
+    for (int s = 0; s < nitem * nseries; s++)
+    {
+        reference[s] = referenceCorrelation(s, ndata);
+    }
+    std::vector<int>  numCalls(nitem, 0);
+    std::vector<real> maxError(nitem, 0);
+    many_auto_correl_batched(
+            nitem, nseries, ndata,
+            [&numCalls](int i, ArrayRef<real> series) {
+                ++numCalls[i];
+                for (int m = 0; m < nseries; m++)
+                {
+                    for (int j = 0; j < ndata; j++)
+                    {
+                        series[m * ndata + j] = seriesValue(i * nseries + m, j);
+                    }
+                }
+            },
+            [&reference, &maxError](int i, ArrayRef<const real> corr) {
+                for (int m = 0; m < nseries; m++)
+                {
+                    for (int j = 0; j < exactLags(ndata); j++)
+                    {
+                        maxError[i] = std::max<real>(
+                                maxError[i], std::abs(corr[m * ndata + j] - reference[i * nseries + m][j]));
+                    }
+                }
+            });
+    for (int i = 0; i < nitem; i++)
+    {
+        EXPECT_EQ(1, numCalls[i]) << "item " << i;
+        EXPECT_LT(maxError[i], ndata * 1e-4) << "item " << i;
+    }
+}
+
+TEST_F(ManyAutocorrelationTest, BatchedEmpty)
+{
+    EXPECT_THROW_GMX(many_auto_correl_batched(
+                             0, 1, 10, [](int, ArrayRef<real>) {}, [](int, ArrayRef<const real>) {}),
+                     gmx::InconsistentInputError);
+}
+
 #ifndef NDEBUG
 TEST_F(ManyAutocorrelationTest, DifferentLength)
 {
@@ -49,10 +49,13 @@
 #include <string>
 
 #include "gromacs/gmxana/gmx_ana.h"
+#include "gromacs/utility/textreader.h"
 
 #include "testutils/cmdlinetest.h"
+#include "testutils/setenv.h"
 #include "testutils/stdiohelper.h"
 #include "testutils/testasserts.h"
+#include "testutils/testfilemanager.h"
 #include "testutils/textblockmatchers.h"
 #include "testutils/xvgtest.h"
 
@@ -154,6 +157,56 @@ TEST_F(EnergyTest, ExtractEnergyMixed)
     runTest("Pressu\n7\nbox-z\nvol\n");
 }
 
+class EnergyBeginTimeTest : public CommandLineTestBase
+{
+public:
+    //! Runs gmx energy -b \p beginTime on the test file and returns the .xvg output
+    std::string runEnergy(const char* beginTime, const char* outputName)
+    {
+        CommandLine cmdline;
+        cmdline.append("energy");
+        cmdline.addOption("-f", fileManager().getInputFilePath("ener.edr"));
+        cmdline.addOption("-b", beginTime);
+        std::string outputFile = fileManager().getTemporaryFilePath(outputName);
+        cmdline.addOption("-o", outputFile);
+        cmdline.addOption("-xvg", "none");
+
+        StdioTestHelper stdioHelper(&fileManager());
+        stdioHelper.redirectStringToStdin("Potential\nPressure\n");
+        EXPECT_EQ(0, gmx_energy(cmdline.argc(), cmdline.argv()));
+
+        return TextReader::readFileToString(outputFile);
+    }
+
+    //! Checks that the output is the same with and without jumping to \p beginTime
+    void runTest(const char* beginTime)
+    {
+        const std::string withIndex = runEnergy(beginTime, "withindex.xvg");
+        gmxSetenv("GMX_ENER_NO_INDEX", "1", true);
+        const std::string withoutIndex = runEnergy(beginTime, "withoutindex.xvg");
+        gmxUnsetenv("GMX_ENER_NO_INDEX");
+
+        EXPECT_EQ(withoutIndex, withIndex);
+        // The first frame written should be the one at the begin time
+        EXPECT_FLOAT_EQ(std::stof(beginTime), std::stof(withIndex));
+    }
+};
+
+/* The frame times are stored in double precision, while -b and the time
+ * checks use real precision. 0.6 is a frame time that in double is
+ * smaller than the begin time in float, so it tests that the frame
+ * index does not skip frames that the time check accepts.
+ */
+TEST_F(EnergyBeginTimeTest, SameOutputWithAndWithoutFrameIndex)
+{
+    runTest("0.6");
+}
+
+TEST_F(EnergyBeginTimeTest, SameOutputWithAndWithoutFrameIndexAtFirstFrame)
+{
+    runTest("0");
+}
+
 class ViscosityTest : public CommandLineTestBase
 {
 public:
@@ -44,11 +44,15 @@
 #include "config.h"
 
 #include <cerrno>
+#include <cinttypes>
 #include <cstdlib>
 #include <cstring>
 
+#include <algorithm>
 #include <array>
 #include <memory>
+#include <string>
+#include <vector>
 
 #include "buildinfo.h"
 #include "gromacs/fileio/filetypes.h"
@@ -77,9 +81,11 @@
 #include "gromacs/utility/arrayref.h"
 #include "gromacs/utility/baseversion.h"
 #include "gromacs/utility/cstringutil.h"
+#include "gromacs/utility/exceptions.h"
 #include "gromacs/utility/fatalerror.h"
 #include "gromacs/utility/futil.h"
 #include "gromacs/utility/gmxassert.h"
+#include "gromacs/utility/gmxomp.h"
 #include "gromacs/utility/int64_to_int.h"
 #include "gromacs/utility/keyvaluetree.h"
 #include "gromacs/utility/keyvaluetreebuilder.h"
@@ -87,9 +93,12 @@
 #include "gromacs/utility/mdmodulenotification.h"
 #include "gromacs/utility/programcontext.h"
 #include "gromacs/utility/smalloc.h"
+#include "gromacs/utility/stringutil.h"
 #include "gromacs/utility/sysinfo.h"
 #include "gromacs/utility/txtdump.h"
 
+#include "checkpoint_impl.h"
+
 #if GMX_FAHCORE
 #    include "corewrap.h"
 #endif
@@ -113,7 +122,8 @@ enum cptv
     cptv_ComPrevStepAsPullGroupReference, /**< Allow using COM of previous step as pull group PBC reference */
     cptv_PullAverage, /**< Added possibility to output average pull force and position */
     cptv_MdModules,   /**< Added checkpointing for MdModules */
-    cptv_Count        /**< the total number of cptv versions */
+    cptv_ChunkedStateVectors, /**< Per-atom state vectors stored in checksummed chunks */
+    cptv_Count                /**< the total number of cptv versions */
 };
 
 /*! \brief Version number of the file format written to checkpoint
@@ -836,6 +846,173 @@ doRvecVector(XDR* xd, StatePart part, int ecpt, int sflags, PaddedVectorOfRVecTy
     }
 }
 
+//! Number of reals in a chunk of a per-atom state vector
+static constexpr int c_stateVectorChunkSize = DIM * 32768;
+
+/*! \brief Returns a Fletcher-style checksum of the big-endian 32-bit words in \p bytes
+ *
+ * The two running sums wrap modulo 2^64, the result is independent of
+ * the endianness of the host.
+ */
+static int64_t chunkChecksum(const unsigned char* bytes, int64_t numBytes)
+{
+    uint64_t sum1 = 0;
+    uint64_t sum2 = 0;
+    for (int64_t i = 0; i + 4 <= numBytes; i += 4)
+    {
+        sum1 += (uint64_t(bytes[i]) << 24) | (uint64_t(bytes[i + 1]) << 16)
+                | (uint64_t(bytes[i + 2]) << 8) | uint64_t(bytes[i + 3]);
+        sum2 += sum1;
+    }
+    return static_cast<int64_t>((sum2 << 32) ^ sum1);
+}
+
+/*! \brief Reads/writes a per-atom vector of rvecs as checksummed chunks
+ *
+ * The data is stored as the element count and type, the chunk size,
+ * a checksum for every chunk and the XDR representation of all
+ * elements as one opaque block. Converting and checksumming the chunks
+ * is done in parallel with OpenMP. On read all chunks are verified
+ * and the atom ranges of all damaged chunks are reported.
+ *
+ * Note that the chunks are not streamed: the XDR bytes of the whole
+ * vector are passed to a single xdr_opaque() call, so during the i/o
+ * a full extra copy of the vector is held in memory.
+ */
+template<typename PaddedVectorOfRVecType>
+static int doChunkedRvecVector(XDR*                    xd,
+                               StatePart               part,
+                               int                     ecpt,
+                               int                     sflags,
+                               PaddedVectorOfRVecType* v,
+                               int                     numAtoms,
+                               FILE*                   list)
+{
+    const bool bRead = (xd->x_op == XDR_DECODE);
+
+    if (list == nullptr)
+    {
+        GMX_RELEASE_ASSERT(
+                sflags & (1 << ecpt),
+                "When not listing, the flag for the entry should be set when requesting i/o");
+        GMX_RELEASE_ASSERT(v->size() >= numAtoms, "v should have sufficient size for numAtoms");
+    }
+
+    int numReals  = numAtoms * DIM;
+    int xdrType   = xdr_type<real>::value;
+    int chunkSize = c_stateVectorChunkSize;
+    if (xdr_int(xd, &numReals) == 0 || xdr_int(xd, &xdrType) == 0 || xdr_int(xd, &chunkSize) == 0)
+    {
+        return -1;
+    }
+    if (list == nullptr && numReals != numAtoms * DIM)
+    {
+        gmx_fatal(FARGS, "Count mismatch for state entry %s, code count is %d, file count is %d\n",
+                  entryName(part, ecpt), numAtoms * DIM, numReals);
+    }
+    if ((xdrType != xdr_datatype_float && xdrType != xdr_datatype_double) || chunkSize <= 0)
+    {
+        gmx_fatal(FARGS, "Incompatible checkpoint formats or corrupted checkpoint file for state entry %s",
+                  entryName(part, ecpt));
+    }
+
+    const int64_t elementSize = sizeOfXdrType(xdrType);
+    const int     numChunks   = (numReals + chunkSize - 1) / chunkSize;
+    const int     numThreads  = std::max(1, gmx_omp_get_max_threads());
+
+    std::vector<int64_t>       checksums(numChunks);
+    std::vector<unsigned char> bytes(numReals * elementSize);
+    real*                      data = nullptr;
+    std::vector<real>          listData;
+    if (list != nullptr)
+    {
+        listData.resize(numReals);
+        data = listData.data();
+    }
+    else
+    {
+        data = as_rvec_array(v->data())[0];
+    }
+
+    if (!bRead)
+    {
+#pragma omp parallel for num_threads(numThreads) schedule(static)
+        for (int chunk = 0; chunk < numChunks; chunk++)
+        {
+            try
+            {
+                const int64_t start = int64_t(chunk) * chunkSize;
+                const int64_t end   = std::min<int64_t>(start + chunkSize, numReals);
+                xdr_reals_to_bytes(data + start, end - start, bytes.data() + start * elementSize);
+                checksums[chunk] = chunkChecksum(bytes.data() + start * elementSize,
+                                                 (end - start) * elementSize);
+            }
+            GMX_CATCH_ALL_AND_EXIT_WITH_FATAL_ERROR
+        }
+    }
+
+    for (int chunk = 0; chunk < numChunks; chunk++)
+    {
+        if (xdr_int64(xd, &checksums[chunk]) == 0)
+        {
+            return -1;
+        }
+    }
+    if (xdr_opaque(xd, reinterpret_cast<char*>(bytes.data()), bytes.size()) == 0)
+    {
+        return -1;
+    }
+
+    if (bRead)
+    {
+        std::vector<char> chunkIsDamaged(numChunks, 0);
+#pragma omp parallel for num_threads(numThreads) schedule(static)
+        for (int chunk = 0; chunk < numChunks; chunk++)
+        {
+            try
+            {
+                const int64_t start = int64_t(chunk) * chunkSize;
+                const int64_t end   = std::min<int64_t>(start + chunkSize, numReals);
+                chunkIsDamaged[chunk] = (chunkChecksum(bytes.data() + start * elementSize,
+                                                       (end - start) * elementSize)
+                                         != checksums[chunk]);
+                xdr_reals_from_bytes(bytes.data() + start * elementSize,
+                                     xdrType == xdr_datatype_double, end - start, data + start);
+            }
+            GMX_CATCH_ALL_AND_EXIT_WITH_FATAL_ERROR
+        }
+
+        std::string damagedRanges;
+        for (int chunk = 0; chunk < numChunks; chunk++)
+        {
+            if (chunkIsDamaged[chunk])
+            {
+                const int64_t start = int64_t(chunk) * chunkSize;
+                const int64_t end   = std::min<int64_t>(start + chunkSize, numReals);
+                damagedRanges += gmx::formatString(" %" PRId64 "-%" PRId64, start / DIM + 1, end / DIM);
+            }
+        }
+        if (!damagedRanges.empty())
+        {
+            if (list == nullptr)
+            {
+                gmx_fatal(FARGS,
+                          "Checksum mismatch for state entry %s in atom range(s)%s, the checkpoint "
+                          "file is corrupted",
+                          entryName(part, ecpt), damagedRanges.c_str());
+            }
+            fprintf(list, "Checksum mismatch for %s in atom range(s)%s\n", entryName(part, ecpt),
+                    damagedRanges.c_str());
+        }
+        if (list != nullptr)
+        {
+            pr_rvecs(list, 0, entryName(part, ecpt), reinterpret_cast<const rvec*>(data), numReals / DIM);
+        }
+    }
+
+    return 0;
+}
+
 /* This function stores n along with the reals for reading,
  * but on reading it assumes that n matches the value in the checkpoint file,
  * a fatal error is generated when this is not the case.
@@ -1206,7 +1383,7 @@ static int do_cpt_footer(XDR* xd, int file_version)
     return 0;
 }
 
-static int do_cpt_state(XDR* xd, int fflags, t_state* state, FILE* list)
+static int do_cpt_state(XDR* xd, int fileVersion, int fflags, t_state* state, FILE* list)
 {
     int             ret    = 0;
     const StatePart part   = StatePart::microState;
@@ -1265,10 +1442,16 @@ static int do_cpt_state(XDR* xd, int fflags, t_state* state, FILE* list)
                 case estVETA: ret = do_cpte_real(xd, part, i, sflags, &state->veta, list); break;
                 case estVOL0: ret = do_cpte_real(xd, part, i, sflags, &state->vol0, list); break;
                 case estX:
-                    ret = doRvecVector(xd, part, i, sflags, &state->x, state->natoms, list);
+                    ret = (fileVersion >= cptv_ChunkedStateVectors)
+                                  ? doChunkedRvecVector(xd, part, i, sflags, &state->x,
+                                                        state->natoms, list)
+                                  : doRvecVector(xd, part, i, sflags, &state->x, state->natoms, list);
                     break;
                 case estV:
-                    ret = doRvecVector(xd, part, i, sflags, &state->v, state->natoms, list);
+                    ret = (fileVersion >= cptv_ChunkedStateVectors)
+                                  ? doChunkedRvecVector(xd, part, i, sflags, &state->v,
+                                                        state->natoms, list)
+                                  : doRvecVector(xd, part, i, sflags, &state->v, state->natoms, list);
                     break;
                 /* The RNG entries are no longer written,
                  * the next 4 lines are only for reading old files.
@@ -2367,7 +2550,7 @@ void write_checkpoint(const char*                   fn,
 
     do_cpt_header(gmx_fio_getxdr(fp), FALSE, nullptr, &headerContents);
 
-    if ((do_cpt_state(gmx_fio_getxdr(fp), state->flags, state, nullptr) < 0)
+    if ((do_cpt_state(gmx_fio_getxdr(fp), headerContents.file_version, state->flags, state, nullptr) < 0)
         || (do_cpt_ekinstate(gmx_fio_getxdr(fp), flags_eks, &state->ekinstate, nullptr) < 0)
         || (do_cpt_enerhist(gmx_fio_getxdr(fp), FALSE, flags_enh, enerhist, nullptr) < 0)
         || (doCptPullHist(gmx_fio_getxdr(fp), FALSE, flagsPullHistory, pullHist, StatePart::pullHistory, nullptr)
@@ -2704,7 +2887,8 @@ static void read_checkpoint(const char*                   fn,
         check_match(fplog, cr, dd_nc, *headerContents, reproducibilityRequested);
     }
 
-    ret             = do_cpt_state(gmx_fio_getxdr(fp), headerContents->flags_state, state, nullptr);
+    ret             = do_cpt_state(gmx_fio_getxdr(fp), headerContents->file_version,
+                                   headerContents->flags_state, state, nullptr);
     *init_fep_state = state->fep_state; /* there should be a better way to do this than setting it
                                            here. Investigate for 5.0. */
     if (ret)
@@ -2899,7 +3083,8 @@ static CheckpointHeaderContents read_checkpoint_data(t_fileio*
     state->nnhpres       = headerContents.nnhpres;
     state->nhchainlength = headerContents.nhchainlength;
     state->flags         = headerContents.flags_state;
-    int ret              = do_cpt_state(gmx_fio_getxdr(fp), state->flags, state, nullptr);
+    int ret              = do_cpt_state(gmx_fio_getxdr(fp), headerContents.file_version,
+                                    state->flags, state, nullptr);
     if (ret)
     {
         cp_error();
@@ -3015,7 +3200,7 @@ void list_checkpoint(const char* fn, FILE* out)
     state.nnhpres       = headerContents.nnhpres;
     state.nhchainlength = headerContents.nhchainlength;
     state.flags         = headerContents.flags_state;
-    ret                 = do_cpt_state(gmx_fio_getxdr(fp), state.flags, &state, out);
+    ret = do_cpt_state(gmx_fio_getxdr(fp), headerContents.file_version, state.flags, &state, out);
     if (ret)
     {
         cp_error();
@@ -3080,6 +3265,14 @@ void list_checkpoint(const char* fn, FILE* out)
     }
 }
 
+int doCheckpointStateVectors(t_fileio* fp, bool useChunkedFormat, t_state* state)
+{
+    const int fileVersion = useChunkedFormat ? cptv_ChunkedStateVectors : cptv_ChunkedStateVectors - 1;
+    const int fflags      = state->flags & ((1 << estX) | (1 << estV));
+
+    return do_cpt_state(gmx_fio_getxdr(fp), fileVersion, fflags, state, nullptr);
+}
+
 /* This routine cannot print tons of data, since it is called before the log file is opened. */
 CheckpointHeaderContents read_checkpoint_simulation_part_and_filenames(t_fileio* fp,
                                                                        std::vector<gmx_file_position_t>* outputfiles)
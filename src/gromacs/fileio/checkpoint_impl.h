@@ -0,0 +1,62 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2020, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \internal \file
+ * \brief
+ * Declares checkpoint routines that are internal to the fileio module.
+ *
+ * These are exposed only for testing the checkpoint storage format.
+ *
+ * \ingroup module_fileio
+ */
+#ifndef GMX_FILEIO_CHECKPOINT_IMPL_H
+#define GMX_FILEIO_CHECKPOINT_IMPL_H
+
+struct t_fileio;
+class t_state;
+
+/*! \brief Reads or writes only the coordinates and velocities of \p state
+ *
+ * The vectors are stored in the format of checkpoint files with
+ * checksummed chunks when \p useChunkedFormat is true and in the format
+ * of the previous checkpoint version otherwise. The entries to store are
+ * selected by state->flags, the direction by the mode \p fp was opened
+ * with. Used for testing the storage of per-atom state vectors.
+ *
+ * Generates a fatal error when a chunk read has a wrong checksum.
+ *
+ * \returns 0 on success, a negative value on an i/o error */
+int doCheckpointStateVectors(t_fileio* fp, bool useChunkedFormat, t_state* state);
+
+#endif
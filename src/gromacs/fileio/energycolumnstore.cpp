@@ -0,0 +1,567 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2021, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \internal \file
+ * \brief
+ * Implements the column-oriented energy store.
+ *
+ * The file starts with a magic number, a version and the offset of the
+ * trailer. It is followed by the values of all terms as big-endian
+ * doubles, one contiguous array per term. The trailer holds the chunk
+ * size, the names and units of the terms, the times and steps of the
+ * frames and the chunk summaries, all in XDR format.
+ *
+ * \ingroup module_fileio
+ */
+#include "gmxpre.h"
+
+#include "energycolumnstore.h"
+
+#include <cinttypes>
+#include <cmath>
+#include <cstdio>
+
+#include <algorithm>
+#include <limits>
+
+#include "gromacs/fileio/enxio.h"
+#include "gromacs/fileio/xdrf.h"
+#include "gromacs/trajectory/energyframe.h"
+#include "gromacs/utility/exceptions.h"
+#include "gromacs/utility/gmxassert.h"
+#include "gromacs/utility/stringutil.h"
+
+namespace gmx
+{
+
+namespace
+{
+
+//! Magic number identifying an energy column store, "ECOL" in ASCII
+const int c_energyColumnStoreMagic = 0x45434F4C;
+//! Version of the energy column store format
+const int c_energyColumnStoreVersion = 1;
+//! Size in bytes of the header, magic number, version and trailer offset
+const gmx_off_t c_headerSize = 16;
+
+/*! \brief Moments of the values and times of a range of frames
+ *
+ * Second moments are taken about the means, so ranges can be combined
+ * without the cancellation errors of sums of squares.
+ */
+struct Moments
+{
+    //! Number of frames
+    int64_t n = 0;
+    //! Mean time
+    double meanTime = 0;
+    //! Sum of squared deviations of the times from meanTime
+    double timeSquaredDeviations = 0;
+    //! Mean value
+    double mean = 0;
+    //! Sum of squared deviations of the values from mean
+    double squaredDeviations = 0;
+    //! Sum of products of the time and value deviations
+    double timeValueDeviations = 0;
+    //! Smallest value
+    double min = std::numeric_limits<double>::max();
+    //! Largest value
+    double max = std::numeric_limits<double>::lowest();
+};
+
+//! Returns the moments of \p n frames with \p times and \p values
+Moments computeMoments(const double* times, const double* values, int64_t n)
+{
+    Moments m;
+    m.n = n;
+    if (n == 0)
+    {
+        return m;
+    }
+    /* Contiguous reductions without dependencies between iterations,
+     * so the compiler can vectorize them. */
+    double sumTime = 0;
+    double sum     = 0;
+    for (int64_t i = 0; i < n; i++)
+    {
+        sumTime += times[i];
+        sum += values[i];
+        m.min = std::min(m.min, values[i]);
+        m.max = std::max(m.max, values[i]);
+    }
+    m.meanTime = sumTime / n;
+    m.mean     = sum / n;
+    for (int64_t i = 0; i < n; i++)
+    {
+        double dt = times[i] - m.meanTime;
+        double dv = values[i] - m.mean;
+        m.timeSquaredDeviations += dt * dt;
+        m.squaredDeviations += dv * dv;
+        m.timeValueDeviations += dt * dv;
+    }
+    return m;
+}
+
+//! Adds the moments \p b to \p a
+void combineMoments(Moments* a, const Moments& b)
+{
+    if (b.n == 0)
+    {
+        return;
+    }
+    if (a->n == 0)
+    {
+        *a = b;
+        return;
+    }
+    const int64_t n  = a->n + b.n;
+    const double  dt = b.meanTime - a->meanTime;
+    const double  dv = b.mean - a->mean;
+    const double  f  = static_cast<double>(a->n) * b.n / n;
+    a->timeSquaredDeviations += b.timeSquaredDeviations + dt * dt * f;
+    a->squaredDeviations += b.squaredDeviations + dv * dv * f;
+    a->timeValueDeviations += b.timeValueDeviations + dt * dv * f;
+    a->meanTime += dt * b.n / n;
+    a->mean += dv * b.n / n;
+    a->min = std::min(a->min, b.min);
+    a->max = std::max(a->max, b.max);
+    a->n   = n;
+}
+
+//! Reads or writes the header, returns false on failure
+bool doHeader(XDR* xd, int* magic, int* version, int64_t* trailerOffset)
+{
+    return xdr_int(xd, magic) && xdr_int(xd, version) && xdr_int64(xd, trailerOffset);
+}
+
+//! Reads or writes a string, returns false on failure
+bool doString(XDR* xd, std::string* s)
+{
+    int length = s->size();
+    if (!xdr_int(xd, &length) || length < 0)
+    {
+        return false;
+    }
+    std::vector<char> buffer(s->begin(), s->end());
+    buffer.resize(length);
+    if (length > 0 && !xdr_opaque(xd, buffer.data(), length))
+    {
+        return false;
+    }
+    s->assign(buffer.begin(), buffer.end());
+    return true;
+}
+
+//! Reads or writes a chunk summary, returns false on failure
+bool doSummary(XDR* xd, EnergyChunkSummary* summary)
+{
+    return xdr_double(xd, &summary->min) && xdr_double(xd, &summary->max)
+           && xdr_double(xd, &summary->sum) && xdr_double(xd, &summary->sumSquaredDeviations)
+           && xdr_double(xd, &summary->sumTimeValueDeviations);
+}
+
+//! Returns the summary of the chunk with \p times and \p values of \p n frames
+EnergyChunkSummary summarizeChunk(const double* times, const double* values, int64_t n)
+{
+    Moments m = computeMoments(times, values, n);
+    return { m.min, m.max, m.mean * n, m.squaredDeviations, m.timeValueDeviations };
+}
+
+//! Returns the number of chunks needed for \p numFrames frames
+int64_t numChunks(int64_t numFrames, int chunkSize)
+{
+    return (numFrames + chunkSize - 1) / chunkSize;
+}
+
+//! Returns the number of frames with energies in the file opened in \p ef, leaves the file position unchanged
+int64_t countEnergyFrames(ener_file_t ef, const std::string& edrFileName)
+{
+    int64_t                       numIndexEntries;
+    const t_enxframe_index_entry* index = enx_get_frame_index(ef, &numIndexEntries);
+    int64_t                       numFrames = 0;
+    if (index != nullptr)
+    {
+        for (int64_t i = 0; i < numIndexEntries; i++)
+        {
+            numFrames += (index[i].nre > 0 ? 1 : 0);
+        }
+        return numFrames;
+    }
+    /* Old file format without index support, count by reading all frames */
+    ener_file_t  countFile = open_enx(edrFileName.c_str(), "r");
+    int          nre       = 0;
+    gmx_enxnm_t* enm       = nullptr;
+    do_enxnms(countFile, &nre, &enm);
+    free_enxnms(nre, enm);
+    t_enxframe fr;
+    init_enxframe(&fr);
+    while (do_enx(countFile, &fr))
+    {
+        numFrames += (fr.nre > 0 ? 1 : 0);
+    }
+    free_enxframe(&fr);
+    done_ener_file(countFile);
+    return numFrames;
+}
+
+//! Writes the \p n doubles in \p values as XDR at \p offset in \p fp
+void writeDoublesAt(FILE* fp, gmx_off_t offset, const double* values, int64_t n, const std::string& fileName)
+{
+    std::vector<char> bytes(n * sizeof(double));
+    xdr_doubles_to_bytes(values, n, bytes.data());
+    if (gmx_fseek(fp, offset, SEEK_SET) != 0
+        || std::fwrite(bytes.data(), 1, bytes.size(), fp) != bytes.size())
+    {
+        GMX_THROW(FileIOError("Could not write energy values to " + fileName));
+    }
+}
+
+} // namespace
+
+void convertEnergyFileToColumnStore(const std::string& edrFileName, const std::string& storeFileName, int chunkSize)
+{
+    GMX_RELEASE_ASSERT(chunkSize > 0, "The chunk size should be positive");
+
+    ener_file_t  ef  = open_enx(edrFileName.c_str(), "r");
+    int          nre = 0;
+    gmx_enxnm_t* enm = nullptr;
+    do_enxnms(ef, &nre, &enm);
+    std::vector<std::string> names, units;
+    for (int i = 0; i < nre; i++)
+    {
+        names.emplace_back(enm[i].name);
+        units.emplace_back(enm[i].unit != nullptr ? enm[i].unit : "");
+    }
+    free_enxnms(nre, enm);
+
+    const int64_t numFrames = countEnergyFrames(ef, edrFileName);
+    /* Only the energies are stored, so skip decoding the data blocks */
+    enx_set_projection(ef, -1, nullptr, FALSE);
+
+    FILE* fp = std::fopen(storeFileName.c_str(), "wb");
+    if (fp == nullptr)
+    {
+        done_ener_file(ef);
+        GMX_THROW(FileIOError("Could not open " + storeFileName + " for writing"));
+    }
+
+    std::vector<double>             times(numFrames);
+    std::vector<int64_t>            steps(numFrames);
+    std::vector<EnergyChunkSummary> summaries(nre * numChunks(numFrames, chunkSize));
+    /* The values of one chunk of frames, stored per term */
+    std::vector<double> chunkValues(static_cast<size_t>(nre) * chunkSize);
+
+    try
+    {
+        t_enxframe fr;
+        init_enxframe(&fr);
+        int64_t frame = 0;
+        while (frame < numFrames && do_enx(ef, &fr))
+        {
+            /* mdrun writes frames with only data blocks, e.g. free-energy
+             * or restraint data, when no energies were computed */
+            if (fr.nre == 0)
+            {
+                continue;
+            }
+            if (fr.nre != nre)
+            {
+                free_enxframe(&fr);
+                GMX_THROW(InvalidInputError(formatString(
+                        "Frame %" PRId64 " of %s has %d energy terms instead of %d", frame,
+                        edrFileName.c_str(), fr.nre, nre)));
+            }
+            const int64_t chunk        = frame / chunkSize;
+            const int     frameInChunk = frame % chunkSize;
+            times[frame]               = fr.t;
+            steps[frame]               = fr.step;
+            for (int i = 0; i < nre; i++)
+            {
+                chunkValues[static_cast<size_t>(i) * chunkSize + frameInChunk] = fr.ener[i].e;
+            }
+            frame++;
+            if (frameInChunk == chunkSize - 1 || frame == numFrames)
+            {
+                /* Write the chunk of each term at its place in the column */
+                const int64_t chunkStart = chunk * chunkSize;
+                const int     n          = frame - chunkStart;
+                for (int i = 0; i < nre; i++)
+                {
+                    const double* values = chunkValues.data() + static_cast<size_t>(i) * chunkSize;
+                    summaries[i * numChunks(numFrames, chunkSize) + chunk] =
+                            summarizeChunk(times.data() + chunkStart, values, n);
+                    writeDoublesAt(fp, c_headerSize + (i * numFrames + chunkStart) * sizeof(double),
+                                   values, n, storeFileName);
+                }
+            }
+        }
+        free_enxframe(&fr);
+        if (frame < numFrames)
+        {
+            GMX_THROW(FileIOError(formatString("Could only read %" PRId64 " of the %" PRId64
+                                               " frames in %s",
+                                               frame, numFrames, edrFileName.c_str())));
+        }
+
+        /* The trailer follows the values, the header points to it */
+        int64_t trailerOffset = c_headerSize + nre * numFrames * sizeof(double);
+        bool    bOK           = (gmx_fseek(fp, trailerOffset, SEEK_SET) == 0);
+        XDR     xd;
+        xdrstdio_create(&xd, fp, XDR_ENCODE);
+        int64_t nframes = numFrames;
+        bOK             = bOK && xdr_int(&xd, &chunkSize) && xdr_int(&xd, &nre)
+              && xdr_int64(&xd, &nframes);
+        for (int i = 0; i < nre && bOK; i++)
+        {
+            bOK = doString(&xd, &names[i]) && doString(&xd, &units[i]);
+        }
+        for (int64_t f = 0; f < numFrames && bOK; f++)
+        {
+            bOK = xdr_double(&xd, &times[f]) && xdr_int64(&xd, &steps[f]);
+        }
+        for (size_t s = 0; s < summaries.size() && bOK; s++)
+        {
+            bOK = doSummary(&xd, &summaries[s]);
+        }
+        xdr_destroy(&xd);
+
+        int magic   = c_energyColumnStoreMagic;
+        int version = c_energyColumnStoreVersion;
+        bOK         = bOK && gmx_fseek(fp, 0, SEEK_SET) == 0;
+        xdrstdio_create(&xd, fp, XDR_ENCODE);
+        bOK = bOK && doHeader(&xd, &magic, &version, &trailerOffset);
+        xdr_destroy(&xd);
+        if (!bOK)
+        {
+            GMX_THROW(FileIOError("Could not write the energy column store " + storeFileName));
+        }
+    }
+    catch (...)
+    {
+        std::fclose(fp);
+        std::remove(storeFileName.c_str());
+        done_ener_file(ef);
+        throw;
+    }
+    done_ener_file(ef);
+    if (std::fclose(fp) != 0)
+    {
+        std::remove(storeFileName.c_str());
+        GMX_THROW(FileIOError("Could not write the energy column store " + storeFileName));
+    }
+}
+
+EnergyColumnStore::EnergyColumnStore(const std::string& fileName) : fileName_(fileName)
+{
+    FILE* fp = std::fopen(fileName.c_str(), "rb");
+    if (fp == nullptr)
+    {
+        GMX_THROW(FileIOError("Could not open the energy column store " + fileName));
+    }
+    XDR xd;
+    xdrstdio_create(&xd, fp, XDR_DECODE);
+    int     magic, version, numTerms;
+    int64_t trailerOffset, numFrames;
+    bool    bOK = (doHeader(&xd, &magic, &version, &trailerOffset) && magic == c_energyColumnStoreMagic
+                && version == c_energyColumnStoreVersion);
+    xdr_destroy(&xd);
+    bOK = bOK && gmx_fseek(fp, trailerOffset, SEEK_SET) == 0;
+    xdrstdio_create(&xd, fp, XDR_DECODE);
+    bOK = bOK && xdr_int(&xd, &chunkSize_) && xdr_int(&xd, &numTerms) && xdr_int64(&xd, &numFrames)
+          && chunkSize_ > 0 && numTerms >= 0 && numFrames >= 0
+          && trailerOffset == c_headerSize + numTerms * numFrames * static_cast<int64_t>(sizeof(double));
+    if (bOK)
+    {
+        names_.resize(numTerms);
+        units_.resize(numTerms);
+        for (int i = 0; i < numTerms && bOK; i++)
+        {
+            bOK = doString(&xd, &names_[i]) && doString(&xd, &units_[i]);
+        }
+        times_.resize(numFrames);
+        steps_.resize(numFrames);
+        for (int64_t f = 0; f < numFrames && bOK; f++)
+        {
+            bOK = xdr_double(&xd, &times_[f]) && xdr_int64(&xd, &steps_[f]);
+        }
+        summaries_.resize(numTerms * numChunks(numFrames, chunkSize_));
+        for (size_t s = 0; s < summaries_.size() && bOK; s++)
+        {
+            bOK = doSummary(&xd, &summaries_[s]);
+        }
+    }
+    xdr_destroy(&xd);
+    std::fclose(fp);
+    if (!bOK)
+    {
+        GMX_THROW(FileIOError(fileName + " is not a valid energy column store"));
+    }
+
+    valuesOffset_ = c_headerSize;
+    values_.resize(numTerms);
+    for (int64_t chunkStart = 0; chunkStart < numFrames; chunkStart += chunkSize_)
+    {
+        int64_t n = std::min<int64_t>(chunkSize_, numFrames - chunkStart);
+        double  sumTime = 0;
+        for (int64_t f = chunkStart; f < chunkStart + n; f++)
+        {
+            sumTime += times_[f];
+        }
+        double meanTime              = sumTime / n;
+        double timeSquaredDeviations = 0;
+        for (int64_t f = chunkStart; f < chunkStart + n; f++)
+        {
+            timeSquaredDeviations += (times_[f] - meanTime) * (times_[f] - meanTime);
+        }
+        chunkMeanTimes_.push_back(meanTime);
+        chunkTimeSquaredDeviations_.push_back(timeSquaredDeviations);
+    }
+}
+
+EnergyColumnStore::~EnergyColumnStore() = default;
+
+int EnergyColumnStore::findTerm(const std::string& name) const
+{
+    auto it = std::find(names_.begin(), names_.end(), name);
+    return it == names_.end() ? -1 : static_cast<int>(it - names_.begin());
+}
+
+ArrayRef<const EnergyChunkSummary> EnergyColumnStore::chunkSummaries(int term) const
+{
+    const size_t n = chunkMeanTimes_.size();
+    return constArrayRefFromArray(summaries_.data() + term * n, n);
+}
+
+void EnergyColumnStore::readValues(int term, int64_t firstFrame, int64_t count, double* values) const
+{
+    FILE* fp = std::fopen(fileName_.c_str(), "rb");
+    if (fp == nullptr)
+    {
+        GMX_THROW(FileIOError("Could not open the energy column store " + fileName_));
+    }
+    std::vector<char> bytes(count * sizeof(double));
+    bool bOK = (gmx_fseek(fp, valuesOffset_ + (term * numFrames() + firstFrame) * sizeof(double), SEEK_SET)
+                        == 0
+                && std::fread(bytes.data(), 1, bytes.size(), fp) == bytes.size());
+    std::fclose(fp);
+    if (!bOK)
+    {
+        GMX_THROW(FileIOError("Could not read energy values from " + fileName_));
+    }
+    xdr_doubles_from_bytes(bytes.data(), count, values);
+}
+
+ArrayRef<const double> EnergyColumnStore::values(int term)
+{
+    GMX_RELEASE_ASSERT(term >= 0 && term < numTerms(), "Term index out of range");
+    if (values_[term].empty() && numFrames() > 0)
+    {
+        std::vector<double> values(numFrames());
+        readValues(term, 0, numFrames(), values.data());
+        values_[term] = std::move(values);
+    }
+    return values_[term];
+}
+
+EnergyTermStatistics EnergyColumnStore::statistics(int term, int64_t firstFrame, int64_t endFrame)
+{
+    GMX_RELEASE_ASSERT(term >= 0 && term < numTerms(), "Term index out of range");
+    firstFrame = std::max<int64_t>(firstFrame, 0);
+    endFrame   = std::min(endFrame, numFrames());
+
+    Moments             m;
+    std::vector<double> buffer;
+    /* Adds the frames in [begin, end) of one chunk by reducing their values */
+    auto addPartialChunk = [&](int64_t begin, int64_t end) {
+        const double* values;
+        if (!values_[term].empty())
+        {
+            values = values_[term].data() + begin;
+        }
+        else
+        {
+            buffer.resize(end - begin);
+            readValues(term, begin, end - begin, buffer.data());
+            values = buffer.data();
+        }
+        combineMoments(&m, computeMoments(times_.data() + begin, values, end - begin));
+    };
+
+    const ArrayRef<const EnergyChunkSummary> summaries = chunkSummaries(term);
+    for (int64_t frame = firstFrame; frame < endFrame;)
+    {
+        const int64_t chunk      = frame / chunkSize_;
+        const int64_t chunkStart = chunk * chunkSize_;
+        const int64_t chunkEnd   = std::min(chunkStart + chunkSize_, numFrames());
+        if (frame == chunkStart && chunkEnd <= endFrame)
+        {
+            const EnergyChunkSummary& s = summaries[chunk];
+            Moments                   chunkMoments;
+            chunkMoments.n                     = chunkEnd - chunkStart;
+            chunkMoments.meanTime              = chunkMeanTimes_[chunk];
+            chunkMoments.timeSquaredDeviations = chunkTimeSquaredDeviations_[chunk];
+            chunkMoments.mean                  = s.sum / chunkMoments.n;
+            chunkMoments.squaredDeviations     = s.sumSquaredDeviations;
+            chunkMoments.timeValueDeviations   = s.sumTimeValueDeviations;
+            chunkMoments.min                   = s.min;
+            chunkMoments.max                   = s.max;
+            combineMoments(&m, chunkMoments);
+            frame = chunkEnd;
+        }
+        else
+        {
+            const int64_t end = std::min(chunkEnd, endFrame);
+            addPartialChunk(frame, end);
+            frame = end;
+        }
+    }
+
+    EnergyTermStatistics stats;
+    stats.numFrames = m.n;
+    if (m.n > 0)
+    {
+        stats.min     = m.min;
+        stats.max     = m.max;
+        stats.average = m.mean;
+        stats.rmsd    = std::sqrt(m.squaredDeviations / m.n);
+        if (m.timeSquaredDeviations > 0)
+        {
+            stats.drift = m.timeValueDeviations / m.timeSquaredDeviations
+                          * (times_[endFrame - 1] - times_[firstFrame]);
+        }
+    }
+    return stats;
+}
+
+} // namespace gmx
@@ -0,0 +1,202 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2021, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \libinternal \file
+ * \brief
+ * Declares a column-oriented store of energy terms.
+ *
+ * The store keeps the values of every energy term of an energy file as
+ * one contiguous array, together with per-chunk summaries of the
+ * values. Statistics over long runs can then be computed from the
+ * summaries and contiguous reductions over single terms, instead of
+ * decoding every frame of the energy file.
+ *
+ * \inlibraryapi
+ * \ingroup module_fileio
+ */
+#ifndef GMX_FILEIO_ENERGYCOLUMNSTORE_H
+#define GMX_FILEIO_ENERGYCOLUMNSTORE_H
+
+#include <cstdint>
+
+#include <string>
+#include <vector>
+
+#include "gromacs/utility/arrayref.h"
+#include "gromacs/utility/futil.h"
+
+namespace gmx
+{
+
+//! Default number of frames per chunk in an energy column store
+const int c_energyColumnStoreChunkSize = 4096;
+
+/*! \libinternal \brief
+ * Summary of the values of one energy term in one chunk of frames.
+ *
+ * The second moments are taken about the means of the chunk, so that
+ * summaries can be combined without loss of precision.
+ */
+struct EnergyChunkSummary
+{
+    //! Smallest value in the chunk
+    double min;
+    //! Largest value in the chunk
+    double max;
+    //! Sum of the values
+    double sum;
+    //! Sum of squared deviations of the values from their mean
+    double sumSquaredDeviations;
+    //! Sum of the products of the deviations of times and values from their means
+    double sumTimeValueDeviations;
+};
+
+/*! \libinternal \brief
+ * Statistics of an energy term over a range of frames.
+ */
+struct EnergyTermStatistics
+{
+    //! Number of frames
+    int64_t numFrames = 0;
+    //! Smallest value
+    double min = 0;
+    //! Largest value
+    double max = 0;
+    //! Average
+    double average = 0;
+    //! Root mean square deviation from the average
+    double rmsd = 0;
+    //! Drift over the range from a least-squares fit of the values against time
+    double drift = 0;
+};
+
+/*! \brief Converts the energy file \p edrFileName to a column store in \p storeFileName
+ *
+ * Only the instantaneous values of the energy terms are stored, frames
+ * that only contain data blocks are skipped. The conversion keeps at
+ * most \p chunkSize frames in memory.
+ *
+ * \throws FileIOError when the store could not be written.
+ * \throws InvalidInputError when the number of energy terms changes
+ *         within the energy file.
+ */
+void convertEnergyFileToColumnStore(const std::string& edrFileName,
+                                    const std::string& storeFileName,
+                                    int                chunkSize = c_energyColumnStoreChunkSize);
+
+/*! \libinternal \brief
+ * Reader for an energy column store.
+ *
+ * The names, times, steps and chunk summaries are read when the store
+ * is opened. The values of a term are only read from the file when
+ * they are requested.
+ */
+class EnergyColumnStore
+{
+public:
+    /*! \brief Opens the store in \p fileName
+     *
+     * \throws FileIOError when the file can not be read or is not an
+     *         energy column store.
+     */
+    explicit EnergyColumnStore(const std::string& fileName);
+    ~EnergyColumnStore();
+
+    //! Returns the number of energy terms
+    int numTerms() const { return static_cast<int>(names_.size()); }
+    //! Returns the number of frames
+    int64_t numFrames() const { return static_cast<int64_t>(times_.size()); }
+    //! Returns the number of frames per chunk
+    int chunkSize() const { return chunkSize_; }
+    //! Returns the name of \p term
+    const std::string& termName(int term) const { return names_[term]; }
+    //! Returns the unit of \p term
+    const std::string& termUnit(int term) const { return units_[term]; }
+    //! Returns the index of the term called \p name, or -1 when there is no such term
+    int findTerm(const std::string& name) const;
+    //! Returns the times of the frames
+    ArrayRef<const double> times() const { return times_; }
+    //! Returns the steps of the frames
+    ArrayRef<const int64_t> steps() const { return steps_; }
+    //! Returns the summaries of all chunks of \p term
+    ArrayRef<const EnergyChunkSummary> chunkSummaries(int term) const;
+
+    /*! \brief Returns all values of \p term
+     *
+     * The values are read on first use and kept in memory.
+     *
+     * \throws FileIOError when the values could not be read.
+     */
+    ArrayRef<const double> values(int term);
+
+    /*! \brief Returns statistics of \p term over the frames from \p firstFrame up to \p endFrame
+     *
+     * Chunks that are fully inside the range are taken from the
+     * summaries, only the values of partially covered chunks are read.
+     *
+     * \throws FileIOError when values could not be read.
+     */
+    EnergyTermStatistics statistics(int term, int64_t firstFrame, int64_t endFrame);
+
+private:
+    //! Reads \p count values of \p term starting at \p firstFrame into \p values
+    void readValues(int term, int64_t firstFrame, int64_t count, double* values) const;
+
+    //! The file name of the store
+    std::string fileName_;
+    //! Number of frames per chunk
+    int chunkSize_ = 0;
+    //! Offset in the file of the values of the first term
+    gmx_off_t valuesOffset_ = 0;
+    //! Names of the terms
+    std::vector<std::string> names_;
+    //! Units of the terms
+    std::vector<std::string> units_;
+    //! Times of the frames
+    std::vector<double> times_;
+    //! Steps of the frames
+    std::vector<int64_t> steps_;
+    //! Chunk summaries, all chunks of the first term first
+    std::vector<EnergyChunkSummary> summaries_;
+    //! Mean time of the frames in each chunk
+    std::vector<double> chunkMeanTimes_;
+    //! Sum of squared deviations of the times in each chunk from their mean
+    std::vector<double> chunkTimeSquaredDeviations_;
+    //! Values of the terms that were requested, empty for the others
+    std::vector<std::vector<double>> values_;
+};
+
+} // namespace gmx
+
+#endif
@@ -43,6 +43,7 @@
 #include <cstring>
 
 #include <algorithm>
+#include <vector>
 
 #include "gromacs/fileio/gmxfio.h"
 #include "gromacs/fileio/gmxfio_xdr.h"
@@ -90,10 +91,17 @@ typedef struct
 
 struct ener_file
 {
-    ener_old_t eo;
-    t_fileio*  fio;
-    int        framenr;
-    real       frametime;
+    ener_old_t                           eo;
+    t_fileio*                            fio;
+    int                                  framenr;
+    real                                 frametime;
+    gmx_bool                             bDouble;        /* Whether reals in the file are doubles */
+    gmx_off_t                            framesOffset;   /* Offset of the first frame */
+    std::vector<t_enxframe_index_entry>* index;          /* Frame index, NULL until used */
+    gmx_off_t                            indexEnd;       /* End of the last indexed frame */
+    gmx_bool                             bIndexComplete; /* Whether all frames are indexed */
+    std::vector<int>*                    selectedTerms;  /* Terms to decode, NULL means all */
+    gmx_bool                             bReadBlocks;    /* Whether to read the data blocks */
 };
 
 static void enxsubblock_init(t_enxsubblock* sb)
@@ -435,6 +443,11 @@ void do_enxnms(ener_file_t ef, int* nre, gmx_enxnm_t** nms)
     }
 
     edr_strings(xdr, bRead, file_version, *nre, nms);
+
+    if (bRead)
+    {
+        ef->framesOffset = gmx_fio_ftell(ef->fio);
+    }
 }
 
 static gmx_bool do_eheader(ener_file_t ef,
@@ -763,6 +776,10 @@ void close_enx(ener_file_t ef)
                 "Cannot close energy file; it might be corrupt, or maybe you are out of disk "
                 "space?");
     }
+    delete ef->index;
+    ef->index = nullptr;
+    delete ef->selectedTerms;
+    ef->selectedTerms = nullptr;
 }
 
 void done_ener_file(ener_file_t ef)
@@ -828,6 +845,7 @@ ener_file_t open_enx(const char* fn, const char* mode)
                  && (nre * 4 * static_cast<long int>(sizeof(float)) == fr->e_size))))
         {
             fprintf(stderr, "Opened %s as single precision energy file\n", fn);
+            ef->bDouble = FALSE;
             free_enxnms(nre, nms);
         }
         else
@@ -845,6 +863,7 @@ ener_file_t open_enx(const char* fn, const char* mode)
                   && (nre * 4 * static_cast<long int>(sizeof(double)) == fr->e_size))))
             {
                 fprintf(stderr, "Opened %s as double precision energy file\n", fn);
+                ef->bDouble = TRUE;
             }
             else
             {
@@ -868,8 +887,9 @@ ener_file_t open_enx(const char* fn, const char* mode)
         ef->fio = gmx_fio_open(fn, mode);
     }
 
-    ef->framenr   = 0;
-    ef->frametime = 0;
+    ef->framenr     = 0;
+    ef->frametime   = 0;
+    ef->bReadBlocks = TRUE;
     return ef;
 }
 
@@ -950,6 +970,229 @@ static void convert_full_sums(ener_old_t* ener_old, t_enxframe* fr)
     ener_old->step_prev = fr->step;
 }
 
+/* Returns the number of reals stored per energy term in a frame */
+static int enx_reals_per_term(int file_version, const t_enxframe* fr)
+{
+    if (file_version == 1)
+    {
+        return 4;
+    }
+    return (fr->nsum > 0) ? 3 : 1;
+}
+
+/* Returns the number of bytes of the data of sub in the file,
+ * or -1 when this depends on the data, as for strings.
+ */
+static gmx_off_t enx_subblock_bytes(const t_enxsubblock* sub)
+{
+    switch (sub->type)
+    {
+        case xdr_datatype_float:
+        case xdr_datatype_int:
+        /* XDR stores each unsigned char in four bytes */
+        case xdr_datatype_char: return 4 * static_cast<gmx_off_t>(sub->nr);
+        case xdr_datatype_double:
+        case xdr_datatype_int64: return 8 * static_cast<gmx_off_t>(sub->nr);
+        default: return -1;
+    }
+}
+
+/* Moves the file position nbytes forward */
+static gmx_bool skip_enx_bytes(ener_file_t ef, gmx_off_t nbytes)
+{
+    return nbytes == 0 || gmx_fio_seek(ef->fio, gmx_fio_ftell(ef->fio) + nbytes) == 0;
+}
+
+/* Skips the data of all blocks of fr without allocating it */
+static gmx_bool skip_enx_blocks(ener_file_t ef, t_enxframe* fr)
+{
+    gmx_bool  bOK     = TRUE;
+    gmx_off_t pending = 0;
+
+    for (int b = 0; b < fr->nblock && bOK; b++)
+    {
+        for (int i = 0; i < fr->block[b].nsub && bOK; i++)
+        {
+            t_enxsubblock* sub   = &(fr->block[b].sub[i]);
+            gmx_off_t      bytes = enx_subblock_bytes(sub);
+            if (bytes >= 0)
+            {
+                pending += bytes;
+            }
+            else
+            {
+                bOK     = skip_enx_bytes(ef, pending);
+                pending = 0;
+                if (sub->type != xdr_datatype_string)
+                {
+                    gmx_incons(
+                            "Reading unknown block data type: this file is corrupted or from the "
+                            "future");
+                }
+                /* Reading with a NULL buffer discards the string */
+                for (int j = 0; j < sub->nr && bOK; j++)
+                {
+                    bOK = gmx_fio_do_string(ef->fio, nullptr);
+                }
+            }
+        }
+    }
+
+    return bOK && skip_enx_bytes(ef, pending);
+}
+
+/* Reads the energies of the terms selected in ef, sets the others to zero */
+static gmx_bool read_selected_energies(ener_file_t ef, int file_version, t_enxframe* fr)
+{
+    const int                  realSize     = ef->bDouble ? sizeof(double) : sizeof(float);
+    const int                  realsPerTerm = enx_reals_per_term(file_version, fr);
+    std::vector<unsigned char> bytes(static_cast<size_t>(fr->nre) * realsPerTerm * realSize);
+
+    /* Read all energies with one call and decode only the selected ones */
+    if (!bytes.empty() && fread(bytes.data(), 1, bytes.size(), gmx_fio_getfp(ef->fio)) != bytes.size())
+    {
+        return FALSE;
+    }
+    for (int i = 0; i < fr->nre; i++)
+    {
+        fr->ener[i].e    = 0;
+        fr->ener[i].eav  = 0;
+        fr->ener[i].esum = 0;
+    }
+    for (int i : *ef->selectedTerms)
+    {
+        if (i >= 0 && i < fr->nre)
+        {
+            real values[4];
+            xdr_reals_from_bytes(bytes.data() + static_cast<size_t>(i) * realsPerTerm * realSize,
+                                 ef->bDouble, realsPerTerm, values);
+            fr->ener[i].e = values[0];
+            if (realsPerTerm > 1)
+            {
+                fr->ener[i].eav  = values[1];
+                fr->ener[i].esum = values[2];
+            }
+        }
+    }
+
+    return TRUE;
+}
+
+/* Extends the frame index of ef by reading frame headers until a frame
+ * with time >= tUntil or frame number frameUntil is indexed, or the end
+ * of the file is reached. Changes the file position.
+ */
+static void extend_enx_index(ener_file_t ef, double tUntil, int64_t frameUntil)
+{
+    if (ef->index == nullptr)
+    {
+        ef->index          = new std::vector<t_enxframe_index_entry>;
+        ef->indexEnd       = ef->framesOffset;
+        ef->bIndexComplete = FALSE;
+    }
+    std::vector<t_enxframe_index_entry>& index = *ef->index;
+
+    FILE* fp = gmx_fio_getfp(ef->fio);
+    gmx_fseek(fp, 0, SEEK_END);
+    const gmx_off_t fileSize = gmx_ftell(fp);
+    gmx_fio_seek(ef->fio, ef->indexEnd);
+
+    const int  realSize = ef->bDouble ? sizeof(double) : sizeof(float);
+    t_enxframe fr;
+    init_enxframe(&fr);
+    while (!ef->bIndexComplete && (index.empty() || index.back().t < tUntil)
+           && static_cast<int64_t>(index.size()) <= frameUntil)
+    {
+        int      file_version;
+        gmx_bool bOK;
+        if (!do_eheader(ef, &file_version, &fr, -1, nullptr, &bOK) || !bOK
+            || !skip_enx_bytes(ef, static_cast<gmx_off_t>(fr.nre)
+                                           * enx_reals_per_term(file_version, &fr) * realSize)
+            || !skip_enx_blocks(ef, &fr) || gmx_fio_ftell(ef->fio) > fileSize)
+        {
+            /* The last frame is incomplete or missing */
+            ef->bIndexComplete = TRUE;
+            break;
+        }
+        index.push_back({ fr.step, fr.t, ef->indexEnd, fr.nre, fr.nblock });
+        ef->indexEnd = gmx_fio_ftell(ef->fio);
+    }
+    free_enxframe(&fr);
+}
+
+gmx_bool enx_seek_time(ener_file_t ef, double t)
+{
+    if (!gmx_fio_getread(ef->fio) || ef->eo.bOldFileOpen)
+    {
+        return FALSE;
+    }
+    const gmx_off_t position = gmx_fio_ftell(ef->fio);
+    extend_enx_index(ef, t, INT64_MAX);
+    /* Compare in real precision, as check_times() does for the begin
+     * time of the analysis tools, so we never skip a frame with a time
+     * that is only smaller than t before rounding.
+     */
+    const real  tReal = t;
+    const auto& index = *ef->index;
+    const auto  frame = std::find_if(
+            index.begin(), index.end(),
+            [tReal](const t_enxframe_index_entry& entry) { return static_cast<real>(entry.t) >= tReal; });
+    if (frame == index.end())
+    {
+        gmx_fio_seek(ef->fio, position);
+        return FALSE;
+    }
+    gmx_fio_seek(ef->fio, frame->offset);
+    ef->framenr = frame - index.begin();
+
+    return TRUE;
+}
+
+gmx_bool enx_seek_frame(ener_file_t ef, int64_t frame)
+{
+    if (!gmx_fio_getread(ef->fio) || ef->eo.bOldFileOpen || frame < 0)
+    {
+        return FALSE;
+    }
+    const gmx_off_t position = gmx_fio_ftell(ef->fio);
+    extend_enx_index(ef, GMX_DOUBLE_MAX, frame);
+    if (frame >= static_cast<int64_t>(ef->index->size()))
+    {
+        gmx_fio_seek(ef->fio, position);
+        return FALSE;
+    }
+    gmx_fio_seek(ef->fio, (*ef->index)[frame].offset);
+    ef->framenr = frame;
+
+    return TRUE;
+}
+
+const t_enxframe_index_entry* enx_get_frame_index(ener_file_t ef, int64_t* nframes)
+{
+    if (!gmx_fio_getread(ef->fio) || ef->eo.bOldFileOpen)
+    {
+        *nframes = 0;
+        return nullptr;
+    }
+    const gmx_off_t position = gmx_fio_ftell(ef->fio);
+    extend_enx_index(ef, GMX_DOUBLE_MAX, INT64_MAX);
+    gmx_fio_seek(ef->fio, position);
+    *nframes = ef->index->size();
+
+    return ef->index->data();
+}
+
+void enx_set_projection(ener_file_t ef, int nsel, const int* sel, gmx_bool bReadBlocks)
+{
+    delete ef->selectedTerms;
+    ef->selectedTerms = nullptr;
+    if (nsel >= 0)
+    {
+        ef->selectedTerms = new std::vector<int>(sel, sel + nsel);
+    }
+    ef->bReadBlocks = bReadBlocks;
+}
+
 gmx_bool do_enx(ener_file_t ef, t_enxframe* fr)
 {
     int      file_version = -1;
@@ -1021,7 +1264,13 @@ gmx_bool do_enx(ener_file_t ef, t_enxframe* fr)
         fr->e_alloc = fr->nre;
     }
 
-    for (i = 0; i < fr->nre; i++)
+    /* Column projection is not supported for old files, which need all sums */
+    const gmx_bool bProject = (bRead && ef->selectedTerms != nullptr && !ef->eo.bOldFileOpen);
+    if (bProject)
+    {
+        bOK = read_selected_energies(ef, file_version, fr);
+    }
+    for (i = 0; i < fr->nre && !bProject; i++)
     {
         bOK = bOK && gmx_fio_do_real(ef->fio, fr->ener[i].e);
 
@@ -1062,6 +1311,12 @@ gmx_bool do_enx(ener_file_t ef, t_enxframe* fr)
         /* Convert old full simulation sums to sums between energy frames */
         convert_full_sums(&(ef->eo), fr);
     }
+    if (bRead && !ef->bReadBlocks && !ef->eo.bOldFileOpen)
+    {
+        /* Skip the blocks without allocating their data */
+        bOK        = bOK && skip_enx_blocks(ef, fr);
+        fr->nblock = 0;
+    }
     /* read the blocks */
     for (b = 0; b < fr->nblock; b++)
     {
@@ -1172,6 +1427,11 @@ void get_enx_state(const char* fn, real t, const SimulationGroups& groups, t_inp
 
     in = open_enx(fn, "r");
     do_enxnms(in, &nre, &enm);
+    /* The state variables are energy terms, so the blocks are not needed,
+     * and we can jump directly to the requested time.
+     */
+    enx_set_projection(in, -1, nullptr, FALSE);
+    enx_seek_time(in, t);
     snew(fr, 1);
     nfr = 0;
     while ((nfr == 0 || fr->t != t) && do_enx(in, fr))
@@ -40,6 +40,7 @@
 
 #include "gromacs/fileio/xdr_datatype.h"
 #include "gromacs/utility/basedefinitions.h"
+#include "gromacs/utility/futil.h"
 #include "gromacs/utility/real.h"
 
 struct SimulationGroups;
@@ -133,6 +134,16 @@ struct t_enxblock
     int            nsub_alloc; /* number of allocated subblocks */
 };
 
+/* Entry of the frame index of an energy file */
+struct t_enxframe_index_entry
+{
+    int64_t   step;   /* MD step of the frame                       */
+    double    t;      /* Time of the frame                          */
+    gmx_off_t offset; /* Offset in bytes of the frame in the file   */
+    int       nre;    /* Number of energy terms in the frame        */
+    int       nblock; /* Number of data blocks in the frame         */
+};
+
 /* file handle */
 typedef struct ener_file* ener_file_t;
 
@@ -178,6 +189,33 @@ void free_enxnms(int n, gmx_enxnm_t* nms);
 gmx_bool do_enx(ener_file_t ef, t_enxframe* fr);
 /* Reads enx_frames, memory in fr is (re)allocated if necessary */
 
+gmx_bool enx_seek_time(ener_file_t ef, double t);
+/* Positions a file opened for reading, after do_enxnms has been called,
+ * such that the next do_enx call returns the first frame with time >= t,
+ * where both times are rounded to real precision as check_times() does.
+ * Uses a frame index that is extended on demand by reading only the frame
+ * headers. Returns FALSE, with the file position unchanged, when there is
+ * no such frame or the file is in the pre-4.1 format.
+ */
+
+gmx_bool enx_seek_frame(ener_file_t ef, int64_t frame);
+/* As enx_seek_time, but positions at frame number frame, counting from 0 */
+
+const t_enxframe_index_entry* enx_get_frame_index(ener_file_t ef, int64_t* nframes);
+/* Completes the frame index and returns it, with the number of frames
+ * in *nframes. Returns NULL for files in the pre-4.1 format.
+ * The file position is unchanged.
+ */
+
+void enx_set_projection(ener_file_t ef, int nsel, const int* sel, gmx_bool bReadBlocks);
+/* Sets which data do_enx decodes when reading. Only the nsel energy
+ * terms with indices sel are decoded, the other terms are set to zero,
+ * unless nsel < 0, which selects all terms. When bReadBlocks is FALSE,
+ * the data blocks are skipped without allocating them and frames are
+ * returned with nblock=0. Files in the pre-4.1 format are always read
+ * completely.
+ */
+
 void get_enx_state(const char* fn, real t, const SimulationGroups& groups, t_inputrec* ir, t_state* state);
 /*
  * Reads state variables from enx file fn at time t.
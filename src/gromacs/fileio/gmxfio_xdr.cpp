@@ -748,9 +748,25 @@ gmx_bool gmx_fio_ndoe_string(t_fileio* fio, char* item[], int n, const char* des
     gmx_bool ret = TRUE;
     int      i;
     gmx_fio_lock(fio);
-    for (i = 0; i < n; i++)
+    for (i = 0; i < n && ret; i++)
     {
-        ret = ret && do_xdr(fio, &(item[i]), 1, eioSTRING, desc, srcfile, line);
+        if (fio->bRead)
+        {
+            /* The length is stored before each string, so we can
+             * (re)allocate item[i] to fit before reading it.
+             */
+            int slen = 0;
+            ret      = (xdr_int(fio->xdr, &slen) > 0 && slen > 0);
+            if (ret)
+            {
+                srenew(item[i], slen);
+                ret = (xdr_string(fio->xdr, &(item[i]), slen) > 0);
+            }
+        }
+        else
+        {
+            ret = do_xdr(fio, item[i], 1, eioSTRING, desc, srcfile, line);
+        }
     }
     gmx_fio_unlock(fio);
     return ret;
@@ -44,9 +44,11 @@
 #include <cstring>
 
 #include <algorithm>
+#include <vector>
 
 #include "gromacs/fileio/xdr_datatype.h"
 #include "gromacs/fileio/xdrf.h"
+#include "gromacs/simd/simd.h"
 #include "gromacs/utility/futil.h"
 
 /* This is just for clarity - it can never be anything but 4! */
@@ -283,63 +285,117 @@ static void sendints(int          buf[],
 
 /*___________________________________________________________________________
  |
- | receivebits - decode number from buf using specified number of bits
+ | XtcBitReader - decode numbers from the compressed byte stream
  |
- | extract the number of bits from the array buf and construct an integer
- | from it. Return that value.
+ | extract a number of bits from the stream and construct an unsigned integer
+ | from it. The bits are kept in a 64-bit buffer that is refilled a word at
+ | a time, so most calls do not need to touch memory at all. Reading past
+ | the end of the stream returns zero bits.
  |
  */
 
-static int receivebits(int buf[], int num_of_bits)
+namespace
 {
 
-    int            cnt, num, lastbits;
-    unsigned int   lastbyte;
-    unsigned char* cbuf;
-    int            mask = (1 << num_of_bits) - 1;
-
-    cbuf     = reinterpret_cast<unsigned char*>(buf) + 3 * sizeof(*buf);
-    cnt      = buf[0];
-    lastbits = static_cast<unsigned int>(buf[1]);
-    lastbyte = static_cast<unsigned int>(buf[2]);
+class XtcBitReader
+{
+public:
+    XtcBitReader(const unsigned char* data, std::size_t numBytes) :
+        next_(data), end_(data + numBytes)
+    {
+    }
 
-    num = 0;
-    while (num_of_bits >= 8)
+    unsigned int receivebits(int num_of_bits)
     {
-        lastbyte = (lastbyte << 8) | cbuf[cnt++];
-        num |= (lastbyte >> lastbits) << (num_of_bits - 8);
-        num_of_bits -= 8;
+        if (num_of_bits == 0)
+        {
+            return 0;
+        }
+        if (num_of_bits > bitsInBuffer_)
+        {
+            refill();
+        }
+        unsigned int num = static_cast<unsigned int>(buffer_ >> (64 - num_of_bits));
+        buffer_ <<= num_of_bits;
+        bitsInBuffer_ -= num_of_bits;
+        return num;
     }
-    if (num_of_bits > 0)
+
+private:
+    void refill()
     {
-        if (lastbits < num_of_bits)
+        if (end_ - next_ >= 8)
         {
-            lastbits += 8;
-            lastbyte = (lastbyte << 8) | cbuf[cnt++];
+            /* Load a big-endian word; bits beyond the whole bytes we consume
+             * equal those that the next refill will set again. */
+            std::uint64_t word = 0;
+            for (int i = 0; i < 8; i++)
+            {
+                word = (word << 8) | next_[i];
+            }
+            buffer_ |= word >> bitsInBuffer_;
+            const int numBytes = (63 - bitsInBuffer_) >> 3;
+            next_ += numBytes;
+            bitsInBuffer_ += numBytes * 8;
+        }
+        else
+        {
+            while (bitsInBuffer_ <= 56 && next_ < end_)
+            {
+                buffer_ |= static_cast<std::uint64_t>(*next_++) << (56 - bitsInBuffer_);
+                bitsInBuffer_ += 8;
+            }
+            if (next_ == end_)
+            {
+                bitsInBuffer_ = 64;
+            }
         }
-        lastbits -= num_of_bits;
-        num |= (lastbyte >> lastbits) & ((1 << num_of_bits) - 1);
     }
-    num &= mask;
-    buf[0] = cnt;
-    buf[1] = lastbits;
-    buf[2] = lastbyte;
-    return num;
-}
+
+    const unsigned char* next_;
+    const unsigned char* end_;
+    std::uint64_t        buffer_       = 0;
+    int                  bitsInBuffer_ = 0;
+};
+
+} // namespace
 
 /*____________________________________________________________________________
  |
- | receiveints - decode 'small' integers from the buf array
+ | receiveints - decode 'small' integers from the compressed stream
  |
  | this routine is the inverse from sendints() and decodes the small integers
  | written to buf by calculating the remainder and doing divisions with
  | the given sizes[]. You need to specify the total number of bits to be
  | used from buf in num_of_bits.
+ | When the combined integer fits in 64 bits, which is the common case,
+ | the remainders are computed with native divisions instead of the
+ | byte-wise long division over the bytes[] table.
  |
  */
 
-static void receiveints(int buf[], const int num_of_ints, int num_of_bits, const unsigned int sizes[], int nums[])
+static void receiveints(XtcBitReader* reader, const int num_of_ints, int num_of_bits, const unsigned int sizes[], int nums[])
 {
+    if (num_of_bits <= 64)
+    {
+        std::uint64_t value = 0;
+        int           shift = 0;
+        while (num_of_bits > 8)
+        {
+            value |= static_cast<std::uint64_t>(reader->receivebits(8)) << shift;
+            shift += 8;
+            num_of_bits -= 8;
+        }
+        value |= static_cast<std::uint64_t>(reader->receivebits(num_of_bits)) << shift;
+        for (int i = num_of_ints - 1; i > 0; i--)
+        {
+            nums[i] = static_cast<int>(value % sizes[i]);
+            value /= sizes[i];
+        }
+        nums[0] = static_cast<int>(value);
+        return;
+    }
+
     int bytes[32];
     int i, j, num_of_bytes, p, num;
 
@@ -347,12 +403,12 @@ static void receiveints(int buf[], const int num_of_ints, int num_of_bits, const
     num_of_bytes                              = 0;
     while (num_of_bits > 8)
     {
-        bytes[num_of_bytes++] = receivebits(buf, 8);
+        bytes[num_of_bytes++] = reader->receivebits(8);
         num_of_bits -= 8;
     }
     if (num_of_bits > 0)
     {
-        bytes[num_of_bytes++] = receivebits(buf, num_of_bits);
+        bytes[num_of_bytes++] = reader->receivebits(num_of_bits);
     }
     for (i = num_of_ints - 1; i > 0; i--)
     {
@@ -396,615 +452,578 @@ static void receiveints(int buf[], const int num_of_ints, int num_of_bits, const
  |
  */
 
-int xdr3dfcoord(XDR* xdrs, float* fp, int* size, float* precision)
+int xdr3dfcoord_compress(const float* fp, int size, float precision, XtcCompressedCoordinates* coords)
 {
-    int*     ip  = nullptr;
-    int*     buf = nullptr;
-    gmx_bool bRead;
-
-    /* preallocate a small buffer and ip on the stack - if we need more
-       we can always malloc(). This is faster for small values of size: */
-    unsigned prealloc_size = 3 * 16;
-    int      prealloc_ip[3 * 16], prealloc_buf[3 * 20];
-    int      we_should_free = 0;
-
     int          minint[3], maxint[3], mindiff, *lip, diff;
     int          lint1, lint2, lint3, oldlint1, oldlint2, oldlint3, smallidx;
     int          minidx, maxidx;
-    unsigned     sizeint[3], sizesmall[3], bitsizeint[3], size3, *luip;
-    int          flag, k;
+    unsigned     sizeint[3], sizesmall[3], bitsizeint[3], *luip;
+    int          k;
     int          smallnum, smaller, larger, i, is_small, is_smaller, run, prevrun;
-    float *      lfp, lf;
+    const float* lfp;
+    float        lf;
     int          tmp, *thiscoord, prevcoord[3];
     unsigned int tmpcoord[30];
-
-    int          bufsize, lsize;
     unsigned int bitsize;
-    float        inv_precision;
     int          errval = 1;
-    int          rc;
 
-    bRead         = (xdrs->x_op == XDR_DECODE);
+    const int size3 = size * 3;
     bitsizeint[0] = bitsizeint[1] = bitsizeint[2] = 0;
     prevcoord[0] = prevcoord[1] = prevcoord[2] = 0;
 
-    // The static analyzer warns about garbage values for thiscoord[] further
-    // down. It might be thrown off by all the reinterpret_casts, but we might
-    // as well make sure the small preallocated buffer is zero-initialized.
-    for (i = 0; i < static_cast<int>(prealloc_size); i++)
+    coords->size = size;
+    coords->bytes.clear();
+    if (size <= 9)
     {
-        prealloc_ip[i] = 0;
+        /* small systems are not compressed, but stored as plain floats */
+        coords->precision = -1;
+        coords->uncompressed.assign(fp, fp + size3);
+        return 1;
     }
-
-    if (!bRead)
+    coords->precision = precision;
+
+    /* The integer coordinates, zero-initialized since the static
+     * analyzer warns about garbage values for thiscoord[] */
+    std::vector<int> ipBuffer(size3, 0);
+    std::vector<int> bufBuffer(std::max(3 * 20, static_cast<int>(size3 * 1.2)));
+    int*             ip  = ipBuffer.data();
+    int*             buf = bufBuffer.data();
+
+    /* buf[0-2] are special and do not contain actual data */
+    buf[0] = buf[1] = buf[2] = 0;
+    minint[0] = minint[1] = minint[2] = INT_MAX;
+    maxint[0] = maxint[1] = maxint[2] = INT_MIN;
+    prevrun                           = -1;
+    lfp                               = fp;
+    lip                               = ip;
+    mindiff                           = INT_MAX;
+    oldlint1 = oldlint2 = oldlint3 = 0;
+    while (lfp < fp + size3)
     {
-        /* xdrs is open for writing */
-
-        if (xdr_int(xdrs, size) == 0)
+        /* find nearest integer */
+        if (*lfp >= 0.0)
         {
-            return 0;
+            lf = *lfp * precision + 0.5;
         }
-        size3 = *size * 3;
-        /* when the number of coordinates is small, don't try to compress; just
-         * write them as floats using xdr_vector
-         */
-        if (*size <= 9)
+        else
         {
-            return (xdr_vector(xdrs, reinterpret_cast<char*>(fp), static_cast<unsigned int>(size3),
-                               static_cast<unsigned int>(sizeof(*fp)),
-                               reinterpret_cast<xdrproc_t>(xdr_float)));
+            lf = *lfp * precision - 0.5;
         }
-
-        if (xdr_float(xdrs, precision) == 0)
+        if (std::fabs(lf) > maxAbsoluteInt)
         {
-            return 0;
+            /* scaling would cause overflow */
+            errval = 0;
         }
-
-        if (size3 <= prealloc_size)
+        lint1 = static_cast<int>(lf);
+        if (lint1 < minint[0])
         {
-            ip  = prealloc_ip;
-            buf = prealloc_buf;
+            minint[0] = lint1;
         }
-        else
+        if (lint1 > maxint[0])
         {
-            we_should_free = 1;
-            bufsize        = static_cast<int>(size3 * 1.2);
-            ip             = reinterpret_cast<int*>(malloc(size3 * sizeof(*ip)));
-            buf            = reinterpret_cast<int*>(malloc(bufsize * sizeof(*buf)));
-            if (ip == nullptr || buf == nullptr)
-            {
-                fprintf(stderr, "malloc failed\n");
-                exit(1);
-            }
+            maxint[0] = lint1;
         }
-        /* buf[0-2] are special and do not contain actual data */
-        buf[0] = buf[1] = buf[2] = 0;
-        minint[0] = minint[1] = minint[2] = INT_MAX;
-        maxint[0] = maxint[1] = maxint[2] = INT_MIN;
-        prevrun                           = -1;
-        lfp                               = fp;
-        lip                               = ip;
-        mindiff                           = INT_MAX;
-        oldlint1 = oldlint2 = oldlint3 = 0;
-        while (lfp < fp + size3)
-        {
-            /* find nearest integer */
-            if (*lfp >= 0.0)
-            {
-                lf = *lfp * *precision + 0.5;
-            }
-            else
-            {
-                lf = *lfp * *precision - 0.5;
-            }
-            if (std::fabs(lf) > maxAbsoluteInt)
-            {
-                /* scaling would cause overflow */
-                errval = 0;
-            }
-            lint1 = static_cast<int>(lf);
-            if (lint1 < minint[0])
-            {
-                minint[0] = lint1;
-            }
-            if (lint1 > maxint[0])
-            {
-                maxint[0] = lint1;
-            }
-            *lip++ = lint1;
-            lfp++;
-            if (*lfp >= 0.0)
-            {
-                lf = *lfp * *precision + 0.5;
-            }
-            else
-            {
-                lf = *lfp * *precision - 0.5;
-            }
-            if (std::fabs(lf) > maxAbsoluteInt)
-            {
-                /* scaling would cause overflow */
-                errval = 0;
-            }
-            lint2 = static_cast<int>(lf);
-            if (lint2 < minint[1])
-            {
-                minint[1] = lint2;
-            }
-            if (lint2 > maxint[1])
-            {
-                maxint[1] = lint2;
-            }
-            *lip++ = lint2;
-            lfp++;
-            if (*lfp >= 0.0)
-            {
-                lf = *lfp * *precision + 0.5;
-            }
-            else
-            {
-                lf = *lfp * *precision - 0.5;
-            }
-            if (std::abs(lf) > maxAbsoluteInt)
-            {
-                /* scaling would cause overflow */
-                errval = 0;
-            }
-            lint3 = static_cast<int>(lf);
-            if (lint3 < minint[2])
-            {
-                minint[2] = lint3;
-            }
-            if (lint3 > maxint[2])
-            {
-                maxint[2] = lint3;
-            }
-            *lip++ = lint3;
-            lfp++;
-            diff = std::abs(oldlint1 - lint1) + std::abs(oldlint2 - lint2) + std::abs(oldlint3 - lint3);
-            if (diff < mindiff && lfp > fp + 3)
-            {
-                mindiff = diff;
-            }
-            oldlint1 = lint1;
-            oldlint2 = lint2;
-            oldlint3 = lint3;
+        *lip++ = lint1;
+        lfp++;
+        if (*lfp >= 0.0)
+        {
+            lf = *lfp * precision + 0.5;
         }
-        if ((xdr_int(xdrs, &(minint[0])) == 0) || (xdr_int(xdrs, &(minint[1])) == 0)
-            || (xdr_int(xdrs, &(minint[2])) == 0) || (xdr_int(xdrs, &(maxint[0])) == 0)
-            || (xdr_int(xdrs, &(maxint[1])) == 0) || (xdr_int(xdrs, &(maxint[2])) == 0))
+        else
         {
-            if (we_should_free)
-            {
-                free(ip);
-                free(buf);
-            }
-            return 0;
+            lf = *lfp * precision - 0.5;
         }
-
-        if (static_cast<float>(maxint[0]) - static_cast<float>(minint[0]) >= maxAbsoluteInt
-            || static_cast<float>(maxint[1]) - static_cast<float>(minint[1]) >= maxAbsoluteInt
-            || static_cast<float>(maxint[2]) - static_cast<float>(minint[2]) >= maxAbsoluteInt)
+        if (std::fabs(lf) > maxAbsoluteInt)
         {
-            /* turning value in unsigned by subtracting minint
-             * would cause overflow
-             */
+            /* scaling would cause overflow */
             errval = 0;
         }
-        sizeint[0] = maxint[0] - minint[0] + 1;
-        sizeint[1] = maxint[1] - minint[1] + 1;
-        sizeint[2] = maxint[2] - minint[2] + 1;
-
-        /* check if one of the sizes is to big to be multiplied */
-        if ((sizeint[0] | sizeint[1] | sizeint[2]) > 0xffffff)
+        lint2 = static_cast<int>(lf);
+        if (lint2 < minint[1])
         {
-            bitsizeint[0] = sizeofint(sizeint[0]);
-            bitsizeint[1] = sizeofint(sizeint[1]);
-            bitsizeint[2] = sizeofint(sizeint[2]);
-            bitsize       = 0; /* flag the use of large sizes */
+            minint[1] = lint2;
         }
-        else
+        if (lint2 > maxint[1])
         {
-            bitsize = sizeofints(3, sizeint);
+            maxint[1] = lint2;
         }
-        luip     = reinterpret_cast<unsigned int*>(ip);
-        smallidx = FIRSTIDX;
-        while (smallidx < LASTIDX && magicints[smallidx] < mindiff)
+        *lip++ = lint2;
+        lfp++;
+        if (*lfp >= 0.0)
         {
-            smallidx++;
+            lf = *lfp * precision + 0.5;
         }
-        if (xdr_int(xdrs, &smallidx) == 0)
+        else
         {
-            if (we_should_free)
-            {
-                free(ip);
-                free(buf);
-            }
-            return 0;
+            lf = *lfp * precision - 0.5;
         }
-
-        maxidx       = std::min(LASTIDX, smallidx + 8);
-        minidx       = maxidx - 8; /* often this equal smallidx */
-        smaller      = magicints[std::max(FIRSTIDX, smallidx - 1)] / 2;
-        smallnum     = magicints[smallidx] / 2;
-        sizesmall[0] = sizesmall[1] = sizesmall[2] = magicints[smallidx];
-        larger                                     = magicints[maxidx] / 2;
-        i                                          = 0;
-        while (i < *size)
+        if (std::abs(lf) > maxAbsoluteInt)
         {
-            is_small  = 0;
-            thiscoord = reinterpret_cast<int*>(luip) + i * 3;
-            if (smallidx < maxidx && i >= 1 && std::abs(thiscoord[0] - prevcoord[0]) < larger
-                && std::abs(thiscoord[1] - prevcoord[1]) < larger
-                && std::abs(thiscoord[2] - prevcoord[2]) < larger)
-            {
-                is_smaller = 1;
-            }
-            else if (smallidx > minidx)
-            {
-                is_smaller = -1;
-            }
-            else
-            {
-                is_smaller = 0;
-            }
-            if (i + 1 < *size)
-            {
-                if (std::abs(thiscoord[0] - thiscoord[3]) < smallnum
-                    && std::abs(thiscoord[1] - thiscoord[4]) < smallnum
-                    && std::abs(thiscoord[2] - thiscoord[5]) < smallnum)
-                {
-                    /* interchange first with second atom for better
-                     * compression of water molecules
-                     */
-                    tmp          = thiscoord[0];
-                    thiscoord[0] = thiscoord[3];
-                    thiscoord[3] = tmp;
-                    tmp          = thiscoord[1];
-                    thiscoord[1] = thiscoord[4];
-                    thiscoord[4] = tmp;
-                    tmp          = thiscoord[2];
-                    thiscoord[2] = thiscoord[5];
-                    thiscoord[5] = tmp;
-                    is_small     = 1;
-                }
-            }
-            tmpcoord[0] = thiscoord[0] - minint[0];
-            tmpcoord[1] = thiscoord[1] - minint[1];
-            tmpcoord[2] = thiscoord[2] - minint[2];
-            if (bitsize == 0)
-            {
-                sendbits(buf, bitsizeint[0], tmpcoord[0]);
-                sendbits(buf, bitsizeint[1], tmpcoord[1]);
-                sendbits(buf, bitsizeint[2], tmpcoord[2]);
-            }
-            else
-            {
-                sendints(buf, 3, bitsize, sizeint, tmpcoord);
-            }
-            prevcoord[0] = thiscoord[0];
-            prevcoord[1] = thiscoord[1];
-            prevcoord[2] = thiscoord[2];
-            thiscoord    = thiscoord + 3;
-            i++;
-
-            run = 0;
-            if (is_small == 0 && is_smaller == -1)
-            {
-                is_smaller = 0;
-            }
-            while (is_small && run < 8 * 3)
-            {
-                if (is_smaller == -1
-                    && (SQR(thiscoord[0] - prevcoord[0]) + SQR(thiscoord[1] - prevcoord[1])
-                                + SQR(thiscoord[2] - prevcoord[2])
-                        >= smaller * smaller))
-                {
-                    is_smaller = 0;
-                }
-
-                tmpcoord[run++] = thiscoord[0] - prevcoord[0] + smallnum;
-                tmpcoord[run++] = thiscoord[1] - prevcoord[1] + smallnum;
-                tmpcoord[run++] = thiscoord[2] - prevcoord[2] + smallnum;
-
-                prevcoord[0] = thiscoord[0];
-                prevcoord[1] = thiscoord[1];
-                prevcoord[2] = thiscoord[2];
-
-                i++;
-                thiscoord = thiscoord + 3;
-                is_small  = 0;
-                if (i < *size && abs(thiscoord[0] - prevcoord[0]) < smallnum
-                    && abs(thiscoord[1] - prevcoord[1]) < smallnum
-                    && abs(thiscoord[2] - prevcoord[2]) < smallnum)
-                {
-                    is_small = 1;
-                }
-            }
-            if (run != prevrun || is_smaller != 0)
-            {
-                prevrun = run;
-                sendbits(buf, 1, 1); /* flag the change in run-length */
-                sendbits(buf, 5, run + is_smaller + 1);
-            }
-            else
-            {
-                sendbits(buf, 1, 0); /* flag the fact that runlength did not change */
-            }
-            for (k = 0; k < run; k += 3)
-            {
-                sendints(buf, 3, smallidx, sizesmall, &tmpcoord[k]);
-            }
-            if (is_smaller != 0)
-            {
-                smallidx += is_smaller;
-                if (is_smaller < 0)
-                {
-                    smallnum = smaller;
-                    smaller  = magicints[smallidx - 1] / 2;
-                }
-                else
-                {
-                    smaller  = smallnum;
-                    smallnum = magicints[smallidx] / 2;
-                }
-                sizesmall[0] = sizesmall[1] = sizesmall[2] = magicints[smallidx];
-            }
+            /* scaling would cause overflow */
+            errval = 0;
         }
-        if (buf[1] != 0)
+        lint3 = static_cast<int>(lf);
+        if (lint3 < minint[2])
         {
-            buf[0]++;
+            minint[2] = lint3;
         }
-        /* buf[0] holds the length in bytes */
-        if (xdr_int(xdrs, &(buf[0])) == 0)
+        if (lint3 > maxint[2])
         {
-            if (we_should_free)
-            {
-                free(ip);
-                free(buf);
-            }
-            return 0;
+            maxint[2] = lint3;
         }
-
-
-        rc = errval
-             * (xdr_opaque(xdrs, reinterpret_cast<char*>(&(buf[3])), static_cast<unsigned int>(buf[0])));
-        if (we_should_free)
+        *lip++ = lint3;
+        lfp++;
+        diff = std::abs(oldlint1 - lint1) + std::abs(oldlint2 - lint2) + std::abs(oldlint3 - lint3);
+        if (diff < mindiff && lfp > fp + 3)
         {
-            free(ip);
-            free(buf);
+            mindiff = diff;
         }
-        return rc;
+        oldlint1 = lint1;
+        oldlint2 = lint2;
+        oldlint3 = lint3;
     }
-    else
+    if (static_cast<float>(maxint[0]) - static_cast<float>(minint[0]) >= maxAbsoluteInt
+        || static_cast<float>(maxint[1]) - static_cast<float>(minint[1]) >= maxAbsoluteInt
+        || static_cast<float>(maxint[2]) - static_cast<float>(minint[2]) >= maxAbsoluteInt)
     {
+        /* turning value in unsigned by subtracting minint
+         * would cause overflow
+         */
+        errval = 0;
+    }
+    sizeint[0] = maxint[0] - minint[0] + 1;
+    sizeint[1] = maxint[1] - minint[1] + 1;
+    sizeint[2] = maxint[2] - minint[2] + 1;
 
-        /* xdrs is open for reading */
-
-        if (xdr_int(xdrs, &lsize) == 0)
+    /* check if one of the sizes is to big to be multiplied */
+    if ((sizeint[0] | sizeint[1] | sizeint[2]) > 0xffffff)
+    {
+        bitsizeint[0] = sizeofint(sizeint[0]);
+        bitsizeint[1] = sizeofint(sizeint[1]);
+        bitsizeint[2] = sizeofint(sizeint[2]);
+        bitsize       = 0; /* flag the use of large sizes */
+    }
+    else
+    {
+        bitsize = sizeofints(3, sizeint);
+    }
+    luip     = reinterpret_cast<unsigned int*>(ip);
+    smallidx = FIRSTIDX;
+    while (smallidx < LASTIDX && magicints[smallidx] < mindiff)
+    {
+        smallidx++;
+    }
+    coords->smallidx = smallidx;
+
+    maxidx       = std::min(LASTIDX, smallidx + 8);
+    minidx       = maxidx - 8; /* often this equal smallidx */
+    smaller      = magicints[std::max(FIRSTIDX, smallidx - 1)] / 2;
+    smallnum     = magicints[smallidx] / 2;
+    sizesmall[0] = sizesmall[1] = sizesmall[2] = magicints[smallidx];
+    larger                                     = magicints[maxidx] / 2;
+    i                                          = 0;
+    while (i < size)
+    {
+        is_small  = 0;
+        thiscoord = reinterpret_cast<int*>(luip) + i * 3;
+        if (smallidx < maxidx && i >= 1 && std::abs(thiscoord[0] - prevcoord[0]) < larger
+            && std::abs(thiscoord[1] - prevcoord[1]) < larger
+            && std::abs(thiscoord[2] - prevcoord[2]) < larger)
         {
-            return 0;
+            is_smaller = 1;
         }
-        if (*size != 0 && lsize != *size)
+        else if (smallidx > minidx)
         {
-            fprintf(stderr,
-                    "wrong number of coordinates in xdr3dfcoord; "
-                    "%d arg vs %d in file",
-                    *size, lsize);
+            is_smaller = -1;
         }
-        *size = lsize;
-        size3 = *size * 3;
-        if (*size <= 9)
+        else
         {
-            *precision = -1;
-            return (xdr_vector(xdrs, reinterpret_cast<char*>(fp), static_cast<unsigned int>(size3),
-                               static_cast<unsigned int>(sizeof(*fp)),
-                               reinterpret_cast<xdrproc_t>(xdr_float)));
+            is_smaller = 0;
         }
-        if (xdr_float(xdrs, precision) == 0)
+        if (i + 1 < size)
         {
-            return 0;
+            if (std::abs(thiscoord[0] - thiscoord[3]) < smallnum
+                && std::abs(thiscoord[1] - thiscoord[4]) < smallnum
+                && std::abs(thiscoord[2] - thiscoord[5]) < smallnum)
+            {
+                /* interchange first with second atom for better
+                 * compression of water molecules
+                 */
+                tmp          = thiscoord[0];
+                thiscoord[0] = thiscoord[3];
+                thiscoord[3] = tmp;
+                tmp          = thiscoord[1];
+                thiscoord[1] = thiscoord[4];
+                thiscoord[4] = tmp;
+                tmp          = thiscoord[2];
+                thiscoord[2] = thiscoord[5];
+                thiscoord[5] = tmp;
+                is_small     = 1;
+            }
         }
-
-        if (size3 <= prealloc_size)
+        tmpcoord[0] = thiscoord[0] - minint[0];
+        tmpcoord[1] = thiscoord[1] - minint[1];
+        tmpcoord[2] = thiscoord[2] - minint[2];
+        if (bitsize == 0)
         {
-            ip  = prealloc_ip;
-            buf = prealloc_buf;
+            sendbits(buf, bitsizeint[0], tmpcoord[0]);
+            sendbits(buf, bitsizeint[1], tmpcoord[1]);
+            sendbits(buf, bitsizeint[2], tmpcoord[2]);
         }
         else
         {
-            we_should_free = 1;
-            bufsize        = static_cast<int>(size3 * 1.2);
-            ip             = reinterpret_cast<int*>(malloc(size3 * sizeof(*ip)));
-            buf            = reinterpret_cast<int*>(malloc(bufsize * sizeof(*buf)));
-            if (ip == nullptr || buf == nullptr)
+            sendints(buf, 3, bitsize, sizeint, tmpcoord);
+        }
+        prevcoord[0] = thiscoord[0];
+        prevcoord[1] = thiscoord[1];
+        prevcoord[2] = thiscoord[2];
+        thiscoord    = thiscoord + 3;
+        i++;
+
+        run = 0;
+        if (is_small == 0 && is_smaller == -1)
+        {
+            is_smaller = 0;
+        }
+        while (is_small && run < 8 * 3)
+        {
+            if (is_smaller == -1
+                && (SQR(thiscoord[0] - prevcoord[0]) + SQR(thiscoord[1] - prevcoord[1])
+                            + SQR(thiscoord[2] - prevcoord[2])
+                    >= smaller * smaller))
             {
-                fprintf(stderr, "malloc failed\n");
-                exit(1);
+                is_smaller = 0;
             }
-        }
 
-        buf[0] = buf[1] = buf[2] = 0;
+            tmpcoord[run++] = thiscoord[0] - prevcoord[0] + smallnum;
+            tmpcoord[run++] = thiscoord[1] - prevcoord[1] + smallnum;
+            tmpcoord[run++] = thiscoord[2] - prevcoord[2] + smallnum;
 
-        if ((xdr_int(xdrs, &(minint[0])) == 0) || (xdr_int(xdrs, &(minint[1])) == 0)
-            || (xdr_int(xdrs, &(minint[2])) == 0) || (xdr_int(xdrs, &(maxint[0])) == 0)
-            || (xdr_int(xdrs, &(maxint[1])) == 0) || (xdr_int(xdrs, &(maxint[2])) == 0))
-        {
-            if (we_should_free)
+            prevcoord[0] = thiscoord[0];
+            prevcoord[1] = thiscoord[1];
+            prevcoord[2] = thiscoord[2];
+
+            i++;
+            thiscoord = thiscoord + 3;
+            is_small  = 0;
+            if (i < size && abs(thiscoord[0] - prevcoord[0]) < smallnum
+                && abs(thiscoord[1] - prevcoord[1]) < smallnum
+                && abs(thiscoord[2] - prevcoord[2]) < smallnum)
             {
-                free(ip);
-                free(buf);
+                is_small = 1;
             }
-            return 0;
         }
-
-        sizeint[0] = maxint[0] - minint[0] + 1;
-        sizeint[1] = maxint[1] - minint[1] + 1;
-        sizeint[2] = maxint[2] - minint[2] + 1;
-
-        /* check if one of the sizes is to big to be multiplied */
-        if ((sizeint[0] | sizeint[1] | sizeint[2]) > 0xffffff)
+        if (run != prevrun || is_smaller != 0)
         {
-            bitsizeint[0] = sizeofint(sizeint[0]);
-            bitsizeint[1] = sizeofint(sizeint[1]);
-            bitsizeint[2] = sizeofint(sizeint[2]);
-            bitsize       = 0; /* flag the use of large sizes */
+            prevrun = run;
+            sendbits(buf, 1, 1); /* flag the change in run-length */
+            sendbits(buf, 5, run + is_smaller + 1);
         }
         else
         {
-            bitsize = sizeofints(3, sizeint);
+            sendbits(buf, 1, 0); /* flag the fact that runlength did not change */
         }
-
-        if (xdr_int(xdrs, &smallidx) == 0)
+        for (k = 0; k < run; k += 3)
         {
-            if (we_should_free)
+            sendints(buf, 3, smallidx, sizesmall, &tmpcoord[k]);
+        }
+        if (is_smaller != 0)
+        {
+            smallidx += is_smaller;
+            if (is_smaller < 0)
             {
-                free(ip);
-                free(buf);
+                smallnum = smaller;
+                smaller  = magicints[smallidx - 1] / 2;
             }
-            return 0;
+            else
+            {
+                smaller  = smallnum;
+                smallnum = magicints[smallidx] / 2;
+            }
+            sizesmall[0] = sizesmall[1] = sizesmall[2] = magicints[smallidx];
         }
+    }
+    if (buf[1] != 0)
+    {
+        buf[0]++;
+    }
+    for (int d = 0; d < 3; d++)
+    {
+        coords->minint[d] = minint[d];
+        coords->maxint[d] = maxint[d];
+    }
+    /* buf[0] holds the length in bytes */
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(&buf[3]);
+    coords->bytes.assign(bytes, bytes + buf[0]);
 
-        smaller      = magicints[std::max(FIRSTIDX, smallidx - 1)] / 2;
-        smallnum     = magicints[smallidx] / 2;
-        sizesmall[0] = sizesmall[1] = sizesmall[2] = magicints[smallidx];
+    return errval;
+}
 
-        /* buf[0] holds the length in bytes */
+int xdr3dfcoord_write_compressed(XDR* xdrs, const XtcCompressedCoordinates& coords)
+{
+    int size = coords.size;
+    if (xdr_int(xdrs, &size) == 0)
+    {
+        return 0;
+    }
+    if (size <= 9)
+    {
+        return (xdr_vector(xdrs, reinterpret_cast<char*>(const_cast<float*>(coords.uncompressed.data())),
+                           static_cast<unsigned int>(size * 3), static_cast<unsigned int>(sizeof(float)),
+                           reinterpret_cast<xdrproc_t>(xdr_float)));
+    }
+    XtcCompressedCoordinates& c         = const_cast<XtcCompressedCoordinates&>(coords);
+    int                       byteCount = coords.bytes.size();
+    if ((xdr_float(xdrs, &c.precision) == 0) || (xdr_int(xdrs, &(c.minint[0])) == 0)
+        || (xdr_int(xdrs, &(c.minint[1])) == 0) || (xdr_int(xdrs, &(c.minint[2])) == 0)
+        || (xdr_int(xdrs, &(c.maxint[0])) == 0) || (xdr_int(xdrs, &(c.maxint[1])) == 0)
+        || (xdr_int(xdrs, &(c.maxint[2])) == 0) || (xdr_int(xdrs, &c.smallidx) == 0)
+        || (xdr_int(xdrs, &byteCount) == 0))
+    {
+        return 0;
+    }
+    return xdr_opaque(xdrs, reinterpret_cast<char*>(c.bytes.data()), static_cast<unsigned int>(byteCount));
+}
 
-        if (xdr_int(xdrs, &(buf[0])) == 0)
-        {
-            if (we_should_free)
-            {
-                free(ip);
-                free(buf);
-            }
-            return 0;
-        }
+int xdr3dfcoord(XDR* xdrs, float* fp, int* size, float* precision)
+{
+    XtcCompressedCoordinates coords;
 
+    if (xdrs->x_op != XDR_DECODE)
+    {
+        /* xdrs is open for writing */
+        const int errval = xdr3dfcoord_compress(fp, *size, *precision, &coords);
 
-        if (xdr_opaque(xdrs, reinterpret_cast<char*>(&(buf[3])), static_cast<unsigned int>(buf[0])) == 0)
+        return errval * xdr3dfcoord_write_compressed(xdrs, coords);
+    }
+    else
+    {
+        /* xdrs is open for reading */
+        if (xdr3dfcoord_read_compressed(xdrs, &coords) == 0)
         {
-            if (we_should_free)
-            {
-                free(ip);
-                free(buf);
-            }
             return 0;
         }
+        if (*size != 0 && coords.size != *size)
+        {
+            fprintf(stderr,
+                    "wrong number of coordinates in xdr3dfcoord; "
+                    "%d arg vs %d in file",
+                    *size, coords.size);
+        }
+        *size      = coords.size;
+        *precision = coords.precision;
 
+        return xdr3dfcoord_decompress(coords, fp);
+    }
+}
 
-        buf[0] = buf[1] = buf[2] = 0;
+int xdr3dfcoord_read_compressed(XDR* xdrs, XtcCompressedCoordinates* coords)
+{
+    int byteCount;
 
-        lfp           = fp;
-        inv_precision = 1.0 / *precision;
-        run           = 0;
-        i             = 0;
-        lip           = ip;
-        while (i < lsize)
-        {
-            thiscoord = reinterpret_cast<int*>(lip) + i * 3;
+    if (xdr_int(xdrs, &coords->size) == 0 || coords->size < 0)
+    {
+        return 0;
+    }
+    if (coords->size <= 9)
+    {
+        /* small systems are not compressed, but stored as plain floats */
+        coords->precision = -1;
+        coords->uncompressed.resize(coords->size * 3);
+        return (xdr_vector(xdrs, reinterpret_cast<char*>(coords->uncompressed.data()),
+                           static_cast<unsigned int>(coords->uncompressed.size()),
+                           static_cast<unsigned int>(sizeof(float)),
+                           reinterpret_cast<xdrproc_t>(xdr_float)));
+    }
+    if ((xdr_float(xdrs, &coords->precision) == 0) || (xdr_int(xdrs, &(coords->minint[0])) == 0)
+        || (xdr_int(xdrs, &(coords->minint[1])) == 0) || (xdr_int(xdrs, &(coords->minint[2])) == 0)
+        || (xdr_int(xdrs, &(coords->maxint[0])) == 0) || (xdr_int(xdrs, &(coords->maxint[1])) == 0)
+        || (xdr_int(xdrs, &(coords->maxint[2])) == 0) || (xdr_int(xdrs, &coords->smallidx) == 0))
+    {
+        return 0;
+    }
+    if (coords->smallidx < FIRSTIDX || coords->smallidx >= LASTIDX)
+    {
+        return 0;
+    }
 
-            if (bitsize == 0)
-            {
-                thiscoord[0] = receivebits(buf, bitsizeint[0]);
-                thiscoord[1] = receivebits(buf, bitsizeint[1]);
-                thiscoord[2] = receivebits(buf, bitsizeint[2]);
-            }
-            else
-            {
-                receiveints(buf, 3, bitsize, sizeint, thiscoord);
-            }
+    /* the length in bytes of the compressed data */
+    if (xdr_int(xdrs, &byteCount) == 0 || byteCount < 0)
+    {
+        return 0;
+    }
+    coords->bytes.resize(byteCount);
 
-            i++;
-            thiscoord[0] += minint[0];
-            thiscoord[1] += minint[1];
-            thiscoord[2] += minint[2];
+    return xdr_opaque(xdrs, reinterpret_cast<char*>(coords->bytes.data()),
+                      static_cast<unsigned int>(byteCount));
+}
 
-            prevcoord[0] = thiscoord[0];
-            prevcoord[1] = thiscoord[1];
-            prevcoord[2] = thiscoord[2];
+int xdr3dfcoord_decompress(const XtcCompressedCoordinates& coords, float* fp)
+{
+    const int lsize = coords.size;
+    unsigned  sizeint[3], sizesmall[3], bitsizeint[3];
+    int       bitsize;
+    int       smallidx, smallnum, smaller;
+    int       thiscoord[3], prevcoord[3];
+    int       i, k, tmp, flag, run, is_smaller;
+    float     inv_precision;
+
+    if (lsize <= 9)
+    {
+        std::copy(coords.uncompressed.begin(), coords.uncompressed.end(), fp);
+        return 1;
+    }
 
+    sizeint[0] = coords.maxint[0] - coords.minint[0] + 1;
+    sizeint[1] = coords.maxint[1] - coords.minint[1] + 1;
+    sizeint[2] = coords.maxint[2] - coords.minint[2] + 1;
 
-            flag       = receivebits(buf, 1);
-            is_smaller = 0;
-            if (flag == 1)
-            {
-                run        = receivebits(buf, 5);
-                is_smaller = run % 3;
-                run -= is_smaller;
-                is_smaller--;
-            }
-            if (run > 0)
-            {
-                thiscoord += 3;
-                for (k = 0; k < run; k += 3)
-                {
-                    receiveints(buf, 3, smallidx, sizesmall, thiscoord);
-                    i++;
-                    thiscoord[0] += prevcoord[0] - smallnum;
-                    thiscoord[1] += prevcoord[1] - smallnum;
-                    thiscoord[2] += prevcoord[2] - smallnum;
-                    if (k == 0)
-                    {
-                        /* interchange first with second atom for better
-                         * compression of water molecules
-                         */
-                        tmp          = thiscoord[0];
-                        thiscoord[0] = prevcoord[0];
-                        prevcoord[0] = tmp;
-                        tmp          = thiscoord[1];
-                        thiscoord[1] = prevcoord[1];
-                        prevcoord[1] = tmp;
-                        tmp          = thiscoord[2];
-                        thiscoord[2] = prevcoord[2];
-                        prevcoord[2] = tmp;
-                        *lfp++       = prevcoord[0] * inv_precision;
-                        *lfp++       = prevcoord[1] * inv_precision;
-                        *lfp++       = prevcoord[2] * inv_precision;
-                    }
-                    else
-                    {
-                        prevcoord[0] = thiscoord[0];
-                        prevcoord[1] = thiscoord[1];
-                        prevcoord[2] = thiscoord[2];
-                    }
-                    *lfp++ = thiscoord[0] * inv_precision;
-                    *lfp++ = thiscoord[1] * inv_precision;
-                    *lfp++ = thiscoord[2] * inv_precision;
-                }
-            }
-            else
-            {
-                *lfp++ = thiscoord[0] * inv_precision;
-                *lfp++ = thiscoord[1] * inv_precision;
-                *lfp++ = thiscoord[2] * inv_precision;
-            }
-            smallidx += is_smaller;
-            if (is_smaller < 0)
+    /* check if one of the sizes is to big to be multiplied */
+    bitsizeint[0] = bitsizeint[1] = bitsizeint[2] = 0;
+    if ((sizeint[0] | sizeint[1] | sizeint[2]) > 0xffffff)
+    {
+        bitsizeint[0] = sizeofint(sizeint[0]);
+        bitsizeint[1] = sizeofint(sizeint[1]);
+        bitsizeint[2] = sizeofint(sizeint[2]);
+        bitsize       = 0; /* flag the use of large sizes */
+    }
+    else
+    {
+        bitsize = sizeofints(3, sizeint);
+    }
+
+    smallidx     = coords.smallidx;
+    smaller      = magicints[std::max(FIRSTIDX, smallidx - 1)] / 2;
+    smallnum     = magicints[smallidx] / 2;
+    sizesmall[0] = sizesmall[1] = sizesmall[2] = magicints[smallidx];
+
+    /* The integer coordinates are decoded first in output order, then
+     * converted to float in a separate pass that can use SIMD.
+     */
+    std::vector<int> ip(3 * lsize);
+    int*             lip = ip.data();
+    XtcBitReader     reader(coords.bytes.data(), coords.bytes.size());
+
+    run = 0;
+    i   = 0;
+    while (i < lsize)
+    {
+        if (bitsize == 0)
+        {
+            thiscoord[0] = reader.receivebits(bitsizeint[0]);
+            thiscoord[1] = reader.receivebits(bitsizeint[1]);
+            thiscoord[2] = reader.receivebits(bitsizeint[2]);
+        }
+        else
+        {
+            receiveints(&reader, 3, bitsize, sizeint, thiscoord);
+        }
+
+        i++;
+        thiscoord[0] += coords.minint[0];
+        thiscoord[1] += coords.minint[1];
+        thiscoord[2] += coords.minint[2];
+
+        prevcoord[0] = thiscoord[0];
+        prevcoord[1] = thiscoord[1];
+        prevcoord[2] = thiscoord[2];
+
+
+        flag       = reader.receivebits(1);
+        is_smaller = 0;
+        if (flag == 1)
+        {
+            run        = reader.receivebits(5);
+            is_smaller = run % 3;
+            run -= is_smaller;
+            is_smaller--;
+        }
+        if (run > 0)
+        {
+            for (k = 0; k < run && i < lsize; k += 3)
             {
-                smallnum = smaller;
-                if (smallidx > FIRSTIDX)
+                receiveints(&reader, 3, smallidx, sizesmall, thiscoord);
+                i++;
+                thiscoord[0] += prevcoord[0] - smallnum;
+                thiscoord[1] += prevcoord[1] - smallnum;
+                thiscoord[2] += prevcoord[2] - smallnum;
+                if (k == 0)
                 {
-                    smaller = magicints[smallidx - 1] / 2;
+                    /* interchange first with second atom for better
+                     * compression of water molecules
+                     */
+                    tmp          = thiscoord[0];
+                    thiscoord[0] = prevcoord[0];
+                    prevcoord[0] = tmp;
+                    tmp          = thiscoord[1];
+                    thiscoord[1] = prevcoord[1];
+                    prevcoord[1] = tmp;
+                    tmp          = thiscoord[2];
+                    thiscoord[2] = prevcoord[2];
+                    prevcoord[2] = tmp;
+                    *lip++       = prevcoord[0];
+                    *lip++       = prevcoord[1];
+                    *lip++       = prevcoord[2];
                 }
                 else
                 {
-                    smaller = 0;
+                    prevcoord[0] = thiscoord[0];
+                    prevcoord[1] = thiscoord[1];
+                    prevcoord[2] = thiscoord[2];
                 }
+                *lip++ = thiscoord[0];
+                *lip++ = thiscoord[1];
+                *lip++ = thiscoord[2];
             }
-            else if (is_smaller > 0)
+        }
+        else
+        {
+            *lip++ = thiscoord[0];
+            *lip++ = thiscoord[1];
+            *lip++ = thiscoord[2];
+        }
+        smallidx += is_smaller;
+        if (is_smaller < 0)
+        {
+            smallnum = smaller;
+            if (smallidx > FIRSTIDX)
             {
-                smaller  = smallnum;
-                smallnum = magicints[smallidx] / 2;
+                smaller = magicints[smallidx - 1] / 2;
+            }
+            else
+            {
+                smaller = 0;
             }
-            sizesmall[0] = sizesmall[1] = sizesmall[2] = magicints[smallidx];
         }
+        else if (is_smaller > 0)
+        {
+            smaller  = smallnum;
+            smallnum = magicints[smallidx] / 2;
+        }
+        if (smallidx < FIRSTIDX || smallidx >= LASTIDX)
+        {
+            /* corrupt data, avoid indexing outside magicints */
+            return 0;
+        }
+        sizesmall[0] = sizesmall[1] = sizesmall[2] = magicints[smallidx];
     }
-    if (we_should_free)
+
+    inv_precision = 1.0 / coords.precision;
+    const int size3 = 3 * lsize;
+    int       n     = 0;
+#if GMX_SIMD_HAVE_FLOAT && GMX_SIMD_HAVE_LOADU && GMX_SIMD_HAVE_STOREU
+    const gmx::SimdFloat inv_precision_S(inv_precision);
+    for (; n + GMX_SIMD_FLOAT_WIDTH <= size3; n += GMX_SIMD_FLOAT_WIDTH)
     {
-        free(ip);
-        free(buf);
+        gmx::SimdFInt32 int_S = gmx::loadU<gmx::SimdFInt32>(ip.data() + n);
+        gmx::storeU(fp + n, gmx::cvtI2R(int_S) * inv_precision_S);
     }
+#endif
+    for (; n < size3; n++)
+    {
+        fp[n] = ip[n] * inv_precision;
+    }
+
     return 1;
 }
 
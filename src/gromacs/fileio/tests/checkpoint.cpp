@@ -0,0 +1,179 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2020, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \internal \file
+ * \brief
+ * Tests for the storage of per-atom state vectors in checkpoint files.
+ *
+ * \ingroup module_fileio
+ */
+#include "gmxpre.h"
+
+#include "gromacs/fileio/checkpoint_impl.h"
+
+#include <cstdio>
+
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "gromacs/fileio/gmxfio.h"
+#include "gromacs/mdtypes/state.h"
+
+#include "testutils/testasserts.h"
+#include "testutils/testfilemanager.h"
+
+namespace gmx
+{
+namespace test
+{
+namespace
+{
+
+class CheckpointStateVectorsTest : public ::testing::Test
+{
+public:
+    //! Returns a state with distinct, not exactly representable, coordinates and velocities
+    static t_state makeState(int numAtoms)
+    {
+        t_state state;
+        state.flags = (1 << estX) | (1 << estV);
+        state_change_natoms(&state, numAtoms);
+        for (int i = 0; i < numAtoms; i++)
+        {
+            for (int d = 0; d < DIM; d++)
+            {
+                state.x[i][d] = 0.1 * i + 0.3 * d + 1.0 / 3.0;
+                state.v[i][d] = -0.7 * d + 1e-4 * i - 1.0 / 7.0;
+            }
+        }
+        return state;
+    }
+
+    //! Writes the vectors of \p state to the test file
+    void writeState(bool useChunkedFormat, t_state* state)
+    {
+        t_fileio* fp = gmx_fio_open(fileName_.c_str(), "w");
+        EXPECT_EQ(0, doCheckpointStateVectors(fp, useChunkedFormat, state));
+        gmx_fio_close(fp);
+    }
+
+    //! Reads the vectors of a state with \p numAtoms atoms from the test file
+    t_state readState(bool useChunkedFormat, int numAtoms)
+    {
+        t_state state;
+        state.flags  = (1 << estX) | (1 << estV);
+        state.natoms = numAtoms;
+        t_fileio* fp = gmx_fio_open(fileName_.c_str(), "r");
+        EXPECT_EQ(0, doCheckpointStateVectors(fp, useChunkedFormat, &state));
+        gmx_fio_close(fp);
+        return state;
+    }
+
+    //! Flips the bits of the byte at \p offset in the test file
+    void corruptByte(long offset)
+    {
+        FILE* fp = std::fopen(fileName_.c_str(), "r+b");
+        ASSERT_NE(nullptr, fp);
+        ASSERT_EQ(0, std::fseek(fp, offset, SEEK_SET));
+        int byte = std::fgetc(fp);
+        ASSERT_NE(EOF, byte);
+        ASSERT_EQ(0, std::fseek(fp, offset, SEEK_SET));
+        ASSERT_EQ(byte ^ 0xff, std::fputc(byte ^ 0xff, fp));
+        std::fclose(fp);
+    }
+
+    //! Number of atoms in a chunk, must match the checkpoint writing code
+    static constexpr int c_numAtomsPerChunk = 32768;
+    //! Number of atoms giving two full chunks and one partial chunk
+    static constexpr int c_numAtoms = 2 * c_numAtomsPerChunk + 100;
+    TestFileManager      fileManager_;
+    std::string          fileName_ = fileManager_.getTemporaryFilePath("state.cpt");
+};
+
+//! Checks that \p state and \p reference have bitwise identical coordinates and velocities
+void compareStates(const t_state& reference, const t_state& state)
+{
+    ASSERT_EQ(reference.natoms, state.natoms);
+    for (int i = 0; i < reference.natoms; i++)
+    {
+        for (int d = 0; d < DIM; d++)
+        {
+            EXPECT_EQ(reference.x[i][d], state.x[i][d]) << "x of atom " << i;
+            EXPECT_EQ(reference.v[i][d], state.v[i][d]) << "v of atom " << i;
+        }
+    }
+}
+
+TEST_F(CheckpointStateVectorsTest, RoundTripsBeforeChunkedFormat)
+{
+    t_state reference = makeState(c_numAtoms);
+    writeState(false, &reference);
+    compareStates(reference, readState(false, c_numAtoms));
+}
+
+TEST_F(CheckpointStateVectorsTest, RoundTripsInChunkedFormat)
+{
+    t_state reference = makeState(c_numAtoms);
+    writeState(true, &reference);
+    compareStates(reference, readState(true, c_numAtoms));
+}
+
+TEST_F(CheckpointStateVectorsTest, RoundTripsInChunkedFormatWithSingleChunk)
+{
+    t_state reference = makeState(5);
+    writeState(true, &reference);
+    compareStates(reference, readState(true, 5));
+}
+
+TEST_F(CheckpointStateVectorsTest, ReportsOnlyTheDamagedChunk)
+{
+    t_state reference = makeState(c_numAtoms);
+    writeState(true, &reference);
+
+    // The x entry starts with the count, type and chunk size, followed
+    // by one 64-bit checksum per chunk and then the data of all chunks.
+    const int  numChunks  = 3;
+    const long dataOffset = 3 * 4 + numChunks * 8;
+    const long chunkBytes = c_numAtomsPerChunk * DIM * sizeof(real);
+    corruptByte(dataOffset + chunkBytes + 1000);
+
+    GMX_EXPECT_DEATH_IF_SUPPORTED(readState(true, c_numAtoms),
+                                  "Checksum mismatch for state entry x in atom range\\(s\\) "
+                                  "32769-65536, the");
+}
+
+} // namespace
+} // namespace test
+} // namespace gmx
@@ -0,0 +1,270 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2021, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \internal \file
+ * \brief
+ * Tests for the column-oriented energy store.
+ *
+ * \ingroup module_fileio
+ */
+#include "gmxpre.h"
+
+#include "gromacs/fileio/energycolumnstore.h"
+
+#include <cmath>
+#include <cstdio>
+
+#include <algorithm>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "gromacs/fileio/enxio.h"
+#include "gromacs/trajectory/energyframe.h"
+#include "gromacs/utility/exceptions.h"
+#include "gromacs/utility/smalloc.h"
+#include "gromacs/utility/stringutil.h"
+
+#include "testutils/testasserts.h"
+#include "testutils/testfilemanager.h"
+
+namespace gmx
+{
+namespace test
+{
+namespace
+{
+
+//! Number of energy terms in the test files
+constexpr int c_numTerms = 3;
+
+//! Returns the energy of term \p i in frame \p frame
+double energyValue(int frame, int i)
+{
+    return -1000.0 * (i + 1) + 0.25 * frame * i + std::sin(0.7 * frame);
+}
+
+class EnergyColumnStoreTest : public ::testing::Test
+{
+public:
+    /*! \brief Writes an energy file with \p numFrames frames
+     *
+     * With \p withBlockOnlyFrames, a frame with only a data block and no
+     * energies follows each frame with energies, as mdrun writes for
+     * free-energy data between energy output steps.
+     */
+    void writeEnergyFile(int numFrames, bool withBlockOnlyFrames = false)
+    {
+        ener_file_t ef = open_enx(edrFileName_.c_str(), "w");
+        gmx_enxnm_t names[c_numTerms];
+        char        nameBuffers[c_numTerms][10];
+        char        unit[] = "kJ/mol";
+        for (int i = 0; i < c_numTerms; i++)
+        {
+            sprintf(nameBuffers[i], "Term-%d", i);
+            names[i].name = nameBuffers[i];
+            names[i].unit = unit;
+        }
+        int          nre = c_numTerms;
+        gmx_enxnm_t* nms = names;
+        do_enxnms(ef, &nre, &nms);
+
+        t_energy   energies[c_numTerms] = {};
+        t_enxframe fr;
+        init_enxframe(&fr);
+        double     blockData[2];
+        t_enxframe blockFrame;
+        init_enxframe(&blockFrame);
+        blockFrame.nre = 0;
+        add_blocks_enxframe(&blockFrame, 1);
+        add_subblocks_enxblock(&blockFrame.block[0], 1);
+        blockFrame.block[0].id          = enxDHHIST;
+        blockFrame.block[0].sub[0].type = xdr_datatype_double;
+        blockFrame.block[0].sub[0].nr   = 2;
+        blockFrame.block[0].sub[0].dval = blockData;
+        for (int frame = 0; frame < numFrames; frame++)
+        {
+            for (int i = 0; i < c_numTerms; i++)
+            {
+                energies[i].e = energyValue(frame, i);
+            }
+            fr.t    = 0.5 * frame;
+            fr.step = 25 * frame;
+            fr.nre  = c_numTerms;
+            fr.ener = energies;
+            do_enx(ef, &fr);
+            if (withBlockOnlyFrames)
+            {
+                blockData[0]    = frame;
+                blockData[1]    = -frame;
+                blockFrame.t    = 0.5 * frame + 0.25;
+                blockFrame.step = 25 * frame + 10;
+                do_enx(ef, &blockFrame);
+            }
+        }
+        /* The frames do not own the data */
+        fr.ener = nullptr;
+        free_enxframe(&fr);
+        sfree(blockFrame.block[0].sub);
+        sfree(blockFrame.block);
+        done_ener_file(ef);
+    }
+
+    //! Returns the statistics of \p term over frames [first, end) computed directly
+    static EnergyTermStatistics referenceStatistics(int term, int first, int end)
+    {
+        EnergyTermStatistics stats;
+        stats.numFrames = end - first;
+        stats.min       = energyValue(first, term);
+        stats.max       = stats.min;
+        double sumT = 0, sumE = 0;
+        for (int f = first; f < end; f++)
+        {
+            stats.min = std::min(stats.min, energyValue(f, term));
+            stats.max = std::max(stats.max, energyValue(f, term));
+            sumT += 0.5 * f;
+            sumE += energyValue(f, term);
+        }
+        const double meanT = sumT / stats.numFrames;
+        stats.average      = sumE / stats.numFrames;
+        double sumTT = 0, sumEE = 0, sumTE = 0;
+        for (int f = first; f < end; f++)
+        {
+            const double dt = 0.5 * f - meanT;
+            const double de = energyValue(f, term) - stats.average;
+            sumTT += dt * dt;
+            sumEE += de * de;
+            sumTE += dt * de;
+        }
+        stats.rmsd  = std::sqrt(sumEE / stats.numFrames);
+        stats.drift = sumTE / sumTT * 0.5 * (end - 1 - first);
+        return stats;
+    }
+
+    TestFileManager fileManager_;
+    std::string     edrFileName_   = fileManager_.getTemporaryFilePath("ener.edr");
+    std::string     storeFileName_ = fileManager_.getTemporaryFilePath("ener.ecol");
+};
+
+TEST_F(EnergyColumnStoreTest, StoresAllTermsAndFrames)
+{
+    writeEnergyFile(11);
+    convertEnergyFileToColumnStore(edrFileName_, storeFileName_, 4);
+    EnergyColumnStore store(storeFileName_);
+
+    ASSERT_EQ(c_numTerms, store.numTerms());
+    ASSERT_EQ(11, store.numFrames());
+    EXPECT_EQ(4, store.chunkSize());
+    EXPECT_EQ("Term-1", store.termName(1));
+    EXPECT_EQ("kJ/mol", store.termUnit(1));
+    EXPECT_EQ(2, store.findTerm("Term-2"));
+    EXPECT_EQ(-1, store.findTerm("Pressure"));
+    for (int frame = 0; frame < 11; frame++)
+    {
+        EXPECT_EQ(0.5 * frame, store.times()[frame]);
+        EXPECT_EQ(25 * frame, store.steps()[frame]);
+    }
+    for (int i = 0; i < c_numTerms; i++)
+    {
+        ArrayRef<const double> values = store.values(i);
+        ASSERT_EQ(11U, values.size());
+        for (int frame = 0; frame < 11; frame++)
+        {
+            /* The energy file stores the values in the precision of real */
+            EXPECT_EQ(static_cast<double>(static_cast<real>(energyValue(frame, i))), values[frame]);
+        }
+    }
+    ASSERT_EQ(3U, store.chunkSummaries(0).size());
+}
+
+TEST_F(EnergyColumnStoreTest, StatisticsMatchDirectComputation)
+{
+    writeEnergyFile(23);
+    convertEnergyFileToColumnStore(edrFileName_, storeFileName_, 5);
+    EnergyColumnStore store(storeFileName_);
+
+    const std::vector<std::pair<int, int>> ranges = { { 0, 23 }, { 5, 20 }, { 3, 17 }, { 6, 9 }, { 21, 23 } };
+    /* The energies are stored in real precision, the reference values are exact */
+    const FloatingPointTolerance tolerance = relativeToleranceAsFloatingPoint(1000, 1e-5);
+    for (int term = 0; term < c_numTerms; term++)
+    {
+        for (const auto& range : ranges)
+        {
+            SCOPED_TRACE(formatString("Term %d, frames %d to %d", term, range.first, range.second));
+            EnergyTermStatistics stats = store.statistics(term, range.first, range.second);
+            EnergyTermStatistics ref   = referenceStatistics(term, range.first, range.second);
+            EXPECT_EQ(ref.numFrames, stats.numFrames);
+            EXPECT_REAL_EQ_TOL(ref.min, stats.min, tolerance);
+            EXPECT_REAL_EQ_TOL(ref.max, stats.max, tolerance);
+            EXPECT_REAL_EQ_TOL(ref.average, stats.average, tolerance);
+            EXPECT_REAL_EQ_TOL(ref.rmsd, stats.rmsd, relativeToleranceAsFloatingPoint(1, 1e-2));
+            EXPECT_REAL_EQ_TOL(ref.drift, stats.drift, relativeToleranceAsFloatingPoint(1, 1e-2));
+        }
+    }
+}
+
+TEST_F(EnergyColumnStoreTest, SkipsFramesWithOnlyDataBlocks)
+{
+    writeEnergyFile(9, true);
+    convertEnergyFileToColumnStore(edrFileName_, storeFileName_, 4);
+    EnergyColumnStore store(storeFileName_);
+
+    ASSERT_EQ(c_numTerms, store.numTerms());
+    ASSERT_EQ(9, store.numFrames());
+    for (int frame = 0; frame < 9; frame++)
+    {
+        EXPECT_EQ(0.5 * frame, store.times()[frame]);
+        EXPECT_EQ(25 * frame, store.steps()[frame]);
+    }
+    ArrayRef<const double> values = store.values(2);
+    ASSERT_EQ(9U, values.size());
+    for (int frame = 0; frame < 9; frame++)
+    {
+        EXPECT_EQ(static_cast<double>(static_cast<real>(energyValue(frame, 2))), values[frame]);
+    }
+}
+
+TEST_F(EnergyColumnStoreTest, RejectsInvalidFile)
+{
+    FILE* fp = std::fopen(storeFileName_.c_str(), "w");
+    std::fputs("not an energy column store", fp);
+    std::fclose(fp);
+    EXPECT_THROW_GMX(EnergyColumnStore store(storeFileName_), FileIOError);
+}
+
+} // namespace
+} // namespace test
+} // namespace gmx
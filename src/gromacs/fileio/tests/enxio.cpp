@@ -0,0 +1,317 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2021, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \internal \file
+ * \brief
+ * Tests for the energy file frame index, seeking and column projection.
+ *
+ * \ingroup module_fileio
+ */
+#include "gmxpre.h"
+
+#include "gromacs/fileio/enxio.h"
+
+#include <cstdio>
+
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "gromacs/trajectory/energyframe.h"
+#include "gromacs/utility/smalloc.h"
+#include "gromacs/utility/stringutil.h"
+
+#include "testutils/testfilemanager.h"
+
+namespace gmx
+{
+namespace test
+{
+namespace
+{
+
+//! Number of energy terms in the test files
+constexpr int c_numTerms = 4;
+
+//! Returns the energy of term \p i in frame \p frame
+real energyValue(int frame, int i)
+{
+    return 100.0 * i + 0.5 * frame;
+}
+
+//! Returns the string stored in frame \p frame
+std::string frameLabel(int frame)
+{
+    return formatString("frame %s", std::string(frame + 1, 'x').c_str());
+}
+
+class EnergyFileIndexTest : public ::testing::Test
+{
+public:
+    /*! \brief Writes \p numFrames frames with energies and a block with
+     * float, int and string sub-blocks
+     *
+     * The strings differ in length between frames, so skipping them
+     * cannot work with a fixed frame size.
+     */
+    void writeFrames(int numFrames)
+    {
+        ener_file_t ef = open_enx(fileName_.c_str(), "w");
+        gmx_enxnm_t names[c_numTerms];
+        char        nameBuffers[c_numTerms][10];
+        char        unit[] = "kJ/mol";
+        for (int i = 0; i < c_numTerms; i++)
+        {
+            sprintf(nameBuffers[i], "Term-%d", i);
+            names[i].name = nameBuffers[i];
+            names[i].unit = unit;
+        }
+        int          nre = c_numTerms;
+        gmx_enxnm_t* nms = names;
+        do_enxnms(ef, &nre, &nms);
+
+        t_energy   energies[c_numTerms];
+        float      floatData[3];
+        int        intData[2];
+        char*      strings[2];
+        t_enxframe fr;
+        init_enxframe(&fr);
+        add_blocks_enxframe(&fr, 1);
+        add_subblocks_enxblock(&fr.block[0], 3);
+        fr.block[0].id          = enxDISRE;
+        fr.block[0].sub[0].type = xdr_datatype_float;
+        fr.block[0].sub[0].nr   = 3;
+        fr.block[0].sub[0].fval = floatData;
+        fr.block[0].sub[1].type = xdr_datatype_int;
+        fr.block[0].sub[1].nr   = 2;
+        fr.block[0].sub[1].ival = intData;
+        fr.block[0].sub[2].type = xdr_datatype_string;
+        fr.block[0].sub[2].nr   = 2;
+        fr.block[0].sub[2].sval = strings;
+        for (int frame = 0; frame < numFrames; frame++)
+        {
+            for (int i = 0; i < c_numTerms; i++)
+            {
+                energies[i].e    = energyValue(frame, i);
+                energies[i].eav  = 2 * i;
+                energies[i].esum = 3 * i;
+            }
+            for (int j = 0; j < 3; j++)
+            {
+                floatData[j] = frame + j;
+            }
+            intData[0] = frame;
+            intData[1] = -frame;
+            std::string label = frameLabel(frame);
+            std::string empty;
+            strings[0]        = &label[0];
+            strings[1]        = &empty[0];
+            fr.t      = 2.0 * frame;
+            fr.step   = 10 * frame;
+            fr.nsteps = 10;
+            fr.dt     = 0.002;
+            fr.nsum   = (frame == 0 ? 1 : 10);
+            fr.nre    = c_numTerms;
+            fr.ener   = energies;
+            do_enx(ef, &fr);
+        }
+        /* The frame does not own the data */
+        fr.ener = nullptr;
+        sfree(fr.block[0].sub);
+        sfree(fr.block);
+        done_ener_file(ef);
+    }
+
+    //! Opens the test file for reading
+    ener_file_t openForReading()
+    {
+        ener_file_t  ef  = open_enx(fileName_.c_str(), "r");
+        int          nre = 0;
+        gmx_enxnm_t* nms = nullptr;
+        do_enxnms(ef, &nre, &nms);
+        free_enxnms(nre, nms);
+        EXPECT_EQ(c_numTerms, nre);
+        return ef;
+    }
+
+    TestFileManager fileManager_;
+    std::string     fileName_ = fileManager_.getTemporaryFilePath("ener.edr");
+};
+
+TEST_F(EnergyFileIndexTest, IndexContainsAllFrames)
+{
+    writeFrames(7);
+    ener_file_t ef = openForReading();
+
+    int64_t                       numFrames;
+    const t_enxframe_index_entry* index = enx_get_frame_index(ef, &numFrames);
+    ASSERT_EQ(7, numFrames);
+    for (int frame = 0; frame < numFrames; frame++)
+    {
+        EXPECT_EQ(10 * frame, index[frame].step);
+        EXPECT_EQ(2.0 * frame, index[frame].t);
+        EXPECT_EQ(c_numTerms, index[frame].nre);
+        EXPECT_EQ(1, index[frame].nblock);
+    }
+
+    /* Building the index does not change the reading position */
+    t_enxframe fr;
+    init_enxframe(&fr);
+    ASSERT_TRUE(do_enx(ef, &fr));
+    EXPECT_EQ(0, fr.step);
+    free_enxframe(&fr);
+    done_ener_file(ef);
+}
+
+TEST_F(EnergyFileIndexTest, SeeksToTimeAndFrame)
+{
+    writeFrames(10);
+    ener_file_t ef = openForReading();
+    t_enxframe  fr;
+    init_enxframe(&fr);
+
+    ASSERT_TRUE(enx_seek_time(ef, 9.0));
+    ASSERT_TRUE(do_enx(ef, &fr));
+    EXPECT_EQ(50, fr.step);
+    EXPECT_EQ(energyValue(5, 2), fr.ener[2].e);
+    ASSERT_EQ(1, fr.nblock);
+    EXPECT_EQ(6, fr.block[0].sub[0].fval[1]);
+    EXPECT_EQ(-5, fr.block[0].sub[1].ival[1]);
+    ASSERT_EQ(2, fr.block[0].sub[2].nr);
+    EXPECT_STREQ(frameLabel(5).c_str(), fr.block[0].sub[2].sval[0]);
+    EXPECT_STREQ("", fr.block[0].sub[2].sval[1]);
+
+    ASSERT_TRUE(enx_seek_frame(ef, 2));
+    ASSERT_TRUE(do_enx(ef, &fr));
+    EXPECT_EQ(20, fr.step);
+    EXPECT_STREQ(frameLabel(2).c_str(), fr.block[0].sub[2].sval[0]);
+
+    /* Failed seeks leave the position unchanged */
+    EXPECT_FALSE(enx_seek_time(ef, 100.0));
+    EXPECT_FALSE(enx_seek_frame(ef, 10));
+    ASSERT_TRUE(do_enx(ef, &fr));
+    EXPECT_EQ(30, fr.step);
+
+    free_enxframe(&fr);
+    done_ener_file(ef);
+}
+
+TEST_F(EnergyFileIndexTest, ReadsAllFramesWithStringSubBlocks)
+{
+    writeFrames(4);
+    ener_file_t ef = openForReading();
+    t_enxframe  fr;
+    init_enxframe(&fr);
+
+    for (int frame = 0; frame < 4; frame++)
+    {
+        ASSERT_TRUE(do_enx(ef, &fr));
+        EXPECT_EQ(10 * frame, fr.step);
+        ASSERT_EQ(1, fr.nblock);
+        ASSERT_EQ(3, fr.block[0].nsub);
+        EXPECT_EQ(frame + 2, fr.block[0].sub[0].fval[2]);
+        EXPECT_EQ(-frame, fr.block[0].sub[1].ival[1]);
+        EXPECT_STREQ(frameLabel(frame).c_str(), fr.block[0].sub[2].sval[0]);
+        EXPECT_STREQ("", fr.block[0].sub[2].sval[1]);
+    }
+    EXPECT_FALSE(do_enx(ef, &fr));
+
+    free_enxframe(&fr);
+    done_ener_file(ef);
+}
+
+TEST_F(EnergyFileIndexTest, SkipsStringSubBlocksOfFrames)
+{
+    writeFrames(4);
+    ener_file_t ef = openForReading();
+    t_enxframe  fr;
+    init_enxframe(&fr);
+
+    /* Skip the blocks of the first two frames, then read the rest fully */
+    const int selection[] = { 0 };
+    enx_set_projection(ef, 1, selection, FALSE);
+    for (int frame = 0; frame < 2; frame++)
+    {
+        ASSERT_TRUE(do_enx(ef, &fr));
+        EXPECT_EQ(10 * frame, fr.step);
+        EXPECT_EQ(0, fr.nblock);
+    }
+    enx_set_projection(ef, -1, nullptr, TRUE);
+    for (int frame = 2; frame < 4; frame++)
+    {
+        ASSERT_TRUE(do_enx(ef, &fr));
+        EXPECT_EQ(10 * frame, fr.step);
+        EXPECT_EQ(energyValue(frame, 3), fr.ener[3].e);
+        ASSERT_EQ(1, fr.nblock);
+        EXPECT_STREQ(frameLabel(frame).c_str(), fr.block[0].sub[2].sval[0]);
+    }
+    EXPECT_FALSE(do_enx(ef, &fr));
+
+    free_enxframe(&fr);
+    done_ener_file(ef);
+}
+
+TEST_F(EnergyFileIndexTest, ProjectionDecodesOnlySelectedTerms)
+{
+    writeFrames(3);
+    ener_file_t ef = openForReading();
+    const int   selection[] = { 1, 3 };
+    enx_set_projection(ef, 2, selection, FALSE);
+
+    t_enxframe fr;
+    init_enxframe(&fr);
+    for (int frame = 0; frame < 3; frame++)
+    {
+        ASSERT_TRUE(do_enx(ef, &fr));
+        EXPECT_EQ(10 * frame, fr.step);
+        EXPECT_EQ(0, fr.nblock);
+        EXPECT_EQ(0, fr.ener[0].e);
+        EXPECT_EQ(energyValue(frame, 1), fr.ener[1].e);
+        EXPECT_EQ(0, fr.ener[2].e);
+        EXPECT_EQ(energyValue(frame, 3), fr.ener[3].e);
+        if (frame > 0)
+        {
+            EXPECT_EQ(6, fr.ener[3].eav);
+            EXPECT_EQ(9, fr.ener[3].esum);
+        }
+    }
+    EXPECT_FALSE(do_enx(ef, &fr));
+
+    free_enxframe(&fr);
+    done_ener_file(ef);
+}
+
+} // namespace
+} // namespace test
+} // namespace gmx
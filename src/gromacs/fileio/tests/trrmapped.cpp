@@ -0,0 +1,228 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2021, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \internal \file
+ * \brief
+ * Tests for the memory-mapped TRR frame data reader.
+ *
+ * \ingroup module_fileio
+ */
+#include "gmxpre.h"
+
+#include "gromacs/fileio/trrmapped.h"
+
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "gromacs/fileio/gmxfio.h"
+#include "gromacs/fileio/trrio.h"
+#include "gromacs/fileio/xdrf.h"
+#include "gromacs/math/vec.h"
+
+#include "testutils/testfilemanager.h"
+
+namespace gmx
+{
+namespace test
+{
+namespace
+{
+
+TEST(XdrRealsFromBytesTest, ConvertsBigEndianFloats)
+{
+    const unsigned char bytes[] = { 0x3F, 0xC0, 0x00, 0x00, 0xC1, 0x20, 0x00, 0x00 };
+    real                values[2];
+    xdr_reals_from_bytes(bytes, false, 2, values);
+    EXPECT_EQ(1.5, values[0]);
+    EXPECT_EQ(-10.0, values[1]);
+}
+
+TEST(XdrRealsFromBytesTest, ConvertsBigEndianDoubles)
+{
+    const unsigned char bytes[] = { 0x3F, 0xF8, 0, 0, 0, 0, 0, 0, 0xC0, 0x24, 0, 0, 0, 0, 0, 0 };
+    real                values[2];
+    xdr_reals_from_bytes(bytes, true, 2, values);
+    EXPECT_EQ(1.5, values[0]);
+    EXPECT_EQ(-10.0, values[1]);
+}
+
+class MappedTrrFileTest : public ::testing::Test
+{
+public:
+    //! Returns the data vector \p which of \p frame
+    static std::vector<RVec> makeVectors(int numAtoms, int frame, int which)
+    {
+        std::vector<RVec> data(numAtoms);
+        for (int i = 0; i < numAtoms; i++)
+        {
+            data[i] = { 0.1F * i + frame, -0.37F * i * which, 1.0F / (i + which + frame + 1) };
+        }
+        return data;
+    }
+
+    //! Writes \p numFrames frames of \p numAtoms atoms with x, v and f
+    void writeFrames(int numAtoms, int numFrames)
+    {
+        t_fileio* fio = gmx_trr_open(fileName_.c_str(), "w");
+        for (int frame = 0; frame < numFrames; frame++)
+        {
+            matrix            box = { { 5.0F + frame, 0, 0 }, { 0.5F, 6, 0 }, { 0.25F, 0.125F, 7 } };
+            std::vector<RVec> x   = makeVectors(numAtoms, frame, 0);
+            std::vector<RVec> v   = makeVectors(numAtoms, frame, 1);
+            std::vector<RVec> f   = makeVectors(numAtoms, frame, 2);
+            gmx_trr_write_frame(fio, frame, 0.5 * frame, 0, box, numAtoms, as_rvec_array(x.data()),
+                                as_rvec_array(v.data()), as_rvec_array(f.data()));
+        }
+        gmx_trr_close(fio);
+    }
+
+    TestFileManager fileManager_;
+    std::string     fileName_ = fileManager_.getTemporaryFilePath("traj.trr");
+};
+
+TEST_F(MappedTrrFileTest, ReadsSameDataAsXdr)
+{
+    const int numAtoms  = 101;
+    const int numFrames = 3;
+    writeFrames(numAtoms, numFrames);
+
+    auto mappedFile = MappedTrrFile::open(fileName_);
+    if (!mappedFile)
+    {
+        /* Memory mapping is not supported on this platform */
+        return;
+    }
+
+    t_fileio* fio = gmx_trr_open(fileName_.c_str(), "r");
+    for (int frame = 0; frame < numFrames; frame++)
+    {
+        gmx_trr_header_t header;
+        gmx_bool         bOK;
+        ASSERT_TRUE(gmx_trr_read_frame_header(fio, &header, &bOK));
+        ASSERT_EQ(numAtoms, header.natoms);
+
+        matrix            box;
+        std::vector<RVec> x(numAtoms), v(numAtoms), f(numAtoms);
+        gmx_off_t         endOffset;
+        ASSERT_TRUE(mappedFile->readFrameData(gmx_fio_ftell(fio), header, box, as_rvec_array(x.data()),
+                                              as_rvec_array(v.data()), as_rvec_array(f.data()),
+                                              &endOffset));
+        matrix            refBox;
+        std::vector<RVec> refX(numAtoms), refV(numAtoms), refF(numAtoms);
+        ASSERT_TRUE(gmx_trr_read_frame_data(fio, &header, refBox, as_rvec_array(refX.data()),
+                                            as_rvec_array(refV.data()), as_rvec_array(refF.data())));
+        EXPECT_EQ(gmx_fio_ftell(fio), endOffset);
+
+        for (int d = 0; d < DIM; d++)
+        {
+            for (int e = 0; e < DIM; e++)
+            {
+                EXPECT_EQ(refBox[d][e], box[d][e]);
+            }
+        }
+        for (int i = 0; i < numAtoms; i++)
+        {
+            for (int d = 0; d < DIM; d++)
+            {
+                EXPECT_EQ(refX[i][d], x[i][d]);
+                EXPECT_EQ(refV[i][d], v[i][d]);
+                EXPECT_EQ(refF[i][d], f[i][d]);
+            }
+        }
+    }
+    gmx_trr_close(fio);
+}
+
+TEST_F(MappedTrrFileTest, SkipsDataNotRequested)
+{
+    const int numAtoms = 10;
+    writeFrames(numAtoms, 2);
+
+    auto mappedFile = MappedTrrFile::open(fileName_);
+    if (!mappedFile)
+    {
+        /* Memory mapping is not supported on this platform */
+        return;
+    }
+
+    t_fileio*        fio = gmx_trr_open(fileName_.c_str(), "r");
+    gmx_trr_header_t header;
+    gmx_bool         bOK;
+    ASSERT_TRUE(gmx_trr_read_frame_header(fio, &header, &bOK));
+    std::vector<RVec> f(numAtoms);
+    gmx_off_t         endOffset;
+    ASSERT_TRUE(mappedFile->readFrameData(gmx_fio_ftell(fio), header, nullptr, nullptr, nullptr,
+                                          as_rvec_array(f.data()), &endOffset));
+    std::vector<RVec> refF = makeVectors(numAtoms, 0, 2);
+    for (int i = 0; i < numAtoms; i++)
+    {
+        EXPECT_EQ(refF[i][XX], f[i][XX]);
+        EXPECT_EQ(refF[i][ZZ], f[i][ZZ]);
+    }
+
+    /* The next frame header starts at the end offset */
+    ASSERT_EQ(0, gmx_fio_seek(fio, endOffset));
+    ASSERT_TRUE(gmx_trr_read_frame_header(fio, &header, &bOK));
+    EXPECT_EQ(1, header.step);
+    gmx_trr_close(fio);
+}
+
+TEST_F(MappedTrrFileTest, RejectsFrameBeyondEndOfFile)
+{
+    const int numAtoms = 10;
+    writeFrames(numAtoms, 1);
+
+    auto mappedFile = MappedTrrFile::open(fileName_);
+    if (!mappedFile)
+    {
+        /* Memory mapping is not supported on this platform */
+        return;
+    }
+
+    t_fileio*        fio = gmx_trr_open(fileName_.c_str(), "r");
+    gmx_trr_header_t header;
+    gmx_bool         bOK;
+    ASSERT_TRUE(gmx_trr_read_frame_header(fio, &header, &bOK));
+    header.natoms *= 2;
+    gmx_off_t endOffset;
+    EXPECT_FALSE(mappedFile->readFrameData(gmx_fio_ftell(fio), header, nullptr, nullptr, nullptr,
+                                           nullptr, &endOffset));
+    gmx_trr_close(fio);
+}
+
+} // namespace
+} // namespace test
+} // namespace gmx
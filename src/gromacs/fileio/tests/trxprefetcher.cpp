@@ -0,0 +1,168 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2021, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \internal \file
+ * \brief
+ * Tests for gmx::TrajectoryFramePrefetcher.
+ *
+ * \ingroup module_fileio
+ */
+#include "gmxpre.h"
+
+#include "gromacs/fileio/trxprefetcher.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "gromacs/fileio/oenv.h"
+#include "gromacs/fileio/trxio.h"
+#include "gromacs/fileio/xtcio.h"
+#include "gromacs/math/vec.h"
+#include "gromacs/trajectory/trajectoryframe.h"
+#include "gromacs/utility/smalloc.h"
+
+#include "testutils/testfilemanager.h"
+
+namespace gmx
+{
+namespace test
+{
+namespace
+{
+
+class TrajectoryFramePrefetcherTest : public ::testing::Test
+{
+public:
+    TrajectoryFramePrefetcherTest()
+    {
+        output_env_init_default(&oenv_);
+        t_fileio* fio = open_xtc(fileName_.c_str(), "w");
+        matrix    box = { { 3, 0, 0 }, { 0, 3, 0 }, { 0, 0, 3 } };
+        for (int frame = 0; frame < c_numFrames; frame++)
+        {
+            std::vector<RVec> x(c_numAtoms);
+            for (int i = 0; i < c_numAtoms; i++)
+            {
+                x[i] = { 0.01F * i, 0.1F * frame, 0.02F * (i + frame) };
+            }
+            EXPECT_EQ(1, write_xtc(fio, c_numAtoms, frame, 0.5 * frame, box, as_rvec_array(x.data()), 1000));
+        }
+        close_xtc(fio);
+    }
+    ~TrajectoryFramePrefetcherTest() override { output_env_done(oenv_); }
+
+    //! Reads all frames, with \p numFramesAhead frames prefetched if positive
+    std::vector<std::vector<RVec>> readFrames(int numFramesAhead, std::vector<real>* times)
+    {
+        std::vector<std::vector<RVec>> frames;
+        t_trxstatus*                   status;
+        t_trxframe                     fr;
+        clear_trxframe(&fr, TRUE);
+        EXPECT_TRUE(read_first_frame(oenv_, &status, fileName_.c_str(), &fr, TRX_NEED_X));
+        std::unique_ptr<TrajectoryFramePrefetcher> prefetcher;
+        if (numFramesAhead > 0)
+        {
+            prefetcher = std::make_unique<TrajectoryFramePrefetcher>(oenv_, status, fr, numFramesAhead);
+        }
+        do
+        {
+            frames.emplace_back(fr.x, fr.x + fr.natoms);
+            times->push_back(fr.time);
+        } while (prefetcher ? prefetcher->readNextFrame(&fr) : read_next_frame(oenv_, status, &fr));
+        prefetcher.reset();
+        close_trx(status);
+        sfree(fr.x);
+        return frames;
+    }
+
+    static constexpr int c_numAtoms  = 30;
+    static constexpr int c_numFrames = 11;
+    gmx_output_env_t*    oenv_       = nullptr;
+    TestFileManager      fileManager_;
+    std::string          fileName_ = fileManager_.getTemporaryFilePath("traj.xtc");
+};
+
+TEST_F(TrajectoryFramePrefetcherTest, SupportsFixedSizeFormats)
+{
+    EXPECT_TRUE(TrajectoryFramePrefetcher::supportsFile("traj.xtc"));
+    EXPECT_TRUE(TrajectoryFramePrefetcher::supportsFile("traj.trr"));
+    EXPECT_FALSE(TrajectoryFramePrefetcher::supportsFile("conf.gro"));
+}
+
+TEST_F(TrajectoryFramePrefetcherTest, ReadsSameFramesAsSequentialReading)
+{
+    std::vector<real>              referenceTimes;
+    std::vector<std::vector<RVec>> reference = readFrames(0, &referenceTimes);
+    ASSERT_EQ(c_numFrames, static_cast<int>(reference.size()));
+    for (int numFramesAhead : { 1, 3, 20 })
+    {
+        SCOPED_TRACE("Frames read ahead " + std::to_string(numFramesAhead));
+        std::vector<real>              times;
+        std::vector<std::vector<RVec>> frames = readFrames(numFramesAhead, &times);
+        ASSERT_EQ(reference.size(), frames.size());
+        EXPECT_EQ(referenceTimes, times);
+        for (size_t frame = 0; frame < frames.size(); frame++)
+        {
+            for (int i = 0; i < c_numAtoms; i++)
+            {
+                for (int d = 0; d < DIM; d++)
+                {
+                    EXPECT_EQ(reference[frame][i][d], frames[frame][i][d]);
+                }
+            }
+        }
+    }
+}
+
+TEST_F(TrajectoryFramePrefetcherTest, CanStopBeforeEndOfTrajectory)
+{
+    t_trxstatus* status;
+    t_trxframe   fr;
+    clear_trxframe(&fr, TRUE);
+    ASSERT_TRUE(read_first_frame(oenv_, &status, fileName_.c_str(), &fr, TRX_NEED_X));
+    {
+        TrajectoryFramePrefetcher prefetcher(oenv_, status, fr, 2);
+        ASSERT_TRUE(prefetcher.readNextFrame(&fr));
+        EXPECT_EQ(1, fr.step);
+    }
+    close_trx(status);
+    sfree(fr.x);
+}
+
+} // namespace
+} // namespace test
+} // namespace gmx
@@ -0,0 +1,309 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2021, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \internal \file
+ * \brief
+ * Tests for the XTC frame index.
+ *
+ * \ingroup module_fileio
+ */
+#include "gmxpre.h"
+
+#include "gromacs/fileio/xtcindex.h"
+
+#include <cstdio>
+
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "gromacs/fileio/gmxfio.h"
+#include "gromacs/fileio/xtcio.h"
+#include "gromacs/math/vec.h"
+#include "gromacs/utility/futil.h"
+#include "gromacs/utility/smalloc.h"
+
+#include "testutils/testfilemanager.h"
+
+namespace gmx
+{
+namespace test
+{
+namespace
+{
+
+class XtcFrameIndexTest : public ::testing::Test
+{
+public:
+    //! Appends \p numFrames frames of a small system to the test trajectory, steps are shifted by \p stepShift
+    void writeFrames(int firstFrame, int numFrames, const char* mode, int stepShift = 0)
+    {
+        t_fileio* fio = open_xtc(fileName_.c_str(), mode);
+        matrix    box = { { 3, 0, 0 }, { 0, 3, 0 }, { 0, 0, 3 } };
+        for (int frame = firstFrame; frame < firstFrame + numFrames; frame++)
+        {
+            std::vector<RVec> x(c_numAtoms);
+            for (int i = 0; i < c_numAtoms; i++)
+            {
+                x[i] = { 0.1F * i + 0.01F * frame, 0.05F * i, 1.5F - 0.02F * i };
+            }
+            EXPECT_EQ(1, write_xtc(fio, c_numAtoms, 10 * frame + stepShift, 0.5 * frame, box,
+                                   as_rvec_array(x.data()), 1000));
+        }
+        close_xtc(fio);
+    }
+
+    //! Overwrites the big-endian 64-bit integer at \p offset in \p fileName
+    static void overwriteInt64(const std::string& fileName, long offset, uint64_t value)
+    {
+        unsigned char bytes[8];
+        for (int i = 0; i < 8; i++)
+        {
+            bytes[i] = static_cast<unsigned char>(value >> (8 * (7 - i)));
+        }
+        FILE* fp = std::fopen(fileName.c_str(), "r+b");
+        ASSERT_NE(nullptr, fp);
+        ASSERT_EQ(0, std::fseek(fp, offset, SEEK_SET));
+        ASSERT_EQ(8U, std::fwrite(bytes, 1, 8, fp));
+        std::fclose(fp);
+    }
+
+    //! Offset of the frame count in the index file header
+    static constexpr long c_numFramesOffset = 12;
+    //! Offset of the trajectory modification time in the index file header
+    static constexpr long c_modificationTimeOffset = 20;
+    //! Offset of the step of the second entry in the index file
+    static constexpr long c_secondEntryStepOffset = 56;
+
+    static constexpr int c_numAtoms = 50;
+    TestFileManager      fileManager_;
+    std::string          fileName_ = fileManager_.getTemporaryFilePath("traj.xtc");
+};
+
+TEST_F(XtcFrameIndexTest, BuildsIndexFromFrameHeaders)
+{
+    writeFrames(0, 5, "w");
+    t_fileio*     fio   = open_xtc(fileName_.c_str(), "r");
+    XtcFrameIndex index = XtcFrameIndex::build(fio);
+    EXPECT_EQ(0, gmx_fio_ftell(fio));
+    close_xtc(fio);
+
+    ASSERT_EQ(5, index.numFrames());
+    EXPECT_EQ(c_numAtoms, index.numAtoms());
+    EXPECT_EQ(0, index[0].offset);
+    for (int frame = 0; frame < index.numFrames(); frame++)
+    {
+        EXPECT_EQ(10 * frame, index[frame].step);
+        EXPECT_FLOAT_EQ(0.5 * frame, index[frame].time);
+        if (frame > 0)
+        {
+            EXPECT_EQ(index[frame - 1].offset + index[frame - 1].size, index[frame].offset);
+        }
+    }
+    FILE* fp = gmx_ffopen(fileName_, "rb");
+    gmx_fseek(fp, 0, SEEK_END);
+    EXPECT_EQ(gmx_ftell(fp), index.indexedLength());
+    gmx_ffclose(fp);
+}
+
+TEST_F(XtcFrameIndexTest, SeekingToIndexedFrameReadsThatFrame)
+{
+    writeFrames(0, 5, "w");
+    t_fileio*     fio   = open_xtc(fileName_.c_str(), "r");
+    XtcFrameIndex index = XtcFrameIndex::build(fio);
+
+    int frame = index.findFirstFrameAtOrAfter(1.2);
+    EXPECT_EQ(3, frame);
+    gmx_fio_seek(fio, index[frame].offset);
+    int      natoms;
+    int64_t  step;
+    real     time, prec;
+    matrix   box;
+    rvec*    x;
+    gmx_bool bOK;
+    EXPECT_EQ(1, read_first_xtc(fio, &natoms, &step, &time, box, &x, &prec, &bOK));
+    EXPECT_EQ(30, step);
+    EXPECT_EQ(5, index.findFirstFrameAtOrAfter(100));
+    sfree(x);
+    close_xtc(fio);
+}
+
+TEST_F(XtcFrameIndexTest, RoundTripsThroughSidecarFile)
+{
+    writeFrames(0, 3, "w");
+    t_fileio*     fio   = open_xtc(fileName_.c_str(), "r");
+    XtcFrameIndex index = XtcFrameIndex::build(fio);
+    close_xtc(fio);
+
+    std::string indexFileName = fileManager_.getTemporaryFilePath("traj.xtc.idx");
+    ASSERT_TRUE(index.write(indexFileName));
+    XtcFrameIndex readIndex;
+    ASSERT_TRUE(XtcFrameIndex::read(indexFileName, &readIndex));
+    ASSERT_EQ(index.numFrames(), readIndex.numFrames());
+    EXPECT_EQ(index.numAtoms(), readIndex.numAtoms());
+    for (int frame = 0; frame < index.numFrames(); frame++)
+    {
+        EXPECT_EQ(index[frame].step, readIndex[frame].step);
+        EXPECT_EQ(index[frame].time, readIndex[frame].time);
+        EXPECT_EQ(index[frame].offset, readIndex[frame].offset);
+        EXPECT_EQ(index[frame].size, readIndex[frame].size);
+    }
+}
+
+TEST_F(XtcFrameIndexTest, ReadingMissingSidecarFails)
+{
+    XtcFrameIndex index;
+    EXPECT_FALSE(XtcFrameIndex::read(fileManager_.getTemporaryFilePath("none.xtc.idx"), &index));
+}
+
+TEST_F(XtcFrameIndexTest, ReadingIndexWithTooLargeFrameCountFails)
+{
+    writeFrames(0, 3, "w");
+    t_fileio*     fio   = open_xtc(fileName_.c_str(), "r");
+    XtcFrameIndex index = XtcFrameIndex::build(fio);
+    close_xtc(fio);
+
+    std::string indexFileName = fileManager_.getTemporaryFilePath("traj.xtc.idx");
+    ASSERT_TRUE(index.write(indexFileName));
+    /* A corrupt frame count should be rejected without allocating for it */
+    overwriteInt64(indexFileName, c_numFramesOffset, uint64_t(1) << 40);
+    XtcFrameIndex readIndex;
+    EXPECT_FALSE(XtcFrameIndex::read(indexFileName, &readIndex));
+    /* A frame count just one above the stored entries should also fail */
+    overwriteInt64(indexFileName, c_numFramesOffset, 4);
+    EXPECT_FALSE(XtcFrameIndex::read(indexFileName, &readIndex));
+    EXPECT_EQ(0, readIndex.numFrames());
+}
+
+TEST_F(XtcFrameIndexTest, WritingIndexForMissingTrajectoryIsNotFatal)
+{
+    std::string missingFileName = fileManager_.getTemporaryFilePath("missing.xtc");
+    writeXtcFrameIndexForFile(missingFileName);
+    EXPECT_FALSE(gmx_fexist(XtcFrameIndex::sidecarFileName(missingFileName)));
+}
+
+TEST_F(XtcFrameIndexTest, UpdateAddsAppendedFrames)
+{
+    writeFrames(0, 3, "w");
+    t_fileio*     fio   = open_xtc(fileName_.c_str(), "r");
+    XtcFrameIndex index = XtcFrameIndex::build(fio);
+    EXPECT_FALSE(index.update(fio));
+    close_xtc(fio);
+
+    writeFrames(3, 2, "a");
+    fio = open_xtc(fileName_.c_str(), "r");
+    EXPECT_TRUE(index.update(fio));
+    close_xtc(fio);
+    ASSERT_EQ(5, index.numFrames());
+    EXPECT_EQ(40, index[4].step);
+}
+
+TEST_F(XtcFrameIndexTest, UpdateResumesAfterLastIntactFrame)
+{
+    writeFrames(0, 5, "w");
+    t_fileio*     fio   = open_xtc(fileName_.c_str(), "r");
+    XtcFrameIndex index = XtcFrameIndex::build(fio);
+    close_xtc(fio);
+    std::string indexFileName = fileManager_.getTemporaryFilePath("traj.xtc.idx");
+    ASSERT_TRUE(index.write(indexFileName));
+    /* Mark the step of the second entry, so we can tell whether the
+     * frames before the last intact frame are scanned again.
+     */
+    overwriteInt64(indexFileName, c_secondEntryStepOffset, 99);
+    ASSERT_TRUE(XtcFrameIndex::read(indexFileName, &index));
+
+    /* Mimic mdrun appending from a checkpoint: the file is truncated after
+     * the third frame and continued with frames that have different steps.
+     */
+    writeFrames(0, 3, "w");
+    writeFrames(3, 3, "a", 5);
+    fio = open_xtc(fileName_.c_str(), "r");
+    EXPECT_TRUE(index.update(fio));
+    close_xtc(fio);
+    ASSERT_EQ(6, index.numFrames());
+    EXPECT_EQ(99, index[1].step);
+    EXPECT_EQ(20, index[2].step);
+    EXPECT_EQ(35, index[3].step);
+    EXPECT_EQ(55, index[5].step);
+    EXPECT_EQ(index[2].offset + index[2].size, index[3].offset);
+}
+
+TEST_F(XtcFrameIndexTest, UpdateRebuildsIndexOfRewrittenFile)
+{
+    writeFrames(0, 4, "w");
+    t_fileio*     fio   = open_xtc(fileName_.c_str(), "r");
+    XtcFrameIndex index = XtcFrameIndex::build(fio);
+    close_xtc(fio);
+
+    writeFrames(7, 2, "w");
+    fio = open_xtc(fileName_.c_str(), "r");
+    EXPECT_TRUE(index.update(fio));
+    close_xtc(fio);
+    ASSERT_EQ(2, index.numFrames());
+    EXPECT_EQ(70, index[0].step);
+}
+
+TEST_F(XtcFrameIndexTest, UpdateRebuildsIndexWhenOnlyEarlierFramesChanged)
+{
+    writeFrames(0, 4, "w");
+    t_fileio*     fio   = open_xtc(fileName_.c_str(), "r");
+    XtcFrameIndex index = XtcFrameIndex::build(fio);
+    close_xtc(fio);
+    std::string indexFileName = fileManager_.getTemporaryFilePath("traj.xtc.idx");
+    ASSERT_TRUE(index.write(indexFileName));
+
+    /* Rewrite the file such that the first and last frames, and the file
+     * length, are identical, but the second frame has a different step.
+     * Only the modification time tells the index is stale. We set the
+     * stored time to an earlier value, since the rewrite can happen
+     * within the resolution of the file modification time.
+     */
+    writeFrames(0, 1, "w");
+    writeFrames(1, 1, "a", 5);
+    writeFrames(2, 2, "a");
+    overwriteInt64(indexFileName, c_modificationTimeOffset, 0);
+
+    XtcFrameIndex readIndex;
+    ASSERT_TRUE(XtcFrameIndex::read(indexFileName, &readIndex));
+    fio = open_xtc(fileName_.c_str(), "r");
+    EXPECT_TRUE(readIndex.update(fio));
+    close_xtc(fio);
+    ASSERT_EQ(4, readIndex.numFrames());
+    EXPECT_EQ(15, readIndex[1].step);
+}
+
+} // namespace
+} // namespace test
+} // namespace gmx
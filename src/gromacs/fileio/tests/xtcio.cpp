@@ -0,0 +1,532 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2021, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \internal \file
+ * \brief
+ * Tests for XTC coordinate compression and parallel decompression.
+ *
+ * \ingroup module_fileio
+ */
+#include "gmxpre.h"
+
+#include "gromacs/fileio/xtcio.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "gromacs/fileio/gmxfio.h"
+#include "gromacs/math/vec.h"
+#include "gromacs/utility/gmxassert.h"
+#include "gromacs/utility/smalloc.h"
+#include "gromacs/utility/stringutil.h"
+
+#include "testutils/refdata.h"
+#include "testutils/testasserts.h"
+#include "testutils/testfilemanager.h"
+
+namespace gmx
+{
+namespace test
+{
+namespace
+{
+
+//! Returns coordinates with water-like triplets that trigger the run-length compression
+std::vector<RVec> makeCoordinates(int numAtoms, int frame)
+{
+    std::vector<RVec> x(numAtoms);
+    for (int i = 0; i < numAtoms; i++)
+    {
+        if (i % 3 == 0)
+        {
+            x[i] = { std::fmod(0.731F * i + 0.013F * frame, 5.0F), std::fmod(0.377F * i, 5.0F),
+                     std::fmod(1.913F * i, 5.0F) - 2.5F };
+        }
+        else
+        {
+            x[i] = { x[i - 1][XX] + 0.0816F, x[i - 1][YY] - 0.0577F * (i % 3), x[i - 1][ZZ] + 0.01F * frame };
+        }
+    }
+    return x;
+}
+
+//! Returns the contents of the file \p fileName
+std::vector<char> readFileBytes(const std::string& fileName)
+{
+    std::vector<char> bytes;
+    FILE*             fp = std::fopen(fileName.c_str(), "rb");
+    int               c;
+    while (fp != nullptr && (c = std::fgetc(fp)) != EOF)
+    {
+        bytes.push_back(static_cast<char>(c));
+    }
+    if (fp != nullptr)
+    {
+        std::fclose(fp);
+    }
+    return bytes;
+}
+
+class XtcIOTest : public ::testing::Test
+{
+public:
+    //! Writes \p numFrames frames of \p numAtoms atoms to the test trajectory
+    void writeFrames(int numAtoms, int numFrames)
+    {
+        t_fileio* fio = open_xtc(fileName_.c_str(), "w");
+        matrix    box = { { 5, 0, 0 }, { 0, 5, 0 }, { 0, 0, 5 } };
+        for (int frame = 0; frame < numFrames; frame++)
+        {
+            std::vector<RVec> x = makeCoordinates(numAtoms, frame);
+            EXPECT_EQ(1, write_xtc(fio, numAtoms, frame, 0.1 * frame, box, as_rvec_array(x.data()), c_precision));
+        }
+        close_xtc(fio);
+    }
+
+    static constexpr real c_precision = 1000;
+    TestFileManager       fileManager_;
+    std::string           fileName_ = fileManager_.getTemporaryFilePath("traj.xtc");
+};
+
+TEST_F(XtcIOTest, DecompressedCoordinatesAreExactlyTheRoundedInput)
+{
+    for (int numAtoms : { 5, 60, 3000 })
+    {
+        SCOPED_TRACE("Number of atoms " + std::to_string(numAtoms));
+        writeFrames(numAtoms, 1);
+
+        t_fileio* fio = open_xtc(fileName_.c_str(), "r");
+        int       natoms;
+        int64_t   step;
+        real      time, prec;
+        matrix    box;
+        rvec*     x;
+        gmx_bool  bOK;
+        ASSERT_EQ(1, read_first_xtc(fio, &natoms, &step, &time, box, &x, &prec, &bOK));
+        close_xtc(fio);
+        ASSERT_EQ(numAtoms, natoms);
+
+        std::vector<RVec> ref          = makeCoordinates(numAtoms, 0);
+        const float       invPrecision = 1.0 / c_precision;
+        for (int i = 0; i < numAtoms; i++)
+        {
+            for (int d = 0; d < DIM; d++)
+            {
+                const float value = ref[i][d];
+                if (numAtoms <= 9)
+                {
+                    /* Small systems are stored uncompressed */
+                    EXPECT_EQ(value, x[i][d]);
+                }
+                else
+                {
+                    const float scaled = value * static_cast<float>(c_precision) + (value >= 0 ? 0.5F : -0.5F);
+                    EXPECT_EQ(static_cast<int>(scaled) * invPrecision, static_cast<float>(x[i][d]));
+                }
+            }
+        }
+        sfree(x);
+    }
+}
+
+TEST_F(XtcIOTest, ReadAheadGivesSameFramesAsSequentialReading)
+{
+    const int numAtoms  = 999;
+    const int numFrames = 11;
+    writeFrames(numAtoms, numFrames);
+
+    std::vector<std::vector<RVec>> reference;
+    t_fileio*                      fio = open_xtc(fileName_.c_str(), "r");
+    int                            natoms;
+    int64_t                        step;
+    real                           time, prec;
+    matrix                         box;
+    rvec*                          x;
+    gmx_bool                       bOK;
+    ASSERT_EQ(1, read_first_xtc(fio, &natoms, &step, &time, box, &x, &prec, &bOK));
+    do
+    {
+        reference.emplace_back(x, x + natoms);
+    } while (read_next_xtc(fio, natoms, &step, &time, box, x, &prec, &bOK));
+    EXPECT_TRUE(bOK);
+    close_xtc(fio);
+    ASSERT_EQ(numFrames, static_cast<int>(reference.size()));
+
+    fio = open_xtc(fileName_.c_str(), "r");
+    XtcReadAhead readAhead(3);
+    for (int frame = 0; frame < numFrames; frame++)
+    {
+        ASSERT_EQ(1, readAhead.readNextFrame(fio, natoms, &step, &time, box, x, &prec, &bOK));
+        EXPECT_EQ(frame, step);
+        for (int i = 0; i < natoms; i++)
+        {
+            EXPECT_EQ(reference[frame][i][XX], x[i][XX]);
+            EXPECT_EQ(reference[frame][i][YY], x[i][YY]);
+            EXPECT_EQ(reference[frame][i][ZZ], x[i][ZZ]);
+        }
+    }
+    EXPECT_EQ(0, readAhead.readNextFrame(fio, natoms, &step, &time, box, x, &prec, &bOK));
+    EXPECT_TRUE(bOK);
+    close_xtc(fio);
+    sfree(x);
+}
+
+TEST_F(XtcIOTest, ReadAheadDiscardPositionsFileAtNextFrame)
+{
+    const int numAtoms = 30;
+    writeFrames(numAtoms, 8);
+
+    t_fileio*    fio = open_xtc(fileName_.c_str(), "r");
+    XtcReadAhead readAhead(2);
+    int64_t      step;
+    real         time, prec;
+    matrix       box;
+    gmx_bool     bOK;
+    rvec*        x;
+    snew(x, numAtoms);
+    ASSERT_EQ(1, readAhead.readNextFrame(fio, numAtoms, &step, &time, box, x, &prec, &bOK));
+    ASSERT_EQ(1, readAhead.readNextFrame(fio, numAtoms, &step, &time, box, x, &prec, &bOK));
+    gmx_off_t nextFrameOffset = readAhead.nextFrameOffset(fio);
+    readAhead.discard(fio);
+    EXPECT_EQ(nextFrameOffset, gmx_fio_ftell(fio));
+    ASSERT_EQ(1, read_next_xtc(fio, numAtoms, &step, &time, box, x, &prec, &bOK));
+    EXPECT_EQ(2, step);
+    close_xtc(fio);
+    sfree(x);
+}
+
+TEST_F(XtcIOTest, ParallelWriterWritesSameFileAsSequentialWriting)
+{
+    for (int numAtoms : { 5, 3000 })
+    {
+        SCOPED_TRACE("Number of atoms " + std::to_string(numAtoms));
+        /* Not a multiple of the window size, so flushing writes a partial window */
+        const int numFrames = 11;
+        writeFrames(numAtoms, numFrames);
+
+        const std::string parallelFileName = fileManager_.getTemporaryFilePath("parallel.xtc");
+        t_fileio*         fio              = open_xtc(parallelFileName.c_str(), "w");
+        matrix            box              = { { 5, 0, 0 }, { 0, 5, 0 }, { 0, 0, 5 } };
+        {
+            XtcParallelWriter writer(2);
+            for (int frame = 0; frame < numFrames; frame++)
+            {
+                std::vector<RVec> x = makeCoordinates(numAtoms, frame);
+                EXPECT_EQ(1, writer.writeFrame(fio, numAtoms, frame, 0.1 * frame, box,
+                                               as_rvec_array(x.data()), c_precision));
+            }
+            EXPECT_EQ(1, writer.flush(fio));
+        }
+        close_xtc(fio);
+
+        EXPECT_EQ(readFileBytes(fileName_), readFileBytes(parallelFileName));
+    }
+}
+
+//! Counts of the ways the atoms in the compressed frames of an XTC file are encoded
+struct XtcEncodingCounts
+{
+    //! Number of frames with compressed coordinates
+    int numCompressedFrames = 0;
+    //! Number of atoms stored as a large integer triplet, decoded by the 64-bit receiveints() path
+    int numAtoms64BitTriplet = 0;
+    //! Number of atoms stored as separate large integers, for coordinate ranges above 2^24
+    int numAtomsSeparateInts = 0;
+    //! Number of atoms stored as run-length encoded small integer differences
+    int numAtomsInRuns = 0;
+};
+
+//! Minimal big-endian reader of the raw contents of an XTC file
+class RawXtcReader
+{
+public:
+    explicit RawXtcReader(const std::vector<char>& bytes) : bytes_(bytes) {}
+
+    bool atEnd() const { return position_ >= bytes_.size(); }
+    //! Returns the next 32-bit big-endian integer
+    uint32_t nextUInt32()
+    {
+        uint32_t value = 0;
+        for (int i = 0; i < 4; i++)
+        {
+            value = (value << 8) | static_cast<unsigned char>(bytes_.at(position_++));
+        }
+        return value;
+    }
+    //! Skips \p numBytes bytes
+    void skip(size_t numBytes) { position_ += numBytes; }
+    //! Returns bit \p bit, counted from the most significant bit of the byte at \p offset
+    int bitAt(size_t offset, size_t bit) const
+    {
+        return (static_cast<unsigned char>(bytes_.at(offset + bit / 8)) >> (7 - bit % 8)) & 1;
+    }
+    //! Returns the current byte position
+    size_t position() const { return position_; }
+
+private:
+    const std::vector<char>& bytes_;
+    size_t                   position_ = 0;
+};
+
+//! Returns the number of bits needed for the product of \p sizes, as sizeofints() in libxdrf
+int bitsizeOfProduct(const uint32_t sizes[3])
+{
+    std::vector<uint32_t> bytes = { 1 };
+    for (int i = 0; i < 3; i++)
+    {
+        uint32_t carry = 0;
+        for (auto& byte : bytes)
+        {
+            uint64_t tmp = static_cast<uint64_t>(byte) * sizes[i] + carry;
+            byte         = tmp & 0xff;
+            carry        = static_cast<uint32_t>(tmp >> 8);
+        }
+        while (carry != 0)
+        {
+            bytes.push_back(carry & 0xff);
+            carry >>= 8;
+        }
+    }
+    int numBits = 0;
+    while ((1U << numBits) <= bytes.back())
+    {
+        numBits++;
+    }
+    return numBits + 8 * (static_cast<int>(bytes.size()) - 1);
+}
+
+/*! \brief Counts how the atoms in all frames in the XTC file contents \p bytes are encoded
+ *
+ * Follows the bit layout of the compressed coordinates without decoding
+ * the values, so it is independent of the decoder that is tested.
+ */
+XtcEncodingCounts countXtcEncodings(const std::vector<char>& bytes)
+{
+    XtcEncodingCounts counts;
+    RawXtcReader      reader(bytes);
+    while (!reader.atEnd())
+    {
+        EXPECT_EQ(1995U, reader.nextUInt32()) << "XTC magic number";
+        reader.skip(3 * 4 + 9 * 4); // natoms, step, time, box
+        const int numAtoms = reader.nextUInt32();
+        if (numAtoms <= 9)
+        {
+            reader.skip(3 * numAtoms * 4);
+            continue;
+        }
+        counts.numCompressedFrames++;
+        reader.skip(4); // precision
+        int32_t minint[3], maxint[3];
+        for (auto& value : minint)
+        {
+            value = reader.nextUInt32();
+        }
+        for (auto& value : maxint)
+        {
+            value = reader.nextUInt32();
+        }
+        uint32_t sizeint[3];
+        int      bitsizeint[3];
+        for (int d = 0; d < 3; d++)
+        {
+            sizeint[d]    = maxint[d] - minint[d] + 1;
+            bitsizeint[d] = 0;
+            while (bitsizeint[d] < 32 && sizeint[d] >= (1U << bitsizeint[d]))
+            {
+                bitsizeint[d]++;
+            }
+        }
+        const bool useSeparateInts = ((sizeint[0] | sizeint[1] | sizeint[2]) > 0xffffff);
+        const int  bitsize         = useSeparateInts ? 0 : bitsizeOfProduct(sizeint);
+        int        smallidx        = reader.nextUInt32();
+        const int  numBytes        = reader.nextUInt32();
+
+        const size_t dataOffset  = reader.position();
+        size_t       bit         = 0;
+        auto         receivebits = [&](int numBits) {
+            int value = 0;
+            for (int b = 0; b < numBits; b++)
+            {
+                value = (value << 1) | reader.bitAt(dataOffset, bit++);
+            }
+            return value;
+        };
+        int run = 0;
+        for (int i = 0; i < numAtoms;)
+        {
+            if (useSeparateInts)
+            {
+                bit += bitsizeint[0] + bitsizeint[1] + bitsizeint[2];
+                counts.numAtomsSeparateInts++;
+            }
+            else
+            {
+                GMX_RELEASE_ASSERT(bitsize <= 64, "Test files should not have triplets above 64 bits");
+                bit += bitsize;
+                counts.numAtoms64BitTriplet++;
+            }
+            i++;
+            int isSmaller = 0;
+            if (receivebits(1) == 1)
+            {
+                run       = receivebits(5);
+                isSmaller = run % 3 - 1;
+                run -= run % 3;
+            }
+            for (int k = 0; k < run && i < numAtoms; k += 3)
+            {
+                bit += smallidx;
+                counts.numAtomsInRuns++;
+                i++;
+            }
+            smallidx += isSmaller;
+        }
+        EXPECT_LE((bit + 7) / 8, static_cast<size_t>(numBytes));
+        reader.skip((numBytes + 3) / 4 * 4);
+    }
+    return counts;
+}
+
+//! Returns an FNV-1a hash of the bit patterns of the coordinates \p x
+uint64_t coordinateChecksum(const rvec* x, int numAtoms)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    for (int i = 0; i < numAtoms; i++)
+    {
+        for (int d = 0; d < DIM; d++)
+        {
+            const float value = x[i][d];
+            uint32_t    bits;
+            std::memcpy(&bits, &value, sizeof(bits));
+            for (int b = 0; b < 4; b++)
+            {
+                hash ^= (bits >> (8 * b)) & 0xff;
+                hash *= 1099511628211ULL;
+            }
+        }
+    }
+    return hash;
+}
+
+/*! \brief
+ * The XTC files in the source tree that are decoded in the reference tests
+ *
+ * Trajectories of other modules are used in place, relative to the input
+ * directory of this module.
+ */
+const char* const c_referenceXtcFiles[] = { "spc2-traj.xtc", "../../gmxana/tests/msd_traj.xtc",
+                                            "../../trajectoryanalysis/tests/freevolume.xtc" };
+
+//! Tests decoding of the XTC files in the source tree against reference data
+class XtcReferenceFileTest : public ::testing::TestWithParam<const char*>
+{
+};
+
+/* The reference data was generated with the xdr3dfcoord() decoder that
+ * preceded the current one, so this checks that decoding is unchanged.
+ * The coordinates of the first atoms are compared as strings with nine
+ * significant digits, which identify a float uniquely, and all coordinates
+ * are compared through a checksum of their bit patterns.
+ */
+TEST_P(XtcReferenceFileTest, DecodesSameCoordinatesAsPreviousDecoder)
+{
+    TestReferenceData    data;
+    TestReferenceChecker checker(data.rootChecker());
+
+    const std::string fileName = TestFileManager::getInputFilePath(GetParam());
+    t_fileio*         fio      = open_xtc(fileName.c_str(), "r");
+    int               natoms;
+    int64_t           step;
+    real              time, prec;
+    matrix            box;
+    rvec*             x;
+    gmx_bool          bOK;
+    ASSERT_EQ(1, read_first_xtc(fio, &natoms, &step, &time, box, &x, &prec, &bOK));
+    checker.checkInteger(natoms, "NumAtoms");
+    int frame = 0;
+    do
+    {
+        TestReferenceChecker frameChecker(
+                checker.checkCompound("Frame", formatString("Frame%d", frame).c_str()));
+        frameChecker.checkInt64(step, "Step");
+        frameChecker.checkString(formatString("%.9g", time), "Time");
+        frameChecker.checkString(formatString("%.9g", prec), "Precision");
+        frameChecker.checkUInt64(coordinateChecksum(x, natoms), "CoordinateChecksum");
+        const int numAtomsToCheck = std::min(natoms, 10);
+        for (int i = 0; i < numAtomsToCheck; i++)
+        {
+            frameChecker.checkString(formatString("%.9g %.9g %.9g", x[i][XX], x[i][YY], x[i][ZZ]),
+                                     formatString("Atom%d", i).c_str());
+        }
+        frame++;
+    } while (read_next_xtc(fio, natoms, &step, &time, box, x, &prec, &bOK));
+    EXPECT_TRUE(bOK);
+    checker.checkInteger(frame, "NumFrames");
+    close_xtc(fio);
+    sfree(x);
+}
+
+INSTANTIATE_TEST_CASE_P(XtcReferenceFiles, XtcReferenceFileTest, ::testing::ValuesIn(c_referenceXtcFiles));
+
+TEST(XtcReferenceFilesTest, CoverTripletAndRunLengthEncodedAtoms)
+{
+    XtcEncodingCounts total;
+    for (const char* file : c_referenceXtcFiles)
+    {
+        XtcEncodingCounts counts =
+                countXtcEncodings(readFileBytes(TestFileManager::getInputFilePath(file)));
+        total.numCompressedFrames += counts.numCompressedFrames;
+        total.numAtoms64BitTriplet += counts.numAtoms64BitTriplet;
+        total.numAtomsInRuns += counts.numAtomsInRuns;
+    }
+    /* The reference tests above should decode large integer triplets,
+     * which go through the 64-bit receiveints() path, as well as
+     * run-length encoded small integers.
+     */
+    EXPECT_GT(total.numCompressedFrames, 0);
+    EXPECT_GT(total.numAtoms64BitTriplet, 0);
+    EXPECT_GT(total.numAtomsInRuns, 0);
+}
+
+} // namespace
+} // namespace test
+} // namespace gmx
@@ -46,6 +46,7 @@
 #include <cstring>
 
 #include <algorithm>
+#include <array>
 #include <memory>
 #include <vector>
 
@@ -2003,6 +2004,22 @@ static void do_ilist(gmx::ISerializer* serializer, InteractionList* ilist)
     serializer->doIntArray(ilist->iatoms.data(), ilist->size());
 }
 
+/*! \brief Skips an interaction list in a file being read
+ *
+ * The atom indices are decoded in blocks of bounded size, so skipping
+ * does not allocate memory proportional to the size of the list.
+ */
+static void skip_ilist(gmx::ISerializer* serializer)
+{
+    int nr = 0;
+    serializer->doInt(&nr);
+    std::array<int, 4096> buffer;
+    for (int i = 0; i < nr; i += buffer.size())
+    {
+        serializer->doIntArray(buffer.data(), std::min<int>(buffer.size(), nr - i));
+    }
+}
+
 static void do_ffparams(gmx::ISerializer* serializer, gmx_ffparams_t* ffparams, int file_version)
 {
     serializer->doInt(&ffparams->atnr);
@@ -2065,8 +2082,14 @@ static void add_settle_atoms(InteractionList* ilist)
     }
 }
 
-static void do_ilists(gmx::ISerializer* serializer, InteractionLists* ilists, int file_version)
+static void do_ilists(gmx::ISerializer*  serializer,
+                      InteractionLists*  ilists,
+                      int                file_version,
+                      TpxTopologyContent content = TpxTopologyContent::Complete)
 {
+    const bool skipContents =
+            (serializer->reading() && content == TpxTopologyContent::WithoutInteractions);
+
     GMX_RELEASE_ASSERT(ilists, "Need a valid ilists object");
     GMX_RELEASE_ASSERT(ilists->size() == F_NRE,
                        "The code needs to be in sync with InteractionLists");
@@ -2089,6 +2112,11 @@ static void do_ilists(gmx::ISerializer* serializer, InteractionLists* ilists, in
         {
             ilist.iatoms.clear();
         }
+        else if (skipContents)
+        {
+            skip_ilist(serializer);
+            ilist.iatoms.clear();
+        }
         else
         {
             do_ilist(serializer, &ilist);
@@ -2425,13 +2453,17 @@ static void do_cmap(gmx::ISerializer* serializer, gmx_cmap_t* cmap_grid)
 }
 
 
-static void do_moltype(gmx::ISerializer* serializer, gmx_moltype_t* molt, t_symtab* symtab, int file_version)
+static void do_moltype(gmx::ISerializer*  serializer,
+                       gmx_moltype_t*     molt,
+                       t_symtab*          symtab,
+                       int                file_version,
+                       TpxTopologyContent content)
 {
     do_symstr(serializer, &(molt->name), symtab);
 
     do_atoms(serializer, &molt->atoms, symtab, file_version);
 
-    do_ilists(serializer, &molt->ilist, file_version);
+    do_ilists(serializer, &molt->ilist, file_version, content);
 
     /* TODO: Remove the obsolete charge group index from the file */
     t_block cgs;
@@ -2510,7 +2542,7 @@ static void set_disres_npair(gmx_mtop_t* mtop)
     }
 }
 
-static void do_mtop(gmx::ISerializer* serializer, gmx_mtop_t* mtop, int file_version)
+static void do_mtop(gmx::ISerializer* serializer, gmx_mtop_t* mtop, int file_version, TpxTopologyContent content)
 {
     do_symtab(serializer, &(mtop->symtab));
 
@@ -2526,7 +2558,7 @@ static void do_mtop(gmx::ISerializer* serializer, gmx_mtop_t* mtop, int file_ver
     }
     for (gmx_moltype_t& moltype : mtop->moltype)
     {
-        do_moltype(serializer, &moltype, &mtop->symtab, file_version);
+        do_moltype(serializer, &moltype, &mtop->symtab, file_version, content);
     }
 
     int nmolblock = mtop->molblock.size();
@@ -2551,7 +2583,7 @@ static void do_mtop(gmx::ISerializer* serializer, gmx_mtop_t* mtop, int file_ver
             {
                 mtop->intermolecular_ilist = std::make_unique<InteractionLists>();
             }
-            do_ilists(serializer, mtop->intermolecular_ilist.get(), file_version);
+            do_ilists(serializer, mtop->intermolecular_ilist.get(), file_version, content);
         }
     }
     else
@@ -2824,22 +2856,26 @@ static void do_tpx_state_first(gmx::ISerializer* serializer, TpxFileHeader* tpx,
  * \param[in] serializer Abstract serializer  used to read/write data.
  * \param[in] tpx The file header data.
  * \param[in,out] mtop Global topology.
+ * \param[in] content Which parts of the topology to read.
  */
-static void do_tpx_mtop(gmx::ISerializer* serializer, TpxFileHeader* tpx, gmx_mtop_t* mtop)
+static void do_tpx_mtop(gmx::ISerializer*  serializer,
+                        TpxFileHeader*     tpx,
+                        gmx_mtop_t*        mtop,
+                        TpxTopologyContent content = TpxTopologyContent::Complete)
 {
     do_test(serializer, tpx->bTop, mtop);
     if (tpx->bTop)
     {
         if (mtop)
         {
-            do_mtop(serializer, mtop, tpx->fileVersion);
+            do_mtop(serializer, mtop, tpx->fileVersion, content);
             set_disres_npair(mtop);
             gmx_mtop_finalize(mtop);
         }
         else
         {
             gmx_mtop_t dum_top;
-            do_mtop(serializer, &dum_top, tpx->fileVersion);
+            do_mtop(serializer, &dum_top, tpx->fileVersion, TpxTopologyContent::WithoutInteractions);
         }
     }
 }
@@ -3050,20 +3086,22 @@ static void do_tpx_finalize(TpxFileHeader* tpx, t_inputrec* ir, t_state* state,
  * \param[in,out] x Individual coordinates for processing, deprecated.
  * \param[in,out] v Individual velocities for processing, deprecated.
  * \param[in,out] mtop Global topology.
+ * \param[in] content Which parts of the topology to read.
  */
-static PbcType do_tpx_body(gmx::ISerializer* serializer,
-                           TpxFileHeader*    tpx,
-                           t_inputrec*       ir,
-                           t_state*          state,
-                           rvec*             x,
-                           rvec*             v,
-                           gmx_mtop_t*       mtop)
+static PbcType do_tpx_body(gmx::ISerializer*  serializer,
+                           TpxFileHeader*     tpx,
+                           t_inputrec*        ir,
+                           t_state*           state,
+                           rvec*              x,
+                           rvec*              v,
+                           gmx_mtop_t*        mtop,
+                           TpxTopologyContent content = TpxTopologyContent::Complete)
 {
     if (state)
     {
         do_tpx_state_first(serializer, tpx, state);
     }
-    do_tpx_mtop(serializer, tpx, mtop);
+    do_tpx_mtop(serializer, tpx, mtop, content);
     if (state)
     {
         do_tpx_state_second(serializer, tpx, state, x, v);
@@ -3171,16 +3209,22 @@ static void doTpxBodyBuffer(gmx::ISerializer* serializer, gmx::ArrayRef<char> bu
  * \param[out] x Coordinates to populate if needed.
  * \param[out] v Velocities to populate if needed.
  * \param[out] mtop Global topology to populate.
+ * \param[in] content Which parts of the topology to read.
+ * \param[in] prepareBodyForCommunication Whether to serialize \p ir and \p mtop
+ *                                        again for communication to other nodes.
  *
- * \returns Partial de-serialized TPR used for communication to nodes.
+ * \returns Partial de-serialized TPR used for communication to nodes,
+ *          only the PBC type when \p prepareBodyForCommunication is false.
  */
-static PartialDeserializedTprFile readTpxBody(TpxFileHeader*    tpx,
-                                              gmx::ISerializer* serializer,
-                                              t_inputrec*       ir,
-                                              t_state*          state,
-                                              rvec*             x,
-                                              rvec*             v,
-                                              gmx_mtop_t*       mtop)
+static PartialDeserializedTprFile readTpxBody(TpxFileHeader*     tpx,
+                                              gmx::ISerializer*  serializer,
+                                              t_inputrec*        ir,
+                                              t_state*           state,
+                                              rvec*              x,
+                                              rvec*              v,
+                                              gmx_mtop_t*        mtop,
+                                              TpxTopologyContent content,
+                                              bool               prepareBodyForCommunication)
 {
     PartialDeserializedTprFile partialDeserializedTpr;
     if (tpx->fileVersion >= tpxv_AddSizeField && tpx->fileGeneration >= 27)
@@ -3189,12 +3233,23 @@ static PartialDeserializedTprFile readTpxBody(TpxFileHeader*    tpx,
         partialDeserializedTpr.header = *tpx;
         doTpxBodyBuffer(serializer, partialDeserializedTpr.body);
 
-        partialDeserializedTpr.pbcType =
-                completeTprDeserialization(&partialDeserializedTpr, ir, state, x, v, mtop);
+        gmx::InMemoryDeserializer tprBodyDeserializer(
+                partialDeserializedTpr.body, partialDeserializedTpr.header.isDouble,
+                gmx::EndianSwapBehavior::SwapIfHostIsLittleEndian);
+        partialDeserializedTpr.pbcType = do_tpx_body(&tprBodyDeserializer, &partialDeserializedTpr.header,
+                                                     ir, state, x, v, mtop, content);
     }
     else
     {
-        partialDeserializedTpr.pbcType = do_tpx_body(serializer, tpx, ir, state, x, v, mtop);
+        partialDeserializedTpr.pbcType = do_tpx_body(serializer, tpx, ir, state, x, v, mtop, content);
+    }
+    if (!prepareBodyForCommunication)
+    {
+        // Analysis tools only need the data structures, which can be
+        // large for big systems, so avoid serializing them again.
+        partialDeserializedTpr.body.clear();
+        partialDeserializedTpr.body.shrink_to_fit();
+        return partialDeserializedTpr;
     }
     // Update header to system info for communication to nodes.
     // As we only need to communicate the inputrec and mtop to other nodes,
@@ -3296,13 +3351,20 @@ PartialDeserializedTprFile read_tpx_state(const char* fn, t_inputrec* ir, t_stat
     gmx::FileIOXdrSerializer   serializer(fio);
     PartialDeserializedTprFile partialDeserializedTpr;
     do_tpxheader(&serializer, &partialDeserializedTpr.header, fn, fio, ir == nullptr);
-    partialDeserializedTpr =
-            readTpxBody(&partialDeserializedTpr.header, &serializer, ir, state, nullptr, nullptr, mtop);
+    partialDeserializedTpr = readTpxBody(&partialDeserializedTpr.header, &serializer, ir, state, nullptr,
+                                         nullptr, mtop, TpxTopologyContent::Complete, true);
     close_tpx(fio);
     return partialDeserializedTpr;
 }
 
-PbcType read_tpx(const char* fn, t_inputrec* ir, matrix box, int* natoms, rvec* x, rvec* v, gmx_mtop_t* mtop)
+PbcType read_tpx(const char*        fn,
+                 t_inputrec*        ir,
+                 matrix             box,
+                 int*               natoms,
+                 rvec*              x,
+                 rvec*              v,
+                 gmx_mtop_t*        mtop,
+                 TpxTopologyContent content)
 {
     t_fileio* fio;
     t_state   state;
@@ -3312,7 +3374,7 @@ PbcType read_tpx(const char* fn, t_inputrec* ir, matrix box, int* natoms, rvec*
     gmx::FileIOXdrSerializer serializer(fio);
     do_tpxheader(&serializer, &tpx, fn, fio, ir == nullptr);
     PartialDeserializedTprFile partialDeserializedTpr =
-            readTpxBody(&tpx, &serializer, ir, &state, x, v, mtop);
+            readTpxBody(&tpx, &serializer, ir, &state, x, v, mtop, content, false);
     close_tpx(fio);
     if (mtop != nullptr && natoms != nullptr)
     {
@@ -3325,6 +3387,48 @@ PbcType read_tpx(const char* fn, t_inputrec* ir, matrix box, int* natoms, rvec*
     return partialDeserializedTpr.pbcType;
 }
 
+void read_tpx_interactions(const char* fn, gmx_mtop_t* mtop)
+{
+    t_fileio* fio = open_tpx(fn, "r");
+    gmx::FileIOXdrSerializer serializer(fio);
+    TpxFileHeader            tpx;
+    do_tpxheader(&serializer, &tpx, fn, fio, true);
+
+    /* Only the box and the topology are deserialized, the topology
+     * is in front of the coordinates and the inputrec in the body.
+     */
+    t_state    state;
+    gmx_mtop_t completeMtop;
+    if (tpx.fileVersion >= tpxv_AddSizeField && tpx.fileGeneration >= 27)
+    {
+        std::vector<char> body(tpx.sizeOfTprBody);
+        doTpxBodyBuffer(&serializer, body);
+        gmx::InMemoryDeserializer tprBodyDeserializer(
+                body, tpx.isDouble, gmx::EndianSwapBehavior::SwapIfHostIsLittleEndian);
+        do_tpx_state_first(&tprBodyDeserializer, &tpx, &state);
+        do_tpx_mtop(&tprBodyDeserializer, &tpx, &completeMtop);
+    }
+    else
+    {
+        do_tpx_state_first(&serializer, &tpx, &state);
+        do_tpx_mtop(&serializer, &tpx, &completeMtop);
+    }
+    close_tpx(fio);
+
+    if (!tpx.bTop || completeMtop.moltype.size() != mtop->moltype.size()
+        || completeMtop.natoms != mtop->natoms)
+    {
+        gmx_fatal(FARGS, "The topology in %s does not match the topology that was read before", fn);
+    }
+    for (size_t mt = 0; mt < mtop->moltype.size(); mt++)
+    {
+        mtop->moltype[mt].ilist = std::move(completeMtop.moltype[mt].ilist);
+    }
+    mtop->bIntermolecularInteractions = completeMtop.bIntermolecularInteractions;
+    mtop->intermolecular_ilist        = std::move(completeMtop.intermolecular_ilist);
+    mtop->ffparams                    = std::move(completeMtop.ffparams);
+}
+
 PbcType read_tpx_top(const char* fn, t_inputrec* ir, matrix box, int* natoms, rvec* x, rvec* v, t_topology* top)
 {
     gmx_mtop_t mtop;
@@ -101,6 +101,21 @@ struct TpxFileHeader
     bool isDouble = false;
 };
 
+/*! \brief
+ * Which parts of the topology to deserialize when reading a TPR file.
+ *
+ * The interaction lists make up most of the topology of molecules
+ * with many bonded interactions, but are not needed by analysis tools
+ * that only use atom properties.
+ */
+enum class TpxTopologyContent : int
+{
+    //! The complete topology.
+    Complete,
+    //! The topology without the interaction lists, which are left empty.
+    WithoutInteractions
+};
+
 /*! \brief
  * Contains the partly deserialized contents of a TPR file.
  *
@@ -208,9 +223,29 @@ PartialDeserializedTprFile read_tpx_state(const char* fn, t_inputrec* ir, t_stat
  * \param[out] x Positions to be filled from file, or nullptr.
  * \param[out] v Velocities to be filled from file, or nullptr.
  * \param[out] mtop Topology to be populated, or nullptr.
+ * \param[in] content Which parts of the topology to read into \p mtop.
  * \returns ir->pbcType if it was read from the file.
  */
-PbcType read_tpx(const char* fn, t_inputrec* ir, matrix box, int* natoms, rvec* x, rvec* v, gmx_mtop_t* mtop);
+PbcType read_tpx(const char*        fn,
+                 t_inputrec*        ir,
+                 matrix             box,
+                 int*               natoms,
+                 rvec*              x,
+                 rvec*              v,
+                 gmx_mtop_t*        mtop,
+                 TpxTopologyContent content = TpxTopologyContent::Complete);
+
+/*! \brief
+ * Read the interaction lists of a topology that was read without them.
+ *
+ * Completes \p mtop, which should have been read from \p fn with
+ * TpxTopologyContent::WithoutInteractions. Only the topology part
+ * of the file is deserialized.
+ *
+ * \param[in] fn Input file name.
+ * \param[in,out] mtop Topology to add the interaction lists to.
+ */
+void read_tpx_interactions(const char* fn, gmx_mtop_t* mtop);
 
 PbcType read_tpx_top(const char* fn, t_inputrec* ir, matrix box, int* natoms, rvec* x, rvec* v, t_topology* top);
 /* As read_tpx, but for the old t_topology struct */
@@ -0,0 +1,206 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2021, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \internal \file
+ * \brief
+ * Implements the memory-mapped reader for TRR frame data.
+ *
+ * \ingroup module_fileio
+ */
+#include "gmxpre.h"
+
+#include "trrmapped.h"
+
+#include "config.h"
+
+#include <cstdint>
+
+#if HAVE_SYS_MMAN_H
+#    include <fcntl.h>
+#    include <sys/mman.h>
+#    include <sys/stat.h>
+#    include <unistd.h>
+#endif
+
+#include "gromacs/fileio/trrio.h"
+#include "gromacs/fileio/xdrf.h"
+#include "gromacs/utility/basedefinitions.h"
+
+namespace gmx
+{
+
+class MappedTrrFile::Impl
+{
+public:
+    Impl() = default;
+    ~Impl()
+    {
+#if HAVE_SYS_MMAN_H
+        if (data_ != nullptr)
+        {
+            munmap(data_, size_);
+        }
+        if (fd_ >= 0)
+        {
+            close(fd_);
+        }
+#endif
+    }
+
+    //! Maps the whole file at its current size, returns whether that succeeded
+    bool map()
+    {
+#if HAVE_SYS_MMAN_H
+        struct stat fileStat;
+        if (fstat(fd_, &fileStat) != 0 || fileStat.st_size <= 0)
+        {
+            return false;
+        }
+        if (data_ != nullptr)
+        {
+            munmap(data_, size_);
+            data_ = nullptr;
+            size_ = 0;
+        }
+        void* data = mmap(nullptr, fileStat.st_size, PROT_READ, MAP_PRIVATE, fd_, 0);
+        if (data == MAP_FAILED)
+        {
+            return false;
+        }
+#    ifdef MADV_SEQUENTIAL
+        /* Trajectories are usually read from start to end */
+        madvise(data, fileStat.st_size, MADV_SEQUENTIAL);
+#    endif
+        data_ = data;
+        size_ = fileStat.st_size;
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    //! File descriptor
+    int fd_ = -1;
+    //! Start of the mapping, nullptr when not mapped
+    void* data_ = nullptr;
+    //! Size of the mapping in bytes
+    size_t size_ = 0;
+};
+
+MappedTrrFile::MappedTrrFile() : impl_(new Impl) {}
+
+MappedTrrFile::~MappedTrrFile() = default;
+
+std::unique_ptr<MappedTrrFile> MappedTrrFile::open(const std::string& filename)
+{
+#if HAVE_SYS_MMAN_H
+    /* Mapping large trajectories needs a 64-bit address space */
+    if (sizeof(void*) < sizeof(int64_t))
+    {
+        return nullptr;
+    }
+    std::unique_ptr<MappedTrrFile> file(new MappedTrrFile);
+    file->impl_->fd_ = ::open(filename.c_str(), O_RDONLY);
+    if (file->impl_->fd_ < 0 || !file->impl_->map())
+    {
+        return nullptr;
+    }
+    return file;
+#else
+    GMX_UNUSED_VALUE(filename);
+    return nullptr;
+#endif
+}
+
+bool MappedTrrFile::readFrameData(gmx_off_t               offset,
+                                  const gmx_trr_header_t& header,
+                                  rvec*                   box,
+                                  rvec*                   x,
+                                  rvec*                   v,
+                                  rvec*                   f,
+                                  gmx_off_t*              endOffset)
+{
+    const int64_t realSize   = header.bDouble ? sizeof(double) : sizeof(float);
+    const int64_t matrixSize = DIM * DIM * realSize;
+    const int64_t vectorSize = int64_t(header.natoms) * DIM * realSize;
+
+    int64_t frameSize = 0;
+    frameSize += (header.box_size != 0) ? matrixSize : 0;
+    frameSize += (header.vir_size != 0) ? matrixSize : 0;
+    frameSize += (header.pres_size != 0) ? matrixSize : 0;
+    frameSize += (header.x_size != 0) ? vectorSize : 0;
+    frameSize += (header.v_size != 0) ? vectorSize : 0;
+    frameSize += (header.f_size != 0) ? vectorSize : 0;
+
+    if (offset < 0 || offset + frameSize > static_cast<int64_t>(impl_->size_))
+    {
+        /* The file might have grown since it was mapped */
+        if (!impl_->map() || offset < 0 || offset + frameSize > static_cast<int64_t>(impl_->size_))
+        {
+            return false;
+        }
+    }
+
+    const unsigned char* data = static_cast<const unsigned char*>(impl_->data_) + offset;
+    if (header.box_size != 0)
+    {
+        if (box != nullptr)
+        {
+            xdr_reals_from_bytes(data, header.bDouble, DIM * DIM, box[0]);
+        }
+        data += matrixSize;
+    }
+    /* The virial and pressure are not used */
+    data += (header.vir_size != 0) ? matrixSize : 0;
+    data += (header.pres_size != 0) ? matrixSize : 0;
+    for (int i = 0; i < 3; i++)
+    {
+        const int vectorSizeInHeader = (i == 0 ? header.x_size : (i == 1 ? header.v_size : header.f_size));
+        rvec*     dest               = (i == 0 ? x : (i == 1 ? v : f));
+        if (vectorSizeInHeader != 0)
+        {
+            if (dest != nullptr)
+            {
+                xdr_reals_from_bytes(data, header.bDouble, int64_t(header.natoms) * DIM, dest[0]);
+            }
+            data += vectorSize;
+        }
+    }
+
+    *endOffset = offset + frameSize;
+
+    return true;
+}
+
+} // namespace gmx
@@ -0,0 +1,114 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2021, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \libinternal \file
+ * \brief
+ * Declares a memory-mapped reader for the data of TRR frames.
+ *
+ * After the frame header has been read through the normal XDR path,
+ * the box, coordinates, velocities and forces are converted in bulk
+ * directly from a read-only mapping of the file, instead of calling
+ * the XDR routines for every single value.
+ *
+ * \inlibraryapi
+ * \ingroup module_fileio
+ */
+#ifndef GMX_FILEIO_TRRMAPPED_H
+#define GMX_FILEIO_TRRMAPPED_H
+
+#include <memory>
+#include <string>
+
+#include "gromacs/math/vectypes.h"
+#include "gromacs/utility/classhelpers.h"
+#include "gromacs/utility/futil.h"
+#include "gromacs/utility/real.h"
+
+struct gmx_trr_header_t;
+
+namespace gmx
+{
+
+/*! \libinternal \brief
+ * Read-only memory mapping of a TRR file.
+ *
+ * The mapping is extended when a frame lies beyond the end of the
+ * mapped range, as happens when reading a trajectory that is still
+ * being written.
+ */
+class MappedTrrFile
+{
+public:
+    /*! \brief Maps the file \p filename
+     *
+     * Returns nullptr when memory mapping is not supported on this
+     * platform or the file could not be mapped, in which case the
+     * caller should use the normal XDR reading routines.
+     */
+    static std::unique_ptr<MappedTrrFile> open(const std::string& filename);
+    ~MappedTrrFile();
+
+    /*! \brief Reads the data of a frame
+     *
+     * \param[in]  offset    Position in the file of the data, i.e. directly after the header
+     * \param[in]  header    The frame header
+     * \param[out] box       The box, can be nullptr
+     * \param[out] x         Coordinates, can be nullptr
+     * \param[out] v         Velocities, can be nullptr
+     * \param[out] f         Forces, can be nullptr
+     * \param[out] endOffset Position in the file after the frame
+     *
+     * Data that is present in the frame but for which the output
+     * argument is nullptr is skipped.
+     * \returns false when the frame extends beyond the end of the file.
+     */
+    bool readFrameData(gmx_off_t               offset,
+                       const gmx_trr_header_t& header,
+                       rvec*                   box,
+                       rvec*                   x,
+                       rvec*                   v,
+                       rvec*                   f,
+                       gmx_off_t*              endOffset);
+
+private:
+    MappedTrrFile();
+
+    class Impl;
+
+    PrivateImplPointer<Impl> impl_;
+};
+
+} // namespace gmx
+
+#endif
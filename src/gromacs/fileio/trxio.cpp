@@ -43,8 +43,11 @@
 
 #include <cassert>
 #include <cmath>
+#include <cstdlib>
 #include <cstring>
 
+#include <algorithm>
+
 #include "gromacs/fileio/checkpoint.h"
 #include "gromacs/fileio/confio.h"
 #include "gromacs/fileio/filetypes.h"
@@ -58,7 +61,9 @@
 #include "gromacs/fileio/tngio.h"
 #include "gromacs/fileio/tpxio.h"
 #include "gromacs/fileio/trrio.h"
+#include "gromacs/fileio/trrmapped.h"
 #include "gromacs/fileio/xdrf.h"
+#include "gromacs/fileio/xtcindex.h"
 #include "gromacs/fileio/xtcio.h"
 #include "gromacs/math/vec.h"
 #include "gromacs/mdtypes/md_enums.h"
@@ -86,14 +91,19 @@ struct t_trxstatus
     int  __frame;
     real t0;                 /* time of the first frame, needed  *
                               * for skipping frames with -dt     */
-    real                 tf; /* internal frame time              */
-    t_trxframe*          xframe;
-    t_fileio*            fio;
-    gmx_tng_trajectory_t tng;
-    int                  natoms;
-    double               DT, BOX[3];
-    gmx_bool             bReadBox;
-    char*                persistent_line; /* Persistent line for reading g96 trajectories */
+    real                    tf; /* internal frame time              */
+    t_trxframe*             xframe;
+    t_fileio*               fio;
+    gmx_tng_trajectory_t    tng;
+    int                     natoms;
+    double                  DT, BOX[3];
+    gmx_bool                bReadBox;
+    char*                   persistent_line; /* Persistent line for reading g96 trajectories */
+    gmx::XtcFrameIndex*     xtcIndex;        /* Frame-offset index for XTC files, can be NULL */
+    int                     xtcFrame;        /* Number of the next XTC frame when indexed */
+    gmx::XtcReadAhead*      xtcReadAhead;    /* Parallel XTC decompression, can be NULL */
+    gmx::XtcParallelWriter* xtcWriter;       /* Parallel XTC compression, can be NULL */
+    gmx::MappedTrrFile*     trrMap;          /* Memory-mapped TRR data reading, can be NULL */
 #if GMX_USE_PLUGINS
     gmx_vmdplugin_t* vmdplugin;
 #endif
@@ -167,6 +177,11 @@ static void status_init(t_trxstatus* status)
     status->tf              = 0;
     status->persistent_line = nullptr;
     status->tng             = nullptr;
+    status->xtcIndex        = nullptr;
+    status->xtcFrame        = 0;
+    status->xtcReadAhead    = nullptr;
+    status->xtcWriter       = nullptr;
+    status->trrMap          = nullptr;
 }
 
 
@@ -230,6 +245,15 @@ real ndec2prec(int ndec)
 
 t_fileio* trx_get_fileio(t_trxstatus* status)
 {
+    /* The caller might access the file directly, so the file position
+     * should be that of the next frame and we can no longer read ahead.
+     */
+    if (status->xtcReadAhead)
+    {
+        status->xtcReadAhead->discard(status->fio);
+        delete status->xtcReadAhead;
+        status->xtcReadAhead = nullptr;
+    }
     return status->fio;
 }
 
@@ -240,7 +264,11 @@ float trx_get_time_of_final_frame(t_trxstatus* status)
     gmx_bool  bOK;
     float     lasttime = -1;
 
-    if (filetype == efXTC)
+    if (filetype == efXTC && status->xtcIndex)
+    {
+        lasttime = (*status->xtcIndex)[status->xtcIndex->numFrames() - 1].time;
+    }
+    else if (filetype == efXTC)
     {
         lasttime = xdr_xtc_get_last_frame_time(gmx_fio_getfp(stfio), gmx_fio_getxdr(stfio),
                                                status->natoms, &bOK);
@@ -265,6 +293,15 @@ float trx_get_time_of_final_frame(t_trxstatus* status)
     return lasttime;
 }
 
+int trx_get_number_of_frames(t_trxstatus* status)
+{
+    if (status->xtcIndex)
+    {
+        return status->xtcIndex->numFrames();
+    }
+    return -1;
+}
+
 void clear_trxframe(t_trxframe* fr, gmx_bool bFirst)
 {
     fr->not_ok    = 0;
@@ -389,7 +426,16 @@ int write_trxframe_indexed(t_trxstatus* status, const t_trxframe* fr, int nind,
     switch (ftp)
     {
         case efTNG: gmx_write_tng_from_trxframe(status->tng, fr, nind); break;
-        case efXTC: write_xtc(status->fio, nind, fr->step, fr->time, fr->box, xout, prec); break;
+        case efXTC:
+            if (status->xtcWriter)
+            {
+                status->xtcWriter->writeFrame(status->fio, nind, fr->step, fr->time, fr->box, xout, prec);
+            }
+            else
+            {
+                write_xtc(status->fio, nind, fr->step, fr->time, fr->box, xout, prec);
+            }
+            break;
         case efTRR:
             gmx_trr_write_frame(status->fio, nframes_read(status), fr->time, fr->step, fr->box,
                                 nind, xout, vout, fout);
@@ -525,7 +571,15 @@ int write_trxframe(t_trxstatus* status, t_trxframe* fr, gmx_conect gc)
     switch (gmx_fio_getftp(status->fio))
     {
         case efXTC:
-            write_xtc(status->fio, fr->natoms, fr->step, fr->time, fr->box, fr->x, prec);
+            if (status->xtcWriter)
+            {
+                status->xtcWriter->writeFrame(status->fio, fr->natoms, fr->step, fr->time, fr->box,
+                                              fr->x, prec);
+            }
+            else
+            {
+                write_xtc(status->fio, fr->natoms, fr->step, fr->time, fr->box, fr->x, prec);
+            }
             break;
         case efTRR:
             gmx_trr_write_frame(status->fio, fr->step, fr->time, fr->lambda, fr->box, fr->natoms,
@@ -599,11 +653,19 @@ void close_trx(t_trxstatus* status)
         return;
     }
     gmx_tng_close(&status->tng);
+    if (status->xtcWriter)
+    {
+        status->xtcWriter->flush(status->fio);
+        delete status->xtcWriter;
+    }
     if (status->fio)
     {
         gmx_fio_close(status->fio);
     }
     sfree(status->persistent_line);
+    delete status->xtcIndex;
+    delete status->xtcReadAhead;
+    delete status->trrMap;
 #if GMX_USE_PLUGINS
     sfree(status->vmdplugin);
 #endif
@@ -626,6 +688,14 @@ t_trxstatus* open_trx(const char* outfile, const char* filemode)
     status_init(stat);
 
     stat->fio = gmx_fio_open(outfile, filemode);
+
+    /* Compress frames in parallel when requested */
+    const char* env = getenv("GMX_XTC_ENCODE_THREADS");
+    if (gmx_fio_getftp(stat->fio) == efXTC && env != nullptr && GMX_OPENMP
+        && std::strtol(env, nullptr, 10) > 1)
+    {
+        stat->xtcWriter = new gmx::XtcParallelWriter(std::strtol(env, nullptr, 10));
+    }
     return stat;
 }
 
@@ -672,7 +742,19 @@ static gmx_bool gmx_next_frame(t_trxstatus* status, t_trxframe* fr)
             }
             fr->bF = sh.f_size > 0;
         }
-        if (gmx_trr_read_frame_data(status->fio, &sh, fr->box, fr->x, fr->v, fr->f))
+        gmx_off_t dataEnd;
+        if (status->trrMap
+            && status->trrMap->readFrameData(gmx_fio_ftell(status->fio), sh, fr->box, fr->x,
+                                             fr->v, fr->f, &dataEnd))
+        {
+            /* Keep the file position in sync for the next header */
+            bRet = (gmx_fio_seek(status->fio, dataEnd) == 0);
+            if (!bRet)
+            {
+                fr->not_ok = DATA_NOT_OK;
+            }
+        }
+        else if (gmx_trr_read_frame_data(status->fio, &sh, fr->box, fr->x, fr->v, fr->f))
         {
             bRet = TRUE;
         }
@@ -767,6 +849,51 @@ static int pdb_first_x(t_trxstatus* status, FILE* fp, t_trxframe* fr)
     return fr->natoms;
 }
 
+/* Positions an indexed XTC file at the next frame that should be decoded.
+ * Frames before the begin time are jumped over and frames that would be
+ * skipped because of the time settings are passed without decompressing. */
+static void xtc_seek_next_indexed_frame(const gmx_output_env_t* oenv, t_trxstatus* status, gmx_bool bDouble)
+{
+    const gmx::XtcFrameIndex& index = *status->xtcIndex;
+    int                       frame = status->xtcFrame;
+
+    if (bTimeSet(TBEGIN) && (status->tf < rTimeValue(TBEGIN)) && frame < index.numFrames())
+    {
+        int first = index.findFirstFrameAtOrAfter(rTimeValue(TBEGIN));
+        if (first == index.numFrames())
+        {
+            gmx_fatal(FARGS,
+                      "Specified frame (time %f) doesn't exist or file "
+                      "corrupt/inconsistent.",
+                      rTimeValue(TBEGIN));
+        }
+        frame = std::max(frame, first);
+        initcount(status);
+    }
+    if (!(status->flags & TRX_DONT_SKIP))
+    {
+        while (frame < index.numFrames() && check_times2(index[frame].time, status->t0, bDouble) < 0)
+        {
+            printcount(status, oenv, index[frame].time, TRUE);
+            frame++;
+        }
+    }
+    if (frame < index.numFrames())
+    {
+        gmx_off_t position = (status->xtcReadAhead ? status->xtcReadAhead->nextFrameOffset(status->fio)
+                                                   : gmx_fio_ftell(status->fio));
+        if (position != index[frame].offset)
+        {
+            if (status->xtcReadAhead)
+            {
+                status->xtcReadAhead->discard(status->fio);
+            }
+            gmx_fio_seek(status->fio, index[frame].offset);
+        }
+    }
+    status->xtcFrame = frame + 1;
+}
+
 bool read_next_frame(const gmx_output_env_t* oenv, t_trxstatus* status, t_trxframe* fr)
 {
     real     pt;
@@ -805,8 +932,16 @@ bool read_next_frame(const gmx_output_env_t* oenv, t_trxstatus* status, t_trxfra
                 break;
             }
             case efXTC:
-                if (bTimeSet(TBEGIN) && (status->tf < rTimeValue(TBEGIN)))
+                if (status->xtcIndex)
                 {
+                    xtc_seek_next_indexed_frame(oenv, status, fr->bDouble);
+                }
+                else if (bTimeSet(TBEGIN) && (status->tf < rTimeValue(TBEGIN)))
+                {
+                    if (status->xtcReadAhead)
+                    {
+                        status->xtcReadAhead->discard(status->fio);
+                    }
                     if (xtc_seek_time(status->fio, rTimeValue(TBEGIN), fr->natoms, TRUE))
                     {
                         gmx_fatal(FARGS,
@@ -816,9 +951,18 @@ bool read_next_frame(const gmx_output_env_t* oenv, t_trxstatus* status, t_trxfra
                     }
                     initcount(status);
                 }
-                bRet = (read_next_xtc(status->fio, fr->natoms, &fr->step, &fr->time, fr->box, fr->x,
-                                      &fr->prec, &bOK)
-                        != 0);
+                if (status->xtcReadAhead)
+                {
+                    bRet = (status->xtcReadAhead->readNextFrame(status->fio, fr->natoms, &fr->step,
+                                                                &fr->time, fr->box, fr->x, &fr->prec, &bOK)
+                            != 0);
+                }
+                else
+                {
+                    bRet = (read_next_xtc(status->fio, fr->natoms, &fr->step, &fr->time, fr->box,
+                                          fr->x, &fr->prec, &bOK)
+                            != 0);
+                }
                 fr->bPrec = (bRet && fr->prec > 0);
                 fr->bStep = bRet;
                 fr->bTime = bRet;
@@ -910,7 +1054,13 @@ bool read_first_frame(const gmx_output_env_t* oenv, t_trxstatus** status, const
     }
     switch (ftp)
     {
-        case efTRR: break;
+        case efTRR:
+            /* Convert the frame data directly from a mapping of the file */
+            if (getenv("GMX_TRR_NO_MMAP") == nullptr)
+            {
+                (*status)->trrMap = gmx::MappedTrrFile::open(fn).release();
+            }
+            break;
         case efCPT:
             read_checkpoint_trxframe(fio, fr);
             bFirst = FALSE;
@@ -959,6 +1109,21 @@ bool read_first_frame(const gmx_output_env_t* oenv, t_trxstatus** status, const
                 fr->bX    = TRUE;
                 fr->bBox  = TRUE;
                 printcount(*status, oenv, fr->time, FALSE);
+
+                (*status)->xtcIndex = gmx::openXtcFrameIndex(fio).release();
+                if ((*status)->xtcIndex && (*status)->xtcIndex->numAtoms() != fr->natoms)
+                {
+                    delete (*status)->xtcIndex;
+                    (*status)->xtcIndex = nullptr;
+                }
+                (*status)->xtcFrame = 1;
+
+                /* Decompress frames in parallel when requested */
+                const char* env = getenv("GMX_XTC_DECODE_THREADS");
+                if (env != nullptr && GMX_OPENMP && std::strtol(env, nullptr, 10) > 1)
+                {
+                    (*status)->xtcReadAhead = new gmx::XtcReadAhead(std::strtol(env, nullptr, 10));
+                }
             }
             bFirst = FALSE;
             break;
@@ -1077,6 +1242,11 @@ gmx_bool read_next_x(const gmx_output_env_t* oenv, t_trxstatus* status, real* t,
 void rewind_trj(t_trxstatus* status)
 {
     initcount(status);
+    status->xtcFrame = 0;
+    if (status->xtcReadAhead)
+    {
+        status->xtcReadAhead->discard(status->fio);
+    }
 
     gmx_fio_rewind(status->fio);
 }
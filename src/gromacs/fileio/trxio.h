@@ -160,11 +160,17 @@ t_trxstatus* open_trx(const char* outfile, const char* filemode);
 /* Open a TRX file and return an allocated status pointer */
 
 struct t_fileio* trx_get_fileio(t_trxstatus* status);
-/* get a fileio from a trxstatus */
+/* get a fileio from a trxstatus, the file is then positioned at the next
+ * frame so that the caller can access it directly */
 
 float trx_get_time_of_final_frame(t_trxstatus* status);
 /* get time of final frame. Only supported for TNG and XTC */
 
+int trx_get_number_of_frames(t_trxstatus* status);
+/* Returns the total number of frames in the trajectory when this is known
+ * without reading the whole file, which is the case for XTC files with a
+ * frame index. Returns -1 otherwise. */
+
 gmx_bool bRmod_fd(double a, double b, double c, gmx_bool bDouble);
 /* Returns TRUE when (a - b) MOD c = 0, using a margin which is slightly
  * larger than the float/double precision.
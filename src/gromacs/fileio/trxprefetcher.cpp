@@ -0,0 +1,221 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2021, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \internal \file
+ * \brief
+ * Implements gmx::TrajectoryFramePrefetcher.
+ *
+ * \ingroup module_fileio
+ */
+#include "gmxpre.h"
+
+#include "trxprefetcher.h"
+
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "gromacs/fileio/filetypes.h"
+#include "gromacs/fileio/trxio.h"
+#include "gromacs/trajectory/trajectoryframe.h"
+#include "gromacs/utility/exceptions.h"
+#include "gromacs/utility/gmxassert.h"
+#include "gromacs/utility/smalloc.h"
+
+namespace gmx
+{
+
+class TrajectoryFramePrefetcher::Impl
+{
+public:
+    Impl(const gmx_output_env_t* oenv, t_trxstatus* status, const t_trxframe& frame, int numFrames);
+    ~Impl();
+
+    //! Reads frames into free buffers until the end of the trajectory or stop
+    void readFrames();
+
+    const gmx_output_env_t* oenv_;
+    t_trxstatus*            status_;
+    //! Ring of frame buffers, frames [first_, first_ + count_) are ready
+    std::vector<t_trxframe> frames_;
+    int                     first_ = 0;
+    int                     count_ = 0;
+    //! Whether the reading thread has reached the end of the trajectory
+    bool endOfTrajectory_ = false;
+    //! Whether the reading thread should stop
+    bool stop_ = false;
+    //! Exception thrown on the reading thread
+    std::exception_ptr      exception_;
+    std::mutex              mutex_;
+    std::condition_variable frameReady_;
+    std::condition_variable bufferFree_;
+    std::thread             thread_;
+};
+
+TrajectoryFramePrefetcher::Impl::Impl(const gmx_output_env_t* oenv,
+                                      t_trxstatus*            status,
+                                      const t_trxframe&       frame,
+                                      int                     numFrames) :
+    oenv_(oenv),
+    status_(status),
+    frames_(numFrames, frame)
+{
+    // The buffers share everything but the per-frame arrays with frame
+    for (t_trxframe& buffer : frames_)
+    {
+        buffer.x = nullptr;
+        buffer.v = nullptr;
+        buffer.f = nullptr;
+        if (frame.x != nullptr)
+        {
+            snew(buffer.x, frame.natoms);
+        }
+        if (frame.v != nullptr)
+        {
+            snew(buffer.v, frame.natoms);
+        }
+        if (frame.f != nullptr)
+        {
+            snew(buffer.f, frame.natoms);
+        }
+    }
+    thread_ = std::thread([this]() { readFrames(); });
+}
+
+TrajectoryFramePrefetcher::Impl::~Impl()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    bufferFree_.notify_one();
+    thread_.join();
+    for (t_trxframe& buffer : frames_)
+    {
+        sfree(buffer.x);
+        sfree(buffer.v);
+        sfree(buffer.f);
+    }
+}
+
+void TrajectoryFramePrefetcher::Impl::readFrames()
+{
+    const int numBuffers = static_cast<int>(frames_.size());
+    while (true)
+    {
+        int buffer;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            bufferFree_.wait(lock, [this, numBuffers]() { return stop_ || count_ < numBuffers; });
+            if (stop_)
+            {
+                return;
+            }
+            buffer = (first_ + count_) % numBuffers;
+        }
+        // Only this thread accesses the buffer and the status while reading
+        bool bRead = false;
+        try
+        {
+            bRead = read_next_frame(oenv_, status_, &frames_[buffer]);
+        }
+        catch (...)
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            exception_       = std::current_exception();
+            endOfTrajectory_ = true;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (bRead)
+            {
+                count_++;
+            }
+            else
+            {
+                endOfTrajectory_ = true;
+            }
+        }
+        frameReady_.notify_one();
+        if (!bRead)
+        {
+            return;
+        }
+    }
+}
+
+TrajectoryFramePrefetcher::TrajectoryFramePrefetcher(const gmx_output_env_t* oenv,
+                                                     t_trxstatus*            status,
+                                                     const t_trxframe&       frame,
+                                                     int                     numFrames)
+{
+    GMX_RELEASE_ASSERT(numFrames > 0, "Need to read at least one frame ahead");
+    impl_ = std::make_unique<Impl>(oenv, status, frame, numFrames);
+}
+
+TrajectoryFramePrefetcher::~TrajectoryFramePrefetcher() = default;
+
+bool TrajectoryFramePrefetcher::readNextFrame(t_trxframe* frame)
+{
+    std::unique_lock<std::mutex> lock(impl_->mutex_);
+    impl_->frameReady_.wait(lock, [this]() { return impl_->count_ > 0 || impl_->endOfTrajectory_; });
+    if (impl_->count_ == 0)
+    {
+        if (impl_->exception_)
+        {
+            std::exception_ptr exception = impl_->exception_;
+            impl_->exception_            = nullptr;
+            std::rethrow_exception(exception);
+        }
+        return false;
+    }
+    // The buffer receives the arrays of frame, which are reused for reading
+    std::swap(*frame, impl_->frames_[impl_->first_]);
+    impl_->first_ = (impl_->first_ + 1) % static_cast<int>(impl_->frames_.size());
+    impl_->count_--;
+    lock.unlock();
+    impl_->bufferFree_.notify_one();
+    return true;
+}
+
+bool TrajectoryFramePrefetcher::supportsFile(const char* fn)
+{
+    const int ftp = fn2ftp(fn);
+    return ftp == efXTC || ftp == efTRR;
+}
+
+} // namespace gmx
@@ -0,0 +1,103 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2021, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \libinternal \file
+ * \brief
+ * Declares gmx::TrajectoryFramePrefetcher.
+ *
+ * \inlibraryapi
+ * \ingroup module_fileio
+ */
+#ifndef GMX_FILEIO_TRXPREFETCHER_H
+#define GMX_FILEIO_TRXPREFETCHER_H
+
+#include <memory>
+
+struct gmx_output_env_t;
+struct t_trxframe;
+struct t_trxstatus;
+
+namespace gmx
+{
+
+/*! \libinternal \brief
+ * Reads trajectory frames ahead on a background thread.
+ *
+ * The frames following an already read frame are read with
+ * read_next_frame() into a ring of preallocated frame buffers, while the
+ * caller processes the current frame. readNextFrame() swaps the contents
+ * of the oldest buffered frame with the frame passed to it, so no
+ * coordinates are copied and the caller keeps ownership of its frame.
+ *
+ * Only formats where every frame has the same size and the reader only
+ * fills the preallocated coordinate arrays are supported, see
+ * supportsFile(). The status must not be used by the caller while the
+ * prefetcher exists, and the prefetcher must be destroyed before the
+ * status is closed.
+ */
+class TrajectoryFramePrefetcher
+{
+public:
+    /*! \brief Starts reading ahead of the frame \p frame
+     *
+     * \param[in] oenv     Output environment passed to read_next_frame().
+     * \param[in] status   Trajectory that \p frame was read from.
+     * \param[in] frame    Last frame read, used as template for the buffers.
+     * \param[in] numFrames Number of frames to read ahead, at least one.
+     */
+    TrajectoryFramePrefetcher(const gmx_output_env_t* oenv,
+                              t_trxstatus*            status,
+                              const t_trxframe&       frame,
+                              int                     numFrames);
+    ~TrajectoryFramePrefetcher();
+
+    /*! \brief Returns the next frame in \p frame, same contract as read_next_frame()
+     *
+     * Exceptions thrown while reading on the background thread are
+     * rethrown here.
+     */
+    bool readNextFrame(t_trxframe* frame);
+
+    //! Returns whether frames from the trajectory \p fn can be prefetched
+    static bool supportsFile(const char* fn);
+
+private:
+    class Impl;
+
+    std::unique_ptr<Impl> impl_;
+};
+
+} // namespace gmx
+
+#endif
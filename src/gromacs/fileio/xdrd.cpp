@@ -36,6 +36,9 @@
  */
 #include "gmxpre.h"
 
+#include <cstdint>
+#include <cstring>
+
 #include "gromacs/fileio/xdrf.h"
 #include "gromacs/math/vectypes.h"
 #include "gromacs/utility/fatalerror.h"
@@ -57,6 +60,117 @@ int xdr_real(XDR* xdrs, real* r)
 #endif
 }
 
+/* Returns the host value of a big-endian 32-bit word stored at p */
+static inline uint32_t loadBigEndian32(const unsigned char* p)
+{
+    return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | uint32_t(p[3]);
+}
+
+/* Stores the 32-bit word w big-endian at p */
+static inline void storeBigEndian32(uint32_t w, unsigned char* p)
+{
+    p[0] = static_cast<unsigned char>(w >> 24);
+    p[1] = static_cast<unsigned char>(w >> 16);
+    p[2] = static_cast<unsigned char>(w >> 8);
+    p[3] = static_cast<unsigned char>(w);
+}
+
+void xdr_reals_from_bytes(const void* src, gmx_bool bDouble, int64_t numValues, real* dest)
+{
+    const unsigned char* bytes = static_cast<const unsigned char*>(src);
+
+    if (GMX_INTEGER_BIG_ENDIAN && (bDouble ? sizeof(real) == sizeof(double) : sizeof(real) == sizeof(float)))
+    {
+        std::memcpy(dest, bytes, numValues * sizeof(real));
+        return;
+    }
+    /* Simple loops without dependencies, so the compiler can vectorize
+     * the byte swapping. */
+    if (!bDouble)
+    {
+        for (int64_t i = 0; i < numValues; i++)
+        {
+            uint32_t bits = loadBigEndian32(bytes + 4 * i);
+            float    value;
+            std::memcpy(&value, &bits, sizeof(value));
+            dest[i] = value;
+        }
+    }
+    else
+    {
+        for (int64_t i = 0; i < numValues; i++)
+        {
+            uint64_t bits = (uint64_t(loadBigEndian32(bytes + 8 * i)) << 32)
+                            | uint64_t(loadBigEndian32(bytes + 8 * i + 4));
+            double value;
+            std::memcpy(&value, &bits, sizeof(value));
+            dest[i] = value;
+        }
+    }
+}
+
+void xdr_reals_to_bytes(const real* src, int64_t numValues, void* dest)
+{
+    unsigned char* bytes = static_cast<unsigned char*>(dest);
+
+    if (GMX_INTEGER_BIG_ENDIAN)
+    {
+        std::memcpy(bytes, src, numValues * sizeof(real));
+        return;
+    }
+#if GMX_DOUBLE
+    for (int64_t i = 0; i < numValues; i++)
+    {
+        uint64_t bits;
+        std::memcpy(&bits, &src[i], sizeof(bits));
+        storeBigEndian32(static_cast<uint32_t>(bits >> 32), bytes + 8 * i);
+        storeBigEndian32(static_cast<uint32_t>(bits), bytes + 8 * i + 4);
+    }
+#else
+    for (int64_t i = 0; i < numValues; i++)
+    {
+        uint32_t bits;
+        std::memcpy(&bits, &src[i], sizeof(bits));
+        storeBigEndian32(bits, bytes + 4 * i);
+    }
+#endif
+}
+
+void xdr_doubles_from_bytes(const void* src, int64_t numValues, double* dest)
+{
+    const unsigned char* bytes = static_cast<const unsigned char*>(src);
+
+    if (GMX_INTEGER_BIG_ENDIAN)
+    {
+        std::memcpy(dest, bytes, numValues * sizeof(double));
+        return;
+    }
+    for (int64_t i = 0; i < numValues; i++)
+    {
+        uint64_t bits = (uint64_t(loadBigEndian32(bytes + 8 * i)) << 32)
+                        | uint64_t(loadBigEndian32(bytes + 8 * i + 4));
+        std::memcpy(&dest[i], &bits, sizeof(bits));
+    }
+}
+
+void xdr_doubles_to_bytes(const double* src, int64_t numValues, void* dest)
+{
+    unsigned char* bytes = static_cast<unsigned char*>(dest);
+
+    if (GMX_INTEGER_BIG_ENDIAN)
+    {
+        std::memcpy(bytes, src, numValues * sizeof(double));
+        return;
+    }
+    for (int64_t i = 0; i < numValues; i++)
+    {
+        uint64_t bits;
+        std::memcpy(&bits, &src[i], sizeof(bits));
+        storeBigEndian32(static_cast<uint32_t>(bits >> 32), bytes + 8 * i);
+        storeBigEndian32(static_cast<uint32_t>(bits), bytes + 8 * i + 4);
+    }
+}
+
 int xdr3drcoord(XDR* xdrs, real* fp, int* size, real* precision)
 {
 #if GMX_DOUBLE
@@ -39,6 +39,8 @@
 
 #include <stdio.h>
 
+#include <vector>
+
 #include "gromacs/utility/basedefinitions.h"
 #include "gromacs/utility/real.h"
 
@@ -59,6 +61,54 @@
 int xdr3dfcoord(XDR* xdrs, float* fp, int* size, float* precision);
 
 
+/* Reduced precision coordinates as stored in the file, before decompression */
+struct XtcCompressedCoordinates
+{
+    int                        size;         /* Number of coordinate triplets */
+    float                      precision;    /* Precision, -1 when not compressed */
+    int                        minint[3];    /* Minimum integer coordinates */
+    int                        maxint[3];    /* Maximum integer coordinates */
+    int                        smallidx;     /* Initial index in the small-number table */
+    std::vector<unsigned char> bytes;        /* The compressed bit stream */
+    std::vector<float>         uncompressed; /* Coordinates of systems with at most 9 atoms */
+};
+
+/* Compress size coordinate triplets in fp with the given precision into
+ * coords, as xdr3dfcoord does when writing. This function is thread safe,
+ * so frames can be compressed concurrently and written in order later.
+ * Returns 0 when the coordinates can not be represented at this precision. */
+int xdr3dfcoord_compress(const float* fp, int size, float precision, XtcCompressedCoordinates* coords);
+
+/* Write coordinates compressed with xdr3dfcoord_compress. The output is
+ * identical to writing the coordinates with xdr3dfcoord. */
+int xdr3dfcoord_write_compressed(XDR* xdrs, const XtcCompressedCoordinates& coords);
+
+/* Read compressed coordinates as written by xdr3dfcoord without decoding
+ * them, so the decompression can be done later, e.g. on another thread. */
+int xdr3dfcoord_read_compressed(XDR* xdrs, XtcCompressedCoordinates* coords);
+
+/* Decompress coordinates read with xdr3dfcoord_read_compressed into fp,
+ * which should hold 3*coords.size floats. The result is identical to
+ * reading the coordinates with xdr3dfcoord. This function is thread safe. */
+int xdr3dfcoord_decompress(const XtcCompressedCoordinates& coords, float* fp);
+
+
+/* Convert numValues big-endian XDR floats, or doubles when bDouble is set,
+ * stored at src to real. This is a bulk alternative to xdr_vector for
+ * data that is already in memory. */
+void xdr_reals_from_bytes(const void* src, gmx_bool bDouble, int64_t numValues, real* dest);
+
+/* Convert numValues reals to their big-endian XDR representation, in the
+ * precision of real, at dest. */
+void xdr_reals_to_bytes(const real* src, int64_t numValues, void* dest);
+
+/* Convert numValues big-endian XDR doubles stored at src to double. */
+void xdr_doubles_from_bytes(const void* src, int64_t numValues, double* dest);
+
+/* Convert numValues doubles to their big-endian XDR representation at dest. */
+void xdr_doubles_to_bytes(const double* src, int64_t numValues, void* dest);
+
+
 /* Read or write a *real* value (stored as float) */
 int xdr_real(XDR* xdrs, real* r);
 
@@ -0,0 +1,379 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2021, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \internal \file
+ * \brief
+ * Implements the frame-offset index for XTC trajectory files.
+ *
+ * \ingroup module_fileio
+ */
+#include "gmxpre.h"
+
+#include "xtcindex.h"
+
+#include <cstdio>
+#include <cstdlib>
+
+#include <algorithm>
+
+#include <sys/stat.h>
+
+#include "gromacs/fileio/gmxfio.h"
+#include "gromacs/fileio/xdrf.h"
+#include "gromacs/fileio/xtcio.h"
+#include "gromacs/utility/basedefinitions.h"
+
+namespace gmx
+{
+
+namespace
+{
+
+//! Magic number identifying an XTC index file, "XIDX" in ASCII
+const int c_xtcIndexMagic = 0x58494458;
+//! Version of the XTC index file format
+const int c_xtcIndexVersion = 2;
+//! Size in bytes of the XDR encoded index file header
+const gmx_off_t c_xtcIndexHeaderSize = 3 * sizeof(int32_t) + 2 * sizeof(int64_t);
+//! Size in bytes of an XDR encoded index entry
+const gmx_off_t c_xtcIndexEntrySize = 3 * sizeof(int64_t) + sizeof(float);
+
+//! Reads or writes the header of an index file, returns false on failure
+bool doIndexHeader(XDR* xd, int* magic, int* version, int* numAtoms, int64_t* numFrames, int64_t* modificationTime)
+{
+    return xdr_int(xd, magic) && xdr_int(xd, version) && xdr_int(xd, numAtoms)
+           && xdr_int64(xd, numFrames) && xdr_int64(xd, modificationTime);
+}
+
+//! Reads or writes an index entry, returns false on failure
+bool doIndexEntry(XDR* xd, XtcFrameIndexEntry* entry)
+{
+    float   time   = entry->time;
+    int64_t offset = entry->offset;
+    int64_t size   = entry->size;
+    if (!(xdr_int64(xd, &entry->step) && xdr_float(xd, &time) && xdr_int64(xd, &offset)
+          && xdr_int64(xd, &size)))
+    {
+        return false;
+    }
+    entry->time   = time;
+    entry->offset = offset;
+    entry->size   = size;
+    return true;
+}
+
+//! Returns the length in bytes of the file opened in \p fio, restores the file position
+gmx_off_t fileLength(t_fileio* fio)
+{
+    FILE*     fp       = gmx_fio_getfp(fio);
+    gmx_off_t position = gmx_ftell(fp);
+    gmx_off_t length   = -1;
+    if (gmx_fseek(fp, 0, SEEK_END) == 0)
+    {
+        length = gmx_ftell(fp);
+    }
+    gmx_fseek(fp, position, SEEK_SET);
+    return length;
+}
+
+//! Returns the modification time of \p fileName, or -1 when it can not be determined
+int64_t fileModificationTime(const char* fileName)
+{
+    struct stat fileStat;
+    if (stat(fileName, &fileStat) != 0)
+    {
+        return -1;
+    }
+    return static_cast<int64_t>(fileStat.st_mtime);
+}
+
+//! Returns whether the frame header at \p entry in \p fio matches the entry
+bool frameMatchesEntry(t_fileio* fio, const XtcFrameIndexEntry& entry, int numAtoms)
+{
+    int      natoms;
+    int64_t  step;
+    real     time;
+    gmx_bool bOK;
+    gmx_fio_seek(fio, entry.offset);
+    return (skip_next_xtc(fio, &natoms, &step, &time, &bOK) && natoms == numAtoms
+            && step == entry.step && time == entry.time
+            && gmx_fio_ftell(fio) == entry.offset + entry.size);
+}
+
+} // namespace
+
+std::string XtcFrameIndex::sidecarFileName(const std::string& xtcFileName)
+{
+    return xtcFileName + ".idx";
+}
+
+gmx_off_t XtcFrameIndex::indexedLength() const
+{
+    return entries_.empty() ? 0 : entries_.back().offset + entries_.back().size;
+}
+
+void XtcFrameIndex::scanFrom(t_fileio* fio)
+{
+    gmx_off_t offset = gmx_fio_ftell(fio);
+    int       natoms;
+    int64_t   step;
+    real      time;
+    gmx_bool  bOK;
+    while (skip_next_xtc(fio, &natoms, &step, &time, &bOK))
+    {
+        if (entries_.empty())
+        {
+            numAtoms_ = natoms;
+        }
+        else if (natoms != numAtoms_)
+        {
+            /* Not an XTC file we can index, readers will report the error */
+            break;
+        }
+        gmx_off_t next = gmx_fio_ftell(fio);
+        entries_.push_back({ step, time, offset, next - offset });
+        offset = next;
+    }
+}
+
+XtcFrameIndex XtcFrameIndex::build(t_fileio* fio)
+{
+    XtcFrameIndex index;
+    gmx_off_t     position = gmx_fio_ftell(fio);
+    index.modificationTime_ = fileModificationTime(gmx_fio_getname(fio));
+    gmx_fio_seek(fio, 0);
+    index.scanFrom(fio);
+    gmx_fio_seek(fio, position);
+    return index;
+}
+
+bool XtcFrameIndex::read(const std::string& indexFileName, XtcFrameIndex* index)
+{
+    FILE* fp = std::fopen(indexFileName.c_str(), "rb");
+    if (fp == nullptr)
+    {
+        return false;
+    }
+    gmx_off_t length = -1;
+    if (gmx_fseek(fp, 0, SEEK_END) == 0)
+    {
+        length = gmx_ftell(fp);
+    }
+    gmx_fseek(fp, 0, SEEK_SET);
+
+    XDR xd;
+    xdrstdio_create(&xd, fp, XDR_DECODE);
+
+    XtcFrameIndex newIndex;
+    int           magic, version;
+    int64_t       numFrames;
+    bool bOK = (doIndexHeader(&xd, &magic, &version, &newIndex.numAtoms_, &numFrames,
+                              &newIndex.modificationTime_)
+                && magic == c_xtcIndexMagic && version == c_xtcIndexVersion && numFrames >= 0);
+    /* Check the frame count against the file size before allocating,
+     * so a corrupt or truncated index is rejected instead of used.
+     */
+    bOK = bOK && numFrames <= (length - c_xtcIndexHeaderSize) / c_xtcIndexEntrySize;
+    if (bOK)
+    {
+        newIndex.entries_.resize(numFrames);
+        for (auto& entry : newIndex.entries_)
+        {
+            if (!doIndexEntry(&xd, &entry))
+            {
+                bOK = false;
+                break;
+            }
+        }
+    }
+    xdr_destroy(&xd);
+    std::fclose(fp);
+
+    if (bOK)
+    {
+        *index = std::move(newIndex);
+    }
+    return bOK;
+}
+
+bool XtcFrameIndex::write(const std::string& indexFileName) const
+{
+    FILE* fp = std::fopen(indexFileName.c_str(), "wb");
+    if (fp == nullptr)
+    {
+        return false;
+    }
+    XDR xd;
+    xdrstdio_create(&xd, fp, XDR_ENCODE);
+
+    int     magic            = c_xtcIndexMagic;
+    int     version          = c_xtcIndexVersion;
+    int     numAtoms         = numAtoms_;
+    int64_t numFrames        = entries_.size();
+    int64_t modificationTime = modificationTime_;
+
+    bool bOK = doIndexHeader(&xd, &magic, &version, &numAtoms, &numFrames, &modificationTime);
+    for (size_t i = 0; i < entries_.size() && bOK; i++)
+    {
+        XtcFrameIndexEntry entry = entries_[i];
+        bOK                      = doIndexEntry(&xd, &entry);
+    }
+    xdr_destroy(&xd);
+    bOK = (std::fclose(fp) == 0) && bOK;
+
+    if (!bOK)
+    {
+        std::remove(indexFileName.c_str());
+    }
+    return bOK;
+}
+
+bool XtcFrameIndex::update(t_fileio* fio)
+{
+    const gmx_off_t length           = fileLength(fio);
+    const int64_t   modificationTime = fileModificationTime(gmx_fio_getname(fio));
+    const gmx_off_t position         = gmx_fio_ftell(fio);
+
+    /* An unmodified file should have the same modification time and length
+     * and the first and last indexed frames should still be where we expect them.
+     */
+    bool bUnchanged = (modificationTime >= 0 && modificationTime == modificationTime_
+                       && length == indexedLength());
+    if (bUnchanged && !entries_.empty())
+    {
+        bUnchanged = (frameMatchesEntry(fio, entries_.front(), numAtoms_)
+                      && frameMatchesEntry(fio, entries_.back(), numAtoms_));
+    }
+    if (bUnchanged)
+    {
+        gmx_fio_seek(fio, position);
+        return false;
+    }
+
+    /* When frames were appended, possibly after truncating the file as
+     * mdrun does when appending from a checkpoint, we keep the entries up
+     * to the last indexed frame that is still intact and resume scanning
+     * after it. As for an unchanged file, only the first frame and that
+     * frame are checked. When nothing was appended after the last intact
+     * frame, the file was rewritten in place and we rebuild the index.
+     */
+    int numIntact = 0;
+    if (!entries_.empty() && frameMatchesEntry(fio, entries_.front(), numAtoms_))
+    {
+        numIntact = numFrames();
+        while (numIntact > 0
+               && (entries_[numIntact - 1].offset + entries_[numIntact - 1].size > length
+                   || !frameMatchesEntry(fio, entries_[numIntact - 1], numAtoms_)))
+        {
+            numIntact--;
+        }
+    }
+    if (numIntact > 0 && length > entries_[numIntact - 1].offset + entries_[numIntact - 1].size)
+    {
+        entries_.resize(numIntact);
+        modificationTime_ = modificationTime;
+        gmx_fio_seek(fio, indexedLength());
+        scanFrom(fio);
+    }
+    else
+    {
+        *this = build(fio);
+    }
+    gmx_fio_seek(fio, position);
+    return true;
+}
+
+int XtcFrameIndex::findFirstFrameAtOrAfter(real time) const
+{
+    auto it = std::lower_bound(
+            entries_.begin(), entries_.end(), time,
+            [](const XtcFrameIndexEntry& entry, real t) { return entry.time < t; });
+    return static_cast<int>(it - entries_.begin());
+}
+
+std::unique_ptr<XtcFrameIndex> openXtcFrameIndex(t_fileio* fio)
+{
+    const std::string indexFileName = XtcFrameIndex::sidecarFileName(gmx_fio_getname(fio));
+    const bool        bWriteIndex   = (std::getenv("GMX_XTC_FRAME_INDEX") != nullptr);
+
+    auto index     = std::make_unique<XtcFrameIndex>();
+    bool bHaveFile = XtcFrameIndex::read(indexFileName, index.get());
+    if (!bHaveFile && !bWriteIndex)
+    {
+        return nullptr;
+    }
+    /* Bring the index up to date, this is a no-op for an unchanged file */
+    if (index->update(fio) && bWriteIndex)
+    {
+        if (!index->write(indexFileName))
+        {
+            fprintf(stderr, "\nNote: could not write XTC frame index file %s\n", indexFileName.c_str());
+        }
+    }
+    if (index->numFrames() == 0)
+    {
+        return nullptr;
+    }
+    return index;
+}
+
+void writeXtcFrameIndexForFile(const std::string& xtcFileName)
+{
+    const std::string indexFileName = XtcFrameIndex::sidecarFileName(xtcFileName);
+
+    /* gmx_fio_open() is fatal on failure, but a missing index should never
+     * abort a run, so we check that we can open the trajectory first.
+     */
+    FILE* fp = std::fopen(xtcFileName.c_str(), "rb");
+    if (fp == nullptr)
+    {
+        fprintf(stderr, "\nNote: could not write XTC frame index file %s\n", indexFileName.c_str());
+        return;
+    }
+    std::fclose(fp);
+
+    t_fileio*     fio = gmx_fio_open(xtcFileName.c_str(), "r");
+    XtcFrameIndex index;
+    XtcFrameIndex::read(indexFileName, &index);
+    if (index.update(fio) || !gmx_fexist(indexFileName))
+    {
+        if (!index.write(indexFileName))
+        {
+            fprintf(stderr, "\nNote: could not write XTC frame index file %s\n", indexFileName.c_str());
+        }
+    }
+    gmx_fio_close(fio);
+}
+
+} // namespace gmx
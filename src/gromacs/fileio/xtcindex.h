@@ -0,0 +1,174 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2021, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \libinternal \file
+ * \brief
+ * Declares a frame-offset index for XTC trajectory files.
+ *
+ * The index stores for every frame its step, time, byte offset and
+ * size, so that readers can seek to a frame in constant time, know the
+ * exact number of frames, and skip frames without decompressing them.
+ * It can be persisted in a sidecar file next to the trajectory.
+ *
+ * \inlibraryapi
+ * \ingroup module_fileio
+ */
+#ifndef GMX_FILEIO_XTCINDEX_H
+#define GMX_FILEIO_XTCINDEX_H
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "gromacs/utility/arrayref.h"
+#include "gromacs/utility/futil.h"
+#include "gromacs/utility/real.h"
+
+struct t_fileio;
+
+namespace gmx
+{
+
+//! Index entry for a single frame in an XTC file
+struct XtcFrameIndexEntry
+{
+    //! MD step of the frame
+    int64_t step;
+    //! Time of the frame
+    real time;
+    //! Offset in bytes of the frame header from the start of the file
+    gmx_off_t offset;
+    //! Size in bytes of the frame including its header
+    gmx_off_t size;
+};
+
+/*! \libinternal \brief
+ * Frame-offset index of an XTC trajectory.
+ *
+ * The frame number is the position of the entry in the index.
+ */
+class XtcFrameIndex
+{
+public:
+    //! Returns the name of the sidecar index file for \p xtcFileName
+    static std::string sidecarFileName(const std::string& xtcFileName);
+
+    /*! \brief Builds the index by scanning the frame headers of \p fio
+     *
+     * Only the headers are read, the coordinates are skipped without
+     * decompressing them. The file position of \p fio is restored
+     * afterwards.
+     */
+    static XtcFrameIndex build(t_fileio* fio);
+
+    /*! \brief Reads the index stored in \p indexFileName
+     *
+     * \returns false when the file does not exist or is not a valid index,
+     *          in which case \p index is not changed.
+     */
+    static bool read(const std::string& indexFileName, XtcFrameIndex* index);
+
+    /*! \brief Writes the index to \p indexFileName
+     *
+     * \returns false when the file could not be written.
+     */
+    bool write(const std::string& indexFileName) const;
+
+    /*! \brief Makes the index consistent with the current contents of \p fio
+     *
+     * The index is kept when the modification time and length of the file
+     * match those stored in the index and the first and last indexed
+     * frames match. When frames were appended after the last indexed frame
+     * that is still intact, possibly after truncating the file, only the
+     * new frames are scanned. Otherwise the file was rewritten, possibly
+     * by a new run with the same file name, and the index is rebuilt by
+     * scanning the frame headers.
+     *
+     * \returns true when the index was changed.
+     */
+    bool update(t_fileio* fio);
+
+    //! Returns the number of frames in the index
+    int numFrames() const { return static_cast<int>(entries_.size()); }
+    //! Returns the number of atoms per frame
+    int numAtoms() const { return numAtoms_; }
+    //! Returns the number of bytes of the trajectory covered by the index
+    gmx_off_t indexedLength() const;
+    //! Returns all index entries
+    ArrayRef<const XtcFrameIndexEntry> entries() const { return entries_; }
+    //! Returns the index entry of \p frame
+    const XtcFrameIndexEntry& operator[](int frame) const { return entries_[frame]; }
+
+    /*! \brief Returns the first frame with time at or after \p time
+     *
+     * Assumes times increase monotonically through the file.
+     * Returns numFrames() when there is no such frame.
+     */
+    int findFirstFrameAtOrAfter(real time) const;
+
+private:
+    //! Appends entries by scanning \p fio from its current position
+    void scanFrom(t_fileio* fio);
+
+    //! The number of atoms per frame
+    int numAtoms_ = 0;
+    //! The modification time of the trajectory when it was indexed, -1 when unknown
+    int64_t modificationTime_ = -1;
+    //! The entries, one per frame
+    std::vector<XtcFrameIndexEntry> entries_;
+};
+
+/*! \brief Opens the frame index for the XTC file \p fio
+ *
+ * A valid sidecar index file is always used, and extended when frames
+ * were appended to the trajectory. When there is no usable sidecar and
+ * the GMX_XTC_FRAME_INDEX environment variable is set, the index is
+ * built by scanning the frame headers and written to the sidecar file
+ * for use by later tools.
+ *
+ * \returns the index, or nullptr when no index is available.
+ */
+std::unique_ptr<XtcFrameIndex> openXtcFrameIndex(t_fileio* fio);
+
+/*! \brief Writes or updates the sidecar index of the closed XTC file \p xtcFileName
+ *
+ * Used by mdrun to leave an index alongside the trajectory it wrote.
+ * Failure to write the index is not an error, since readers fall back
+ * to sequential reading.
+ */
+void writeXtcFrameIndexForFile(const std::string& xtcFileName);
+
+} // namespace gmx
+
+#endif
@@ -41,10 +41,14 @@
 
 #include <cstring>
 
+#include <deque>
+#include <vector>
+
 #include "gromacs/fileio/gmxfio.h"
 #include "gromacs/fileio/gmxfio_xdr.h"
 #include "gromacs/fileio/xdrf.h"
 #include "gromacs/math/vec.h"
+#include "gromacs/utility/exceptions.h"
 #include "gromacs/utility/fatalerror.h"
 #include "gromacs/utility/futil.h"
 #include "gromacs/utility/smalloc.h"
@@ -285,3 +289,347 @@ int read_next_xtc(t_fileio* fio, int natoms, int64_t* step, real* time, matrix b
 
     return static_cast<int>(*bOK);
 }
+
+int skip_next_xtc(t_fileio* fio, int* natoms, int64_t* step, real* time, gmx_bool* bOK)
+{
+    int   magic;
+    int   lsize;
+    float fdum;
+    XDR*  xd;
+
+    *bOK = TRUE;
+    xd   = gmx_fio_getxdr(fio);
+
+    /* read header */
+    if (!xtc_header(xd, &magic, natoms, step, time, TRUE, bOK))
+    {
+        return 0;
+    }
+    if (magic != XTC_MAGIC)
+    {
+        *bOK = FALSE;
+        return 0;
+    }
+
+    /* skip the box, we only need to advance the file position */
+    gmx_off_t skip = DIM * DIM * sizeof(float);
+    if (gmx_fio_seek(fio, gmx_fio_ftell(fio) + skip) != 0 || xdr_int(xd, &lsize) == 0)
+    {
+        *bOK = FALSE;
+        return 0;
+    }
+    if (lsize <= 9)
+    {
+        /* Small systems are stored as plain floats */
+        skip = DIM * lsize * sizeof(float);
+    }
+    else
+    {
+        /* Skip precision, minint[3], maxint[3] and smallidx, then read the
+         * length in bytes of the compressed data, which is padded to four bytes.
+         */
+        int byteCount;
+        if (gmx_fio_seek(fio, gmx_fio_ftell(fio) + 8 * sizeof(int)) != 0 || xdr_int(xd, &byteCount) == 0)
+        {
+            *bOK = FALSE;
+            return 0;
+        }
+        skip = ((byteCount + 3) / 4) * 4;
+    }
+    /* Check that the frame is complete by reading its last word */
+    if (skip > 0)
+    {
+        if (gmx_fio_seek(fio, gmx_fio_ftell(fio) + skip - sizeof(float)) != 0
+            || xdr_float(xd, &fdum) == 0)
+        {
+            *bOK = FALSE;
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+namespace gmx
+{
+
+//! An XTC frame that has been read from file
+struct XtcReadAheadFrame
+{
+    //! Offset of the frame in the file
+    gmx_off_t offset;
+    //! The MD step
+    int64_t step;
+    //! The time
+    real time;
+    //! The box
+    matrix box;
+    //! The compressed coordinates
+    XtcCompressedCoordinates coords;
+    //! The decompressed coordinates
+    std::vector<float> x;
+    //! Whether decompression succeeded
+    bool bDecompressed;
+};
+
+class XtcReadAhead::Impl
+{
+public:
+    explicit Impl(int numThreads) : numThreads_(numThreads) {}
+
+    //! Reads the next batch of frames and decompresses them
+    void readBatch(t_fileio* fio, int natoms);
+
+    //! The number of threads used for decompression
+    int numThreads_;
+    //! Frames read ahead, in file order
+    std::deque<XtcReadAheadFrame> frames_;
+    //! Frames no longer in use, kept to reuse their buffers
+    std::vector<XtcReadAheadFrame> unusedFrames_;
+    //! Whether the last read reached the end of the file or a broken frame
+    bool bEndOfFile_ = false;
+    //! Whether the frame at the end was incomplete
+    bool bLastFrameOK_ = true;
+};
+
+void XtcReadAhead::Impl::readBatch(t_fileio* fio, int natoms)
+{
+    XDR*      xd        = gmx_fio_getxdr(fio);
+    const int batchSize = 2 * numThreads_;
+
+    while (static_cast<int>(frames_.size()) < batchSize && !bEndOfFile_)
+    {
+        if (unusedFrames_.empty())
+        {
+            unusedFrames_.emplace_back();
+        }
+        XtcReadAheadFrame& frame = unusedFrames_.back();
+        int                magic, n;
+        gmx_bool           bOK = TRUE;
+
+        frame.offset = gmx_fio_ftell(fio);
+        if (!xtc_header(xd, &magic, &n, &frame.step, &frame.time, TRUE, &bOK))
+        {
+            bEndOfFile_   = true;
+            bLastFrameOK_ = bOK;
+            break;
+        }
+        check_xtc_magic(magic);
+        if (n > natoms)
+        {
+            gmx_fatal(FARGS, "Frame contains more atoms (%d) than expected (%d)", n, natoms);
+        }
+        bool bRead = true;
+        for (int i = 0; i < DIM && bRead; i++)
+        {
+            for (int j = 0; j < DIM && bRead; j++)
+            {
+                bRead = XTC_CHECK("box", xdr_r2f(xd, &(frame.box[i][j]), TRUE));
+            }
+        }
+        bRead = bRead && XTC_CHECK("x", xdr3dfcoord_read_compressed(xd, &frame.coords));
+        if (!bRead)
+        {
+            bEndOfFile_   = true;
+            bLastFrameOK_ = false;
+            break;
+        }
+        frames_.push_back(std::move(frame));
+        unusedFrames_.pop_back();
+    }
+
+    const int numFrames = frames_.size();
+#pragma omp parallel for num_threads(numThreads_) schedule(dynamic)
+    for (int f = 0; f < numFrames; f++)
+    {
+        try
+        {
+            XtcReadAheadFrame& frame = frames_[f];
+            frame.x.resize(DIM * frame.coords.size);
+            frame.bDecompressed = (xdr3dfcoord_decompress(frame.coords, frame.x.data()) != 0);
+        }
+        GMX_CATCH_ALL_AND_EXIT_WITH_FATAL_ERROR
+    }
+}
+
+XtcReadAhead::XtcReadAhead(int numThreads) : impl_(new Impl(numThreads)) {}
+
+XtcReadAhead::~XtcReadAhead() = default;
+
+int XtcReadAhead::readNextFrame(t_fileio* fio, int natoms, int64_t* step, real* time, matrix box, rvec* x, real* prec, gmx_bool* bOK)
+{
+    if (impl_->frames_.empty())
+    {
+        impl_->readBatch(fio, natoms);
+    }
+    if (impl_->frames_.empty())
+    {
+        /* Report the status of the frame that failed to read, once */
+        *bOK                 = impl_->bLastFrameOK_;
+        impl_->bEndOfFile_   = false;
+        impl_->bLastFrameOK_ = true;
+        return 0;
+    }
+
+    XtcReadAheadFrame& frame = impl_->frames_.front();
+    *step                    = frame.step;
+    *time                    = frame.time;
+    copy_mat(frame.box, box);
+    *prec = frame.coords.precision;
+    *bOK  = frame.bDecompressed;
+    if (frame.bDecompressed)
+    {
+        for (int i = 0; i < frame.coords.size; i++)
+        {
+            x[i][XX] = frame.x[DIM * i + XX];
+            x[i][YY] = frame.x[DIM * i + YY];
+            x[i][ZZ] = frame.x[DIM * i + ZZ];
+        }
+    }
+    impl_->unusedFrames_.push_back(std::move(frame));
+    impl_->frames_.pop_front();
+
+    return static_cast<int>(*bOK);
+}
+
+gmx_off_t XtcReadAhead::nextFrameOffset(t_fileio* fio) const
+{
+    return impl_->frames_.empty() ? gmx_fio_ftell(fio) : impl_->frames_.front().offset;
+}
+
+void XtcReadAhead::discard(t_fileio* fio)
+{
+    if (!impl_->frames_.empty())
+    {
+        gmx_fio_seek(fio, impl_->frames_.front().offset);
+    }
+    for (auto& frame : impl_->frames_)
+    {
+        impl_->unusedFrames_.push_back(std::move(frame));
+    }
+    impl_->frames_.clear();
+    impl_->bEndOfFile_   = false;
+    impl_->bLastFrameOK_ = true;
+}
+
+//! An XTC frame waiting to be compressed and written
+struct XtcWriteBehindFrame
+{
+    //! The MD step
+    int64_t step;
+    //! The time
+    real time;
+    //! The box
+    matrix box;
+    //! The coordinates
+    std::vector<float> x;
+    //! The precision
+    real prec;
+    //! The compressed coordinates
+    XtcCompressedCoordinates coords;
+    //! Whether compression succeeded
+    bool bCompressed;
+};
+
+class XtcParallelWriter::Impl
+{
+public:
+    explicit Impl(int numThreads) : numThreads_(numThreads), frames_(2 * numThreads) {}
+
+    //! Compresses the pending frames in parallel and writes them in order
+    int writePending(t_fileio* fio);
+
+    //! The number of threads used for compression
+    int numThreads_;
+    //! The window of frames, the first numPending_ are waiting to be written
+    std::vector<XtcWriteBehindFrame> frames_;
+    //! The number of frames waiting to be written
+    int numPending_ = 0;
+    //! Whether writing a frame failed
+    bool bFailed_ = false;
+};
+
+int XtcParallelWriter::Impl::writePending(t_fileio* fio)
+{
+    const int numFrames = numPending_;
+#pragma omp parallel for num_threads(numThreads_) schedule(dynamic)
+    for (int f = 0; f < numFrames; f++)
+    {
+        try
+        {
+            XtcWriteBehindFrame& frame = frames_[f];
+            frame.bCompressed          = (xdr3dfcoord_compress(frame.x.data(), frame.x.size() / DIM,
+                                                      frame.prec, &frame.coords)
+                                 != 0);
+        }
+        GMX_CATCH_ALL_AND_EXIT_WITH_FATAL_ERROR
+    }
+
+    XDR* xd = gmx_fio_getxdr(fio);
+    for (int f = 0; f < numFrames && !bFailed_; f++)
+    {
+        XtcWriteBehindFrame& frame        = frames_[f];
+        int                  magic_number = XTC_MAGIC;
+        int                  natoms       = frame.coords.size;
+        gmx_bool             bDum;
+        bool bOK = (xtc_header(xd, &magic_number, &natoms, &frame.step, &frame.time, FALSE, &bDum) != 0);
+        for (int i = 0; i < DIM && bOK; i++)
+        {
+            for (int j = 0; j < DIM && bOK; j++)
+            {
+                bOK = XTC_CHECK("box", xdr_r2f(xd, &(frame.box[i][j]), FALSE));
+            }
+        }
+        bOK = bOK && XTC_CHECK("x", xdr3dfcoord_write_compressed(xd, frame.coords));
+        /* As write_xtc, a frame that could not be compressed is written but fails */
+        bFailed_ = !(bOK && frame.bCompressed);
+    }
+    numPending_ = 0;
+    if (numFrames > 0 && gmx_fio_flush(fio) != 0)
+    {
+        bFailed_ = true;
+    }
+    return static_cast<int>(!bFailed_);
+}
+
+XtcParallelWriter::XtcParallelWriter(int numThreads) : impl_(new Impl(numThreads)) {}
+
+XtcParallelWriter::~XtcParallelWriter() = default;
+
+int XtcParallelWriter::writeFrame(t_fileio* fio, int natoms, int64_t step, real time, const rvec* box, const rvec* x, real prec)
+{
+    if (!fio)
+    {
+        /* Same pseudo-success as write_xtc() without file */
+        return 1;
+    }
+    XtcWriteBehindFrame& frame = impl_->frames_[impl_->numPending_];
+    frame.step                 = step;
+    frame.time                 = time;
+    copy_mat(box, frame.box);
+    frame.prec = prec;
+    frame.x.resize(DIM * natoms);
+    for (int i = 0; i < natoms; i++)
+    {
+        frame.x[DIM * i + XX] = x[i][XX];
+        frame.x[DIM * i + YY] = x[i][YY];
+        frame.x[DIM * i + ZZ] = x[i][ZZ];
+    }
+    impl_->numPending_++;
+    if (impl_->numPending_ == static_cast<int>(impl_->frames_.size()))
+    {
+        return impl_->writePending(fio);
+    }
+    return static_cast<int>(!impl_->bFailed_);
+}
+
+int XtcParallelWriter::flush(t_fileio* fio)
+{
+    if (!fio)
+    {
+        return 1;
+    }
+    return impl_->writePending(fio);
+}
+
+} // namespace gmx
@@ -39,8 +39,11 @@
 #ifndef GMX_FILEIO_XTCIO_H
 #define GMX_FILEIO_XTCIO_H
 
+#include <memory>
+
 #include "gromacs/math/vectypes.h"
 #include "gromacs/utility/basedefinitions.h"
+#include "gromacs/utility/futil.h"
 #include "gromacs/utility/real.h"
 
 struct t_fileio;
@@ -75,7 +78,82 @@ int read_first_xtc(struct t_fileio* fio,
 int read_next_xtc(struct t_fileio* fio, int natoms, int64_t* step, real* time, matrix box, rvec* x, real* prec, gmx_bool* bOK);
 /* Read subsequent frames */
 
+int skip_next_xtc(struct t_fileio* fio, int* natoms, int64_t* step, real* time, gmx_bool* bOK);
+/* Read the header of the next frame and advance the file position to the
+ * start of the following frame without decompressing the coordinates.
+ * Returns 0 at the end of the file or when the frame is incomplete. */
+
 int write_xtc(struct t_fileio* fio, int natoms, int64_t step, real time, const rvec* box, const rvec* x, real prec);
 /* Write a frame to xtc file */
 
+namespace gmx
+{
+
+/*! \libinternal \brief
+ * Reads XTC frames ahead and decompresses several frames concurrently.
+ *
+ * The compressed frames are read sequentially from the file and then
+ * decompressed in parallel with OpenMP, after which they are handed out
+ * in file order. The coordinates are identical to those from
+ * read_next_xtc().
+ */
+class XtcReadAhead
+{
+public:
+    //! Constructs a reader that decompresses with \p numThreads threads
+    explicit XtcReadAhead(int numThreads);
+    ~XtcReadAhead();
+
+    //! Reads the next frame, same contract as read_next_xtc()
+    int readNextFrame(t_fileio* fio, int natoms, int64_t* step, real* time, matrix box, rvec* x, real* prec, gmx_bool* bOK);
+
+    //! Returns the file offset of the next frame that will be handed out
+    gmx_off_t nextFrameOffset(t_fileio* fio) const;
+
+    //! Discards the frames read ahead and positions \p fio at the next frame
+    void discard(t_fileio* fio);
+
+private:
+    class Impl;
+
+    std::unique_ptr<Impl> impl_;
+};
+
+/*! \libinternal \brief
+ * Writes XTC frames with several frames compressed concurrently.
+ *
+ * Frames are collected in a window of twice the number of threads.
+ * When the window is full, the frames are compressed in parallel with
+ * OpenMP and written in the order they were passed. The file contents
+ * are identical to writing the frames with write_xtc().
+ */
+class XtcParallelWriter
+{
+public:
+    //! Constructs a writer that compresses with \p numThreads threads
+    explicit XtcParallelWriter(int numThreads);
+    ~XtcParallelWriter();
+
+    /*! \brief Adds a frame, same arguments as write_xtc()
+     *
+     * The frame is copied, so \p x can be reused after the call.
+     * Returns 0 when writing this or an earlier frame failed.
+     */
+    int writeFrame(t_fileio* fio, int natoms, int64_t step, real time, const rvec* box, const rvec* x, real prec);
+
+    /*! \brief Writes all pending frames to \p fio
+     *
+     * Should be called before closing \p fio.
+     * Returns 0 when writing any frame failed.
+     */
+    int flush(t_fileio* fio);
+
+private:
+    class Impl;
+
+    std::unique_ptr<Impl> impl_;
+};
+
+} // namespace gmx
+
 #endif
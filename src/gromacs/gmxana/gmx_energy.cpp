@@ -37,6 +37,7 @@
  */
 #include "gmxpre.h"
 
+#include <cinttypes>
 #include <cmath>
 #include <cstdlib>
 #include <cstring>
@@ -46,8 +47,10 @@
 #include "gromacs/commandline/pargs.h"
 #include "gromacs/commandline/viewit.h"
 #include "gromacs/correlationfunctions/autocorr.h"
+#include "gromacs/fileio/energycolumnstore.h"
 #include "gromacs/fileio/enxio.h"
 #include "gromacs/fileio/gmxfio.h"
+#include "gromacs/fileio/timecontrol.h"
 #include "gromacs/fileio/tpxio.h"
 #include "gromacs/fileio/trxio.h"
 #include "gromacs/fileio/xvgr.h"
@@ -1340,6 +1343,48 @@ static void fec(const char*             ene2fn,
     sfree(fr);
 }
 
+/*! \brief Prints the statistics of all terms in the energy column store \p storeFileName
+ *
+ * The statistics are over the frames within the -b and -e times and are
+ * computed from the chunk summaries of the store.
+ */
+static void printColumnStoreStatistics(const char* storeFileName)
+{
+    gmx::EnergyColumnStore            store(storeFileName);
+    const gmx::ArrayRef<const double> times      = store.times();
+    int64_t                           firstFrame = 0;
+    int64_t                           endFrame   = store.numFrames();
+    if (bTimeSet(TBEGIN))
+    {
+        firstFrame =
+                std::lower_bound(times.begin(), times.end(), rTimeValue(TBEGIN)) - times.begin();
+    }
+    if (bTimeSet(TEND))
+    {
+        endFrame = std::upper_bound(times.begin(), times.end(), rTimeValue(TEND)) - times.begin();
+    }
+    if (firstFrame >= endFrame)
+    {
+        fprintf(stdout, "No frames of the column store are in the selected time range\n");
+        return;
+    }
+
+    fprintf(stdout, "\nStatistics from the column store over %" PRId64 " frames\n\n",
+            endFrame - firstFrame);
+    fprintf(stdout, "%-24s %10s %10s %10s %10s %10s\n", "Energy", "Average", "RMSD", "Tot-Drift",
+            "Minimum", "Maximum");
+    fprintf(stdout,
+            "-------------------------------------------------------------------------------"
+            "\n");
+    for (int term = 0; term < store.numTerms(); term++)
+    {
+        const gmx::EnergyTermStatistics stats = store.statistics(term, firstFrame, endFrame);
+        fprintf(stdout, "%-24s %10g %10g %10g %10g %10g  (%s)\n", store.termName(term).c_str(),
+                stats.average, stats.rmsd, stats.drift, stats.min, stats.max,
+                store.termUnit(term).c_str());
+    }
+    fprintf(stdout, "\n");
+}
 
 static void do_dhdl(t_enxframe*             fr,
                     const t_inputrec*       ir,
@@ -1668,7 +1713,15 @@ int gmx_energy(int argc, char* argv[])
         "where E[SUB]A[sub] and E[SUB]B[sub] are the energies from the first and second energy",
         "files, and the average is over the ensemble A. The running average",
         "of the free energy difference is printed to a file specified by [TT]-ravg[tt].",
-        "[BB]Note[bb] that the energies must both be calculated from the same trajectory."
+        "[BB]Note[bb] that the energies must both be calculated from the same trajectory.[PAR]",
+
+        "Option [TT]-ocol[tt] converts all energy terms in the energy file to a",
+        "column-oriented store with one contiguous array per term and summaries",
+        "per chunk of frames, from which averages, fluctuations and drifts of",
+        "selected terms of long simulations can be computed quickly.",
+        "The average, RMSD, total drift, minimum and maximum of all terms over the",
+        "frames between [TT]-b[tt] and [TT]-e[tt] are printed from these summaries.",
+        "Frames that only contain free-energy or restraint data are not stored."
 
     };
     static gmx_bool bSum = FALSE, bFee = FALSE, bPrAll = FALSE, bFluct = FALSE, bDriftCorr = FALSE;
@@ -1760,7 +1813,8 @@ int gmx_energy(int argc, char* argv[])
         { efXVG, "-viol", "violaver", ffOPTWR }, { efXVG, "-pairs", "pairs", ffOPTWR },
         { efXVG, "-corr", "enecorr", ffOPTWR },  { efXVG, "-vis", "visco", ffOPTWR },
         { efXVG, "-evisco", "evisco", ffOPTWR }, { efXVG, "-eviscoi", "eviscoi", ffOPTWR },
-        { efXVG, "-ravg", "runavgdf", ffOPTWR }, { efXVG, "-odh", "dhdl", ffOPTWR }
+        { efXVG, "-ravg", "runavgdf", ffOPTWR }, { efXVG, "-odh", "dhdl", ffOPTWR },
+        { efDAT, "-ocol", "energycolumns", ffOPTWR }
     };
 #define NFILE asize(fnm)
     int      npargs;
@@ -1777,6 +1831,13 @@ int gmx_energy(int argc, char* argv[])
 
     bDHDL = opt2bSet("-odh", NFILE, fnm);
 
+    if (opt2bSet("-ocol", NFILE, fnm))
+    {
+        gmx::convertEnergyFileToColumnStore(ftp2fn(efEDR, NFILE, fnm), opt2fn("-ocol", NFILE, fnm));
+        printf("Wrote the energy terms in column format to %s\n", opt2fn("-ocol", NFILE, fnm));
+        printColumnStoreStatistics(opt2fn("-ocol", NFILE, fnm));
+    }
+
     nset = 0;
 
     snew(frame, 2);
@@ -1884,6 +1945,22 @@ int gmx_energy(int argc, char* argv[])
         get_dhdl_parms(ftp2fn(efTPR, NFILE, fnm), ir);
     }
 
+    if (!bDHDL)
+    {
+        /* Only decode the selected energy terms */
+        enx_set_projection(fp, nset, set, TRUE);
+    }
+    if (bTimeSet(TBEGIN) && getenv("GMX_ENER_NO_INDEX") == nullptr)
+    {
+        /* Jump to the begin time using the frame index */
+        if (!enx_seek_time(fp, rTimeValue(TBEGIN)))
+        {
+            fprintf(stderr,
+                    "\nCould not jump to time %g using the frame index, reading all frames\n",
+                    rTimeValue(TBEGIN));
+        }
+    }
+
     /* Initiate energies and set them to zero */
     edat.nsteps    = 0;
     edat.npoints   = 0;
@@ -44,7 +44,10 @@
 #include <cstring>
 
 #include <algorithm>
+#include <iterator>
 #include <numeric>
+#include <utility>
+#include <vector>
 
 #include "gromacs/commandline/pargs.h"
 #include "gromacs/commandline/viewit.h"
@@ -63,9 +66,11 @@
 #include "gromacs/math/vec.h"
 #include "gromacs/mdtypes/inputrec.h"
 #include "gromacs/pbcutil/pbc.h"
+#include "gromacs/selection/nbsearch.h"
 #include "gromacs/topology/ifunc.h"
 #include "gromacs/topology/index.h"
 #include "gromacs/topology/topology.h"
+#include "gromacs/utility/arrayref.h"
 #include "gromacs/utility/arraysize.h"
 #include "gromacs/utility/cstringutil.h"
 #include "gromacs/utility/exceptions.h"
@@ -108,8 +113,6 @@ static const unsigned char c_donorMask    = (1 << 1);
 static const unsigned char c_inGroupMask  = (1 << 2);
 
 
-static const char* grpnames[grNR] = { "0", "1", "I" };
-
 static gmx_bool bDebug = FALSE;
 
 #define HB_NO 0
@@ -126,21 +129,83 @@ static gmx_bool bDebug = FALSE;
 #define ISDON(h) ((h)&c_donorMask)
 #define ISINGRP(h) ((h)&c_inGroupMask)
 
-typedef struct
-{
-    int  nr;
-    int  maxnr;
-    int* atoms;
-} t_ncell;
+typedef int t_icell[grNR];
+typedef int h_id[MAXHYDRO];
 
-typedef struct
+/*! \brief
+ * Frames in which a hydrogen bond or donor-acceptor distance exists.
+ *
+ * The frames are stored as run-length intervals, so the memory use grows
+ * with the number of times a bond is formed instead of with the length
+ * of the trajectory.
+ */
+class HBondExistence
 {
-    t_ncell d[grNR];
-    t_ncell a[grNR];
-} t_gridcell;
+public:
+    //! Half-open interval [first, second) of frames.
+    typedef std::pair<int, int> Interval;
 
-typedef int t_icell[grNR];
-typedef int h_id[MAXHYDRO];
+    //! Marks \p frame as present, frames should be set in non-decreasing order.
+    void set(int frame)
+    {
+        if (!intervals_.empty() && frame <= intervals_.back().second)
+        {
+            intervals_.back().second = std::max(intervals_.back().second, frame + 1);
+        }
+        else
+        {
+            intervals_.emplace_back(frame, frame + 1);
+        }
+    }
+    //! Returns whether \p frame is present.
+    bool isSet(int frame) const
+    {
+        auto interval = std::upper_bound(
+                intervals_.begin(), intervals_.end(), frame,
+                [](int f, const Interval& interval) { return f < interval.second; });
+        return interval != intervals_.end() && interval->first <= frame;
+    }
+    //! Shifts all frames by \p shift.
+    void shift(int shift)
+    {
+        for (auto& interval : intervals_)
+        {
+            interval.first += shift;
+            interval.second += shift;
+        }
+    }
+    //! Adds the frames present in \p other, after shifting them by \p otherShift.
+    void unite(const HBondExistence& other, int otherShift)
+    {
+        std::vector<Interval> all;
+        all.reserve(intervals_.size() + other.intervals_.size());
+        for (const auto& interval : other.intervals_)
+        {
+            all.emplace_back(interval.first + otherShift, interval.second + otherShift);
+        }
+        std::vector<Interval> united;
+        united.reserve(all.size() + intervals_.size());
+        std::merge(intervals_.begin(), intervals_.end(), all.begin(), all.end(),
+                   std::back_inserter(united));
+        intervals_.clear();
+        for (const auto& interval : united)
+        {
+            if (!intervals_.empty() && interval.first <= intervals_.back().second)
+            {
+                intervals_.back().second = std::max(intervals_.back().second, interval.second);
+            }
+            else
+            {
+                intervals_.push_back(interval);
+            }
+        }
+    }
+    //! Returns the intervals in which the bond is present, in increasing order.
+    gmx::ArrayRef<const Interval> intervals() const { return intervals_; }
+
+private:
+    std::vector<Interval> intervals_;
+};
 
 typedef struct
 {
@@ -148,13 +213,13 @@ typedef struct
     /* Has this hbond existed ever? If so as hbDist or hbHB or both.
      * Result is stored as a bitmap (1 = hbDist) || (2 = hbHB)
      */
-    /* Bitmask array which tells whether a hbond is present
-     * at a given time. Either of these may be NULL
+    /* Frames, relative to n0, in which the hbond is present for each
+     * hydrogen. These are empty until the hbond is first found.
      */
-    int            n0;                 /* First frame a HB was found     */
-    int            nframes, maxframes; /* Amount of frames in this hbond */
-    unsigned int** h;
-    unsigned int** g;
+    int                         n0;      /* First frame a HB was found     */
+    int                         nframes; /* Amount of frames in this hbond */
+    std::vector<HBondExistence> h;
+    std::vector<HBondExistence> g;
     /* See Xu and Berne, JPCB 105 (2001), p. 11929. We define the
      * function g(t) = [1-h(t)] H(t) where H(t) is one when the donor-
      * acceptor distance is less than the user-specified distance (typically
@@ -184,7 +249,6 @@ typedef struct
 typedef struct
 {
     gmx_bool bHBmap, bDAnr;
-    int      wordlen;
     /* The following arrays are nframes long */
     int      nframes, max_frames, maxhydro;
     int *    nhb, *ndist;
@@ -211,9 +275,8 @@ static t_hbdata* mk_hbdata(gmx_bool bHBmap, gmx_bool bDAnr, gmx_bool oneHB)
     t_hbdata* hb;
 
     snew(hb, 1);
-    hb->wordlen = 8 * sizeof(unsigned int);
-    hb->bHBmap  = bHBmap;
-    hb->bDAnr   = bDAnr;
+    hb->bHBmap = bHBmap;
+    hb->bDAnr  = bDAnr;
     if (oneHB)
     {
         hb->maxhydro = 1;
@@ -262,90 +325,36 @@ static void add_frames(t_hbdata* hb, int nframes)
     hb->nframes = nframes;
 }
 
-#define OFFSET(frame) ((frame) / 32)
-#define MASK(frame) (1 << ((frame) % 32))
-
-static void _set_hb(unsigned int hbexist[], unsigned int frame, gmx_bool bValue)
-{
-    if (bValue)
-    {
-        hbexist[OFFSET(frame)] |= MASK(frame);
-    }
-    else
-    {
-        hbexist[OFFSET(frame)] &= ~MASK(frame);
-    }
-}
-
-static gmx_bool is_hb(const unsigned int hbexist[], int frame)
-{
-    return (hbexist[OFFSET(frame)] & MASK(frame)) != 0;
-}
-
-static void set_hb(t_hbdata* hb, int id, int ih, int ia, int frame, int ihb)
+static void add_ff(t_hbdata* hbd, int id, int h, int ia, int frame, int ihb)
 {
-    unsigned int* ghptr = nullptr;
+    t_hbond* hb = hbd->hbmap[id][ia];
 
-    if (ihb == hbHB)
-    {
-        ghptr = hb->hbmap[id][ia]->h[ih];
-    }
-    else if (ihb == hbDist)
+    if (hb->h.empty())
     {
-        ghptr = hb->hbmap[id][ia]->g[ih];
+        int maxhydro = std::min(hbd->maxhydro, hbd->d.nhydro[id]);
+
+        hb->n0 = frame;
+        hb->h.resize(maxhydro);
+        hb->g.resize(maxhydro);
     }
     else
     {
-        gmx_fatal(FARGS, "Incomprehensible iValue %d in set_hb", ihb);
+        hb->nframes = frame - hb->n0;
     }
-
-    _set_hb(ghptr, frame - hb->hbmap[id][ia]->n0, TRUE);
-}
-
-static void add_ff(t_hbdata* hbd, int id, int h, int ia, int frame, int ihb)
-{
-    int      i, j, n;
-    t_hbond* hb       = hbd->hbmap[id][ia];
-    int      maxhydro = std::min(hbd->maxhydro, hbd->d.nhydro[id]);
-    int      wlen     = hbd->wordlen;
-    int      delta    = 32 * wlen;
-
-    if (!hb->h[0])
+    if (frame >= 0)
     {
-        hb->n0        = frame;
-        hb->maxframes = delta;
-        for (i = 0; (i < maxhydro); i++)
+        if (ihb == hbHB)
         {
-            snew(hb->h[i], hb->maxframes / wlen);
-            snew(hb->g[i], hb->maxframes / wlen);
+            hb->h[h].set(frame - hb->n0);
         }
-    }
-    else
-    {
-        hb->nframes = frame - hb->n0;
-        /* We need a while loop here because hbonds may be returning
-         * after a long time.
-         */
-        while (hb->nframes >= hb->maxframes)
+        else if (ihb == hbDist)
         {
-            n = hb->maxframes + delta;
-            for (i = 0; (i < maxhydro); i++)
-            {
-                srenew(hb->h[i], n / wlen);
-                srenew(hb->g[i], n / wlen);
-                for (j = hb->maxframes / wlen; (j < n / wlen); j++)
-                {
-                    hb->h[i][j] = 0;
-                    hb->g[i][j] = 0;
-                }
-            }
-
-            hb->maxframes = n;
+            hb->g[h].set(frame - hb->n0);
+        }
+        else
+        {
+            gmx_fatal(FARGS, "Incomprehensible iValue %d in add_ff", ihb);
         }
-    }
-    if (frame >= 0)
-    {
-        set_hb(hbd, id, h, ia, frame, ihb);
     }
 }
 
@@ -516,9 +525,7 @@ add_hbond(t_hbdata* hb, int d, int a, int h, int grpd, int grpa, int frame, gmx_
                 {
                     if (hb->hbmap[id][ia] == nullptr)
                     {
-                        snew(hb->hbmap[id][ia], 1);
-                        snew(hb->hbmap[id][ia]->h, hb->maxhydro);
-                        snew(hb->hbmap[id][ia]->g, hb->maxhydro);
+                        hb->hbmap[id][ia] = new t_hbond();
                     }
                     add_ff(hb, id, k, ia, frame, ihb);
                 }
@@ -878,53 +885,6 @@ static void search_donors(const t_topology* top,
     }
 }
 
-static t_gridcell*** init_grid(gmx_bool bBox, rvec box[], real rcut, ivec ngrid)
-{
-    t_gridcell*** grid;
-    int           i, y, z;
-
-    if (bBox)
-    {
-        for (i = 0; i < DIM; i++)
-        {
-            ngrid[i] = static_cast<int>(box[i][i] / (1.2 * rcut));
-        }
-    }
-
-    if (!bBox || (ngrid[XX] < 3) || (ngrid[YY] < 3) || (ngrid[ZZ] < 3))
-    {
-        for (i = 0; i < DIM; i++)
-        {
-            ngrid[i] = 1;
-        }
-    }
-    else
-    {
-        printf("\nWill do grid-search on %dx%dx%d grid, rcut=%3.8f\n", ngrid[XX], ngrid[YY],
-               ngrid[ZZ], rcut);
-    }
-    if (((ngrid[XX] * ngrid[YY] * ngrid[ZZ]) * sizeof(grid)) > INT_MAX)
-    {
-        gmx_fatal(FARGS,
-                  "Failed to allocate memory for %d x %d x %d grid points, which is larger than "
-                  "the maximum of %zu. "
-                  "You are likely either using a box that is too large (box dimensions are %3.8f "
-                  "nm x%3.8f nm x%3.8f nm) or a cutoff (%3.8f nm) that is too small.",
-                  ngrid[XX], ngrid[YY], ngrid[ZZ], INT_MAX / sizeof(grid), box[XX][XX], box[YY][YY],
-                  box[ZZ][ZZ], rcut);
-    }
-    snew(grid, ngrid[ZZ]);
-    for (z = 0; z < ngrid[ZZ]; z++)
-    {
-        snew((grid)[z], ngrid[YY]);
-        for (y = 0; y < ngrid[YY]; y++)
-        {
-            snew((grid)[z][y], ngrid[XX]);
-        }
-    }
-    return grid;
-}
-
 static void reset_nhbonds(t_donors* ddd)
 {
     int i, j;
@@ -938,330 +898,46 @@ static void reset_nhbonds(t_donors* ddd)
     }
 }
 
-static void pbc_correct_gem(rvec dx, matrix box, const rvec hbox);
-static void pbc_in_gridbox(rvec dx, matrix box);
-
-static void build_grid(t_hbdata*     hb,
-                       rvec          x[],
-                       rvec          xshell,
-                       gmx_bool      bBox,
-                       matrix        box,
-                       rvec          hbox,
-                       real          rcut,
-                       real          rshell,
-                       ivec          ngrid,
-                       t_gridcell*** grid)
-{
-    int      i, m, gr, xi, yi, zi, nr;
-    int*     ad;
-    ivec     grididx;
-    rvec     invdelta, dshell;
-    t_ncell* newgrid;
-    gmx_bool bDoRshell, bInShell;
-    real     rshell2 = 0;
-    int      gx, gy, gz;
-    int      dum = -1;
-
-    bDoRshell = (rshell > 0);
-    rshell2   = gmx::square(rshell);
-    bInShell  = TRUE;
-
-#define DBB(x)           \
-    if (debug && bDebug) \
-    fprintf(debug, "build_grid, line %d, %s = %d\n", __LINE__, #x, x)
-    DBB(dum);
-    for (m = 0; m < DIM; m++)
-    {
-        hbox[m] = box[m][m] * 0.5;
-        if (bBox)
-        {
-            invdelta[m] = ngrid[m] / box[m][m];
-            if (1 / invdelta[m] < rcut)
-            {
-                gmx_fatal(FARGS,
-                          "Your computational box has shrunk too much.\n"
-                          "%s can not handle this situation, sorry.\n",
-                          gmx::getProgramContext().displayName());
-            }
-        }
-        else
-        {
-            invdelta[m] = 0;
-        }
-    }
-    grididx[XX] = 0;
-    grididx[YY] = 0;
-    grididx[ZZ] = 0;
-    DBB(dum);
-    /* resetting atom counts */
-    for (gr = 0; (gr < grNR); gr++)
-    {
-        for (zi = 0; zi < ngrid[ZZ]; zi++)
-        {
-            for (yi = 0; yi < ngrid[YY]; yi++)
-            {
-                for (xi = 0; xi < ngrid[XX]; xi++)
-                {
-                    grid[zi][yi][xi].d[gr].nr = 0;
-                    grid[zi][yi][xi].a[gr].nr = 0;
-                }
-            }
-        }
-        DBB(dum);
-
-        /* put atoms in grid cells */
-        for (int acc = 0; acc < 2; acc++)
-        {
-            if (acc == 1)
-            {
-                nr = hb->a.nra;
-                ad = hb->a.acc;
-            }
-            else
-            {
-                nr = hb->d.nrd;
-                ad = hb->d.don;
-            }
-            DBB(acc);
-            for (i = 0; (i < nr); i++)
-            {
-                /* check if we are inside the shell */
-                /* if bDoRshell=FALSE then bInShell=TRUE always */
-                DBB(i);
-                if (bDoRshell)
-                {
-                    bInShell = TRUE;
-                    rvec_sub(x[ad[i]], xshell, dshell);
-                    if (bBox)
-                    {
-                        gmx_bool bDone = FALSE;
-                        while (!bDone)
-                        {
-                            bDone = TRUE;
-                            for (m = DIM - 1; m >= 0 && bInShell; m--)
-                            {
-                                if (dshell[m] < -hbox[m])
-                                {
-                                    bDone = FALSE;
-                                    rvec_inc(dshell, box[m]);
-                                }
-                                if (dshell[m] >= hbox[m])
-                                {
-                                    bDone = FALSE;
-                                    dshell[m] -= 2 * hbox[m];
-                                }
-                            }
-                        }
-                        for (m = DIM - 1; m >= 0 && bInShell; m--)
-                        {
-                            /* if we're outside the cube, we're outside the sphere also! */
-                            if ((dshell[m] > rshell) || (-dshell[m] > rshell))
-                            {
-                                bInShell = FALSE;
-                            }
-                        }
-                    }
-                    /* if we're inside the cube, check if we're inside the sphere */
-                    if (bInShell)
-                    {
-                        bInShell = norm2(dshell) < rshell2;
-                    }
-                }
-                DBB(i);
-                if (bInShell)
-                {
-                    if (bBox)
-                    {
-                        pbc_in_gridbox(x[ad[i]], box);
-
-                        for (m = DIM - 1; m >= 0; m--)
-                        { /* determine grid index of atom */
-                            grididx[m] = static_cast<int>(x[ad[i]][m] * invdelta[m]);
-                            grididx[m] = (grididx[m] + ngrid[m]) % ngrid[m];
-                        }
-                    }
-
-                    gx = grididx[XX];
-                    gy = grididx[YY];
-                    gz = grididx[ZZ];
-                    range_check(gx, 0, ngrid[XX]);
-                    range_check(gy, 0, ngrid[YY]);
-                    range_check(gz, 0, ngrid[ZZ]);
-                    DBB(gx);
-                    DBB(gy);
-                    DBB(gz);
-                    /* add atom to grid cell */
-                    if (acc == 1)
-                    {
-                        newgrid = &(grid[gz][gy][gx].a[gr]);
-                    }
-                    else
-                    {
-                        newgrid = &(grid[gz][gy][gx].d[gr]);
-                    }
-                    if (newgrid->nr >= newgrid->maxnr)
-                    {
-                        newgrid->maxnr += 10;
-                        DBB(newgrid->maxnr);
-                        srenew(newgrid->atoms, newgrid->maxnr);
-                    }
-                    DBB(newgrid->nr);
-                    newgrid->atoms[newgrid->nr] = ad[i];
-                    newgrid->nr++;
-                }
-            }
-        }
-    }
-}
-
-static void count_da_grid(const ivec ngrid, t_gridcell*** grid, t_icell danr)
-{
-    int gr, xi, yi, zi;
-
-    for (gr = 0; (gr < grNR); gr++)
-    {
-        danr[gr] = 0;
-        for (zi = 0; zi < ngrid[ZZ]; zi++)
-        {
-            for (yi = 0; yi < ngrid[YY]; yi++)
-            {
-                for (xi = 0; xi < ngrid[XX]; xi++)
-                {
-                    danr[gr] += grid[zi][yi][xi].d[gr].nr;
-                }
-            }
-        }
-    }
-}
-
-/* The grid loop.
- * Without a box, the grid is 1x1x1, so all loops are 1 long.
- * With a rectangular box (bTric==FALSE) all loops are 3 long.
- * With a triclinic box all loops are 3 long, except when a cell is
- * located next to one of the box edges which is not parallel to the
- * x/y-plane, in that case all cells in a line or layer are searched.
- * This could be implemented slightly more efficient, but the code
- * would get much more complicated.
+/* Collects the donor and acceptor atoms of each group for the current frame.
+ * With rshell > 0 only atoms within rshell from xshell are used.
  */
-static inline int grid_loop_begin(int n, int x, gmx_bool bTric, gmx_bool bEdge)
-{
-    return ((n == 1) ? x : bTric && bEdge ? 0 : (x - 1));
-}
-static inline int grid_loop_end(int n, int x, gmx_bool bTric, gmx_bool bEdge)
-{
-    return ((n == 1) ? x : bTric && bEdge ? (n - 1) : (x + 1));
-}
-static inline int grid_mod(int j, int n)
+static void select_frame_atoms(const t_hbdata*  hb,
+                               const rvec       x[],
+                               const rvec       xshell,
+                               const t_pbc*     pbc,
+                               real             rshell,
+                               std::vector<int> donors[],
+                               std::vector<int> acceptors[])
 {
-    return (j + n) % (n);
-}
+    const real rshell2 = gmx::square(rshell);
+    auto       inShell = [x, xshell, pbc, rshell, rshell2](int atom) {
+        rvec dshell;
 
-static void dump_grid(FILE* fp, ivec ngrid, t_gridcell*** grid)
-{
-    int gr, x, y, z, sum[grNR];
-
-    fprintf(fp, "grid %dx%dx%d\n", ngrid[XX], ngrid[YY], ngrid[ZZ]);
-    for (gr = 0; gr < grNR; gr++)
-    {
-        sum[gr] = 0;
-        fprintf(fp, "GROUP %d (%s)\n", gr, grpnames[gr]);
-        for (z = 0; z < ngrid[ZZ]; z += 2)
+        if (rshell <= 0)
         {
-            fprintf(fp, "Z=%d,%d\n", z, z + 1);
-            for (y = 0; y < ngrid[YY]; y++)
-            {
-                for (x = 0; x < ngrid[XX]; x++)
-                {
-                    fprintf(fp, "%3d", grid[x][y][z].d[gr].nr);
-                    sum[gr] += grid[z][y][x].d[gr].nr;
-                    fprintf(fp, "%3d", grid[x][y][z].a[gr].nr);
-                    sum[gr] += grid[z][y][x].a[gr].nr;
-                }
-                fprintf(fp, " | ");
-                if ((z + 1) < ngrid[ZZ])
-                {
-                    for (x = 0; x < ngrid[XX]; x++)
-                    {
-                        fprintf(fp, "%3d", grid[z + 1][y][x].d[gr].nr);
-                        sum[gr] += grid[z + 1][y][x].d[gr].nr;
-                        fprintf(fp, "%3d", grid[z + 1][y][x].a[gr].nr);
-                        sum[gr] += grid[z + 1][y][x].a[gr].nr;
-                    }
-                }
-                fprintf(fp, "\n");
-            }
+            return true;
         }
-    }
-    fprintf(fp, "TOTALS:");
-    for (gr = 0; gr < grNR; gr++)
-    {
-        fprintf(fp, " %d=%d", gr, sum[gr]);
-    }
-    fprintf(fp, "\n");
-}
-
-/* New GMX record! 5 * in a row. Congratulations!
- * Sorry, only four left.
- */
-static void free_grid(const ivec ngrid, t_gridcell**** grid)
-{
-    int           y, z;
-    t_gridcell*** g = *grid;
+        pbc_dx_aiuc(pbc, x[atom], xshell, dshell);
+        return norm2(dshell) < rshell2;
+    };
 
-    for (z = 0; z < ngrid[ZZ]; z++)
+    for (int gr = 0; (gr < grNR); gr++)
     {
-        for (y = 0; y < ngrid[YY]; y++)
-        {
-            sfree(g[z][y]);
-        }
-        sfree(g[z]);
+        donors[gr].clear();
+        acceptors[gr].clear();
     }
-    sfree(g);
-    g = nullptr;
-}
-
-static void pbc_correct_gem(rvec dx, matrix box, const rvec hbox)
-{
-    int      m;
-    gmx_bool bDone = FALSE;
-    while (!bDone)
+    for (int i = 0; (i < hb->d.nrd); i++)
     {
-        bDone = TRUE;
-        for (m = DIM - 1; m >= 0; m--)
+        if (inShell(hb->d.don[i]))
         {
-            if (dx[m] < -hbox[m])
-            {
-                bDone = FALSE;
-                rvec_inc(dx, box[m]);
-            }
-            if (dx[m] >= hbox[m])
-            {
-                bDone = FALSE;
-                rvec_dec(dx, box[m]);
-            }
+            donors[hb->d.grp[i]].push_back(hb->d.don[i]);
         }
     }
-}
-
-static void pbc_in_gridbox(rvec dx, matrix box)
-{
-    int      m;
-    gmx_bool bDone = FALSE;
-    while (!bDone)
+    for (int i = 0; (i < hb->a.nra); i++)
     {
-        bDone = TRUE;
-        for (m = DIM - 1; m >= 0; m--)
+        if (inShell(hb->a.acc[i]))
         {
-            if (dx[m] < 0)
-            {
-                bDone = FALSE;
-                rvec_inc(dx, box[m]);
-            }
-            if (dx[m] >= box[m][m])
-            {
-                bDone = FALSE;
-                rvec_dec(dx, box[m]);
-            }
+            acceptors[hb->a.grp[i]].push_back(hb->a.acc[i]);
         }
     }
 }
@@ -1270,27 +946,30 @@ static void pbc_in_gridbox(rvec dx, matrix box)
  * use of second cut-off.
  * - Erik Marklund, June 29, 2006
  */
-static int is_hbond(t_hbdata* hb,
-                    int       grpd,
-                    int       grpa,
-                    int       d,
-                    int       a,
-                    real      rcut,
-                    real      r2cut,
-                    real      ccut,
-                    rvec      x[],
-                    gmx_bool  bBox,
-                    matrix    box,
-                    rvec      hbox,
-                    real*     d_ha,
-                    real*     ang,
-                    gmx_bool  bDA,
-                    int*      hhh,
-                    gmx_bool  bContact,
-                    gmx_bool  bMerge)
+/* The donor-acceptor vector r_da = x[d] - x[a] is passed in corrected for
+ * periodicity, since the neighborhood search has already computed it.
+ */
+static int is_hbond(t_hbdata*    hb,
+                    int          grpd,
+                    int          grpa,
+                    int          d,
+                    int          a,
+                    real         rcut,
+                    real         r2cut,
+                    real         ccut,
+                    const rvec   x[],
+                    gmx_bool     bBox,
+                    const t_pbc* pbc,
+                    const rvec   r_da,
+                    real*        d_ha,
+                    real*        ang,
+                    gmx_bool     bDA,
+                    int*         hhh,
+                    gmx_bool     bContact,
+                    gmx_bool     bMerge)
 {
     int      h, hh, id;
-    rvec     r_da, r_ha, r_dh;
+    rvec     r_ha, r_dh;
     real     rc2, r2c2, rda2, rha2, ca;
     gmx_bool HAinrange = FALSE; /* If !bDA. Needed for returning hbDist in a correct way. */
     gmx_bool daSwap    = FALSE;
@@ -1308,22 +987,10 @@ static int is_hbond(t_hbdata* hb,
     rc2  = rcut * rcut;
     r2c2 = r2cut * r2cut;
 
-    rvec_sub(x[d], x[a], r_da);
-    /* Insert projection code here */
-
-    if (bMerge && d > a && isInterchangable(hb, d, a, grpd, grpa))
-    {
-        /* Then this hbond/contact will be found again, or it has already been found. */
-        /*return hbNo;*/
-    }
-    if (bBox)
-    {
-        if (d > a && bMerge
-            && isInterchangable(hb, d, a, grpd, grpa)) /* acceptor is also a donor and vice versa? */
-        {                                              /* return hbNo; */
-            daSwap = TRUE; /* If so, then their history should be filed with donor and acceptor swapped. */
-        }
-        pbc_correct_gem(r_da, box, hbox);
+    if (bBox && d > a && bMerge
+        && isInterchangable(hb, d, a, grpd, grpa)) /* acceptor is also a donor and vice versa? */
+    {                                              /* return hbNo; */
+        daSwap = TRUE; /* If so, then their history should be filed with donor and acceptor swapped. */
     }
     rda2 = iprod(r_da, r_da);
 
@@ -1355,26 +1022,18 @@ static int is_hbond(t_hbdata* hb,
 
     for (h = 0; (h < hb->d.nhydro[id]); h++)
     {
-        hh   = hb->d.hydro[id][h];
+        hh = hb->d.hydro[id][h];
+        pbc_dx_aiuc(pbc, x[d], x[hh], r_dh);
         rha2 = rc2 + 1;
         if (!bDA)
         {
-            rvec_sub(x[hh], x[a], r_ha);
-            if (bBox)
-            {
-                pbc_correct_gem(r_ha, box, hbox);
-            }
+            /* x[hh] - x[a], using the periodic images of the other two vectors */
+            rvec_sub(r_da, r_dh, r_ha);
             rha2 = iprod(r_ha, r_ha);
         }
 
         if (bDA || (rha2 <= rc2))
         {
-            rvec_sub(x[d], x[hh], r_dh);
-            if (bBox)
-            {
-                pbc_correct_gem(r_dh, box, hbox);
-            }
-
             if (!bDA)
             {
                 HAinrange = TRUE;
@@ -1403,69 +1062,31 @@ static int is_hbond(t_hbdata* hb,
 /* Merging is now done on the fly, so do_merge is most likely obsolete now.
  * Will do some more testing before removing the function entirely.
  * - Erik Marklund, MAY 10 2010 */
-static void do_merge(t_hbdata* hb, int ntmp, bool htmp[], bool gtmp[], t_hbond* hb0, t_hbond* hb1)
+static void do_merge(t_hbond* hb0, t_hbond* hb1)
 {
     /* Here we need to make sure we're treating periodicity in
      * the right way for the geminate recombination kinetics. */
 
-    int m, mm, n00, n01, nn0, nnframes;
+    int n00, n01, nn0;
 
     /* Decide where to start from when merging */
-    n00      = hb0->n0;
-    n01      = hb1->n0;
-    nn0      = std::min(n00, n01);
-    nnframes = std::max(n00 + hb0->nframes, n01 + hb1->nframes) - nn0;
-    /* Initiate tmp arrays */
-    for (m = 0; (m < ntmp); m++)
-    {
-        htmp[m] = false;
-        gtmp[m] = false;
-    }
-    /* Fill tmp arrays with values due to first HB */
-    /* Once again '<' had to be replaced with '<='
-       to catch the last frame in which the hbond
-       appears.
-       - Erik Marklund, June 1, 2006 */
-    for (m = 0; (m <= hb0->nframes); m++)
-    {
-        mm       = m + n00 - nn0;
-        htmp[mm] = is_hb(hb0->h[0], m);
-    }
-    for (m = 0; (m <= hb0->nframes); m++)
-    {
-        mm       = m + n00 - nn0;
-        gtmp[mm] = is_hb(hb0->g[0], m);
-    }
-    /* Next HB */
-    for (m = 0; (m <= hb1->nframes); m++)
-    {
-        mm       = m + n01 - nn0;
-        htmp[mm] = htmp[mm] || is_hb(hb1->h[0], m);
-        gtmp[mm] = gtmp[mm] || is_hb(hb1->g[0], m);
-    }
-    /* Reallocate target array */
-    if (nnframes > hb0->maxframes)
-    {
-        srenew(hb0->h[0], 4 + nnframes / hb->wordlen);
-        srenew(hb0->g[0], 4 + nnframes / hb->wordlen);
-    }
+    n00 = hb0->n0;
+    n01 = hb1->n0;
+    nn0 = std::min(n00, n01);
 
-    /* Copy temp array to target array */
-    for (m = 0; (m <= nnframes); m++)
-    {
-        _set_hb(hb0->h[0], m, htmp[m]);
-        _set_hb(hb0->g[0], m, gtmp[m]);
-    }
+    /* Express both HBs relative to the new first frame and combine them */
+    hb0->h[0].shift(n00 - nn0);
+    hb0->g[0].shift(n00 - nn0);
+    hb0->h[0].unite(hb1->h[0], n01 - nn0);
+    hb0->g[0].unite(hb1->g[0], n01 - nn0);
 
     /* Set scalar variables */
-    hb0->n0        = nn0;
-    hb0->maxframes = nnframes;
+    hb0->n0 = nn0;
 }
 
 static void merge_hb(t_hbdata* hb, gmx_bool bTwo, gmx_bool bContact)
 {
-    int      i, inrnew, indnew, j, ii, jj, id, ia, ntmp;
-    bool *   htmp, *gtmp;
+    int      i, inrnew, indnew, j, ii, jj, id, ia;
     t_hbond *hb0, *hb1;
 
     inrnew = hb->nrhb;
@@ -1474,9 +1095,6 @@ static void merge_hb(t_hbdata* hb, gmx_bool bTwo, gmx_bool bContact)
     /* Check whether donors are also acceptors */
     printf("Merging hbonds with Acceptor and Donor swapped\n");
 
-    ntmp = 2 * hb->max_frames;
-    snew(gtmp, ntmp);
-    snew(htmp, ntmp);
     for (i = 0; (i < hb->d.nrd); i++)
     {
         fprintf(stderr, "\r%d/%d", i + 1, hb->d.nrd);
@@ -1494,7 +1112,7 @@ static void merge_hb(t_hbdata* hb, gmx_bool bTwo, gmx_bool bContact)
                 hb1 = hb->hbmap[jj][ii];
                 if (hb0 && hb1 && ISHB(hb0->history[0]) && ISHB(hb1->history[0]))
                 {
-                    do_merge(hb, ntmp, htmp, gtmp, hb0, hb1);
+                    do_merge(hb0, hb1);
                     if (ISHB(hb1->history[0]))
                     {
                         inrnew--;
@@ -1511,10 +1129,8 @@ static void merge_hb(t_hbdata* hb, gmx_bool bTwo, gmx_bool bContact)
                     {
                         gmx_incons("Neither hydrogen bond nor distance");
                     }
-                    sfree(hb1->h[0]);
-                    sfree(hb1->g[0]);
-                    hb1->h[0]       = nullptr;
-                    hb1->g[0]       = nullptr;
+                    hb1->h.clear();
+                    hb1->g.clear();
                     hb1->history[0] = hbNo;
                 }
             }
@@ -1525,8 +1141,6 @@ static void merge_hb(t_hbdata* hb, gmx_bool bTwo, gmx_bool bContact)
     printf("- Reduced number of distances from %d to %d\n", hb->nrdist, indnew);
     hb->nrhb   = inrnew;
     hb->nrdist = indnew;
-    sfree(gtmp);
-    sfree(htmp);
 }
 
 static void do_nhb_dist(FILE* fp, t_hbdata* hb, real t)
@@ -1558,17 +1172,16 @@ static void do_nhb_dist(FILE* fp, t_hbdata* hb, real t)
 
 static void do_hblife(const char* fn, t_hbdata* hb, gmx_bool bMerge, gmx_bool bContact, const gmx_output_env_t* oenv)
 {
-    FILE*          fp;
-    const char*    leg[] = { "p(t)", "t p(t)" };
-    int*           histo;
-    int            i, j, j0, k, m, nh, ihb, ohb, nhydro, ndump = 0;
-    int            nframes = hb->nframes;
-    unsigned int** h;
-    real           t, x1, dt;
-    double         sum, integral;
-    t_hbond*       hbh;
-
-    snew(h, hb->maxhydro);
+    FILE*                                 fp;
+    const char*                           leg[] = { "p(t)", "t p(t)" };
+    int*                                  histo;
+    int                                   i, j0, k, m, nh, nhydro;
+    int                                   nframes = hb->nframes;
+    std::vector<const HBondExistence*>    h(hb->maxhydro);
+    real                                  t, x1, dt;
+    double                                sum, integral;
+    t_hbond*                              hbh;
+
     snew(histo, nframes + 1);
     /* Total number of hbonds analyzed here */
     for (i = 0; (i < hb->d.nrd); i++)
@@ -1580,9 +1193,9 @@ static void do_hblife(const char* fn, t_hbdata* hb, gmx_bool bMerge, gmx_bool bC
             {
                 if (bMerge)
                 {
-                    if (hbh->h[0])
+                    if (!hbh->h.empty())
                     {
-                        h[0]   = hbh->h[0];
+                        h[0]   = &hbh->h[0];
                         nhydro = 1;
                     }
                     else
@@ -1593,40 +1206,23 @@ static void do_hblife(const char* fn, t_hbdata* hb, gmx_bool bMerge, gmx_bool bC
                 else
                 {
                     nhydro = 0;
-                    for (m = 0; (m < hb->maxhydro); m++)
+                    for (m = 0; (m < gmx::ssize(hbh->h)); m++)
                     {
-                        if (hbh->h[m])
-                        {
-                            h[nhydro++] = bContact ? hbh->g[m] : hbh->h[m];
-                        }
+                        h[nhydro++] = bContact ? &hbh->g[m] : &hbh->h[m];
                     }
                 }
                 for (nh = 0; (nh < nhydro); nh++)
                 {
-                    ohb = 0;
-                    j0  = 0;
-
-                    for (j = 0; (j <= hbh->nframes); j++)
+                    /* Each interval that ends within the frames of this hbond
+                     * is one uninterrupted lifetime.
+                     */
+                    for (const auto& interval : h[nh]->intervals())
                     {
-                        ihb = static_cast<int>(is_hb(h[nh], j));
-                        if (debug && (ndump < 10))
-                        {
-                            fprintf(debug, "%5d  %5d\n", j, ihb);
-                        }
-                        if (ihb != ohb)
+                        if (interval.second <= hbh->nframes)
                         {
-                            if (ihb)
-                            {
-                                j0 = j;
-                            }
-                            else
-                            {
-                                histo[j - j0]++;
-                            }
-                            ohb = ihb;
+                            histo[interval.second - interval.first]++;
                         }
                     }
-                    ndump++;
                 }
             }
         }
@@ -1669,7 +1265,6 @@ static void do_hblife(const char* fn, t_hbdata* hb, gmx_bool bMerge, gmx_bool bC
     printf("Note that the lifetime obtained in this manner is close to useless\n");
     printf("Use the -ac option instead and check the Forward lifetime\n");
     please_cite(stdout, "Spoel2006b");
-    sfree(h);
     sfree(histo);
 }
 
@@ -1698,21 +1293,19 @@ static void dump_ac(t_hbdata* hb, gmx_bool oneHB, int nDump)
                 hbh         = hb->hbmap[i][k];
                 if (oneHB)
                 {
-                    if (hbh->h[0])
+                    if (!hbh->h.empty())
                     {
-                        ihb    = static_cast<int>(is_hb(hbh->h[0], j));
-                        idist  = static_cast<int>(is_hb(hbh->g[0], j));
+                        ihb    = static_cast<int>(hbh->h[0].isSet(j));
+                        idist  = static_cast<int>(hbh->g[0].isSet(j));
                         bPrint = TRUE;
                     }
                 }
                 else
                 {
-                    for (m = 0; (m < hb->maxhydro) && !ihb; m++)
+                    for (m = 0; (m < gmx::ssize(hbh->h)) && !ihb; m++)
                     {
-                        ihb   = static_cast<int>((ihb != 0)
-                                               || (((hbh->h[m]) != nullptr) && is_hb(hbh->h[m], j)));
-                        idist = static_cast<int>((idist != 0)
-                                                 || (((hbh->g[m]) != nullptr) && is_hb(hbh->g[m], j)));
+                        ihb   = static_cast<int>((ihb != 0) || hbh->h[m].isSet(j));
+                        idist = static_cast<int>((idist != 0) || hbh->g[m].isSet(j));
                     }
                     /* This is not correct! */
                     /* What isn't correct? -Erik M */
@@ -1981,11 +1574,11 @@ static void do_hbac(const char*             fn,
     real *      ct, tail, tail2, dtail, *cct;
     const real  tol     = 1e-3;
     int         nframes = hb->nframes;
-    unsigned int **h = nullptr, **g = nullptr;
-    int            nh, nhbonds, nhydro;
-    t_hbond*       hbh;
-    int            acType;
-    int*           dondata = nullptr;
+    std::vector<const HBondExistence*> h(hb->maxhydro), g(hb->maxhydro);
+    int                                nh, nhbonds, nhydro;
+    t_hbond*                           hbh;
+    int                                acType;
+    int*                               dondata = nullptr;
 
     enum
     {
@@ -2013,12 +1606,6 @@ static void do_hbac(const char*             fn,
 
     nn = nframes / 2;
 
-    if (acType != AC_NN || bOMP)
-    {
-        snew(h, hb->maxhydro);
-        snew(g, hb->maxhydro);
-    }
-
     /* Dump hbonds for debugging */
     dump_ac(hb, bMerge || bContact, nDump);
 
@@ -2076,8 +1663,8 @@ static void do_hbac(const char*             fn,
                 {
                     if (ISHB(hbh->history[0]))
                     {
-                        h[0]   = hbh->h[0];
-                        g[0]   = hbh->g[0];
+                        h[0]   = &hbh->h[0];
+                        g[0]   = &hbh->g[0];
                         nhydro = 1;
                     }
                 }
@@ -2087,8 +1674,8 @@ static void do_hbac(const char*             fn,
                     {
                         if (bContact ? ISDIST(hbh->history[m]) : ISHB(hbh->history[m]))
                         {
-                            g[nhydro] = hbh->g[m];
-                            h[nhydro] = hbh->h[m];
+                            g[nhydro] = &hbh->g[m];
+                            h[nhydro] = &hbh->h[m];
                             nhydro++;
                         }
                     }
@@ -2108,8 +1695,8 @@ static void do_hbac(const char*             fn,
                     {
                         if (j <= nf)
                         {
-                            ihb   = static_cast<int>(is_hb(h[nh], j));
-                            idist = static_cast<int>(is_hb(g[nh], j));
+                            ihb   = static_cast<int>(h[nh]->isSet(j));
+                            idist = static_cast<int>(g[nh]->isSet(j));
                         }
                         else
                         {
@@ -2154,8 +1741,6 @@ static void do_hbac(const char*             fn,
         }
     }
     fprintf(stderr, "\n");
-    sfree(h);
-    sfree(g);
     normalizeACF(ct, ght, static_cast<int>(nhb), nn);
 
     /* Determine tail value for statistics */
@@ -2269,7 +1854,8 @@ static void analyse_donor_properties(FILE* fp, t_hbdata* hb, int nframes, real t
             nhtot++;
             for (j = 0; (j < hb->a.nra) && (nb == 0); j++)
             {
-                if (hb->hbmap[i][j] && hb->hbmap[i][j]->h[k] && is_hb(hb->hbmap[i][j]->h[k], nframes))
+                const t_hbond* hbh = hb->hbmap[i][j];
+                if (hbh && k < gmx::ssize(hbh->h) && hbh->h[k].isSet(nframes - hbh->n0))
                 {
                     nb = 1;
                 }
@@ -2604,32 +2190,34 @@ int gmx_hbond(int argc, char* argv[])
     int*              isize;
     char**            grpnames;
     int**             index;
-    rvec *            x, hbox;
+    rvec*             x;
     matrix            box;
+    t_pbc             pbc;
     real              t, ccut, dist = 0.0, ang = 0.0;
     double            max_nhb, aver_nhb, aver_dist;
     int               h = 0, i = 0, j, k = 0, ogrp, nsel;
-    int               xi = 0, yi, zi, ai;
-    int               xj, yj, zj, aj, xjj, yjj, zjj;
-    gmx_bool          bSelected, bHBmap, bStop, bTwo, bBox, bTric;
+    int               ai;
+    gmx_bool          bSelected, bHBmap, bStop, bTwo, bBox;
     int *             adist, *rdist;
     int               grp, nabin, nrbin, resdist, ihb;
     char**            leg;
     t_hbdata*         hb;
     FILE *            fp, *fpnhb = nullptr, *donor_properties = nullptr;
-    t_gridcell***     grid;
-    t_ncell *         icell, *jcell;
-    ivec              ngrid;
     unsigned char*    datable;
     gmx_output_env_t* oenv;
     int               ii, hh, actual_nThreads;
     int               threadNr = 0;
     gmx_bool          bParallel;
-    gmx_bool          bEdge_yjj, bEdge_xjj;
 
     t_hbdata** p_hb    = nullptr; /* one per thread, then merge after the frame loop */
     int **     p_adist = nullptr, **p_rdist = nullptr; /* a histogram for each thread. */
 
+    /* Donors and acceptors of each group (within the shell) in the current
+     * frame, and a neighborhood search over the acceptors of each group. */
+    std::vector<int>                frameDonors[grNR], frameAcceptors[grNR];
+    gmx::AnalysisNeighborhood       nb;
+    gmx::AnalysisNeighborhoodSearch acceptorSearch[grNR];
+
     const bool bOMP = GMX_OPENMP;
 
     npargs = asize(pa);
@@ -2848,8 +2436,10 @@ int gmx_hbond(int argc, char* argv[])
         gmx_fatal(FARGS, "Topology (%d atoms) does not match trajectory (%d atoms)", top.atoms.nr, natoms);
     }
 
-    bBox  = (ir->pbcType != PbcType::No);
-    grid  = init_grid(bBox, box, (rcut > r2cut) ? rcut : r2cut, ngrid);
+    bBox = (ir->pbcType != PbcType::No);
+    /* With -da we search for donor-acceptor pairs, otherwise we search
+     * for acceptors within rcut from any of the hydrogens of a donor. */
+    nb.setCutoff((bContact && r2cut > rcut) ? r2cut : rcut);
     nabin = static_cast<int>(acut / abin);
     nrbin = static_cast<int>(rcut / rbin);
     snew(adist, nabin + 1);
@@ -2877,7 +2467,7 @@ int gmx_hbond(int argc, char* argv[])
             actual_nThreads = std::min((nThreads <= 0) ? INT_MAX : nThreads, gmx_omp_get_max_threads());
 
             gmx_omp_set_num_threads(actual_nThreads);
-            printf("Frame loop parallelized with OpenMP using %i threads.\n", actual_nThreads);
+            printf("Donor loop parallelized with OpenMP using %i threads.\n", actual_nThreads);
             fflush(stdout);
         }
         else
@@ -2903,7 +2493,6 @@ int gmx_hbond(int argc, char* argv[])
 
             p_hb[i]->bHBmap   = hb->bHBmap;
             p_hb[i]->bDAnr    = hb->bDAnr;
-            p_hb[i]->wordlen  = hb->wordlen;
             p_hb[i]->nframes  = hb->nframes;
             p_hb[i]->maxhydro = hb->maxhydro;
             p_hb[i]->danr     = hb->danr;
@@ -2920,19 +2509,18 @@ int gmx_hbond(int argc, char* argv[])
     /* Make a thread pool here,
      * instead of forking anew at every frame. */
 
-#pragma omp parallel firstprivate(i) private(                                                   \
-        j, h, ii, hh, xi, yi, zi, xj, yj, zj, threadNr, dist, ang, icell, jcell, grp, ogrp, ai, \
-        aj, xjj, yjj, zjj, ihb, resdist, k, bTric, bEdge_xjj, bEdge_yjj) default(shared)
+#pragma omp parallel firstprivate(i) private(j, h, ii, hh, threadNr, dist, ang, grp, ogrp, ai, ihb, \
+                                             resdist, k) default(shared)
     { /* Start of parallel region */
+        std::vector<gmx::AnalysisNeighborhoodPair> pairs;
+
+        h = NOTSET;
         if (bOMP)
         {
             threadNr = gmx_omp_get_thread_num();
         }
         do
         {
-
-            bTric = bBox && TRICLINIC(box);
-
             if (bOMP)
             {
                 try
@@ -2945,21 +2533,31 @@ int gmx_hbond(int argc, char* argv[])
             {
                 try
                 {
-                    build_grid(hb, x, x[shatom], bBox, box, hbox, (rcut > r2cut) ? rcut : r2cut,
-                               rshell, ngrid, grid);
-                    reset_nhbonds(&(hb->d));
-
-                    if (debug && bDebug)
+                    set_pbc(&pbc, ir->pbcType, box);
+                    select_frame_atoms(hb, x, x[shatom], &pbc, rshell, frameDonors, frameAcceptors);
+                    for (grp = gr0; (grp <= (bTwo ? gr1 : gr0)); grp++)
                     {
-                        dump_grid(debug, ngrid, grid);
+                        acceptorSearch[grp].reset();
+                        acceptorSearch[grp] = nb.initSearch(
+                                &pbc, gmx::AnalysisNeighborhoodPositions(x, natoms).indexed(frameAcceptors[grp]));
                     }
+                    reset_nhbonds(&(hb->d));
 
                     add_frames(hb, nframes);
                     init_hbframe(hb, nframes, output_env_conv_time(oenv, t));
 
                     if (hb->bDAnr)
                     {
-                        count_da_grid(ngrid, grid, hb->danr[nframes]);
+                        /* All donors within the shell are counted for each group */
+                        int ndon = 0;
+                        for (const auto& donors : frameDonors)
+                        {
+                            ndon += donors.size();
+                        }
+                        for (grp = 0; (grp < grNR); grp++)
+                        {
+                            hb->danr[nframes][grp] = ndon;
+                        }
                     }
                 }
                 GMX_CATCH_ALL_AND_EXIT_WITH_FATAL_ERROR
@@ -2984,8 +2582,10 @@ int gmx_hbond(int argc, char* argv[])
                             int dd       = index[0][i];
                             int aa       = index[0][i + 2];
                             /* int */ hh = index[0][i + 1];
-                            ihb = is_hbond(hb, ii, ii, dd, aa, rcut, r2cut, ccut, x, bBox, box,
-                                           hbox, &dist, &ang, bDA, &h, bContact, bMerge);
+                            rvec r_da;
+                            pbc_dx_aiuc(&pbc, x[dd], x[aa], r_da);
+                            ihb = is_hbond(hb, ii, ii, dd, aa, rcut, r2cut, ccut, x, bBox, &pbc,
+                                           r_da, &dist, &ang, bDA, &h, bContact, bMerge);
 
                             if (ihb)
                             {
@@ -3000,130 +2600,115 @@ int gmx_hbond(int argc, char* argv[])
             }     /* if (bSelected) */
             else
             {
-                /* The outer grid loop will have to do for now. */
-#pragma omp for schedule(dynamic)
-                for (xi = 0; xi < ngrid[XX]; xi++)
+                /* loop over donor groups gr0 (always) and gr1 (if necessary) */
+                for (grp = gr0; (grp <= (bTwo ? gr1 : gr0)); grp++)
                 {
-                    try
+                    if (bTwo)
+                    {
+                        ogrp = 1 - grp;
+                    }
+                    else
                     {
-                        for (yi = 0; (yi < ngrid[YY]); yi++)
+                        ogrp = grp;
+                    }
+                    const std::vector<int>& donors    = frameDonors[grp];
+                    const std::vector<int>& acceptors = frameAcceptors[ogrp];
+
+                    /* loop over all donors from group (grp) */
+#pragma omp for schedule(dynamic, 16)
+                    for (ai = 0; ai < gmx::ssize(donors); ai++)
+                    {
+                        try
                         {
-                            for (zi = 0; (zi < ngrid[ZZ]); zi++)
+                            i = donors[ai];
+                            if (bDA)
                             {
+                                acceptorSearch[ogrp].findAllPairs(x[i], &pairs);
+                            }
+                            else
+                            {
+                                /* An acceptor may be close to several hydrogens of this donor */
+                                int id = hb->d.dptr[i];
+                                acceptorSearch[ogrp].findAllPairs(
+                                        gmx::AnalysisNeighborhoodPositions(x, natoms).indexed(
+                                                gmx::arrayRefFromArray(hb->d.hydro[id], hb->d.nhydro[id])),
+                                        &pairs);
+                                std::sort(pairs.begin(), pairs.end(),
+                                          [](const gmx::AnalysisNeighborhoodPair& a,
+                                             const gmx::AnalysisNeighborhoodPair& b) {
+                                              return a.refIndex() < b.refIndex();
+                                          });
+                                pairs.erase(std::unique(pairs.begin(), pairs.end(),
+                                                        [](const gmx::AnalysisNeighborhoodPair& a,
+                                                           const gmx::AnalysisNeighborhoodPair& b) {
+                                                            return a.refIndex() == b.refIndex();
+                                                        }),
+                                            pairs.end());
+                            }
+                            /* loop over acceptor atoms from other group (ogrp) within the cut-off */
+                            for (const auto& pair : pairs)
+                            {
+                                j = acceptors[pair.refIndex()];
 
-                                /* loop over donor groups gr0 (always) and gr1 (if necessary) */
-                                for (grp = gr0; (grp <= (bTwo ? gr1 : gr0)); grp++)
+                                rvec r_da;
+                                if (bDA)
+                                {
+                                    /* The pair vector points from the donor to the acceptor */
+                                    svmul(-1, pair.dx(), r_da);
+                                }
+                                else
                                 {
-                                    icell = &(grid[zi][yi][xi].d[grp]);
+                                    pbc_dx_aiuc(&pbc, x[i], x[j], r_da);
+                                }
 
-                                    if (bTwo)
-                                    {
-                                        ogrp = 1 - grp;
-                                    }
-                                    else
-                                    {
-                                        ogrp = grp;
-                                    }
+                                /* check if this once was a h-bond */
+                                ihb = is_hbond(__HBDATA, grp, ogrp, i, j, rcut, r2cut, ccut, x,
+                                               bBox, &pbc, r_da, &dist, &ang, bDA, &h, bContact, bMerge);
 
-                                    /* loop over all hydrogen atoms from group (grp)
-                                     * in this gridcell (icell)
-                                     */
-                                    for (ai = 0; (ai < icell->nr); ai++)
-                                    {
-                                        i = icell->atoms[ai];
+                                if (ihb)
+                                {
+                                    /* add to index if not already there */
+                                    /* Add a hbond */
+                                    add_hbond(__HBDATA, i, j, h, grp, ogrp, nframes, bMerge, ihb, bContact);
 
-                                        /* loop over all adjacent gridcells (xj,yj,zj) */
-                                        for (zjj = grid_loop_begin(ngrid[ZZ], zi, bTric, FALSE);
-                                             zjj <= grid_loop_end(ngrid[ZZ], zi, bTric, FALSE); zjj++)
+                                    /* make angle and distance distributions */
+                                    if (ihb == hbHB && !bContact)
+                                    {
+                                        if (dist > rcut)
                                         {
-                                            zj        = grid_mod(zjj, ngrid[ZZ]);
-                                            bEdge_yjj = (zj == 0) || (zj == ngrid[ZZ] - 1);
-                                            for (yjj = grid_loop_begin(ngrid[YY], yi, bTric, bEdge_yjj);
-                                                 yjj <= grid_loop_end(ngrid[YY], yi, bTric, bEdge_yjj);
-                                                 yjj++)
+                                            gmx_fatal(FARGS,
+                                                      "distance is higher than what is allowed for "
+                                                      "an hbond: %f",
+                                                      dist);
+                                        }
+                                        ang *= RAD2DEG;
+                                        __ADIST[static_cast<int>(ang / abin)]++;
+                                        __RDIST[static_cast<int>(dist / rbin)]++;
+                                        if (!bTwo)
+                                        {
+                                            if (donor_index(&hb->d, grp, i) == NOTSET)
+                                            {
+                                                gmx_fatal(FARGS, "Invalid donor %d", i);
+                                            }
+                                            if (acceptor_index(&hb->a, ogrp, j) == NOTSET)
+                                            {
+                                                gmx_fatal(FARGS, "Invalid acceptor %d", j);
+                                            }
+                                            resdist = std::abs(top.atoms.atom[i].resind
+                                                               - top.atoms.atom[j].resind);
+                                            if (resdist >= max_hx)
                                             {
-                                                yj        = grid_mod(yjj, ngrid[YY]);
-                                                bEdge_xjj = (yj == 0) || (yj == ngrid[YY] - 1)
-                                                            || (zj == 0) || (zj == ngrid[ZZ] - 1);
-                                                for (xjj = grid_loop_begin(ngrid[XX], xi, bTric, bEdge_xjj);
-                                                     xjj <= grid_loop_end(ngrid[XX], xi, bTric, bEdge_xjj);
-                                                     xjj++)
-                                                {
-                                                    xj    = grid_mod(xjj, ngrid[XX]);
-                                                    jcell = &(grid[zj][yj][xj].a[ogrp]);
-                                                    /* loop over acceptor atoms from other group
-                                                     * (ogrp) in this adjacent gridcell (jcell)
-                                                     */
-                                                    for (aj = 0; (aj < jcell->nr); aj++)
-                                                    {
-                                                        j = jcell->atoms[aj];
-
-                                                        /* check if this once was a h-bond */
-                                                        ihb = is_hbond(__HBDATA, grp, ogrp, i, j,
-                                                                       rcut, r2cut, ccut, x, bBox,
-                                                                       box, hbox, &dist, &ang, bDA,
-                                                                       &h, bContact, bMerge);
-
-                                                        if (ihb)
-                                                        {
-                                                            /* add to index if not already there */
-                                                            /* Add a hbond */
-                                                            add_hbond(__HBDATA, i, j, h, grp, ogrp,
-                                                                      nframes, bMerge, ihb, bContact);
-
-                                                            /* make angle and distance distributions */
-                                                            if (ihb == hbHB && !bContact)
-                                                            {
-                                                                if (dist > rcut)
-                                                                {
-                                                                    gmx_fatal(
-                                                                            FARGS,
-                                                                            "distance is higher "
-                                                                            "than what is allowed "
-                                                                            "for an hbond: %f",
-                                                                            dist);
-                                                                }
-                                                                ang *= RAD2DEG;
-                                                                __ADIST[static_cast<int>(ang / abin)]++;
-                                                                __RDIST[static_cast<int>(dist / rbin)]++;
-                                                                if (!bTwo)
-                                                                {
-                                                                    if (donor_index(&hb->d, grp, i) == NOTSET)
-                                                                    {
-                                                                        gmx_fatal(
-                                                                                FARGS,
-                                                                                "Invalid donor %d", i);
-                                                                    }
-                                                                    if (acceptor_index(&hb->a, ogrp, j)
-                                                                        == NOTSET)
-                                                                    {
-                                                                        gmx_fatal(FARGS,
-                                                                                  "Invalid "
-                                                                                  "acceptor %d",
-                                                                                  j);
-                                                                    }
-                                                                    resdist = std::abs(
-                                                                            top.atoms.atom[i].resind
-                                                                            - top.atoms.atom[j].resind);
-                                                                    if (resdist >= max_hx)
-                                                                    {
-                                                                        resdist = max_hx - 1;
-                                                                    }
-                                                                    __HBDATA->nhx[nframes][resdist]++;
-                                                                }
-                                                            }
-                                                        }
-                                                    } /* for aj  */
-                                                }     /* for xjj */
-                                            }         /* for yjj */
-                                        }             /* for zjj */
-                                    }                 /* for ai  */
-                                }                     /* for grp */
-                            }                         /* for xi,yi,zi */
+                                                resdist = max_hx - 1;
+                                            }
+                                            __HBDATA->nhx[nframes][resdist]++;
+                                        }
+                                    }
+                                }
+                            } /* for pair */
                         }
-                    }
-                    GMX_CATCH_ALL_AND_EXIT_WITH_FATAL_ERROR
-                }
+                        GMX_CATCH_ALL_AND_EXIT_WITH_FATAL_ERROR
+                    } /* for ai  */
+                }     /* for grp */
             } /* if (bSelected) {...} else */
 
 
@@ -3243,8 +2828,6 @@ int gmx_hbond(int argc, char* argv[])
                   "Cannot calculate autocorrelation of life times with less than two frames");
     }
 
-    free_grid(ngrid, &grid);
-
     close_trx(status);
 
     if (donor_properties)
@@ -3432,7 +3015,7 @@ int gmx_hbond(int argc, char* argv[])
                                         int nn0 = hb->hbmap[id][ia]->n0;
                                         range_check(y, 0, mat.ny);
                                         mat.matrix(x + nn0, y) = static_cast<t_matelmt>(
-                                                is_hb(hb->hbmap[id][ia]->h[hh], x));
+                                                hb->hbmap[id][ia]->h[hh].isSet(x));
                                     }
                                     y++;
                                 }
@@ -3440,6 +3023,7 @@ int gmx_hbond(int argc, char* argv[])
                         }
                     }
                 }
+                mat.axis_x.resize(mat.nx);
                 std::copy(hb->time, hb->time + mat.nx, mat.axis_x.begin());
                 mat.axis_y.resize(mat.ny);
                 std::iota(mat.axis_y.begin(), mat.axis_y.end(), 0);
@@ -3449,11 +3033,11 @@ int gmx_hbond(int argc, char* argv[])
                 mat.label_y = bContact ? "Contact Index" : "Hydrogen Bond Index";
                 mat.bDiscrete = true;
                 mat.map.resize(2);
-                for (auto& m : mat.map)
+                for (gmx::index m = 0; m < gmx::ssize(mat.map); m++)
                 {
-                    m.code.c1 = hbmap[i];
-                    m.desc    = hbdesc[i];
-                    m.rgb     = hbrgb[i];
+                    mat.map[m].code.c1 = hbmap[m];
+                    mat.map[m].desc    = hbdesc[m];
+                    mat.map[m].rgb     = hbrgb[m];
                 }
                 fp = opt2FILE("-hbm", NFILE, fnm, "w");
                 write_xpm_m(fp, mat);
@@ -40,16 +40,19 @@
 #include <cmath>
 #include <cstring>
 
+#include <algorithm>
 #include <memory>
 
 #include "gromacs/commandline/pargs.h"
 #include "gromacs/commandline/viewit.h"
+#include "gromacs/fft/fft.h"
 #include "gromacs/fileio/confio.h"
 #include "gromacs/fileio/trxio.h"
 #include "gromacs/fileio/xvgr.h"
 #include "gromacs/gmxana/gmx_ana.h"
 #include "gromacs/gmxana/gstat.h"
 #include "gromacs/math/functions.h"
+#include "gromacs/math/gmxcomplex.h"
 #include "gromacs/math/utilities.h"
 #include "gromacs/math/vec.h"
 #include "gromacs/math/vectypes.h"
@@ -57,10 +60,13 @@
 #include "gromacs/statistics/statistics.h"
 #include "gromacs/topology/index.h"
 #include "gromacs/topology/topology.h"
+#include "gromacs/utility/arrayref.h"
 #include "gromacs/utility/arraysize.h"
+#include "gromacs/utility/exceptions.h"
 #include "gromacs/utility/fatalerror.h"
 #include "gromacs/utility/futil.h"
 #include "gromacs/utility/gmxassert.h"
+#include "gromacs/utility/gmxomp.h"
 #include "gromacs/utility/smalloc.h"
 
 static constexpr double diffusionConversionFactor = 1000.0; /* Convert nm^2/ps to 10e-5 cm^2/s */
@@ -97,6 +103,7 @@ struct t_corr
     gmx_stats_t**                       lsq;  /* fitting stats for individual molecule msds */
     msd_type                            type; /* the type of msd to calculate (lateral, etc.)*/
     int                                 axis; /* the axis along which to calculate */
+    gmx_bool                            bFFT; /* use every frame as a time origin (FFT algorithm) */
     int                                 ncoords;
     int                                 nrestart; /* number of restart points */
     int                                 nmol;     /* number of molecules (for bMol) */
@@ -127,6 +134,7 @@ struct t_corr
         lsq(nullptr),
         type(static_cast<msd_type>(type)),
         axis(axis),
+        bFFT(FALSE),
         ncoords(0),
         nrestart(0),
         nmol(nrmol),
@@ -207,8 +215,16 @@ static void corr_print(t_corr*                 curr,
     out = xvgropen(fn, title, output_env_get_xvgr_tlabel(oenv), yaxis, oenv);
     if (DD)
     {
-        fprintf(out, "# MSD gathered over %g %s with %d restarts\n", msdtime,
-                output_env_get_time_unit(oenv).c_str(), curr->nrestart);
+        if (curr->bFFT)
+        {
+            fprintf(out, "# MSD gathered over %g %s using all frames as time origins\n", msdtime,
+                    output_env_get_time_unit(oenv).c_str());
+        }
+        else
+        {
+            fprintf(out, "# MSD gathered over %g %s with %d restarts\n", msdtime,
+                    output_env_get_time_unit(oenv).c_str(), curr->nrestart);
+        }
         fprintf(out, "# Diffusion constants fitted from time %g to %g %s\n", beginfit, endfit,
                 output_env_get_time_unit(oenv).c_str());
         for (i = 0; i < curr->ngrp; i++)
@@ -651,9 +667,262 @@ static void printmol(t_corr*                 curr,
     }
 }
 
+/* Storage for the FFT-based MSD calculation, which uses every frame as a
+ * time origin. To limit memory usage, the trajectory can be processed in
+ * several passes, each of which stores the positions of a range of the
+ * atoms (or molecules) in each group for all frames.
+ */
+struct t_msd_fft
+{
+    int chunkStart; /* first atom/molecule (within each group) stored in this pass */
+    int chunkEnd;   /* end of the range of atoms/molecules stored in this pass */
+    std::vector<std::vector<std::vector<gmx::RVec>>> x; /* positions, indexed as [group][atom -
+                                                           chunkStart][frame] */
+    std::vector<std::vector<double>> msd;    /* weighted sum of MSDs, [group][frame] */
+    std::vector<std::vector<double>> tensor; /* weighted sum of MSD tensors, [group][frame*DIM*DIM] */
+    std::vector<double>              weight; /* sum of weights, [group] */
+};
+
+/* store the positions of the atoms/molecules in the current chunk for the FFT-based MSD */
+static void store_fft_positions(t_msd_fft* fft, gmx_bool bMol, int ngrp, const int gnx[], int* index[], rvec xc[], const rvec com)
+{
+    for (int g = 0; g < ngrp; g++)
+    {
+        const int end = std::min(gnx[g], fft->chunkEnd);
+        for (int i = fft->chunkStart; i < end; i++)
+        {
+            const int ind = bMol ? i : index[g][i];
+            rvec      x;
+            rvec_sub(xc[ind], com, x);
+            fft->x[g][i - fft->chunkStart].emplace_back(x);
+        }
+    }
+}
+
+/* returns an FFT length of at least n that only has small prime factors */
+static int fft_msd_size(int n)
+{
+    for (;; n++)
+    {
+        int m = n;
+        for (int f : { 2, 3, 5, 7 })
+        {
+            while (m % f == 0)
+            {
+                m /= f;
+            }
+        }
+        if (m == 1 && n % 2 == 0)
+        {
+            return n;
+        }
+    }
+}
+
+/* Computes the MSD of one atom or molecule for all lags, using every frame as
+ * a time origin. For each pair of dimensions, the average over the origins is
+ * obtained as S1(m) - S2(m), where S1 is a running sum of the products of the
+ * coordinates and S2 is their (symmetrized) correlation function, computed
+ * with FFTs on a zero-padded array. The average position is subtracted first
+ * to avoid losing precision in the subtraction.
+ * msd gets the MSD summed over the dimensions in bDim, and tensor (if not
+ * empty) the lower triangle of the MSD tensor.
+ */
+static void fft_msd_one(gmx_fft_t                      fft,
+                        int                            nfft,
+                        gmx::ArrayRef<const gmx::RVec> x,
+                        const gmx_bool                 bDim[],
+                        std::vector<real>*             work,
+                        std::vector<t_complex>         transform[],
+                        std::vector<t_complex>*        product,
+                        std::vector<double>*           msd,
+                        std::vector<double>*           tensor)
+{
+    const int  nframes = x.size();
+    const bool bTen    = !tensor->empty();
+    dvec       average;
+
+    clear_dvec(average);
+    for (int d = 0; d < DIM; d++)
+    {
+        if (!bDim[d])
+        {
+            continue;
+        }
+        for (int k = 0; k < nframes; k++)
+        {
+            average[d] += x[k][d];
+        }
+        average[d] /= nframes;
+        for (int k = 0; k < nframes; k++)
+        {
+            (*work)[k] = x[k][d] - average[d];
+        }
+        std::fill(work->begin() + nframes, work->end(), 0);
+        gmx_fft_1d_real(fft, GMX_FFT_REAL_TO_COMPLEX, work->data(), transform[d].data());
+    }
+
+    std::fill(msd->begin(), msd->end(), 0);
+    for (int a = 0; a < DIM; a++)
+    {
+        for (int b = 0; b <= a; b++)
+        {
+            if (!bDim[a] || !bDim[b] || (a != b && !bTen))
+            {
+                continue;
+            }
+            for (size_t j = 0; j < product->size(); j++)
+            {
+                const t_complex& fa = transform[a][j];
+                const t_complex& fb = transform[b][j];
+                (*product)[j].re    = 2 * (fa.re * fb.re + fa.im * fb.im);
+                (*product)[j].im    = 0;
+            }
+            gmx_fft_1d_real(fft, GMX_FFT_COMPLEX_TO_REAL, product->data(), work->data());
+
+            auto selfProduct = [&x, &average, a, b](int k) {
+                return (x[k][a] - average[a]) * (x[k][b] - average[b]);
+            };
+            double selfSum = 0;
+            for (int k = 0; k < nframes; k++)
+            {
+                selfSum += 2 * selfProduct(k);
+            }
+            for (int m = 0; m < nframes; m++)
+            {
+                if (m > 0)
+                {
+                    selfSum -= selfProduct(m - 1) + selfProduct(nframes - m);
+                }
+                const double value = (selfSum - (*work)[m] / nfft) / (nframes - m);
+                if (a == b)
+                {
+                    (*msd)[m] += value;
+                }
+                if (bTen)
+                {
+                    (*tensor)[m * DIM * DIM + a * DIM + b] = value;
+                }
+            }
+        }
+    }
+}
+
+/* Accumulates the MSD of the atoms/molecules stored in fft, threaded over
+ * the atoms/molecules. Each thread accumulates separately and the results
+ * are summed in thread order, so that the result is reproducible.
+ */
+static void calc_fft_msd(t_corr* curr, t_msd_fft* fft, gmx_bool bMol, const int gnx[], int* index[], gmx_bool bTen)
+{
+    const int nframes = curr->nframes;
+    const int nfft    = fft_msd_size(2 * nframes);
+    gmx_bool  bDim[DIM];
+    for (int d = 0; d < DIM; d++)
+    {
+        switch (curr->type)
+        {
+            case X:
+            case Y:
+            case Z: bDim[d] = (d == curr->type - X); break;
+            case LATERAL: bDim[d] = (d != curr->axis); break;
+            default: bDim[d] = TRUE; break;
+        }
+    }
+
+    const int nthreads = gmx_omp_get_max_threads();
+    std::vector<std::vector<std::vector<double>>> threadMsd(
+            nthreads, std::vector<std::vector<double>>(curr->ngrp, std::vector<double>(nframes, 0.0)));
+    std::vector<std::vector<std::vector<double>>> threadTensor(
+            nthreads, std::vector<std::vector<double>>(
+                              curr->ngrp, std::vector<double>(bTen ? nframes * DIM * DIM : 0, 0.0)));
+    std::vector<std::vector<double>> threadWeight(nthreads, std::vector<double>(curr->ngrp, 0.0));
+    for (int g = 0; g < curr->ngrp; g++)
+    {
+        const int ncoords = std::max(0, std::min(gnx[g], fft->chunkEnd) - fft->chunkStart);
+#pragma omp parallel num_threads(nthreads)
+        {
+            try
+            {
+                const int              thread    = gmx_omp_get_thread_num();
+                std::vector<double>&   sum       = threadMsd[thread][g];
+                std::vector<double>&   tensorSum = threadTensor[thread][g];
+                double&                weightSum = threadWeight[thread][g];
+                std::vector<real>      work(nfft);
+                std::vector<t_complex> transform[DIM];
+                std::vector<t_complex> product(nfft / 2 + 1);
+                std::vector<double>    msd(nframes);
+                std::vector<double>    tensor(bTen ? nframes * DIM * DIM : 0);
+                for (auto& t : transform)
+                {
+                    t.resize(nfft / 2 + 1);
+                }
+                gmx_fft_t fftSetup;
+                if (int fftcode = gmx_fft_init_1d_real(&fftSetup, nfft, GMX_FFT_FLAG_NONE))
+                {
+                    gmx_fatal(FARGS, "gmx_fft_init_1d_real returned %d", fftcode);
+                }
+#pragma omp for schedule(static)
+                for (int i = 0; i < ncoords; i++)
+                {
+                    const int  mol = fft->chunkStart + i;
+                    const int  ix  = bMol ? mol : index[g][mol];
+                    const real w   = curr->mass.empty() ? 1 : curr->mass[ix];
+                    if (w == 0)
+                    {
+                        continue;
+                    }
+                    fft_msd_one(fftSetup, nfft, fft->x[g][i], bDim, &work, transform, &product,
+                                &msd, &tensor);
+                    for (int m = 0; m < nframes; m++)
+                    {
+                        sum[m] += w * msd[m];
+                    }
+                    for (size_t m = 0; m < tensor.size(); m++)
+                    {
+                        tensorSum[m] += w * tensor[m];
+                    }
+                    weightSum += w;
+                    if (curr->lsq != nullptr)
+                    {
+                        for (int m = 0; m < nframes; m++)
+                        {
+                            const real tt = curr->time[m];
+                            if (tt >= curr->beginfit && (curr->endfit < 0 || tt <= curr->endfit))
+                            {
+                                gmx_stats_add_point(curr->lsq[0][mol], tt, msd[m], 0, 0);
+                            }
+                        }
+                    }
+                }
+                gmx_fft_destroy(fftSetup);
+            }
+            GMX_CATCH_ALL_AND_EXIT_WITH_FATAL_ERROR
+        }
+    }
+    for (int g = 0; g < curr->ngrp; g++)
+    {
+        fft->msd[g].resize(nframes, 0.0);
+        fft->tensor[g].resize(bTen ? nframes * DIM * DIM : 0, 0.0);
+        for (int thread = 0; thread < nthreads; thread++)
+        {
+            for (int m = 0; m < nframes; m++)
+            {
+                fft->msd[g][m] += threadMsd[thread][g][m];
+            }
+            for (size_t m = 0; m < fft->tensor[g].size(); m++)
+            {
+                fft->tensor[g][m] += threadTensor[thread][g][m];
+            }
+            fft->weight[g] += threadWeight[thread][g];
+        }
+    }
+}
+
 /* this is the main loop for the correlation type functions
  * fx and nx are file pointers to things like read_first_x and
  * read_next_x
+ * If fft is not NULL, the positions are stored for the FFT-based MSD
+ * calculation instead of computing the MSD from restart points.
  */
 static int corr_loop(t_corr*                  curr,
                      const char*              fn,
@@ -670,6 +939,7 @@ static int corr_loop(t_corr*                  curr,
                      real                     t_pdb,
                      rvec**                   x_pdb,
                      matrix                   box_pdb,
+                     t_msd_fft*               fft,
                      const gmx_output_env_t*  oenv)
 {
     rvec*        x[2];  /* the coordinates to read */
@@ -744,7 +1014,7 @@ static int corr_loop(t_corr*                  curr,
 
 
         /* check whether we've reached a restart point */
-        if (bRmod(t, curr->t0, dt))
+        if (fft == nullptr && bRmod(t, curr->t0, dt))
         {
             curr->nrestart++;
 
@@ -838,21 +1108,37 @@ static int corr_loop(t_corr*                  curr,
             calc_com(bMol, gnx_com[0], index_com[0], xa[cur], xa[prev], box, &top->atoms, com);
         }
 
-        /* loop over all groups in index file */
-        for (i = 0; (i < curr->ngrp); i++)
+        if (fft)
         {
-            /* calculate something useful, like mean square displacements */
-            calc_corr(curr, i, gnx[i], index[i], xa[cur], (!gnx_com.empty()), com, calc1, bTen);
+            store_fft_positions(fft, bMol, curr->ngrp, gnx, index, xa[cur], com);
+        }
+        else
+        {
+            /* loop over all groups in index file */
+            for (i = 0; (i < curr->ngrp); i++)
+            {
+                /* calculate something useful, like mean square displacements */
+                calc_corr(curr, i, gnx[i], index[i], xa[cur], (!gnx_com.empty()), com, calc1, bTen);
+            }
         }
         cur    = prev;
         t_prev = t;
 
         curr->nframes++;
     } while (read_next_x(oenv, status, &t, x[cur], box));
-    fprintf(stderr, "\nUsed %d restart points spaced %g %s over %g %s\n\n", curr->nrestart,
-            output_env_conv_time(oenv, dt), output_env_get_time_unit(oenv).c_str(),
-            output_env_conv_time(oenv, curr->time[curr->nframes - 1]),
-            output_env_get_time_unit(oenv).c_str());
+    if (fft)
+    {
+        fprintf(stderr, "\nUsed all %d frames as time origins over %g %s\n\n", curr->nframes,
+                output_env_conv_time(oenv, curr->time[curr->nframes - 1]),
+                output_env_get_time_unit(oenv).c_str());
+    }
+    else
+    {
+        fprintf(stderr, "\nUsed %d restart points spaced %g %s over %g %s\n\n", curr->nrestart,
+                output_env_conv_time(oenv, dt), output_env_get_time_unit(oenv).c_str(),
+                output_env_conv_time(oenv, curr->time[curr->nframes - 1]),
+                output_env_get_time_unit(oenv).c_str());
+    }
 
     if (bMol)
     {
@@ -916,13 +1202,15 @@ static void do_corr(const char*             trx_file,
                     real                    dt,
                     real                    beginfit,
                     real                    endfit,
+                    gmx_bool                bFFT,
+                    int                     fftChunk,
                     const gmx_output_env_t* oenv)
 {
     std::unique_ptr<t_corr> msd;
     std::vector<int>        gnx, gnx_com; /* the selected groups' sizes */
     int**                   index;        /* selected groups' indices */
     char**                  grpname;
-    int                     i, i0, i1, j, N, nat_trx;
+    int                     i, i0, i1, j, N, nat_trx = 0;
     std::vector<real>       SigmaD, DD;
     real                    a, a2, b, r, chi2;
     rvec*                   x = nullptr;
@@ -955,19 +1243,85 @@ static void do_corr(const char*             trx_file,
     msd = std::make_unique<t_corr>(nrgrp, type, axis, dim_factor, mol_file == nullptr ? 0 : gnx[0],
                                    bTen, bMW, dt, top, beginfit, endfit);
 
-    nat_trx = corr_loop(msd.get(), trx_file, top, pbcType, mol_file ? gnx[0] != 0 : false, gnx.data(),
-                        index, (mol_file != nullptr) ? calc1_mol : (bMW ? calc1_mw : calc1_norm),
-                        bTen, gnx_com, index_com, dt, t_pdb, pdb_file ? &x : nullptr, box, oenv);
-
-    /* Correct for the number of points */
-    for (j = 0; (j < msd->ngrp); j++)
+    if (bFFT)
     {
-        for (i = 0; (i < msd->nframes); i++)
+        msd->bFFT = TRUE;
+        if (mol_file)
         {
-            msd->data[j][i] /= msd->ndata[j][i];
-            if (bTen)
+            /* All time origins contribute to a single fit per molecule */
+            msd->nrestart = 1;
+            snew(msd->lsq, 1);
+            snew(msd->lsq[0], msd->nmol);
+            for (i = 0; i < msd->nmol; i++)
             {
-                msmul(msd->datam[j][i], 1.0 / msd->ndata[j][i], msd->datam[j][i]);
+                msd->lsq[0][i] = gmx_stats_init();
+            }
+        }
+        t_msd_fft fft;
+        fft.x.resize(nrgrp);
+        fft.msd.resize(nrgrp);
+        fft.tensor.resize(nrgrp);
+        fft.weight.resize(nrgrp, 0.0);
+        const int ncoordsMax = *std::max_element(gnx.begin(), gnx.end());
+        const int chunkSize  = (fftChunk > 0 ? std::min(fftChunk, ncoordsMax) : ncoordsMax);
+        const int npass      = (ncoordsMax + chunkSize - 1) / chunkSize;
+        for (int pass = 0; pass < npass; pass++)
+        {
+            fft.chunkStart = pass * chunkSize;
+            fft.chunkEnd   = std::min(fft.chunkStart + chunkSize, ncoordsMax);
+            for (j = 0; j < nrgrp; j++)
+            {
+                fft.x[j].assign(std::max(0, std::min(gnx[j], fft.chunkEnd) - fft.chunkStart),
+                                std::vector<gmx::RVec>());
+            }
+            if (npass > 1)
+            {
+                fprintf(stderr, "\nPass %d of %d over the trajectory, for atoms/molecules %d to %d\n",
+                        pass + 1, npass, fft.chunkStart + 1, fft.chunkEnd);
+            }
+            /* Every pass reads the whole trajectory again */
+            msd->nframes = 0;
+            nat_trx = corr_loop(msd.get(), trx_file, top, pbcType, mol_file ? gnx[0] != 0 : false,
+                                gnx.data(), index, nullptr, bTen, gnx_com, index_com, dt, t_pdb,
+                                (pdb_file && pass == 0) ? &x : nullptr, box, &fft, oenv);
+            calc_fft_msd(msd.get(), &fft, mol_file != nullptr, gnx.data(), index, bTen);
+        }
+        for (j = 0; (j < msd->ngrp); j++)
+        {
+            for (i = 0; (i < msd->nframes); i++)
+            {
+                msd->data[j][i] = fft.msd[j][i] / fft.weight[j];
+                if (bTen)
+                {
+                    for (int m = 0; m < DIM; m++)
+                    {
+                        for (int m2 = 0; m2 <= m; m2++)
+                        {
+                            msd->datam[j][i][m][m2] =
+                                    fft.tensor[j][i * DIM * DIM + m * DIM + m2] / fft.weight[j];
+                        }
+                    }
+                }
+            }
+        }
+    }
+    else
+    {
+        nat_trx = corr_loop(msd.get(), trx_file, top, pbcType, mol_file ? gnx[0] != 0 : false,
+                            gnx.data(), index,
+                            (mol_file != nullptr) ? calc1_mol : (bMW ? calc1_mw : calc1_norm), bTen,
+                            gnx_com, index_com, dt, t_pdb, pdb_file ? &x : nullptr, box, nullptr, oenv);
+
+        /* Correct for the number of points */
+        for (j = 0; (j < msd->ngrp); j++)
+        {
+            for (i = 0; (i < msd->nframes); i++)
+            {
+                msd->data[j][i] /= msd->ndata[j][i];
+                if (bTen)
+                {
+                    msmul(msd->datam[j][i], 1.0 / msd->ndata[j][i], msd->datam[j][i]);
+                }
             }
         }
     }
@@ -1099,7 +1453,16 @@ int gmx_msd(int argc, char* argv[])
         "Option [TT]-pdb[tt] writes a [REF].pdb[ref] file with the coordinates of the frame",
         "at time [TT]-tpdb[tt] with in the B-factor field the square root of",
         "the diffusion coefficient of the molecule.",
-        "This option implies option [TT]-mol[tt]."
+        "This option implies option [TT]-mol[tt].[PAR]",
+        "With [TT]-fft[tt], every frame is used as a time origin and",
+        "[TT]-trestart[tt] is ignored. The MSD is then computed from",
+        "position correlation functions using FFTs, which scales as",
+        "N log N with the number of frames N instead of quadratically.",
+        "The calculation is parallelized over atoms or molecules with OpenMP.",
+        "This requires storing the positions of all frames; to limit the",
+        "memory usage, [TT]-fftchunk[tt] sets the number of atoms or molecules",
+        "to process per pass, at the cost of reading the trajectory once",
+        "for each pass. The frames should be equally spaced in time."
     };
     static const char* normtype[] = { nullptr, "no", "x", "y", "z", nullptr };
     static const char* axtitle[]  = { nullptr, "no", "x", "y", "z", nullptr };
@@ -1111,6 +1474,8 @@ int gmx_msd(int argc, char* argv[])
     static gmx_bool    bTen       = FALSE;
     static gmx_bool    bMW        = TRUE;
     static gmx_bool    bRmCOMM    = FALSE;
+    gmx_bool           bFFT       = FALSE;
+    int                fftChunk   = 0;
     t_pargs            pa[]       = {
         { "-type", FALSE, etENUM, { normtype }, "Compute diffusion coefficient in one direction" },
         { "-lateral",
@@ -1129,7 +1494,14 @@ int gmx_msd(int argc, char* argv[])
           etTIME,
           { &beginfit },
           "Start time for fitting the MSD (%t), -1 is 10%" },
-        { "-endfit", FALSE, etTIME, { &endfit }, "End time for fitting the MSD (%t), -1 is 90%" }
+        { "-endfit", FALSE, etTIME, { &endfit }, "End time for fitting the MSD (%t), -1 is 90%" },
+        { "-fft", FALSE, etBOOL, { &bFFT }, "Use all frames as time origins, computed with FFTs" },
+        { "-fftchunk",
+          FALSE,
+          etINT,
+          { &fftChunk },
+          "With [TT]-fft[tt], the number of atoms or molecules per pass over the trajectory, 0 is "
+          "all" }
     };
 
     t_filenm fnm[] = {
@@ -1172,6 +1544,10 @@ int gmx_msd(int argc, char* argv[])
     {
         gmx_fatal(FARGS, "Must have at least 1 group (now %d)", ngroup);
     }
+    if (fftChunk < 0)
+    {
+        gmx_fatal(FARGS, "The number of atoms or molecules per pass can not be negative (now %d)", fftChunk);
+    }
     if (mol_file && ngroup > 1)
     {
         gmx_fatal(FARGS, "With molecular msd can only have 1 group (now %d)", ngroup);
@@ -1220,7 +1596,7 @@ int gmx_msd(int argc, char* argv[])
     }
 
     do_corr(trx_file, ndx_file, msd_file, mol_file, pdb_file, t_pdb, ngroup, &top, pbcType, bTen,
-            bMW, bRmCOMM, type, dim_factor, axis, dt, beginfit, endfit, oenv);
+            bMW, bRmCOMM, type, dim_factor, axis, dt, beginfit, endfit, bFFT, fftChunk, oenv);
 
     done_top(&top);
     view_all(oenv, NFILE, fnm);
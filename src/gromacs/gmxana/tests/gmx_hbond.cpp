@@ -0,0 +1,146 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2021, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \internal \file
+ * \brief
+ * Tests for gmx hbond.
+ */
+
+#include "gmxpre.h"
+
+#include <cstdio>
+
+#include <string>
+
+#include "gromacs/gmxana/gmx_ana.h"
+#include "gromacs/gmxpreprocess/grompp.h"
+#include "gromacs/utility/path.h"
+
+#include "testutils/cmdlinetest.h"
+#include "testutils/refdata.h"
+#include "testutils/stdiohelper.h"
+#include "testutils/testfilemanager.h"
+#include "testutils/textblockmatchers.h"
+#include "testutils/xvgtest.h"
+
+namespace
+{
+
+using gmx::test::CommandLine;
+using gmx::test::ExactTextMatch;
+using gmx::test::StdioTestHelper;
+using gmx::test::XvgMatch;
+
+class HbondTest : public gmx::test::CommandLineTestBase
+{
+public:
+    /* The trajectory is a hydrogen-bonded SPC water dimer over 26 frames,
+     * shared with the tests of gmx extract-cluster. The run input file is
+     * prepared from the dimer in the simulation database.
+     */
+    HbondTest()
+    {
+        setInputFile("-f", "../../trajectoryanalysis/tests/extract_cluster.trr");
+        setOutputFile("-num", "hbnum.xvg", XvgMatch());
+        setOutputFile("-ac", "hbac.xvg", XvgMatch());
+        setOutputFile("-life", "hblife.xvg", XvgMatch());
+    }
+
+    void runTest(const CommandLine& args)
+    {
+        std::string tpr = fileManager().getTemporaryFilePath(".tpr");
+        std::string mdp = fileManager().getTemporaryFilePath(".mdp");
+        FILE*       fp  = fopen(mdp.c_str(), "w");
+        fprintf(fp, "cutoff-scheme = verlet\n");
+        fprintf(fp, "rcoulomb      = 0.85\n");
+        fprintf(fp, "rvdw          = 0.85\n");
+        fprintf(fp, "rlist         = 0.85\n");
+        fclose(fp);
+
+        // Prepare a .tpr file
+        {
+            CommandLine caller;
+            auto        simDB = gmx::test::TestFileManager::getTestSimulationDatabaseDirectory();
+            auto        base  = gmx::Path::join(simDB, "spc2");
+            caller.append("grompp");
+            caller.addOption("-maxwarn", 0);
+            caller.addOption("-f", mdp.c_str());
+            std::string gro = (base + ".gro");
+            caller.addOption("-c", gro.c_str());
+            std::string top = (base + ".top");
+            caller.addOption("-p", top.c_str());
+            caller.addOption("-o", tpr.c_str());
+            ASSERT_EQ(0, gmx_grompp(caller.argc(), caller.argv()));
+        }
+        // Run the hydrogen bond analysis between all atoms
+        {
+            StdioTestHelper stdioHelper(&fileManager());
+            stdioHelper.redirectStringToStdin("0 0\n");
+
+            CommandLine& cmdline = commandLine();
+            cmdline.merge(args);
+            cmdline.addOption("-s", tpr.c_str());
+            ASSERT_EQ(0, gmx_hbond(cmdline.argc(), cmdline.argv()));
+            checkOutputFiles();
+        }
+    }
+};
+
+// The dimer stays hydrogen bonded with the default criteria
+TEST_F(HbondTest, DimerWithDefaultCriteria)
+{
+    setOutputFile("-hbn", "hbond.ndx", ExactTextMatch());
+    setOutputFile("-hbm", "hbmap.xpm", ExactTextMatch());
+    const char* const cmdline[] = { "hbond" };
+    runTest(CommandLine(cmdline));
+}
+
+// With a shorter distance cut-off, the hydrogen bond breaks during the trajectory
+TEST_F(HbondTest, DimerBreaksWithShortCutoff)
+{
+    setOutputFile("-hbm", "hbmap.xpm", ExactTextMatch());
+    setOutputFile("-dan", "danum.xvg", XvgMatch());
+    setOutputFile("-don", "donor.xvg", XvgMatch());
+    const char* const cmdline[] = { "hbond", "-r", "0.28" };
+    runTest(CommandLine(cmdline));
+}
+
+// With a smaller angle cut-off, the hydrogen bond breaks later
+TEST_F(HbondTest, DimerBreaksWithSmallAngle)
+{
+    const char* const cmdline[] = { "hbond", "-a", "15" };
+    runTest(CommandLine(cmdline));
+}
+
+} // namespace
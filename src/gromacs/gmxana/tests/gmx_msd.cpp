@@ -167,6 +167,20 @@ TEST_F(MsdTest, oneDimensionalDiffusion)
     runTest(CommandLine(cmdline));
 }
 
+// with all frames as time origins, should match -trestart 1
+TEST_F(MsdTest, oneDimensionalDiffusionAllOrigins)
+{
+    const char* const cmdline[] = { "msd", "-mw", "no", "-type", "x", "-fft" };
+    runTest(CommandLine(cmdline));
+}
+
+// processing one atom per pass over the trajectory should not change the result
+TEST_F(MsdTest, oneDimensionalDiffusionAllOriginsInChunks)
+{
+    const char* const cmdline[] = { "msd", "-mw", "no", "-type", "x", "-fft", "-fftchunk", "1" };
+    runTest(CommandLine(cmdline));
+}
+
 // Test the diffusion per molecule output, mass weighted
 TEST_F(MsdMolTest, diffMolMassWeighted)
 {
@@ -181,6 +195,13 @@ TEST_F(MsdMolTest, diffMolNonMassWeighted)
     runTest(CommandLine(cmdline), "spc5.ndx", "spc5");
 }
 
+// Test the diffusion per molecule output, with all frames as time origins
+TEST_F(MsdMolTest, diffMolAllOrigins)
+{
+    const char* const cmdline[] = { "msd", "-fft" };
+    runTest(CommandLine(cmdline), "spc5.ndx", "spc5");
+}
+
 // Test the diffusion per molecule output, with selection
 TEST_F(MsdMolTest, diffMolSelected)
 {
@@ -55,25 +55,32 @@
 #include "gromacs/mdtypes/interaction_const.h"
 #include "gromacs/mdtypes/md_enums.h"
 #include "gromacs/mdtypes/mdatom.h"
+#include "gromacs/nbnxm/pairlist.h"
 #include "gromacs/simd/simd.h"
+#include "gromacs/simd/simd_math.h"
 #include "gromacs/utility/fatalerror.h"
 
 
+//! The maximum number of atoms in an i-cluster of a free-energy pair list
+static constexpr int c_maxIClusterSize = std::max(c_nbnxnCpuIClusterSize, c_nbnxnGpuClusterSize);
+
 //! Scalar (non-SIMD) data types.
 struct ScalarDataTypes
 {
-    using RealType                     = real; //!< The data type to use as real.
-    using IntType                      = int;  //!< The data type to use as int.
-    static constexpr int simdRealWidth = 1;    //!< The width of the RealType.
-    static constexpr int simdIntWidth  = 1;    //!< The width of the IntType.
+    using RealType = real; //!< The data type to use as real.
+    using IntType  = int;  //!< The data type to use as int.
+    using BoolType = bool; //!< The data type to use as bool for real value comparison.
+    static constexpr int simdRealWidth = 1; //!< The width of the RealType.
+    static constexpr int simdIntWidth  = 1; //!< The width of the IntType.
 };
 
 #if GMX_SIMD_HAVE_REAL && GMX_SIMD_HAVE_INT32_ARITHMETICS
 //! SIMD data types.
 struct SimdDataTypes
 {
-    using RealType                     = gmx::SimdReal;         //!< The data type to use as real.
-    using IntType                      = gmx::SimdInt32;        //!< The data type to use as int.
+    using RealType = gmx::SimdReal;  //!< The data type to use as real.
+    using IntType  = gmx::SimdInt32; //!< The data type to use as int.
+    using BoolType = gmx::SimdBool;  //!< The data type to use as bool for real value comparison.
     static constexpr int simdRealWidth = GMX_SIMD_REAL_WIDTH;   //!< The width of the RealType.
     static constexpr int simdIntWidth  = GMX_SIMD_FINT32_WIDTH; //!< The width of the IntType.
 };
@@ -87,6 +94,15 @@ static inline void pthRoot(const RealType r, RealType* pthRoot, RealType* invPth
     *pthRoot    = 1 / (*invPthRoot);
 }
 
+#if GMX_SIMD_HAVE_REAL && GMX_SIMD_HAVE_INT32_ARITHMETICS
+//! Computes r^(1/p) and 1/r^(1/p) for the standard p=6, SIMD version
+static inline void pthRoot(const gmx::SimdReal r, gmx::SimdReal* pthRoot, gmx::SimdReal* invPthRoot)
+{
+    *invPthRoot = gmx::invsqrt(gmx::cbrt(r));
+    *pthRoot    = gmx::inv(*invPthRoot);
+}
+#endif
+
 template<class RealType>
 static inline RealType calculateRinv6(const RealType rinvV)
 {
@@ -158,47 +174,37 @@ static inline RealType lennardJonesPotential(const RealType v6,
 }
 
 /* Ewald LJ */
-static inline real ewaldLennardJonesGridSubtract(const real c6grid, const real potentialShift, const real onesixth)
+template<class RealType>
+static inline RealType ewaldLennardJonesGridSubtract(const RealType c6grid,
+                                                     const real     potentialShift,
+                                                     const real     onesixth)
 {
     return (c6grid * potentialShift * onesixth);
 }
 
-/* LJ Potential switch */
-template<class RealType>
+/* LJ Potential switch, the mask should select r < rVdw */
+template<class RealType, class BoolType>
 static inline RealType potSwitchScalarForceMod(const RealType fScalarInp,
                                                const RealType potential,
                                                const RealType sw,
                                                const RealType r,
-                                               const RealType rVdw,
                                                const RealType dsw,
-                                               const real     zero)
+                                               const BoolType mask)
 {
-    if (r < rVdw)
-    {
-        real fScalar = fScalarInp * sw - r * potential * dsw;
-        return (fScalar);
-    }
-    return (zero);
+    return (gmx::selectByMask(fScalarInp * sw - r * potential * dsw, mask));
 }
-template<class RealType>
+template<class RealType, class BoolType>
 static inline RealType potSwitchPotentialMod(const RealType potentialInp,
                                              const RealType sw,
-                                             const RealType r,
-                                             const RealType rVdw,
-                                             const real     zero)
+                                             const BoolType mask)
 {
-    if (r < rVdw)
-    {
-        real potential = potentialInp * sw;
-        return (potential);
-    }
-    return (zero);
+    return (gmx::selectByMask(potentialInp * sw, mask));
 }
 
 
 //! Templated free-energy non-bonded kernel
 template<typename DataTypes, bool useSoftCore, bool scLambdasOrAlphasDiffer, bool vdwInteractionTypeIsEwald, bool elecInteractionTypeIsEwald, bool vdwModifierIsPotSwitch>
-static void nb_free_energy_kernel(const t_nblist* gmx_restrict nlist,
+static void nb_free_energy_kernel(const NbnxnPairlistFep* gmx_restrict nlist,
                                   rvec* gmx_restrict         xx,
                                   gmx::ForceWithShiftForces* forceWithShiftForces,
                                   const t_forcerec* gmx_restrict fr,
@@ -212,26 +218,27 @@ static void nb_free_energy_kernel(const t_nblist* gmx_restrict nlist,
 
     using RealType = typename DataTypes::RealType;
     using IntType  = typename DataTypes::IntType;
+    using BoolType = typename DataTypes::BoolType;
 
-    /* FIXME: How should these be handled with SIMD? */
     constexpr real onetwelfth = 1.0 / 12.0;
     constexpr real onesixth   = 1.0 / 6.0;
     constexpr real zero       = 0.0;
     constexpr real half       = 0.5;
     constexpr real one        = 1.0;
     constexpr real two        = 2.0;
-    constexpr real six        = 6.0;
 
     /* Extract pointer to non-bonded interaction constants */
     const interaction_const_t* ic = fr->ic;
 
     // Extract pair list data
-    const int  nri    = nlist->nri;
-    const int* iinr   = nlist->iinr;
-    const int* jindex = nlist->jindex;
-    const int* jjnr   = nlist->jjnr;
-    const int* shift  = nlist->shift;
-    const int* gid    = nlist->gid;
+    const int                      na_ci       = nlist->na_ci;
+    const int                      na_cj       = nlist->na_cj;
+    const int                      numPairsCj  = na_ci * na_cj;
+    const gmx::ArrayRef<const int> atomIndices = nlist->atomIndices;
+    const nbnxn_fep_cj_t*          cjList      = nlist->cj.data();
+
+    GMX_ASSERT(nlist->ci.empty() || (na_ci <= c_maxIClusterSize && numPairsCj <= 64),
+               "The cluster sizes should fit the local buffers and pair masks");
 
     const real* shiftvec      = fr->shift_vec[0];
     const real* chargeA       = mdatoms->chargeA;
@@ -342,8 +349,8 @@ static void nb_free_energy_kernel(const t_nblist* gmx_restrict nlist,
     GMX_RELEASE_ASSERT(!(vdwInteractionTypeIsEwald && vdwModifierIsPotSwitch),
                        "Can not apply soft-core to switched Ewald potentials");
 
-    real dvdl_coul = 0;
-    real dvdl_vdw  = 0;
+    RealType dvdl_coul = zero;
+    RealType dvdl_vdw  = zero;
 
     /* Lambda factor for state A, 1-lambda*/
     real LFC[NSTATES], LFV[NSTATES];
@@ -374,48 +381,166 @@ static void nb_free_energy_kernel(const t_nblist* gmx_restrict nlist,
     real* gmx_restrict f      = &(forceWithShiftForces->force()[0][0]);
     real* gmx_restrict fshift = &(forceWithShiftForces->shiftForces()[0][0]);
 
-    for (int n = 0; n < nri; n++)
+    for (const nbnxn_fep_ci_t& ciEntry : nlist->ci)
     {
-        int npair_within_cutoff = 0;
-
-        const int  is3   = 3 * shift[n];
-        const real shX   = shiftvec[is3];
-        const real shY   = shiftvec[is3 + 1];
-        const real shZ   = shiftvec[is3 + 2];
-        const int  nj0   = jindex[n];
-        const int  nj1   = jindex[n + 1];
-        const int  ii    = iinr[n];
-        const int  ii3   = 3 * ii;
-        const real ix    = shX + x[ii3 + 0];
-        const real iy    = shY + x[ii3 + 1];
-        const real iz    = shZ + x[ii3 + 2];
-        const real iqA   = facel * chargeA[ii];
-        const real iqB   = facel * chargeB[ii];
-        const int  ntiA  = 2 * ntype * typeA[ii];
-        const int  ntiB  = 2 * ntype * typeB[ii];
-        real       vctot = 0;
-        real       vvtot = 0;
-        real       fix   = 0;
-        real       fiy   = 0;
-        real       fiz   = 0;
-
-        for (int k = nj0; k < nj1; k++)
+        bool havePairsWithinCutoff = false;
+
+        const int  is3 = 3 * ciEntry.shift;
+        const real shX = shiftvec[is3];
+        const real shY = shiftvec[is3 + 1];
+        const real shZ = shiftvec[is3 + 2];
+
+        /* Load the i-cluster data once for all its j-clusters */
+        int  iAtom[c_maxIClusterSize];
+        real ix[c_maxIClusterSize], iy[c_maxIClusterSize], iz[c_maxIClusterSize];
+        real iqA[c_maxIClusterSize], iqB[c_maxIClusterSize];
+        int  ntiA[c_maxIClusterSize], ntiB[c_maxIClusterSize];
+        real fi[c_maxIClusterSize][DIM];
+        for (int i = 0; i < na_ci; i++)
         {
-            int            tj[NSTATES];
-            const int      jnr = jjnr[k];
-            const int      j3  = 3 * jnr;
+            const int ii = atomIndices[ciEntry.ci * na_ci + i];
+            iAtom[i]     = ii;
+            fi[i][XX]    = 0;
+            fi[i][YY]    = 0;
+            fi[i][ZZ]    = 0;
+            if (ii >= 0)
+            {
+                ix[i]   = shX + x[3 * ii + 0];
+                iy[i]   = shY + x[3 * ii + 1];
+                iz[i]   = shZ + x[3 * ii + 2];
+                iqA[i]  = facel * chargeA[ii];
+                iqB[i]  = facel * chargeB[ii];
+                ntiA[i] = 2 * ntype * typeA[ii];
+                ntiB[i] = 2 * ntype * typeB[ii];
+            }
+        }
+        RealType vctot = zero;
+        RealType vvtot = zero;
+
+        /* We loop over the atom pairs set in the pair masks of the j-entries,
+         * filling all SIMD lanes with pairs, which can cross j-clusters.
+         */
+        int cjInd   = ciEntry.cj_ind_start;
+        int pairInd = 0;
+        while (cjInd < ciEntry.cj_ind_end)
+        {
+            /* Gather the pair data into aligned buffers, padding the
+             * lanes beyond the end of the list with non-interacting pairs.
+             */
+            alignas(GMX_SIMD_ALIGNMENT) int  preloadI[DataTypes::simdRealWidth];
+            alignas(GMX_SIMD_ALIGNMENT) int  preloadJnr[DataTypes::simdRealWidth];
+            alignas(GMX_SIMD_ALIGNMENT) real preloadIx[DataTypes::simdRealWidth];
+            alignas(GMX_SIMD_ALIGNMENT) real preloadIy[DataTypes::simdRealWidth];
+            alignas(GMX_SIMD_ALIGNMENT) real preloadIz[DataTypes::simdRealWidth];
+            alignas(GMX_SIMD_ALIGNMENT) real preloadX[DataTypes::simdRealWidth];
+            alignas(GMX_SIMD_ALIGNMENT) real preloadY[DataTypes::simdRealWidth];
+            alignas(GMX_SIMD_ALIGNMENT) real preloadZ[DataTypes::simdRealWidth];
+            alignas(GMX_SIMD_ALIGNMENT) real preloadPairIsValid[DataTypes::simdRealWidth];
+            alignas(GMX_SIMD_ALIGNMENT) real preloadPairIncluded[DataTypes::simdRealWidth];
+            alignas(GMX_SIMD_ALIGNMENT) real preloadSelfScale[DataTypes::simdRealWidth];
+            alignas(GMX_SIMD_ALIGNMENT) real preloadQq[NSTATES][DataTypes::simdRealWidth];
+            alignas(GMX_SIMD_ALIGNMENT) real preloadC6[NSTATES][DataTypes::simdRealWidth];
+            alignas(GMX_SIMD_ALIGNMENT) real preloadC12[NSTATES][DataTypes::simdRealWidth];
+            alignas(GMX_SIMD_ALIGNMENT) real preloadC6grid[NSTATES][DataTypes::simdRealWidth];
+            int numLanes = 0;
+            while (numLanes < DataTypes::simdRealWidth && cjInd < ciEntry.cj_ind_end)
+            {
+                const nbnxn_fep_cj_t& cjEntry = cjList[cjInd];
+                if (pairInd == numPairsCj)
+                {
+                    cjInd++;
+                    pairInd = 0;
+                    continue;
+                }
+                if (((cjEntry.pairs >> pairInd) & 1U) == 0)
+                {
+                    pairInd++;
+                    continue;
+                }
+
+                const int i    = pairInd / na_cj;
+                const int ii   = iAtom[i];
+                const int jnr  = atomIndices[cjEntry.cj * na_cj + pairInd - i * na_cj];
+                const int j3   = 3 * jnr;
+                const int j    = numLanes;
+                preloadI[j]    = i;
+                preloadJnr[j]  = jnr;
+                preloadIx[j]   = ix[i];
+                preloadIy[j]   = iy[i];
+                preloadIz[j]   = iz[i];
+                preloadX[j]    = x[j3];
+                preloadY[j]    = x[j3 + 1];
+                preloadZ[j]    = x[j3 + 2];
+                /* Check if this pair on the exlusions list.*/
+                preloadPairIsValid[j]  = one;
+                preloadPairIncluded[j] = (((cjEntry.interactions >> pairInd) & 1U) != 0) ? one : zero;
+                /* If the i particle (ii) has itself (jnr) in its neighborlist,
+                 * which can only happen with the Verlet scheme, the
+                 * self-interaction will occur twice. Scale it down by 50%
+                 * to only include it once.
+                 */
+                preloadSelfScale[j] = (ii == jnr) ? half : one;
+
+                preloadQq[STATE_A][j] = iqA[i] * chargeA[jnr];
+                preloadQq[STATE_B][j] = iqB[i] * chargeB[jnr];
+
+                const int tj[NSTATES] = { ntiA[i] + 2 * typeA[jnr], ntiB[i] + 2 * typeB[jnr] };
+                for (int s = 0; s < NSTATES; s++)
+                {
+                    preloadC6[s][j]  = nbfp[tj[s]];
+                    preloadC12[s][j] = nbfp[tj[s] + 1];
+                    if (vdwInteractionTypeIsEwald)
+                    {
+                        preloadC6grid[s][j] = nbfp_grid[tj[s]];
+                    }
+                }
+
+                numLanes++;
+                pairInd++;
+            }
+            if (numLanes == 0)
+            {
+                /* The remaining pair masks of this i-entry were empty */
+                break;
+            }
+            for (int j = numLanes; j < DataTypes::simdRealWidth; j++)
+            {
+                preloadI[j]            = preloadI[0];
+                preloadJnr[j]          = preloadJnr[0];
+                preloadIx[j]           = preloadIx[0];
+                preloadIy[j]           = preloadIy[0];
+                preloadIz[j]           = preloadIz[0];
+                preloadX[j]            = preloadX[0];
+                preloadY[j]            = preloadY[0];
+                preloadZ[j]            = preloadZ[0];
+                preloadPairIsValid[j]  = zero;
+                preloadPairIncluded[j] = zero;
+                preloadSelfScale[j]    = one;
+                for (int s = 0; s < NSTATES; s++)
+                {
+                    preloadQq[s][j]     = zero;
+                    preloadC6[s][j]     = zero;
+                    preloadC12[s][j]    = zero;
+                    preloadC6grid[s][j] = zero;
+                }
+            }
+
             RealType       c6[NSTATES], c12[NSTATES], qq[NSTATES], Vcoul[NSTATES], Vvdw[NSTATES];
             RealType       r, rinv, rp, rpm2;
-            RealType       alpha_vdw_eff, alpha_coul_eff, sigma6[NSTATES];
-            const RealType dx  = ix - x[j3];
-            const RealType dy  = iy - x[j3 + 1];
-            const RealType dz  = iz - x[j3 + 2];
+            RealType       alpha_vdw_eff = zero, alpha_coul_eff = zero, sigma6[NSTATES];
+            const RealType dx  = gmx::load<RealType>(preloadIx) - gmx::load<RealType>(preloadX);
+            const RealType dy  = gmx::load<RealType>(preloadIy) - gmx::load<RealType>(preloadY);
+            const RealType dz  = gmx::load<RealType>(preloadIz) - gmx::load<RealType>(preloadZ);
             const RealType rsq = dx * dx + dy * dy + dz * dz;
             RealType       FscalC[NSTATES], FscalV[NSTATES];
-            /* Check if this pair on the exlusions list.*/
-            const bool bPairIncluded = nlist->excl_fep == nullptr || nlist->excl_fep[k];
 
-            if (rsq >= rcutoff_max2 && bPairIncluded)
+            const RealType pairIncluded  = gmx::load<RealType>(preloadPairIncluded);
+            const BoolType bPairIsValid  = (gmx::load<RealType>(preloadPairIsValid) != zero);
+            const BoolType bPairIncluded = (pairIncluded != zero);
+            const BoolType bPairExcluded = (pairIncluded == zero && bPairIsValid);
+            const BoolType bPairIncludedWithinCutoff = (rsq < rcutoff_max2 && bPairIncluded);
+
+            if (!gmx::anyTrue(bPairIncludedWithinCutoff || bPairExcluded))
             {
                 /* We save significant time by skipping all code below.
                  * Note that with soft-core interactions, the actual cut-off
@@ -428,28 +553,18 @@ static void nb_free_energy_kernel(const t_nblist* gmx_restrict nlist,
 
                 continue;
             }
-            npair_within_cutoff++;
-
-            if (rsq > 0)
-            {
-                /* Note that unlike in the nbnxn kernels, we do not need
-                 * to clamp the value of rsq before taking the invsqrt
-                 * to avoid NaN in the LJ calculation, since here we do
-                 * not calculate LJ interactions when C6 and C12 are zero.
-                 */
-
-                rinv = gmx::invsqrt(rsq);
-                r    = rsq * rinv;
-            }
-            else
-            {
-                /* The force at r=0 is zero, because of symmetry.
-                 * But note that the potential is in general non-zero,
-                 * since the soft-cored r will be non-zero.
-                 */
-                rinv = 0;
-                r    = 0;
-            }
+            havePairsWithinCutoff = true;
+
+            /* Note that unlike in the nbnxn kernels, we do not need
+             * to clamp the value of rsq before taking the invsqrt
+             * to avoid NaN in the LJ calculation, since here we do
+             * not calculate LJ interactions when C6 and C12 are zero.
+             * The force at r=0 is zero, because of symmetry.
+             * But note that the potential is in general non-zero,
+             * since the soft-cored r will be non-zero.
+             */
+            rinv = gmx::maskzInvsqrt(rsq, zero < rsq);
+            r    = rsq * rinv;
 
             if (useSoftCore)
             {
@@ -463,78 +578,72 @@ static void nb_free_energy_kernel(const t_nblist* gmx_restrict nlist,
                  * the simplest math and cheapest code.
                  */
                 rpm2 = rinv * rinv;
-                rp   = 1;
+                rp   = one;
             }
 
-            RealType Fscal = 0;
-
-            qq[STATE_A] = iqA * chargeA[jnr];
-            qq[STATE_B] = iqB * chargeB[jnr];
+            RealType Fscal = zero;
 
-            tj[STATE_A] = ntiA + 2 * typeA[jnr];
-            tj[STATE_B] = ntiB + 2 * typeB[jnr];
+            const RealType selfScale = gmx::load<RealType>(preloadSelfScale);
 
-            if (bPairIncluded)
+            for (int i = 0; i < NSTATES; i++)
             {
-                c6[STATE_A] = nbfp[tj[STATE_A]];
-                c6[STATE_B] = nbfp[tj[STATE_B]];
+                qq[i]  = gmx::load<RealType>(preloadQq[i]);
+                c6[i]  = gmx::load<RealType>(preloadC6[i]);
+                c12[i] = gmx::load<RealType>(preloadC12[i]);
+            }
 
-                for (int i = 0; i < NSTATES; i++)
+            if (gmx::anyTrue(bPairIncludedWithinCutoff))
+            {
+                if (useSoftCore)
                 {
-                    c12[i] = nbfp[tj[i] + 1];
-                    if (useSoftCore)
+                    for (int i = 0; i < NSTATES; i++)
                     {
-                        if ((c6[i] > 0) && (c12[i] > 0))
-                        {
-                            /* c12 is stored scaled with 12.0 and c6 is scaled with 6.0 - correct for this */
-                            sigma6[i] = half * c12[i] / c6[i];
-                            if (sigma6[i] < sigma6_min) /* for disappearing coul and vdw with soft core at the same time */
-                            {
-                                sigma6[i] = sigma6_min;
-                            }
-                        }
-                        else
-                        {
-                            sigma6[i] = sigma6_def;
-                        }
+                        /* c12 is stored scaled with 12.0 and c6 is scaled with 6.0
+                         * - correct for this
+                         */
+                        const BoolType bHaveSigma = (zero < c6[i] && zero < c12[i]);
+                        sigma6[i] = half * c12[i] * gmx::maskzInv(c6[i], bHaveSigma);
+                        /* for disappearing coul and vdw with soft core at the same time */
+                        sigma6[i] = gmx::blend(RealType(sigma6_def), gmx::max(sigma6[i], sigma6_min),
+                                               bHaveSigma);
                     }
-                }
 
-                if (useSoftCore)
-                {
                     /* only use softcore if one of the states has a zero endstate - softcore is for avoiding infinities!*/
-                    if ((c12[STATE_A] > 0) && (c12[STATE_B] > 0))
-                    {
-                        alpha_vdw_eff  = 0;
-                        alpha_coul_eff = 0;
-                    }
-                    else
-                    {
-                        alpha_vdw_eff  = alpha_vdw;
-                        alpha_coul_eff = alpha_coul;
-                    }
+                    const BoolType bAvoidSoftCore = (zero < c12[STATE_A] && zero < c12[STATE_B]);
+                    alpha_vdw_eff  = gmx::selectByNotMask(RealType(alpha_vdw), bAvoidSoftCore);
+                    alpha_coul_eff = gmx::selectByNotMask(RealType(alpha_coul), bAvoidSoftCore);
                 }
 
                 for (int i = 0; i < NSTATES; i++)
                 {
-                    FscalC[i] = 0;
-                    FscalV[i] = 0;
-                    Vcoul[i]  = 0;
-                    Vvdw[i]   = 0;
+                    FscalC[i] = zero;
+                    FscalV[i] = zero;
+                    Vcoul[i]  = zero;
+                    Vvdw[i]   = zero;
 
                     RealType rinvC, rinvV, rC, rV, rpinvC, rpinvV;
 
                     /* Only spend time on A or B state if it is non-zero */
-                    if ((qq[i] != 0) || (c6[i] != 0) || (c12[i] != 0))
+                    const BoolType bComputeState =
+                            (bPairIncludedWithinCutoff
+                             && (qq[i] != zero || c6[i] != zero || c12[i] != zero));
+                    if (gmx::anyTrue(bComputeState))
                     {
                         /* this section has to be inside the loop because of the dependence on sigma6 */
                         if (useSoftCore)
                         {
-                            rpinvC = one / (alpha_coul_eff * lfac_coul[i] * sigma6[i] + rp);
+                            /* Use a unit denominator for the pairs we do not compute,
+                             * so we do not produce infinities there.
+                             */
+                            rpinvC = gmx::inv(gmx::blend(RealType(one),
+                                                         alpha_coul_eff * lfac_coul[i] * sigma6[i] + rp,
+                                                         bComputeState));
                             pthRoot(rpinvC, &rinvC, &rC);
                             if (scLambdasOrAlphasDiffer)
                             {
-                                rpinvV = one / (alpha_vdw_eff * lfac_vdw[i] * sigma6[i] + rp);
+                                rpinvV = gmx::inv(gmx::blend(RealType(one),
+                                                             alpha_vdw_eff * lfac_vdw[i] * sigma6[i] + rp,
+                                                             bComputeState));
                                 pthRoot(rpinvV, &rinvV, &rV);
                             }
                             else
@@ -547,11 +656,11 @@ static void nb_free_energy_kernel(const t_nblist* gmx_restrict nlist,
                         }
                         else
                         {
-                            rpinvC = 1;
+                            rpinvC = one;
                             rinvC  = rinv;
                             rC     = r;
 
-                            rpinvV = 1;
+                            rpinvV = one;
                             rinvV  = rinv;
                             rV     = r;
                         }
@@ -560,10 +669,11 @@ static void nb_free_energy_kernel(const t_nblist* gmx_restrict nlist,
                          * and if we either include all entries in the list (no cutoff
                          * used in the kernel), or if we are within the cutoff.
                          */
-                        bool computeElecInteraction = (elecInteractionTypeIsEwald && r < rcoulomb)
-                                                      || (!elecInteractionTypeIsEwald && rC < rcoulomb);
+                        const BoolType computeElecInteraction =
+                                (elecInteractionTypeIsEwald ? (r < rcoulomb) : (rC < rcoulomb))
+                                && qq[i] != zero && bComputeState;
 
-                        if ((qq[i] != 0) && computeElecInteraction)
+                        if (gmx::anyTrue(computeElecInteraction))
                         {
                             if (elecInteractionTypeIsEwald)
                             {
@@ -575,6 +685,8 @@ static void nb_free_energy_kernel(const t_nblist* gmx_restrict nlist,
                                 Vcoul[i]  = reactionFieldPotential(qq[i], rinvC, rC, krf, crf);
                                 FscalC[i] = reactionFieldScalarForce(qq[i], rinvC, rC, krf, two);
                             }
+                            Vcoul[i]  = gmx::selectByMask(Vcoul[i], computeElecInteraction);
+                            FscalC[i] = gmx::selectByMask(FscalC[i], computeElecInteraction);
                         }
 
                         /* Only process the VDW interactions if we have
@@ -582,9 +694,10 @@ static void nb_free_energy_kernel(const t_nblist* gmx_restrict nlist,
                          * include all entries in the list (no cutoff used
                          * in the kernel), or if we are within the cutoff.
                          */
-                        bool computeVdwInteraction = (vdwInteractionTypeIsEwald && r < rvdw)
-                                                     || (!vdwInteractionTypeIsEwald && rV < rvdw);
-                        if ((c6[i] != 0 || c12[i] != 0) && computeVdwInteraction)
+                        const BoolType computeVdwInteraction =
+                                (vdwInteractionTypeIsEwald ? (r < rvdw) : (rV < rvdw))
+                                && (c6[i] != zero || c12[i] != zero) && bComputeState;
+                        if (gmx::anyTrue(computeVdwInteraction))
                         {
                             RealType rinv6;
                             if (useSoftCore)
@@ -605,23 +718,25 @@ static void nb_free_energy_kernel(const t_nblist* gmx_restrict nlist,
                             if (vdwInteractionTypeIsEwald)
                             {
                                 /* Subtract the grid potential at the cut-off */
-                                Vvdw[i] += ewaldLennardJonesGridSubtract(nbfp_grid[tj[i]],
-                                                                         sh_lj_ewald, onesixth);
+                                Vvdw[i] = Vvdw[i]
+                                          + ewaldLennardJonesGridSubtract(
+                                                    gmx::load<RealType>(preloadC6grid[i]), sh_lj_ewald, onesixth);
                             }
 
                             if (vdwModifierIsPotSwitch)
                             {
                                 RealType d        = rV - ic->rvdw_switch;
-                                d                 = (d > zero) ? d : zero;
+                                d                 = gmx::max(d, zero);
                                 const RealType d2 = d * d;
                                 const RealType sw =
                                         one + d2 * d * (vdw_swV3 + d * (vdw_swV4 + d * vdw_swV5));
                                 const RealType dsw = d2 * (vdw_swF2 + d * (vdw_swF3 + d * vdw_swF4));
 
-                                FscalV[i] = potSwitchScalarForceMod(FscalV[i], Vvdw[i], sw, rV,
-                                                                    rvdw, dsw, zero);
-                                Vvdw[i]   = potSwitchPotentialMod(Vvdw[i], sw, rV, rvdw, zero);
+                                FscalV[i] = potSwitchScalarForceMod(FscalV[i], Vvdw[i], sw, rV, dsw, rV < rvdw);
+                                Vvdw[i]   = potSwitchPotentialMod(Vvdw[i], sw, rV < rvdw);
                             }
+                            Vvdw[i]   = gmx::selectByMask(Vvdw[i], computeVdwInteraction);
+                            FscalV[i] = gmx::selectByMask(FscalV[i], computeVdwInteraction);
                         }
 
                         /* FscalC (and FscalV) now contain: dV/drC * rC
@@ -629,57 +744,54 @@ static void nb_free_energy_kernel(const t_nblist* gmx_restrict nlist,
                          * Further down we first multiply by r^p-2 and then by
                          * the vector r, which in total gives: dV/drC * (r/rC)^1-p
                          */
-                        FscalC[i] *= rpinvC;
-                        FscalV[i] *= rpinvV;
+                        FscalC[i] = FscalC[i] * rpinvC;
+                        FscalV[i] = FscalV[i] * rpinvV;
                     }
                 } // end for (int i = 0; i < NSTATES; i++)
 
                 /* Assemble A and B states */
                 for (int i = 0; i < NSTATES; i++)
                 {
-                    vctot += LFC[i] * Vcoul[i];
-                    vvtot += LFV[i] * Vvdw[i];
+                    vctot = vctot + LFC[i] * Vcoul[i];
+                    vvtot = vvtot + LFV[i] * Vvdw[i];
 
-                    Fscal += LFC[i] * FscalC[i] * rpm2;
-                    Fscal += LFV[i] * FscalV[i] * rpm2;
+                    Fscal = Fscal + LFC[i] * FscalC[i] * rpm2;
+                    Fscal = Fscal + LFV[i] * FscalV[i] * rpm2;
 
                     if (useSoftCore)
                     {
-                        dvdl_coul += Vcoul[i] * DLF[i]
-                                     + LFC[i] * alpha_coul_eff * dlfac_coul[i] * FscalC[i] * sigma6[i];
-                        dvdl_vdw += Vvdw[i] * DLF[i]
-                                    + LFV[i] * alpha_vdw_eff * dlfac_vdw[i] * FscalV[i] * sigma6[i];
+                        dvdl_coul = dvdl_coul + Vcoul[i] * DLF[i]
+                                    + LFC[i] * alpha_coul_eff * dlfac_coul[i] * FscalC[i] * sigma6[i];
+                        dvdl_vdw = dvdl_vdw + Vvdw[i] * DLF[i]
+                                   + LFV[i] * alpha_vdw_eff * dlfac_vdw[i] * FscalV[i] * sigma6[i];
                     }
                     else
                     {
-                        dvdl_coul += Vcoul[i] * DLF[i];
-                        dvdl_vdw += Vvdw[i] * DLF[i];
+                        dvdl_coul = dvdl_coul + Vcoul[i] * DLF[i];
+                        dvdl_vdw  = dvdl_vdw + Vvdw[i] * DLF[i];
                     }
                 }
-            } // end if (bPairIncluded)
-            else if (icoul == GMX_NBKERNEL_ELEC_REACTIONFIELD)
+            } // end if (gmx::anyTrue(bPairIncludedWithinCutoff))
+
+            if (icoul == GMX_NBKERNEL_ELEC_REACTIONFIELD && gmx::anyTrue(bPairExcluded))
             {
                 /* For excluded pairs, which are only in this pair list when
                  * using the Verlet scheme, we don't use soft-core.
                  * As there is no singularity, there is no need for soft-core.
                  */
-                const real FF = -two * krf;
-                RealType   VV = krf * rsq - crf;
-
-                if (ii == jnr)
-                {
-                    VV *= half;
-                }
+                const RealType FF = gmx::selectByMask(RealType(-two * krf), bPairExcluded);
+                const RealType VV = gmx::selectByMask((krf * rsq - crf) * selfScale, bPairExcluded);
 
                 for (int i = 0; i < NSTATES; i++)
                 {
-                    vctot += LFC[i] * qq[i] * VV;
-                    Fscal += LFC[i] * qq[i] * FF;
-                    dvdl_coul += DLF[i] * qq[i] * VV;
+                    vctot     = vctot + LFC[i] * qq[i] * VV;
+                    Fscal     = Fscal + LFC[i] * qq[i] * FF;
+                    dvdl_coul = dvdl_coul + DLF[i] * qq[i] * VV;
                 }
             }
 
-            if (elecInteractionTypeIsEwald && (r < rcoulomb || !bPairIncluded))
+            const BoolType computeElecEwaldInteraction = (bPairExcluded || (r < rcoulomb && bPairIncluded));
+            if (elecInteractionTypeIsEwald && gmx::anyTrue(computeElecEwaldInteraction))
             {
                 /* See comment in the preamble. When using Ewald interactions
                  * (unless we use a switch modifier) we subtract the reciprocal-space
@@ -689,39 +801,36 @@ static void nb_free_energy_kernel(const t_nblist* gmx_restrict nlist,
                  * the softcore to the entire electrostatic interaction,
                  * including the reciprocal-space component.
                  */
-                real v_lr, f_lr;
-
-                const RealType ewrt   = r * coulombTableScale;
-                IntType        ewitab = static_cast<IntType>(ewrt);
-                const RealType eweps  = ewrt - ewitab;
-                ewitab                = 4 * ewitab;
-                f_lr                  = ewtab[ewitab] + eweps * ewtab[ewitab + 1];
-                v_lr = (ewtab[ewitab + 2] - coulombTableScaleInvHalf * eweps * (ewtab[ewitab] + f_lr));
-                f_lr *= rinv;
+                RealType v_lr, f_lr;
+
+                /* Pairs we do not compute look up the table at r=0 */
+                const RealType ewrt   = gmx::selectByMask(r, computeElecEwaldInteraction) * coulombTableScale;
+                const IntType  ewitab = gmx::cvttR2I(ewrt);
+                const RealType eweps  = ewrt - gmx::cvtI2R(ewitab);
+                RealType       ewtabF, ewtabFDiff, ewtabV, ewtabZero;
+                gmx::gatherLoadBySimdIntTranspose<4>(ewtab, ewitab, &ewtabF, &ewtabFDiff, &ewtabV, &ewtabZero);
+                f_lr = ewtabF + eweps * ewtabFDiff;
+                v_lr = (ewtabV - coulombTableScaleInvHalf * eweps * (ewtabF + f_lr));
+                f_lr = f_lr * rinv;
 
                 /* Note that any possible Ewald shift has already been applied in
                  * the normal interaction part above.
                  */
 
-                if (ii == jnr)
-                {
-                    /* If we get here, the i particle (ii) has itself (jnr)
-                     * in its neighborlist. This can only happen with the Verlet
-                     * scheme, and corresponds to a self-interaction that will
-                     * occur twice. Scale it down by 50% to only include it once.
-                     */
-                    v_lr *= half;
-                }
+                /* A self-interaction is only included once, see above */
+                v_lr = gmx::selectByMask(v_lr * selfScale, computeElecEwaldInteraction);
+                f_lr = gmx::selectByMask(f_lr, computeElecEwaldInteraction);
 
                 for (int i = 0; i < NSTATES; i++)
                 {
-                    vctot -= LFC[i] * qq[i] * v_lr;
-                    Fscal -= LFC[i] * qq[i] * f_lr;
-                    dvdl_coul -= (DLF[i] * qq[i]) * v_lr;
+                    vctot     = vctot - LFC[i] * qq[i] * v_lr;
+                    Fscal     = Fscal - LFC[i] * qq[i] * f_lr;
+                    dvdl_coul = dvdl_coul - (DLF[i] * qq[i]) * v_lr;
                 }
             }
 
-            if (vdwInteractionTypeIsEwald && r < rvdw)
+            const BoolType computeVdwEwaldInteraction = (r < rvdw && bPairIsValid);
+            if (vdwInteractionTypeIsEwald && gmx::anyTrue(computeVdwEwaldInteraction))
             {
                 /* See comment in the preamble. When using LJ-Ewald interactions
                  * (unless we use a switch modifier) we subtract the reciprocal-space
@@ -736,111 +845,141 @@ static void nb_free_energy_kernel(const t_nblist* gmx_restrict nlist,
                  * r close to 0 for non-interacting pairs.
                  */
 
-                const RealType rs   = rsq * rinv * vdwTableScale;
-                const IntType  ri   = static_cast<IntType>(rs);
-                const RealType frac = rs - ri;
-                const RealType f_lr = (1 - frac) * tab_ewald_F_lj[ri] + frac * tab_ewald_F_lj[ri + 1];
+                const RealType rs   = gmx::selectByMask(r, computeVdwEwaldInteraction) * vdwTableScale;
+                const IntType  ri   = gmx::cvttR2I(rs);
+                const RealType frac = rs - gmx::cvtI2R(ri);
+                RealType       tabF0, tabF1, tabV0, tabV1;
+                gmx::gatherLoadUBySimdIntTranspose<1>(tab_ewald_F_lj, ri, &tabF0, &tabF1);
+                gmx::gatherLoadUBySimdIntTranspose<1>(tab_ewald_V_lj, ri, &tabV0, &tabV1);
+                const RealType f_lr = (one - frac) * tabF0 + frac * tabF1;
                 /* TODO: Currently the Ewald LJ table does not contain
                  * the factor 1/6, we should add this.
                  */
-                const RealType FF = f_lr * rinv / six;
-                RealType       VV =
-                        (tab_ewald_V_lj[ri] - vdwTableScaleInvHalf * frac * (tab_ewald_F_lj[ri] + f_lr))
-                        / six;
+                RealType FF = f_lr * rinv * onesixth;
+                RealType VV = (tabV0 - vdwTableScaleInvHalf * frac * (tabF0 + f_lr)) * onesixth;
 
-                if (ii == jnr)
-                {
-                    /* If we get here, the i particle (ii) has itself (jnr)
-                     * in its neighborlist. This can only happen with the Verlet
-                     * scheme, and corresponds to a self-interaction that will
-                     * occur twice. Scale it down by 50% to only include it once.
-                     */
-                    VV *= half;
-                }
+                /* A self-interaction is only included once, see above */
+                VV = gmx::selectByMask(VV * selfScale, computeVdwEwaldInteraction);
+                FF = gmx::selectByMask(FF, computeVdwEwaldInteraction);
 
                 for (int i = 0; i < NSTATES; i++)
                 {
-                    const real c6grid = nbfp_grid[tj[i]];
-                    vvtot += LFV[i] * c6grid * VV;
-                    Fscal += LFV[i] * c6grid * FF;
-                    dvdl_vdw += (DLF[i] * c6grid) * VV;
+                    const RealType c6grid = gmx::load<RealType>(preloadC6grid[i]);
+                    vvtot                 = vvtot + LFV[i] * c6grid * VV;
+                    Fscal                 = Fscal + LFV[i] * c6grid * FF;
+                    dvdl_vdw              = dvdl_vdw + (DLF[i] * c6grid) * VV;
                 }
             }
 
             if (doForces)
             {
-                const real tx = Fscal * dx;
-                const real ty = Fscal * dy;
-                const real tz = Fscal * dz;
-                fix           = fix + tx;
-                fiy           = fiy + ty;
-                fiz           = fiz + tz;
-                /* OpenMP atomics are expensive, but this kernels is also
-                 * expensive, so we can take this hit, instead of using
-                 * thread-local output buffers and extra reduction.
-                 *
-                 * All the OpenMP regions in this file are trivial and should
-                 * not throw, so no need for try/catch.
-                 */
+                const RealType tx = Fscal * dx;
+                const RealType ty = Fscal * dy;
+                const RealType tz = Fscal * dz;
+
+                alignas(GMX_SIMD_ALIGNMENT) real storeFscal[DataTypes::simdRealWidth];
+                alignas(GMX_SIMD_ALIGNMENT) real storeTx[DataTypes::simdRealWidth];
+                alignas(GMX_SIMD_ALIGNMENT) real storeTy[DataTypes::simdRealWidth];
+                alignas(GMX_SIMD_ALIGNMENT) real storeTz[DataTypes::simdRealWidth];
+                gmx::store(storeFscal, Fscal);
+                gmx::store(storeTx, tx);
+                gmx::store(storeTy, ty);
+                gmx::store(storeTz, tz);
+                for (int j = 0; j < numLanes; j++)
+                {
+                    /* Skip the pairs beyond the cut-off in this SIMD batch */
+                    if (storeFscal[j] == 0)
+                    {
+                        continue;
+                    }
+                    const int j3 = 3 * preloadJnr[j];
+                    /* OpenMP atomics are expensive, but this kernels is also
+                     * expensive, so we can take this hit, instead of using
+                     * thread-local output buffers and extra reduction.
+                     *
+                     * All the OpenMP regions in this file are trivial and should
+                     * not throw, so no need for try/catch.
+                     */
 #pragma omp atomic
-                f[j3] -= tx;
+                    f[j3] -= storeTx[j];
 #pragma omp atomic
-                f[j3 + 1] -= ty;
+                    f[j3 + 1] -= storeTy[j];
 #pragma omp atomic
-                f[j3 + 2] -= tz;
+                    f[j3 + 2] -= storeTz[j];
+
+                    fi[preloadI[j]][XX] += storeTx[j];
+                    fi[preloadI[j]][YY] += storeTy[j];
+                    fi[preloadI[j]][ZZ] += storeTz[j];
+                }
             }
-        } // end for (int k = nj0; k < nj1; k++)
+        } // end while (cjInd < ciEntry.cj_ind_end)
 
         /* The atomics below are expensive with many OpenMP threads.
          * Here unperturbed i-particles will usually only have a few
          * (perturbed) j-particles in the list. Thus with a buffered list
          * we can skip a significant number of i-reductions with a check.
          */
-        if (npair_within_cutoff > 0)
+        if (havePairsWithinCutoff)
         {
-            if (doForces)
+            if (doForces || doShiftForces)
             {
+                real fShift[DIM] = { 0, 0, 0 };
+                for (int i = 0; i < na_ci; i++)
+                {
+                    if (iAtom[i] < 0 || (fi[i][XX] == 0 && fi[i][YY] == 0 && fi[i][ZZ] == 0))
+                    {
+                        continue;
+                    }
+                    if (doForces)
+                    {
+                        const int ii3 = 3 * iAtom[i];
 #pragma omp atomic
-                f[ii3] += fix;
+                        f[ii3] += fi[i][XX];
 #pragma omp atomic
-                f[ii3 + 1] += fiy;
+                        f[ii3 + 1] += fi[i][YY];
 #pragma omp atomic
-                f[ii3 + 2] += fiz;
-            }
-            if (doShiftForces)
-            {
+                        f[ii3 + 2] += fi[i][ZZ];
+                    }
+                    for (int d = 0; d < DIM; d++)
+                    {
+                        fShift[d] += fi[i][d];
+                    }
+                }
+                if (doShiftForces)
+                {
 #pragma omp atomic
-                fshift[is3] += fix;
+                    fshift[is3] += fShift[XX];
 #pragma omp atomic
-                fshift[is3 + 1] += fiy;
+                    fshift[is3 + 1] += fShift[YY];
 #pragma omp atomic
-                fshift[is3 + 2] += fiz;
+                    fshift[is3 + 2] += fShift[ZZ];
+                }
             }
             if (doPotential)
             {
-                int ggid = gid[n];
+                int ggid = ciEntry.gid;
 #pragma omp atomic
-                Vc[ggid] += vctot;
+                Vc[ggid] += gmx::reduce(vctot);
 #pragma omp atomic
-                Vv[ggid] += vvtot;
+                Vv[ggid] += gmx::reduce(vvtot);
             }
         }
-    } // end for (int n = 0; n < nri; n++)
+    } // end for (const nbnxn_fep_ci_t& ciEntry : nlist->ci)
 
 #pragma omp atomic
-    dvdl[efptCOUL] += dvdl_coul;
+    dvdl[efptCOUL] += gmx::reduce(dvdl_coul);
 #pragma omp atomic
-    dvdl[efptVDW] += dvdl_vdw;
+    dvdl[efptVDW] += gmx::reduce(dvdl_vdw);
 
     /* Estimate flops, average for free energy stuff:
-     * 12  flops per outer iteration
-     * 150 flops per inner iteration
+     * 12  flops per i-entry
+     * 150 flops per atom pair
      */
 #pragma omp atomic
-    inc_nrnb(nrnb, eNR_NBKERNEL_FREE_ENERGY, nlist->nri * 12 + nlist->jindex[nri] * 150);
+    inc_nrnb(nrnb, eNR_NBKERNEL_FREE_ENERGY, nlist->ci.size() * 12 + nlist->numPairs * 150);
 }
 
-typedef void (*KernelFunction)(const t_nblist* gmx_restrict nlist,
+typedef void (*KernelFunction)(const NbnxnPairlistFep* gmx_restrict nlist,
                                rvec* gmx_restrict         xx,
                                gmx::ForceWithShiftForces* forceWithShiftForces,
                                const t_forcerec* gmx_restrict fr,
@@ -854,8 +993,7 @@ static KernelFunction dispatchKernelOnUseSimd(const bool useSimd)
     if (useSimd)
     {
 #if GMX_SIMD_HAVE_REAL && GMX_SIMD_HAVE_INT32_ARITHMETICS && GMX_USE_SIMD_KERNELS
-        /* FIXME: Here SimdDataTypes should be used to enable SIMD. So far, the code in nb_free_energy_kernel is not adapted to SIMD */
-        return (nb_free_energy_kernel<ScalarDataTypes, useSoftCore, scLambdasOrAlphasDiffer, vdwInteractionTypeIsEwald,
+        return (nb_free_energy_kernel<SimdDataTypes, useSoftCore, scLambdasOrAlphasDiffer, vdwInteractionTypeIsEwald,
                                       elecInteractionTypeIsEwald, vdwModifierIsPotSwitch>);
 #else
         return (nb_free_energy_kernel<ScalarDataTypes, useSoftCore, scLambdasOrAlphasDiffer, vdwInteractionTypeIsEwald,
@@ -960,7 +1098,7 @@ static KernelFunction dispatchKernel(const bool        scLambdasOrAlphasDiffer,
 }
 
 
-void gmx_nb_free_energy_kernel(const t_nblist*            nlist,
+void gmx_nb_free_energy_kernel(const NbnxnPairlistFep*    nlist,
                                rvec*                      xx,
                                gmx::ForceWithShiftForces* ff,
                                const t_forcerec*          fr,
@@ -41,8 +41,8 @@
 #include "gromacs/gmxlib/nrnb.h"
 #include "gromacs/gmxlib/nonbonded/nb_kernel.h"
 #include "gromacs/math/vectypes.h"
-#include "gromacs/mdtypes/nblist.h"
 
+struct NbnxnPairlistFep;
 struct t_forcerec;
 struct t_mdatoms;
 namespace gmx
@@ -50,7 +50,7 @@ namespace gmx
 class ForceWithShiftForces;
 }
 
-void gmx_nb_free_energy_kernel(const t_nblist* gmx_restrict nlist,
+void gmx_nb_free_energy_kernel(const NbnxnPairlistFep* gmx_restrict nlist,
                                rvec* gmx_restrict         xx,
                                gmx::ForceWithShiftForces* forceWithShiftForces,
                                const t_forcerec* gmx_restrict fr,
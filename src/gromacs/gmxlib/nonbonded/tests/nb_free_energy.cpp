@@ -0,0 +1,402 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2020, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \internal \file
+ * \brief
+ * Tests the free-energy non-bonded kernel by comparing the SIMD
+ * and the plain-C versions of the kernel.
+ */
+#include "gmxpre.h"
+
+#include "gromacs/gmxlib/nonbonded/nb_free_energy.h"
+
+#include <cmath>
+#include <cstdint>
+
+#include <memory>
+#include <tuple>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "gromacs/ewald/ewald_utils.h"
+#include "gromacs/gmxlib/nrnb.h"
+#include "gromacs/gmxlib/nonbonded/nb_kernel.h"
+#include "gromacs/gmxlib/nonbonded/nonbonded.h"
+#include "gromacs/math/functions.h"
+#include "gromacs/math/vectypes.h"
+#include "gromacs/mdlib/forcerec.h"
+#include "gromacs/mdtypes/forceoutput.h"
+#include "gromacs/mdtypes/forcerec.h"
+#include "gromacs/mdtypes/interaction_const.h"
+#include "gromacs/mdtypes/md_enums.h"
+#include "gromacs/mdtypes/mdatom.h"
+#include "gromacs/nbnxm/pairlist.h"
+#include "gromacs/pbcutil/ishift.h"
+#include "gromacs/random/threefry.h"
+#include "gromacs/random/uniformrealdistribution.h"
+#include "gromacs/utility/arrayref.h"
+#include "gromacs/utility/smalloc.h"
+
+#include "testutils/testasserts.h"
+
+namespace gmx
+{
+namespace test
+{
+namespace
+{
+
+//! The Van der Waals interaction variants to test
+enum class VdwVariant
+{
+    PotentialShift,
+    PotentialSwitch,
+    LJPme
+};
+
+//! Number of atoms in the test system
+constexpr int c_numAtoms = 31;
+//! Number of atoms that have their own pair list
+constexpr int c_numIAtoms = 7;
+//! Number of atoms per cluster in the pair list
+constexpr int c_clusterSize = 4;
+//! Number of clusters, the last one has a filler particle
+constexpr int c_numClusters = (c_numAtoms + c_clusterSize - 1) / c_clusterSize;
+//! Number of atom types, the last one has no LJ interaction
+constexpr int c_numTypes = 3;
+//! The cut-off distance
+constexpr real c_cutoff = 1.0;
+//! The size of the region the atoms are put in
+constexpr real c_boxSize = 1.5;
+//! The length beyond the cut-off covered by the Ewald correction tables
+constexpr real c_tableExtension = 1.7;
+
+//! The output of a kernel call
+struct KernelOutput
+{
+    //! The forces
+    std::vector<RVec> force;
+    //! The shift forces
+    std::vector<RVec> shiftForce;
+    //! The Coulomb and VdW energies
+    real energy[2] = { 0, 0 };
+    //! The Coulomb and VdW dV/dlambda
+    real dvdl[2] = { 0, 0 };
+};
+
+//! Parameters: electrostatics type, VdW variant, use soft-core, lambda values differ
+using FepKernelTestParameters = std::tuple<int, VdwVariant, bool, bool>;
+
+/*! \brief Sets up a small system with perturbed atoms and a pair list
+ * with exclusions, self-interactions and pairs beyond the cut-off.
+ */
+class FepKernelTest : public ::testing::TestWithParam<FepKernelTestParameters>
+{
+public:
+    FepKernelTest()
+    {
+        int  eeltype;
+        bool useSoftCore;
+        std::tie(eeltype, vdwVariant_, useSoftCore, lambdasDiffer_) = GetParam();
+
+        ic_.eeltype               = eeltype;
+        ic_.rcoulomb              = c_cutoff;
+        ic_.rvdw                  = c_cutoff;
+        ic_.epsfac                = 138.935;
+        ic_.vdw_modifier          = eintmodPOTSHIFT;
+        ic_.dispersion_shift.cpot = -1.0 / gmx::power6(c_cutoff);
+        ic_.repulsion_shift.cpot  = -1.0 / gmx::power12(c_cutoff);
+        if (eeltype == eelRF)
+        {
+            ic_.k_rf = 0.45;
+            ic_.c_rf = 1.45;
+        }
+        else
+        {
+            ic_.coulomb_modifier   = eintmodPOTSHIFT;
+            ic_.ewaldcoeff_q       = calc_ewaldcoeff_q(c_cutoff, 1e-5);
+            ic_.sh_ewald           = std::erfc(ic_.ewaldcoeff_q * c_cutoff) / c_cutoff;
+            ic_.coulombEwaldTables = std::make_unique<EwaldCorrectionTables>();
+        }
+        if (vdwVariant_ == VdwVariant::PotentialSwitch)
+        {
+            ic_.vdw_modifier          = eintmodPOTSWITCH;
+            ic_.rvdw_switch           = 0.8;
+            ic_.dispersion_shift.cpot = 0;
+            ic_.repulsion_shift.cpot  = 0;
+        }
+        else if (vdwVariant_ == VdwVariant::LJPme)
+        {
+            ic_.vdwtype        = evdwPME;
+            ic_.ewaldcoeff_lj  = calc_ewaldcoeff_lj(c_cutoff, 1e-3);
+            ic_.sh_lj_ewald    = 0.1;
+            ic_.vdwEwaldTables = std::make_unique<EwaldCorrectionTables>();
+        }
+        /* As with the table-extension in mdrun, the tables need to cover
+         * the excluded pairs beyond the cut-off.
+         */
+        init_interaction_const_tables(nullptr, &ic_, c_tableExtension);
+
+        fr_.ic = &ic_;
+        snew(fr_.shift_vec, SHIFTS);
+        fr_.ntype = c_numTypes;
+        fr_.nbfp.resize(2 * c_numTypes * c_numTypes);
+        c6grid_.resize(2 * c_numTypes * c_numTypes);
+        const real sigma[c_numTypes]   = { 0.32, 0.25, 0 };
+        const real epsilon[c_numTypes] = { 0.65, 0.4, 0 };
+        for (int ti = 0; ti < c_numTypes; ti++)
+        {
+            for (int tj = 0; tj < c_numTypes; tj++)
+            {
+                const real sigma6    = gmx::power6(0.5 * (sigma[ti] + sigma[tj]));
+                const real epsilonIJ = std::sqrt(epsilon[ti] * epsilon[tj]);
+                /* The kernels expect c6 and c12 to be scaled by 6 and 12 */
+                const int index     = 2 * (ti * c_numTypes + tj);
+                fr_.nbfp[index]     = 6 * 4 * epsilonIJ * sigma6;
+                fr_.nbfp[index + 1] = 12 * 4 * epsilonIJ * sigma6 * sigma6;
+                c6grid_[index]      = 0.9 * fr_.nbfp[index];
+            }
+        }
+        fr_.ljpme_c6grid = c6grid_.data();
+        if (useSoftCore)
+        {
+            fr_.sc_alphavdw   = 0.5;
+            fr_.sc_alphacoul  = 0.5;
+            fr_.sc_power      = 1;
+            fr_.sc_r_power    = 6;
+            fr_.sc_sigma6_def = gmx::power6(0.3);
+            fr_.sc_sigma6_min = gmx::power6(0.3);
+        }
+
+        /* Put the atoms in a box larger than the cut-off, so part of the
+         * pairs is beyond the cut-off, and put one atom close to the first
+         * i-atom to test the soft-core region.
+         */
+        DefaultRandomEngine           rng(12345);
+        UniformRealDistribution<real> dist(0, c_boxSize);
+        x_.resize(c_numAtoms);
+        for (auto& x : x_)
+        {
+            x = { dist(rng), dist(rng), dist(rng) };
+        }
+        x_[c_numIAtoms] = x_[0] + RVec(0.05, 0.02, 0);
+
+        chargeA_.resize(c_numAtoms);
+        chargeB_.resize(c_numAtoms);
+        typeA_.resize(c_numAtoms);
+        typeB_.resize(c_numAtoms);
+        for (int a = 0; a < c_numAtoms; a++)
+        {
+            chargeA_[a] = (a % 2 == 0 ? 0.4 : -0.3) + 0.01 * a;
+            typeA_[a]   = a % 2;
+            /* The i-atoms are perturbed, the first ones decouple completely */
+            if (a < c_numIAtoms)
+            {
+                chargeB_[a] = (a < 3 ? 0 : -chargeA_[a]);
+                typeB_[a]   = (a < 3 ? c_numTypes - 1 : 1 - typeA_[a]);
+            }
+            else
+            {
+                chargeB_[a] = chargeA_[a];
+                typeB_[a]   = typeA_[a];
+            }
+        }
+        mdatoms_.chargeA = chargeA_.data();
+        mdatoms_.chargeB = chargeB_.data();
+        mdatoms_.typeA   = typeA_.data();
+        mdatoms_.typeB   = typeB_.data();
+
+        /* Each i-atom interacts with itself and all later atoms,
+         * the self-interaction and the next atom are excluded.
+         * The pairs are stored in a cluster pair list with one
+         * i-entry per i-cluster.
+         */
+        for (int c = 0; c < c_numClusters * c_clusterSize; c++)
+        {
+            atomIndices_.push_back(c < c_numAtoms ? c : -1);
+        }
+        nlist_.na_ci       = c_clusterSize;
+        nlist_.na_cj       = c_clusterSize;
+        nlist_.atomIndices = atomIndices_;
+        for (int ci = 0; ci * c_clusterSize < c_numIAtoms; ci++)
+        {
+            nbnxn_fep_ci_t ciEntry;
+            ciEntry.ci           = ci;
+            ciEntry.shift        = CENTRAL;
+            ciEntry.gid          = 0;
+            ciEntry.cj_ind_start = nlist_.cj.size();
+            for (int cj = ci; cj < c_numClusters; cj++)
+            {
+                nbnxn_fep_cj_t cjEntry = { cj, 0, 0 };
+                for (int i = 0; i < c_clusterSize; i++)
+                {
+                    for (int j = 0; j < c_clusterSize; j++)
+                    {
+                        const int ai = ci * c_clusterSize + i;
+                        const int aj = cj * c_clusterSize + j;
+                        if (ai < c_numIAtoms && aj >= ai && aj < c_numAtoms)
+                        {
+                            const uint64_t pairBit = uint64_t(1) << (i * c_clusterSize + j);
+                            cjEntry.pairs |= pairBit;
+                            if (aj != ai && aj != ai + 1)
+                            {
+                                cjEntry.interactions |= pairBit;
+                            }
+                            nlist_.numPairs++;
+                        }
+                    }
+                }
+                nlist_.cj.push_back(cjEntry);
+            }
+            ciEntry.cj_ind_end = nlist_.cj.size();
+            nlist_.ci.push_back(ciEntry);
+        }
+    }
+
+    //! Runs the kernel with or without SIMD
+    KernelOutput runKernel(bool useSimd)
+    {
+        KernelOutput output;
+        output.force.resize(c_numAtoms + 1, { 0, 0, 0 });
+        output.shiftForce.resize(SHIFTS, { 0, 0, 0 });
+
+        fr_.use_simd_kernels = useSimd;
+
+        real lambda[efptNR] = { 0 };
+        lambda[efptCOUL]    = 0.35;
+        lambda[efptVDW]     = lambdasDiffer_ ? 0.6 : 0.35;
+        real dvdl[efptNR]   = { 0 };
+
+        nb_kernel_data_t kernelData;
+        kernelData.flags = GMX_NONBONDED_DO_FORCE | GMX_NONBONDED_DO_SHIFTFORCE | GMX_NONBONDED_DO_POTENTIAL;
+        kernelData.exclusions     = nullptr;
+        kernelData.lambda         = lambda;
+        kernelData.dvdl           = dvdl;
+        kernelData.table_elec     = nullptr;
+        kernelData.table_vdw      = nullptr;
+        kernelData.table_elec_vdw = nullptr;
+        kernelData.energygrp_elec = &output.energy[0];
+        kernelData.energygrp_vdw  = &output.energy[1];
+
+        ForceWithShiftForces forceWithShiftForces(
+                ArrayRefWithPadding<RVec>(output.force.data(), output.force.data() + c_numAtoms,
+                                          output.force.data() + output.force.size()),
+                true, output.shiftForce);
+        t_nrnb nrnb;
+        gmx_nb_free_energy_kernel(&nlist_, as_rvec_array(x_.data()), &forceWithShiftForces, &fr_,
+                                  &mdatoms_, &kernelData, &nrnb);
+
+        output.dvdl[0] = dvdl[efptCOUL];
+        output.dvdl[1] = dvdl[efptVDW];
+
+        return output;
+    }
+
+private:
+    VdwVariant          vdwVariant_;
+    bool                lambdasDiffer_;
+    interaction_const_t ic_;
+    t_forcerec          fr_;
+    std::vector<real>   c6grid_;
+    std::vector<RVec>   x_;
+    std::vector<real>   chargeA_, chargeB_;
+    std::vector<int>    typeA_, typeB_;
+    t_mdatoms           mdatoms_ = {};
+    std::vector<int>    atomIndices_;
+    NbnxnPairlistFep    nlist_;
+};
+
+TEST_P(FepKernelTest, SimdMatchesPlainC)
+{
+    const KernelOutput reference = runKernel(false);
+    const KernelOutput simd      = runKernel(true);
+
+    real maxForce = 0;
+    for (int a = 0; a < c_numAtoms; a++)
+    {
+        for (int d = 0; d < DIM; d++)
+        {
+            maxForce = std::max(maxForce, std::abs(reference.force[a][d]));
+        }
+    }
+    ASSERT_GT(maxForce, 0) << "The test system should have interactions";
+
+    /* The SIMD math functions and the summation order differ slightly,
+     * so we compare with a tolerance relative to the largest value.
+     */
+    const FloatingPointTolerance forceTolerance =
+            absoluteTolerance(maxForce * (GMX_DOUBLE ? 1e-10 : 2e-5));
+    for (int a = 0; a < c_numAtoms; a++)
+    {
+        for (int d = 0; d < DIM; d++)
+        {
+            EXPECT_REAL_EQ_TOL(reference.force[a][d], simd.force[a][d], forceTolerance)
+                    << "force on atom " << a << " dim " << d;
+        }
+    }
+    for (int d = 0; d < DIM; d++)
+    {
+        EXPECT_REAL_EQ_TOL(reference.shiftForce[CENTRAL][d], simd.shiftForce[CENTRAL][d], forceTolerance);
+    }
+    for (int t = 0; t < 2; t++)
+    {
+        const real scale = std::max(std::abs(reference.energy[t]), std::abs(reference.dvdl[t]));
+        const FloatingPointTolerance energyTolerance =
+                absoluteTolerance(std::max(scale, real(1)) * (GMX_DOUBLE ? 1e-10 : 2e-5));
+        EXPECT_REAL_EQ_TOL(reference.energy[t], simd.energy[t], energyTolerance) << "energy term " << t;
+        EXPECT_REAL_EQ_TOL(reference.dvdl[t], simd.dvdl[t], energyTolerance) << "dV/dl term " << t;
+    }
+}
+
+INSTANTIATE_TEST_CASE_P(ReactionField,
+                        FepKernelTest,
+                        ::testing::Combine(::testing::Values(eelRF),
+                                           ::testing::Values(VdwVariant::PotentialShift,
+                                                             VdwVariant::PotentialSwitch),
+                                           ::testing::Bool(),
+                                           ::testing::Bool()));
+
+INSTANTIATE_TEST_CASE_P(Ewald,
+                        FepKernelTest,
+                        ::testing::Combine(::testing::Values(eelPME),
+                                           ::testing::Values(VdwVariant::PotentialShift,
+                                                             VdwVariant::PotentialSwitch,
+                                                             VdwVariant::LJPme),
+                                           ::testing::Bool(),
+                                           ::testing::Bool()));
+
+} // namespace
+} // namespace test
+} // namespace gmx
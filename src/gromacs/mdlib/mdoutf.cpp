@@ -37,6 +37,16 @@
 
 #include "mdoutf.h"
 
+#include <cstdlib>
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
 #include "gromacs/commandline/filenm.h"
 #include "gromacs/domdec/collect.h"
 #include "gromacs/domdec/domdec_struct.h"
@@ -44,6 +54,7 @@
 #include "gromacs/fileio/gmxfio.h"
 #include "gromacs/fileio/tngio.h"
 #include "gromacs/fileio/trrio.h"
+#include "gromacs/fileio/xtcindex.h"
 #include "gromacs/fileio/xtcio.h"
 #include "gromacs/fileio/xvgr.h"
 #include "gromacs/math/vec.h"
@@ -58,10 +69,47 @@
 #include "gromacs/mdtypes/state.h"
 #include "gromacs/timing/wallcycle.h"
 #include "gromacs/topology/topology.h"
+#include "gromacs/utility/exceptions.h"
 #include "gromacs/utility/fatalerror.h"
 #include "gromacs/utility/pleasecite.h"
 #include "gromacs/utility/smalloc.h"
 
+namespace
+{
+
+/*! \brief Trajectory data of one output step
+ *
+ * The pointers refer to the global state on the master rank, or to
+ * the buffers of an AsyncTrajectoryWriter when written asynchronously.
+ */
+struct TrajectoryFrame
+{
+    //! Which data to write, MDOF_CPT is ignored
+    unsigned int mdof_flags;
+    //! The total number of atoms
+    int natoms;
+    //! The MD step
+    int64_t step;
+    //! The time
+    double t;
+    //! The FEP lambda
+    real lambda;
+    //! The box
+    matrix box;
+    //! Coordinates, can be nullptr when not written
+    const rvec* x;
+    //! Velocities, can be nullptr when not written
+    const rvec* v;
+    //! Forces, can be nullptr when not written
+    const rvec* f;
+    //! Coordinates for compressed output, can be nullptr when not written
+    const rvec* xCompressed;
+};
+
+class AsyncTrajectoryWriter;
+
+} // namespace
+
 struct gmx_mdoutf
 {
     t_fileio*                     fp_trn;
@@ -86,8 +134,231 @@ struct gmx_mdoutf
     const gmx::MdModulesNotifier* mdModulesNotifier;
     bool                          simulationsShareState;
     MPI_Comm                      mpiCommMasters;
+    AsyncTrajectoryWriter*        asyncWriter; /* Writes frames on a separate thread, can be NULL */
+};
+
+namespace
+{
+
+//! Writes the trajectory data in \p frame to the open output files of \p of
+void write_trajectory_frame(gmx_mdoutf_t of, const TrajectoryFrame& frame)
+{
+    const unsigned int mdof_flags = frame.mdof_flags;
+    const int          natoms     = frame.natoms;
+    const int64_t      step       = frame.step;
+    const double       t          = frame.t;
+    const real         lambda     = frame.lambda;
+    /* The TNG and XTC writers take a non-const box */
+    matrix box;
+    copy_mat(frame.box, box);
+
+    if (mdof_flags & (MDOF_X | MDOF_V | MDOF_F))
+    {
+        const rvec* x = (mdof_flags & MDOF_X) ? frame.x : nullptr;
+        const rvec* v = (mdof_flags & MDOF_V) ? frame.v : nullptr;
+        const rvec* f = (mdof_flags & MDOF_F) ? frame.f : nullptr;
+
+        if (of->fp_trn)
+        {
+            gmx_trr_write_frame(of->fp_trn, step, t, lambda, box, natoms, x, v, f);
+            if (gmx_fio_flush(of->fp_trn) != 0)
+            {
+                gmx_file("Cannot write trajectory; maybe you are out of disk space?");
+            }
+        }
+
+        /* If a TNG file is open for uncompressed coordinate output also write
+           velocities and forces to it. */
+        else if (of->tng)
+        {
+            gmx_fwrite_tng(of->tng, FALSE, step, t, lambda, box, natoms, x, v, f);
+        }
+        /* If only a TNG file is open for compressed coordinate output (no uncompressed
+           coordinate output) also write forces and velocities to it. */
+        else if (of->tng_low_prec)
+        {
+            gmx_fwrite_tng(of->tng_low_prec, FALSE, step, t, lambda, box, natoms, x, v, f);
+        }
+    }
+    if (mdof_flags & MDOF_X_COMPRESSED)
+    {
+        if (write_xtc(of->fp_xtc, of->natoms_x_compressed, step, t, box, frame.xCompressed,
+                      of->x_compression_precision)
+            == 0)
+        {
+            gmx_fatal(FARGS,
+                      "XTC error. This indicates you are out of disk space, or a "
+                      "simulation with major instabilities resulting in coordinates "
+                      "that are NaN or too large to be represented in the XTC format.\n");
+        }
+        gmx_fwrite_tng(of->tng_low_prec, TRUE, step, t, lambda, box, of->natoms_x_compressed,
+                       frame.xCompressed, nullptr, nullptr);
+    }
+    if (mdof_flags & (MDOF_BOX | MDOF_LAMBDA) && !(mdof_flags & (MDOF_X | MDOF_V | MDOF_F)))
+    {
+        if (of->tng)
+        {
+            gmx_fwrite_tng(of->tng, FALSE, step, t, (mdof_flags & MDOF_LAMBDA) ? lambda : -1,
+                           (mdof_flags & MDOF_BOX) ? box : nullptr, natoms, nullptr, nullptr, nullptr);
+        }
+    }
+    if (mdof_flags & (MDOF_BOX_COMPRESSED | MDOF_LAMBDA_COMPRESSED)
+        && !(mdof_flags & (MDOF_X_COMPRESSED)))
+    {
+        if (of->tng_low_prec)
+        {
+            gmx_fwrite_tng(of->tng_low_prec, FALSE, step, t,
+                           (mdof_flags & MDOF_LAMBDA_COMPRESSED) ? lambda : -1,
+                           (mdof_flags & MDOF_BOX_COMPRESSED) ? box : nullptr, natoms, nullptr,
+                           nullptr, nullptr);
+        }
+    }
+}
+
+/*! \brief Writes trajectory frames on a dedicated I/O thread
+ *
+ * The master rank copies each output frame into one of a pool of
+ * reusable buffers and continues the simulation, while the I/O thread
+ * compresses and writes the frames in order. When all buffers are in
+ * use, submitting waits for a buffer to become free. flush() waits until
+ * all submitted frames are written, which is needed before the file
+ * positions are used, i.e. at checkpointing and when closing files.
+ */
+class AsyncTrajectoryWriter
+{
+public:
+    //! Starts the I/O thread writing to \p of using \p numBuffers frame buffers
+    AsyncTrajectoryWriter(gmx_mdoutf_t of, int numBuffers) : of_(of), buffers_(numBuffers)
+    {
+        for (auto& buffer : buffers_)
+        {
+            freeBuffers_.push_back(&buffer);
+        }
+        thread_ = std::thread([this]() { writerLoop(); });
+    }
+    ~AsyncTrajectoryWriter()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            bStop_ = true;
+        }
+        queueChanged_.notify_all();
+        thread_.join();
+    }
+
+    //! Copies \p frame into a free buffer and queues it for writing
+    void submit(const TrajectoryFrame& frame)
+    {
+        FrameBuffer* buffer;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            bufferFreed_.wait(lock, [this]() { return !freeBuffers_.empty(); });
+            buffer = freeBuffers_.back();
+            freeBuffers_.pop_back();
+        }
+
+        buffer->frame             = frame;
+        buffer->frame.x           = copyVector(frame.x, frame.natoms, &buffer->x);
+        buffer->frame.v           = copyVector(frame.v, frame.natoms, &buffer->v);
+        buffer->frame.f           = copyVector(frame.f, frame.natoms, &buffer->f);
+        buffer->frame.xCompressed =
+                copyVector(frame.xCompressed, of_->natoms_x_compressed, &buffer->xCompressed);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            queue_.push_back(buffer);
+        }
+        queueChanged_.notify_all();
+    }
+
+    //! Waits until all submitted frames have been written
+    void flush()
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        bufferFreed_.wait(lock, [this]() { return queue_.empty() && !bWriting_; });
+    }
+
+private:
+    //! Buffer holding a copy of the data of a frame
+    struct FrameBuffer
+    {
+        //! The frame with pointers into the vectors below
+        TrajectoryFrame frame;
+        //! Coordinate buffer
+        std::vector<gmx::RVec> x;
+        //! Velocity buffer
+        std::vector<gmx::RVec> v;
+        //! Force buffer
+        std::vector<gmx::RVec> f;
+        //! Compressed coordinate buffer
+        std::vector<gmx::RVec> xCompressed;
+    };
+
+    //! Copies \p n vectors from \p src into \p dest, returns the copy or nullptr
+    static const rvec* copyVector(const rvec* src, int n, std::vector<gmx::RVec>* dest)
+    {
+        if (src == nullptr)
+        {
+            return nullptr;
+        }
+        dest->assign(reinterpret_cast<const gmx::RVec*>(src), reinterpret_cast<const gmx::RVec*>(src) + n);
+        return as_rvec_array(dest->data());
+    }
+
+    //! The loop run by the I/O thread
+    void writerLoop()
+    {
+        try
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            while (true)
+            {
+                queueChanged_.wait(lock, [this]() { return !queue_.empty() || bStop_; });
+                if (queue_.empty())
+                {
+                    /* Stop requested and everything written */
+                    break;
+                }
+                FrameBuffer* buffer = queue_.front();
+                queue_.pop_front();
+                bWriting_ = true;
+                lock.unlock();
+
+                write_trajectory_frame(of_, buffer->frame);
+
+                lock.lock();
+                bWriting_ = false;
+                freeBuffers_.push_back(buffer);
+                bufferFreed_.notify_all();
+            }
+        }
+        GMX_CATCH_ALL_AND_EXIT_WITH_FATAL_ERROR
+    }
+
+    //! The output files
+    gmx_mdoutf_t of_;
+    //! The pool of frame buffers
+    std::vector<FrameBuffer> buffers_;
+    //! Buffers available for new frames
+    std::vector<FrameBuffer*> freeBuffers_;
+    //! Frames waiting to be written, in order
+    std::deque<FrameBuffer*> queue_;
+    //! Whether the I/O thread is writing a frame
+    bool bWriting_ = false;
+    //! Whether the I/O thread should stop
+    bool bStop_ = false;
+    //! Protects the members above
+    std::mutex mutex_;
+    //! Signals new frames or a stop request to the I/O thread
+    std::condition_variable queueChanged_;
+    //! Signals that a frame has been written and its buffer is free
+    std::condition_variable bufferFreed_;
+    //! The I/O thread
+    std::thread thread_;
 };
 
+} // namespace
+
 
 gmx_mdoutf_t init_mdoutf(FILE*                         fplog,
                          int                           nfile,
@@ -118,6 +389,7 @@ gmx_mdoutf_t init_mdoutf(FILE*                         fplog,
     of->tng          = nullptr;
     of->tng_low_prec = nullptr;
     of->fp_dhdl      = nullptr;
+    of->asyncWriter  = nullptr;
 
     of->eIntegrator             = ir->eI;
     of->bExpanded               = ir->bExpanded;
@@ -230,6 +502,22 @@ gmx_mdoutf_t init_mdoutf(FILE*                         fplog,
         {
             snew(of->f_global, top_global->natoms);
         }
+
+        /* Optionally write trajectory frames on a separate thread, the value
+         * sets the number of frame buffers, i.e. how many frames the
+         * simulation can run ahead of the writing.
+         */
+        const char* asyncEnv = getenv("GMX_ASYNC_TRAJECTORY_OUTPUT");
+        if (asyncEnv != nullptr && (of->fp_trn || of->fp_xtc || of->tng || of->tng_low_prec))
+        {
+            int numBuffers = std::max(std::atoi(asyncEnv), 2);
+            of->asyncWriter = new AsyncTrajectoryWriter(of, numBuffers);
+            if (fplog)
+            {
+                fprintf(fplog, "Writing trajectory frames asynchronously using %d frame buffers\n",
+                        numBuffers);
+            }
+        }
     }
 
     if (bCiteTng)
@@ -307,6 +595,13 @@ void mdoutf_write_to_trajectory_files(FILE*                    fplog,
     {
         if (mdof_flags & MDOF_CPT)
         {
+            /* The checkpoint stores the output file positions, so all
+             * earlier frames need to be written out first.
+             */
+            if (of->asyncWriter)
+            {
+                of->asyncWriter->flush();
+            }
             fflush_tng(of->tng);
             fflush_tng(of->tng_low_prec);
             /* Write the checkpoint file.
@@ -323,41 +618,21 @@ void mdoutf_write_to_trajectory_files(FILE*                    fplog,
                              of->simulationsShareState, of->mpiCommMasters);
         }
 
-        if (mdof_flags & (MDOF_X | MDOF_V | MDOF_F))
-        {
-            const rvec* x = (mdof_flags & MDOF_X) ? state_global->x.rvec_array() : nullptr;
-            const rvec* v = (mdof_flags & MDOF_V) ? state_global->v.rvec_array() : nullptr;
-            const rvec* f = (mdof_flags & MDOF_F) ? f_global : nullptr;
-
-            if (of->fp_trn)
-            {
-                gmx_trr_write_frame(of->fp_trn, step, t, state_local->lambda[efptFEP],
-                                    state_local->box, natoms, x, v, f);
-                if (gmx_fio_flush(of->fp_trn) != 0)
-                {
-                    gmx_file("Cannot write trajectory; maybe you are out of disk space?");
-                }
-            }
-
-            /* If a TNG file is open for uncompressed coordinate output also write
-               velocities and forces to it. */
-            else if (of->tng)
-            {
-                gmx_fwrite_tng(of->tng, FALSE, step, t, state_local->lambda[efptFEP],
-                               state_local->box, natoms, x, v, f);
-            }
-            /* If only a TNG file is open for compressed coordinate output (no uncompressed
-               coordinate output) also write forces and velocities to it. */
-            else if (of->tng_low_prec)
-            {
-                gmx_fwrite_tng(of->tng_low_prec, FALSE, step, t, state_local->lambda[efptFEP],
-                               state_local->box, natoms, x, v, f);
-            }
-        }
+        TrajectoryFrame frame;
+        frame.mdof_flags  = mdof_flags;
+        frame.natoms      = natoms;
+        frame.step        = step;
+        frame.t           = t;
+        frame.lambda      = state_local->lambda[efptFEP];
+        frame.x           = (mdof_flags & MDOF_X) ? state_global->x.rvec_array() : nullptr;
+        frame.v           = (mdof_flags & MDOF_V) ? state_global->v.rvec_array() : nullptr;
+        frame.f           = (mdof_flags & MDOF_F) ? f_global : nullptr;
+        frame.xCompressed = nullptr;
+        copy_mat(state_local->box, frame.box);
+
+        rvec* xxtc = nullptr;
         if (mdof_flags & MDOF_X_COMPRESSED)
         {
-            rvec* xxtc = nullptr;
-
             if (of->natoms_x_compressed == of->natoms_global)
             {
                 /* We are writing the positions of all of the atoms to
@@ -381,63 +656,32 @@ void mdoutf_write_to_trajectory_files(FILE*                    fplog,
                     }
                 }
             }
-            if (write_xtc(of->fp_xtc, of->natoms_x_compressed, step, t, state_local->box, xxtc,
-                          of->x_compression_precision)
-                == 0)
-            {
-                gmx_fatal(FARGS,
-                          "XTC error. This indicates you are out of disk space, or a "
-                          "simulation with major instabilities resulting in coordinates "
-                          "that are NaN or too large to be represented in the XTC format.\n");
-            }
-            gmx_fwrite_tng(of->tng_low_prec, TRUE, step, t, state_local->lambda[efptFEP],
-                           state_local->box, of->natoms_x_compressed, xxtc, nullptr, nullptr);
-            if (of->natoms_x_compressed != of->natoms_global)
-            {
-                sfree(xxtc);
-            }
+            frame.xCompressed = xxtc;
         }
-        if (mdof_flags & (MDOF_BOX | MDOF_LAMBDA) && !(mdof_flags & (MDOF_X | MDOF_V | MDOF_F)))
+
+        if (of->asyncWriter)
         {
-            if (of->tng)
-            {
-                real  lambda = -1;
-                rvec* box    = nullptr;
-                if (mdof_flags & MDOF_BOX)
-                {
-                    box = state_local->box;
-                }
-                if (mdof_flags & MDOF_LAMBDA)
-                {
-                    lambda = state_local->lambda[efptFEP];
-                }
-                gmx_fwrite_tng(of->tng, FALSE, step, t, lambda, box, natoms, nullptr, nullptr, nullptr);
-            }
+            /* Only copy the frame, the I/O thread does the writing */
+            of->asyncWriter->submit(frame);
         }
-        if (mdof_flags & (MDOF_BOX_COMPRESSED | MDOF_LAMBDA_COMPRESSED)
-            && !(mdof_flags & (MDOF_X_COMPRESSED)))
+        else
         {
-            if (of->tng_low_prec)
-            {
-                real  lambda = -1;
-                rvec* box    = nullptr;
-                if (mdof_flags & MDOF_BOX_COMPRESSED)
-                {
-                    box = state_local->box;
-                }
-                if (mdof_flags & MDOF_LAMBDA_COMPRESSED)
-                {
-                    lambda = state_local->lambda[efptFEP];
-                }
-                gmx_fwrite_tng(of->tng_low_prec, FALSE, step, t, lambda, box, natoms, nullptr,
-                               nullptr, nullptr);
-            }
+            write_trajectory_frame(of, frame);
+        }
+
+        if (xxtc != nullptr && of->natoms_x_compressed != of->natoms_global)
+        {
+            sfree(xxtc);
         }
     }
 }
 
 void mdoutf_tng_close(gmx_mdoutf_t of)
 {
+    if (of->asyncWriter)
+    {
+        of->asyncWriter->flush();
+    }
     if (of->tng || of->tng_low_prec)
     {
         wallcycle_start(of->wcycle, ewcTRAJ);
@@ -449,13 +693,23 @@ void mdoutf_tng_close(gmx_mdoutf_t of)
 
 void done_mdoutf(gmx_mdoutf_t of)
 {
+    /* Write all pending frames and stop the I/O thread before closing the files */
+    delete of->asyncWriter;
+    of->asyncWriter = nullptr;
+
     if (of->fp_ene != nullptr)
     {
         done_ener_file(of->fp_ene);
     }
     if (of->fp_xtc)
     {
+        const std::string xtcFileName = gmx_fio_getname(of->fp_xtc);
         close_xtc(of->fp_xtc);
+        if (getenv("GMX_XTC_FRAME_INDEX") != nullptr)
+        {
+            /* Leave a frame index next to the trajectory for analysis tools */
+            gmx::writeXtcFrameIndexForFile(xtcFileName);
+        }
     }
     if (of->fp_trn)
     {
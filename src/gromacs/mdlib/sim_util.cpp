@@ -1179,6 +1179,13 @@ void do_force(FILE*                               fplog,
         launchPmeGpuSpread(fr->pmedata, box, stepWork, localXReadyOnDevice, wcycle);
     }
 
+    /* With CPU lists, there is no work that needs to be done between the local
+     * and non-local search, so we can search both in a single parallel region.
+     * With GPU lists we want to launch the local non-bonded work before the non-local search.
+     */
+    const bool searchLocalAndNonLocalTogether =
+            (stepWork.doNeighborSearch && havePPDomainDecomposition(cr) && nbv->pairlistIsSimple());
+
     /* do gridding for pair search */
     if (stepWork.doNeighborSearch)
     {
@@ -1251,13 +1258,24 @@ void do_force(FILE*                               fplog,
                 *inputrec, *fr, pull_work, ed, top->idef, *fcd, *mdatoms, simulationWork, stepWork);
 
         wallcycle_start_nocount(wcycle, ewcNS);
-        wallcycle_sub_start(wcycle, ewcsNBS_SEARCH_LOCAL);
-        /* Note that with a GPU the launch overhead of the list transfer is not timed separately */
-        nbv->constructPairlist(InteractionLocality::Local, top->excls, step, nrnb);
-
-        nbv->setupGpuShortRangeWork(fr->gpuBonded, InteractionLocality::Local);
+        if (searchLocalAndNonLocalTogether)
+        {
+            /* Threads continue with the non-local search without waiting for the local search
+             * of other threads, so the two searches can only be timed together.
+             */
+            wallcycle_sub_start(wcycle, ewcsNBS_SEARCH_LOCAL_NONLOCAL);
+            nbv->constructLocalAndNonLocalPairlists(top->excls, step, nrnb);
+            wallcycle_sub_stop(wcycle, ewcsNBS_SEARCH_LOCAL_NONLOCAL);
+        }
+        else
+        {
+            wallcycle_sub_start(wcycle, ewcsNBS_SEARCH_LOCAL);
+            /* Note that with a GPU the launch overhead of the list transfer is not timed separately */
+            nbv->constructPairlist(InteractionLocality::Local, top->excls, step, nrnb);
 
-        wallcycle_sub_stop(wcycle, ewcsNBS_SEARCH_LOCAL);
+            nbv->setupGpuShortRangeWork(fr->gpuBonded, InteractionLocality::Local);
+            wallcycle_sub_stop(wcycle, ewcsNBS_SEARCH_LOCAL);
+        }
         wallcycle_stop(wcycle, ewcNS);
 
         if (stepWork.useGpuXBufferOps)
@@ -1343,14 +1361,17 @@ void do_force(FILE*                               fplog,
         if (stepWork.doNeighborSearch)
         {
             // TODO: fuse this branch with the above large stepWork.doNeighborSearch block
-            wallcycle_start_nocount(wcycle, ewcNS);
-            wallcycle_sub_start(wcycle, ewcsNBS_SEARCH_NONLOCAL);
-            /* Note that with a GPU the launch overhead of the list transfer is not timed separately */
-            nbv->constructPairlist(InteractionLocality::NonLocal, top->excls, step, nrnb);
-
-            nbv->setupGpuShortRangeWork(fr->gpuBonded, InteractionLocality::NonLocal);
-            wallcycle_sub_stop(wcycle, ewcsNBS_SEARCH_NONLOCAL);
-            wallcycle_stop(wcycle, ewcNS);
+            if (!searchLocalAndNonLocalTogether)
+            {
+                wallcycle_start_nocount(wcycle, ewcNS);
+                wallcycle_sub_start(wcycle, ewcsNBS_SEARCH_NONLOCAL);
+                /* Note that with a GPU the launch overhead of the list transfer is not timed separately */
+                nbv->constructPairlist(InteractionLocality::NonLocal, top->excls, step, nrnb);
+
+                nbv->setupGpuShortRangeWork(fr->gpuBonded, InteractionLocality::NonLocal);
+                wallcycle_sub_stop(wcycle, ewcsNBS_SEARCH_NONLOCAL);
+                wallcycle_stop(wcycle, ewcNS);
+            }
             // TODO refactor this GPU halo exchange re-initialisation
             // to location in do_md where GPU halo exchange is
             // constructed at partitioning, after above stateGpu
@@ -125,6 +125,7 @@
 #include "gromacs/modularsimulator/energyelement.h"
 #include "gromacs/nbnxm/gpu_data_mgmt.h"
 #include "gromacs/nbnxm/nbnxm.h"
+#include "gromacs/nbnxm/pairlist_tuning.h"
 #include "gromacs/pbcutil/pbc.h"
 #include "gromacs/pulling/output.h"
 #include "gromacs/pulling/pull.h"
@@ -473,6 +474,17 @@ void gmx::LegacySimulator::do_md()
                          fr->nbv->useGpu());
     }
 
+    /* Tuning of the pair-list setup at run time is only supported without DD
+     * and should not interfere with PME tuning, which also changes the list radii.
+     */
+    std::unique_ptr<PairlistSetupTuner> pairlistTuner;
+    if (mdrunOptions.tuneNstlist && !mdrunOptions.reproducible && !DOMAINDECOMP(cr)
+        && !(bPMETune && pme_loadbal_is_active(pme_loadbal)) && wcycle != nullptr
+        && pairlistSetupCanBeTuned(*ir, *fr->nbv))
+    {
+        pairlistTuner = std::make_unique<PairlistSetupTuner>(mdlog, *ir, *top_global, *fr->ic, *fr->nbv);
+    }
+
     if (!ir->bContinuation)
     {
         if (state->flags & (1U << estV))
@@ -756,7 +768,14 @@ void gmx::LegacySimulator::do_md()
     {
 
         /* Determine if this is a neighbor search step */
-        bNStList = (ir->nstlist > 0 && step % ir->nstlist == 0);
+        const int nstlist = (pairlistTuner ? pairlistTuner->nstlist() : ir->nstlist);
+        bNStList          = (nstlist > 0 && step % nstlist == 0);
+
+        if (pairlistTuner && bNStList)
+        {
+            /* This can change the list radii for the search at this step */
+            pairlistTuner->tune(step, state->box, wcycle, fr);
+        }
 
         if (bPMETune && bNStList)
         {
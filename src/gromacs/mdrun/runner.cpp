@@ -1110,6 +1110,11 @@ int Mdrunner::mdrunner()
     prepare_verlet_scheme(fplog, cr, inputrec, nstlist_cmdline, &mtop, box,
                           useGpuForNonbonded || (emulateGpuNonbonded == EmulateGpuNonbonded::Yes),
                           *hwinfo->cpuInfo);
+    if (nstlist_cmdline > 0)
+    {
+        /* Keep the nstlist value set by the user */
+        mdrunOptions.tuneNstlist = FALSE;
+    }
 
     const bool prefer1DAnd1PulseDD = (devFlags.enableGpuHaloExchange && useGpuForNonbonded);
     // This builder is necessary while we have multi-part construction
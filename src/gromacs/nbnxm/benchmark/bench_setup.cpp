@@ -45,6 +45,7 @@
 
 #include "bench_setup.h"
 
+#include <chrono>
 #include <optional>
 
 #include "gromacs/gmxlib/nrnb.h"
@@ -184,6 +185,16 @@ static std::unique_ptr<nonbonded_verlet_t> setupNbnxmForBenchInstance(const Kern
     Nbnxm::KernelSetup kernelSetup = getKernelSetup(options);
 
     PairlistParams pairlistParams(kernelSetup.kernelType, false, options.pairlistCutoff, false);
+    if (options.timeSteps && options.nstlistPrune > 0)
+    {
+        // Mimic an MD setup where the outer list is buffered and pruned dynamically
+        pairlistParams.rlistOuter             = options.pairlistCutoff + options.pairlistBuffer;
+        pairlistParams.rlistInner             = options.pairlistCutoff;
+        pairlistParams.useDynamicPruning      = true;
+        pairlistParams.nstlistPrune           = options.nstlistPrune;
+        pairlistParams.numRollingPruningParts = 1;
+        pairlistParams.lifetime               = options.nstlist - 1;
+    }
 
     GridSet gridSet(PbcType::Xyz, false, nullptr, nullptr, pairlistParams.pairlistType, false,
                     numThreads, pinPolicy);
@@ -261,13 +272,243 @@ static void expandSimdOptionAndPushBack(const KernelBenchOptions&        options
     }
 }
 
+//! The parts of the non-bonded work in an MD step that are timed with KernelBenchOptions::timeSteps
+enum class StepPart : int
+{
+    Grid,
+    Pairlist,
+    CoordinateConversion,
+    Pruning,
+    Kernel,
+    ForceReduction,
+    Count
+};
+
+//! Short names of the timed parts, used in the output
+static const gmx::EnumerationArray<StepPart, const char*> c_stepPartNames = {
+    { "grid", "pairlist", "x-conversion", "pruning", "kernel", "force-reduction" }
+};
+
+//! Accumulated wall-clock time and number of calls for a timed part
+struct PartTiming
+{
+    //! The number of calls
+    int numCalls = 0;
+    //! The total time in seconds
+    double seconds = 0;
+};
+
+//! Runs \p work and adds its wall-clock time to \p timing
+template<typename Work>
+static void timePart(PartTiming* timing, Work&& work)
+{
+    const auto start = std::chrono::steady_clock::now();
+    work();
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    timing->numCalls++;
+    timing->seconds += elapsed.count();
+}
+
+//! Returns the simulation performance in ns/day for a step that takes \p secondsPerStep
+static double nsPerDay(const KernelBenchOptions& options, const double secondsPerStep)
+{
+    constexpr double c_secondsPerDay = 24 * 60 * 60;
+
+    return options.timeStep * 1e-3 * c_secondsPerDay / secondsPerStep;
+}
+
+//! Names of the kernel SIMD setups, used in the output
+static const gmx::EnumerationArray<BenchMarkKernels, std::string> c_kernelNames = { "auto", "no",
+                                                                                   "4xM", "2xMM" };
+
+//! Names of the LJ combination rules, used in the output
+static const gmx::EnumerationArray<BenchMarkCombRule, std::string> c_combruleNames = { "geom.", "LB",
+                                                                                      "none" };
+
+//! Prints the setup of a benchmark instance to \p fp, as comma-separated values when \p forData is true
+static void printInstanceSetup(FILE* fp, const KernelBenchOptions& options, const bool forData)
+{
+    const char* coulombName = options.coulombType == BenchMarkCoulomb::Pme ? "Ewald" : "RF";
+    const char* ljName      = options.useHalfLJOptimization ? "half" : "all";
+    const char* energyName  = options.computeVirialAndEnergy ? "yes" : "no";
+    if (forData)
+    {
+        fprintf(fp, "%d,%s,%s,%s,%s,%s,", options.numThreads, coulombName, ljName,
+                c_combruleNames[options.ljCombinationRule].c_str(),
+                c_kernelNames[options.nbnxmSimd].c_str(), energyName);
+    }
+    else
+    {
+        fprintf(fp, "%-7s %-4s %-5s %-4s %-3s ", coulombName, ljName,
+                c_combruleNames[options.ljCombinationRule].c_str(),
+                c_kernelNames[options.nbnxmSimd].c_str(), energyName);
+    }
+}
+
+void printBenchDataHeader(FILE* fp)
+{
+    fprintf(fp,
+            "atoms,threads,coulomb,lj,combrule,simd,energy,part,calls,ms_per_call,pairs_per_s,ns_"
+            "per_day\n");
+}
+
+/*! \brief Writes one line of machine-readable output for a timed part to \p fp
+ *
+ * The pair throughput and performance are only written when they are positive.
+ */
+static void printBenchDataLine(FILE*                     fp,
+                               const int                 numAtoms,
+                               const KernelBenchOptions& options,
+                               const char*               partName,
+                               const PartTiming&         timing,
+                               const double              pairsPerSecond,
+                               const double              nsPerDay)
+{
+    fprintf(fp, "%d,", numAtoms);
+    printInstanceSetup(fp, options, true);
+    fprintf(fp, "%s,%d,%.6f,", partName, timing.numCalls,
+            timing.numCalls > 0 ? timing.seconds * 1e3 / timing.numCalls : 0.0);
+    if (pairsPerSecond > 0)
+    {
+        fprintf(fp, "%.6e", pairsPerSecond);
+    }
+    fprintf(fp, ",");
+    if (nsPerDay > 0)
+    {
+        fprintf(fp, "%.3f", nsPerDay);
+    }
+    fprintf(fp, "\n");
+}
+
+/*! \brief Runs the requested number of MD steps and prints the time spent in each part
+ *
+ * Each step does the same non-bonded work as a step in mdrun without
+ * domain decomposition: putting atoms on the grid and building
+ * the pair list at search steps, converting coordinates at other steps,
+ * dynamic pruning when active, the kernel and the force reduction.
+ * As the coordinates do not change, the pair list is identical at every
+ * search step.
+ */
+static void runStepsInstance(const gmx::BenchmarkSystem& system,
+                             const KernelBenchOptions&   options,
+                             const bool                  doWarmup,
+                             const real                  numUsefulPairs,
+                             FILE*                       dataFile)
+{
+    std::unique_ptr<nonbonded_verlet_t> nbv = setupNbnxmForBenchInstance(options, system);
+
+    interaction_const_t ic = setupInteractionConst(options);
+
+    t_nrnb nrnb = { 0 };
+
+    gmx_enerdata_t enerd(1, 0);
+
+    gmx::StepWorkload stepWork;
+    stepWork.computeForces = true;
+    if (options.computeVirialAndEnergy)
+    {
+        stepWork.computeVirial = true;
+        stepWork.computeEnergy = true;
+    }
+
+    const rvec lowerCorner = { 0, 0, 0 };
+    const rvec upperCorner = { system.box[XX][XX], system.box[YY][YY], system.box[ZZ][ZZ] };
+
+    gmx::ArrayRef<const int> atomInfo =
+            (options.useHalfLJOptimization ? system.atomInfoOxygenVdw : system.atomInfoAllVdw);
+
+    const int  numAtoms    = system.coordinates.size();
+    const real atomDensity = numAtoms / det(system.box);
+
+    std::vector<gmx::RVec> force(numAtoms);
+
+    gmx::EnumerationArray<StepPart, PartTiming> timings;
+
+    const int numSteps = (doWarmup ? options.numWarmupIterations : options.numIterations);
+    for (int step = 0; step < numSteps; step++)
+    {
+        if (step % options.nstlist == 0)
+        {
+            timePart(&timings[StepPart::Grid], [&]() {
+                nbnxn_put_on_grid(nbv.get(), system.box, 0, lowerCorner, upperCorner, nullptr,
+                                  { 0, numAtoms }, atomDensity, atomInfo, system.coordinates, 0, nullptr);
+            });
+            timePart(&timings[StepPart::Pairlist], [&]() {
+                nbv->constructPairlist(gmx::InteractionLocality::Local, system.excls, step, &nrnb);
+                nbv->setAtomProperties(system.atomTypes, system.charges, atomInfo);
+            });
+        }
+        else
+        {
+            timePart(&timings[StepPart::CoordinateConversion], [&]() {
+                nbv->convertCoordinates(gmx::AtomLocality::Local, false, system.coordinates);
+            });
+        }
+
+        if (nbv->isDynamicPruningStepCpu(step))
+        {
+            timePart(&timings[StepPart::Pruning], [&]() {
+                nbv->dispatchPruneKernelCpu(gmx::InteractionLocality::Local, system.forceRec.shift_vec);
+            });
+        }
+
+        timePart(&timings[StepPart::Kernel], [&]() {
+            nbv->dispatchNonbondedKernel(gmx::InteractionLocality::Local, ic, stepWork,
+                                         enbvClearFYes, system.forceRec, &enerd, &nrnb);
+        });
+
+        timePart(&timings[StepPart::ForceReduction], [&]() {
+            nbv->atomdata_add_nbat_f_to_f(gmx::AtomLocality::All, force);
+        });
+    }
+
+    if (doWarmup)
+    {
+        return;
+    }
+
+    double     totalSeconds = 0;
+    const auto partNames    = gmx::keysOf(timings);
+    for (const auto part : partNames)
+    {
+        totalSeconds += timings[part].seconds;
+    }
+    const double secondsPerStep = totalSeconds / numSteps;
+    const double kernelPairsPerSecond =
+            numUsefulPairs * timings[StepPart::Kernel].numCalls / timings[StepPart::Kernel].seconds;
+
+    printInstanceSetup(stdout, options, false);
+    for (const auto part : partNames)
+    {
+        fprintf(stdout, " %7.4f", timings[part].seconds * 1e3 / numSteps);
+    }
+    fprintf(stdout, " %8.4f %8.2f %9.1f\n", secondsPerStep * 1e3, nsPerDay(options, secondsPerStep),
+            numUsefulPairs / secondsPerStep * 1e-6);
+
+    if (dataFile)
+    {
+        for (const auto part : partNames)
+        {
+            printBenchDataLine(dataFile, numAtoms, options, c_stepPartNames[part], timings[part],
+                               part == StepPart::Kernel ? kernelPairsPerSecond : 0, 0);
+        }
+        PartTiming stepTiming;
+        stepTiming.numCalls = numSteps;
+        stepTiming.seconds  = totalSeconds;
+        printBenchDataLine(dataFile, numAtoms, options, "step", stepTiming,
+                           numUsefulPairs / secondsPerStep, nsPerDay(options, secondsPerStep));
+    }
+}
+
 //! Sets up and runs the requested benchmark instance and prints the results
 //
 // When \p doWarmup is true runs the warmup iterations instead
 // of the normal ones and does not print any results
 static void setupAndRunInstance(const gmx::BenchmarkSystem& system,
                                 const KernelBenchOptions&   options,
-                                const bool                  doWarmup)
+                                const bool                  doWarmup,
+                                FILE*                       dataFile)
 {
     // Generate an, accurate, estimate of the number of non-zero pair interactions
     const real atomDensity = system.coordinates.size() / det(system.box);
@@ -275,6 +516,13 @@ static void setupAndRunInstance(const gmx::BenchmarkSystem& system,
             atomDensity * 4.0 / 3.0 * M_PI * std::pow(options.pairlistCutoff, 3);
     const real numUsefulPairs = system.coordinates.size() * 0.5 * (numPairsWithinCutoff + 1);
 
+    if (options.timeSteps)
+    {
+        runStepsInstance(system, options, doWarmup, numUsefulPairs, dataFile);
+
+        return;
+    }
+
     std::unique_ptr<nonbonded_verlet_t> nbv = setupNbnxmForBenchInstance(options, system);
 
     // We set the interaction cut-off to the pairlist cut-off
@@ -292,18 +540,9 @@ static void setupAndRunInstance(const gmx::BenchmarkSystem& system,
         stepWork.computeEnergy = true;
     }
 
-    const gmx::EnumerationArray<BenchMarkKernels, std::string> kernelNames = { "auto", "no", "4xM",
-                                                                               "2xMM" };
-
-    const gmx::EnumerationArray<BenchMarkCombRule, std::string> combruleNames = { "geom.", "LB",
-                                                                                  "none" };
-
     if (!doWarmup)
     {
-        fprintf(stdout, "%-7s %-4s %-5s %-4s ",
-                options.coulombType == BenchMarkCoulomb::Pme ? "Ewald" : "RF",
-                options.useHalfLJOptimization ? "half" : "all",
-                combruleNames[options.ljCombinationRule].c_str(), kernelNames[options.nbnxmSimd].c_str());
+        printInstanceSetup(stdout, options, false);
     }
 
     // Run pre-iteration to avoid cache misses
@@ -316,14 +555,18 @@ static void setupAndRunInstance(const gmx::BenchmarkSystem& system,
     const int numIterations = (doWarmup ? options.numWarmupIterations : options.numIterations);
     const PairlistSet& pairlistSet = nbv->pairlistSets().pairlistSet(gmx::InteractionLocality::Local);
     const gmx::index numPairs = pairlistSet.natpair_ljq_ + pairlistSet.natpair_lj_ + pairlistSet.natpair_q_;
+    PartTiming kernelTiming;
     gmx_cycles_t cycles = gmx_cycles_read();
-    for (int iter = 0; iter < numIterations; iter++)
-    {
-        // Run the kernel without force clearing
-        nbv->dispatchNonbondedKernel(gmx::InteractionLocality::Local, ic, stepWork, enbvClearFNo,
-                                     system.forceRec, &enerd, &nrnb);
-    }
+    timePart(&kernelTiming, [&]() {
+        for (int iter = 0; iter < numIterations; iter++)
+        {
+            // Run the kernel without force clearing
+            nbv->dispatchNonbondedKernel(gmx::InteractionLocality::Local, ic, stepWork,
+                                         enbvClearFNo, system.forceRec, &enerd, &nrnb);
+        }
+    });
     cycles = gmx_cycles_read() - cycles;
+    kernelTiming.numCalls = numIterations;
     if (!doWarmup)
     {
         const double dCycles = static_cast<double>(cycles);
@@ -339,10 +582,18 @@ static void setupAndRunInstance(const gmx::BenchmarkSystem& system,
                     dCycles / options.numIterations * 1e-6, options.numIterations * numPairs / dCycles,
                     options.numIterations * numUsefulPairs / dCycles);
         }
+
+        if (dataFile)
+        {
+            const double secondsPerCall = kernelTiming.seconds / numIterations;
+            printBenchDataLine(dataFile, system.coordinates.size(), options,
+                               c_stepPartNames[StepPart::Kernel], kernelTiming,
+                               numUsefulPairs / secondsPerCall, nsPerDay(options, secondsPerCall));
+        }
     }
 }
 
-void bench(const int sizeFactor, const KernelBenchOptions& options)
+void bench(const int sizeFactor, const KernelBenchOptions& options, FILE* dataFile)
 {
     // We don't want to call gmx_omp_nthreads_init(), so we init what we need
     gmx_omp_nthreads_set(emntPairsearch, options.numThreads);
@@ -355,10 +606,15 @@ void bench(const int sizeFactor, const KernelBenchOptions& options)
     {
         minBoxSize = std::min(minBoxSize, norm(system.box[dim]));
     }
-    if (options.pairlistCutoff > 0.5 * minBoxSize)
+    const bool useDynamicPruning = (options.timeSteps && options.nstlistPrune > 0);
+    if (options.pairlistCutoff + (useDynamicPruning ? options.pairlistBuffer : 0) > 0.5 * minBoxSize)
     {
         gmx_fatal(FARGS, "The cut-off should be shorter than half the box size");
     }
+    if (options.timeSteps && options.nstlist <= 0)
+    {
+        gmx_fatal(FARGS, "The pair-search interval should be positive");
+    }
 
     std::vector<KernelBenchOptions> optionsList;
     if (options.doAll)
@@ -377,7 +633,12 @@ void bench(const int sizeFactor, const KernelBenchOptions& options)
                 {
                     opt.ljCombinationRule = combRule;
 
-                    expandSimdOptionAndPushBack(opt, &optionsList);
+                    for (int energy = 0; energy <= 1; energy++)
+                    {
+                        opt.computeVirialAndEnergy = (energy == 1);
+
+                        expandSimdOptionAndPushBack(opt, &optionsList);
+                    }
                 }
             }
         }
@@ -398,7 +659,15 @@ void bench(const int sizeFactor, const KernelBenchOptions& options)
     fprintf(stdout, "Cut-off radius:       %g nm\n", options.pairlistCutoff);
     fprintf(stdout, "Number of threads:    %d\n", options.numThreads);
     fprintf(stdout, "Number of iterations: %d\n", options.numIterations);
-    fprintf(stdout, "Compute energies:     %s\n", options.computeVirialAndEnergy ? "yes" : "no");
+    if (options.timeSteps)
+    {
+        fprintf(stdout, "Pair-search interval: %d steps\n", options.nstlist);
+        if (useDynamicPruning)
+        {
+            fprintf(stdout, "Pruning interval:     %d steps\n", options.nstlistPrune);
+            fprintf(stdout, "Pair-list buffer:     %g nm\n", options.pairlistBuffer);
+        }
+    }
     if (options.coulombType != BenchMarkCoulomb::ReactionField)
     {
         fprintf(stdout, "Ewald excl. corr.:    %s\n",
@@ -410,16 +679,26 @@ void bench(const int sizeFactor, const KernelBenchOptions& options)
 
     if (options.numWarmupIterations > 0)
     {
-        setupAndRunInstance(system, optionsList[0], true);
+        setupAndRunInstance(system, optionsList[0], true, nullptr);
     }
 
-    fprintf(stdout, "Coulomb LJ   comb. SIMD    Mcycles  Mcycles/it.   %s\n",
-            options.cyclesPerPair ? "cycles/pair" : "pairs/cycle");
-    fprintf(stdout, "                                                total    useful\n");
+    if (options.timeSteps)
+    {
+        fprintf(stdout, "Times in ms per step, averaged over all steps\n");
+        fprintf(stdout,
+                "Coulomb LJ   comb. SIMD En.     grid  p.list  x-conv   prune  kernel  f-red.     "
+                "step   ns/day  Mpairs/s\n");
+    }
+    else
+    {
+        fprintf(stdout, "Coulomb LJ   comb. SIMD En.    Mcycles  Mcycles/it.   %s\n",
+                options.cyclesPerPair ? "cycles/pair" : "pairs/cycle");
+        fprintf(stdout, "                                                    total    useful\n");
+    }
 
     for (const auto& optionsInstance : optionsList)
     {
-        setupAndRunInstance(system, optionsInstance, false);
+        setupAndRunInstance(system, optionsInstance, false, dataFile);
     }
 }
 
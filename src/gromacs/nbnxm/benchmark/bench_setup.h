@@ -46,6 +46,8 @@
 #ifndef GMX_NBNXN_BENCH_SETUP_H
 #define GMX_NBNXN_BENCH_SETUP_H
 
+#include <cstdio>
+
 #include "gromacs/utility/real.h"
 
 namespace Nbnxm
@@ -103,8 +105,18 @@ struct KernelBenchOptions
     BenchMarkCoulomb coulombType = BenchMarkCoulomb::Pme;
     //! Whether to use tabulated PME grid correction instead of analytical, not applicable with simd=no
     bool useTabulatedEwaldCorr = false;
-    //! Whether to run all combinations of Coulomb type, combination rule and SIMD
+    //! Whether to run all combinations of Coulomb type, combination rule, energy output and SIMD
     bool doAll = false;
+    //! Whether to time all non-bonded parts of MD steps instead of only the kernel
+    bool timeSteps = false;
+    //! The pair-search interval in steps, only used with \p timeSteps
+    int nstlist = 20;
+    //! The dynamic pruning interval in steps, no dynamic pruning when <= 0, only used with \p timeSteps
+    int nstlistPrune = 4;
+    //! The buffer for the outer pair-list with dynamic pruning, only used with \p timeSteps
+    real pairlistBuffer = 0.1;
+    //! The MD time step in ps, used for reporting ns/day
+    real timeStep = 0.002;
     //! Number of iterations to run before running each kernel benchmark, currently always 1
     int numPreIterations = 1;
     //! The number of iterations for each kernel
@@ -115,6 +127,11 @@ struct KernelBenchOptions
     bool cyclesPerPair = false;
 };
 
+/*! \brief
+ * Writes the header line for the machine-readable output of bench() to \p fp
+ */
+void printBenchDataHeader(FILE* fp);
+
 /*! \brief
  * Sets up and runs one or more Nbnxm kernel benchmarks
  *
@@ -122,11 +139,14 @@ struct KernelBenchOptions
  * by the factor \p sizeFactor, which has to be a power of 2.
  * One or more benchmarks are run, as specified by \p options.
  * Benchmark settings and timings are printed to stdout.
+ * When \p dataFile is not nullptr, the timings are also written to it
+ * as comma-separated values, one line per benchmark and timed part.
  *
  * \param[in] sizeFactor How much should the system size be increased.
  * \param[in] options How the benchmark will be run.
+ * \param[in] dataFile File for machine-readable output, can be nullptr.
  */
-void bench(int sizeFactor, const KernelBenchOptions& options);
+void bench(int sizeFactor, const KernelBenchOptions& options, FILE* dataFile = nullptr);
 
 } // namespace Nbnxm
 
@@ -48,6 +48,7 @@
 #include "gromacs/domdec/domdec_struct.h"
 #include "gromacs/nbnxm/atomdata.h"
 #include "gromacs/timing/wallcycle.h"
+#include "gromacs/utility/gmxassert.h"
 
 #include "nbnxm_gpu.h"
 #include "pairlistsets.h"
@@ -238,6 +239,13 @@ void nonbonded_verlet_t::changePairlistRadii(real rlistOuter, real rlistInner)
     pairlistSets_->changePairlistRadii(rlistOuter, rlistInner);
 }
 
+void nonbonded_verlet_t::changePairlistIntervals(int nstlist, int nstlistPrune)
+{
+    GMX_RELEASE_ASSERT(pairlistIsSimple(), "Changing pair-list intervals is only supported with CPU lists");
+
+    pairlistSets_->changePairlistIntervals(nstlist, nstlistPrune);
+}
+
 void nonbonded_verlet_t::setupGpuShortRangeWork(const gmx::GpuBonded*          gpuBonded,
                                                 const gmx::InteractionLocality iLocality)
 {
@@ -111,6 +111,8 @@
 #ifndef GMX_NBNXM_NBNXM_H
 #define GMX_NBNXM_NBNXM_H
 
+#include <cstdint>
+
 #include <memory>
 
 #include "gromacs/gpu_utils/devicebuffer_datatype.h"
@@ -209,6 +211,24 @@ enum
     enbvClearFYes
 };
 
+/*! \libinternal
+ * \brief Accumulated cycle counts of the CPU kernels that depend on the pair-list setup
+ *
+ * These are recorded independently of the wallcycle sub-counters, which
+ * are usually not compiled in, for tuning the pair-list setup at run time.
+ */
+struct NbnxmCpuKernelCycles
+{
+    //! The number of calls to the dynamic pruning kernel
+    int64_t numPruneCalls = 0;
+    //! The total number of cycles spent in the dynamic pruning kernel
+    double pruneCycles = 0;
+    //! The number of calls to the non-bonded kernel
+    int64_t numKernelCalls = 0;
+    //! The total number of cycles spent in the non-bonded kernel
+    double kernelCycles = 0;
+};
+
 /*! \libinternal
  *  \brief Top-level non-bonded data structure for the Verlet-type cut-off scheme. */
 struct nonbonded_verlet_t
@@ -265,6 +285,20 @@ public:
                            int64_t                      step,
                            t_nrnb*                      nrnb);
 
+    /*! \brief Constructs the local and non-local pairlists together, only with CPU lists and DD
+     *
+     * Equivalent to constructing the local and then the non-local pairlist,
+     * but threads continue with the non-local search while other threads
+     * are still busy with the local search.
+     *
+     * \param[in] exclusions  Lists of exclusions for every atom.
+     * \param[in] step        Used to set the list creation step
+     * \param[in,out] nrnb    Flop accounting struct, can be nullptr
+     */
+    void constructLocalAndNonLocalPairlists(const gmx::ListOfLists<int>& exclusions,
+                                            int64_t                      step,
+                                            t_nrnb*                      nrnb);
+
     //! Updates all the atom properties in Nbnxm
     void setAtomProperties(gmx::ArrayRef<const int>  atomTypes,
                            gmx::ArrayRef<const real> atomCharges,
@@ -379,6 +413,18 @@ public:
     //! Changes the pair-list outer and inner radius
     void changePairlistRadii(real rlistOuter, real rlistInner);
 
+    /*! \brief Changes the pair-list update and dynamic pruning intervals
+     *
+     * Should only be called before constructing the pair lists.
+     *
+     * \param[in] nstlist       The pair-list update interval
+     * \param[in] nstlistPrune  The dynamic pruning interval, no dynamic pruning when <= 0
+     */
+    void changePairlistIntervals(int nstlist, int nstlistPrune);
+
+    //! Returns the accumulated cycle counts of the CPU non-bonded and pruning kernels
+    const NbnxmCpuKernelCycles& cpuKernelCycles() const { return cpuKernelCycles_; }
+
     //! Set up internal flags that indicate what type of short-range work there is.
     void setupGpuShortRangeWork(const gmx::GpuBonded* gpuBonded, gmx::InteractionLocality iLocality);
 
@@ -396,6 +442,8 @@ private:
     Nbnxm::KernelSetup kernelSetup_;
     //! \brief Pointer to wallcycle structure.
     gmx_wallcycle* wcycle_;
+    //! Cycle counts of the CPU kernels, always recorded
+    NbnxmCpuKernelCycles cpuKernelCycles_;
 
 public:
     //! GPU Nbnxm data, only used with a physical GPU (TODO: use unique_ptr)
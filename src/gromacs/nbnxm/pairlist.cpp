@@ -64,7 +64,6 @@
 #include "gromacs/utility/fatalerror.h"
 #include "gromacs/utility/gmxomp.h"
 #include "gromacs/utility/listoflists.h"
-#include "gromacs/utility/smalloc.h"
 
 #include "boundingboxes.h"
 #include "clusterdistancekerneltype.h"
@@ -217,28 +216,6 @@ static inline int xIndexFromCj(int cj)
 #endif // defined(GMX_NBNXN_SIMD_4XN) || defined(GMX_NBNXN_SIMD_2XNN)
 
 
-void nbnxn_init_pairlist_fep(t_nblist* nl)
-{
-    nl->type      = GMX_NBLIST_INTERACTION_FREE_ENERGY;
-    nl->igeometry = GMX_NBLIST_GEOMETRY_PARTICLE_PARTICLE;
-    /* The interaction functions are set in the free energy kernel fuction */
-    nl->ivdw     = -1;
-    nl->ivdwmod  = -1;
-    nl->ielec    = -1;
-    nl->ielecmod = -1;
-
-    nl->maxnri   = 0;
-    nl->maxnrj   = 0;
-    nl->nri      = 0;
-    nl->nrj      = 0;
-    nl->iinr     = nullptr;
-    nl->gid      = nullptr;
-    nl->shift    = nullptr;
-    nl->jindex   = nullptr;
-    nl->jjnr     = nullptr;
-    nl->excl_fep = nullptr;
-}
-
 static constexpr int sizeNeededForBufferFlags(const int numAtoms)
 {
     return (numAtoms + NBNXN_BUFFERFLAG_SIZE - 1) / NBNXN_BUFFERFLAG_SIZE;
@@ -732,8 +709,7 @@ PairlistSet::PairlistSet(const InteractionLocality locality, const PairlistParam
                  * master thread (but all contained list memory thread local)
                  * impacts performance.
                  */
-                fepLists_[i] = std::make_unique<t_nblist>();
-                nbnxn_init_pairlist_fep(fepLists_[i].get());
+                fepLists_[i] = std::make_unique<NbnxnPairlistFep>();
             }
             GMX_CATCH_ALL_AND_EXIT_WITH_FATAL_ERROR
         }
@@ -1433,49 +1409,76 @@ static void setExclusionsForIEntry(const Nbnxm::GridSet&   gridSet,
     }
 }
 
-/* Add a new i-entry to the FEP list and copy the i-properties */
-static inline void fep_list_new_nri_copy(t_nblist* nlist)
-{
-    /* Add a new i-entry */
-    nlist->nri++;
+/* For load balancing of the free-energy lists over threads, we close
+ * an i-entry at the first j-cluster after it has reached this number
+ * of atom pairs and continue with a new i-entry for the same i-cluster.
+ * This leads to good load balancing in the worst case scenario of a single
+ * perturbed particle on 16 threads, while not introducing significant overhead.
+ * Note that half of the perturbed pairs will anyhow end up in very small lists,
+ * since non perturbed i-particles will see few perturbed j-particles).
+ */
+const int c_fepListMaxNumPairsPerIEntry = 64;
 
-    assert(nlist->nri < nlist->maxnri);
+/* Returns the number of atom pairs in a free-energy pair mask */
+static inline int numFepPairs(uint64_t pairs)
+{
+    int count = 0;
+    while (pairs != 0)
+    {
+        pairs &= pairs - 1;
+        count++;
+    }
+    return count;
+}
 
-    /* Duplicate the last i-entry, except for jindex, which continues */
-    nlist->iinr[nlist->nri]   = nlist->iinr[nlist->nri - 1];
-    nlist->shift[nlist->nri]  = nlist->shift[nlist->nri - 1];
-    nlist->gid[nlist->nri]    = nlist->gid[nlist->nri - 1];
-    nlist->jindex[nlist->nri] = nlist->nrj;
+/* Adds a new, empty i-entry to the FEP list */
+static void fepListOpenIEntry(NbnxnPairlistFep* nlist, int ci, int shift, int gid)
+{
+    nbnxn_fep_ci_t ciEntry;
+    ciEntry.ci           = ci;
+    ciEntry.shift        = shift;
+    ciEntry.gid          = gid;
+    ciEntry.cj_ind_start = nlist->cj.size();
+    ciEntry.cj_ind_end   = nlist->cj.size();
+    nlist->ci.push_back(ciEntry);
 }
 
-/* Rellocate FEP list for size nl->maxnri, TODO: replace by C++ */
-static void reallocate_nblist(t_nblist* nl)
+/* Removes the last i-entry of the FEP list when it is empty */
+static void fepListCloseIEntry(NbnxnPairlistFep* nlist)
 {
-    if (gmx_debug_at)
+    if (nlist->ci.back().cj_ind_end == nlist->ci.back().cj_ind_start)
     {
-        fprintf(debug,
-                "reallocating neigborlist (ielec=%d, ivdw=%d, igeometry=%d, type=%d), maxnri=%d\n",
-                nl->ielec, nl->ivdw, nl->igeometry, nl->type, nl->maxnri);
+        nlist->ci.pop_back();
     }
-    srenew(nl->iinr, nl->maxnri);
-    srenew(nl->gid, nl->maxnri);
-    srenew(nl->shift, nl->maxnri);
-    srenew(nl->jindex, nl->maxnri + 1);
 }
 
-/* For load balancing of the free-energy lists over threads, we set
- * the maximum nrj size of an i-entry to 40. This leads to good
- * load balancing in the worst case scenario of a single perturbed
- * particle on 16 threads, while not introducing significant overhead.
- * Note that half of the perturbed pairs will anyhow end up in very small lists,
- * since non perturbed i-particles will see few perturbed j-particles).
+/* Adds a j-entry to the last i-entry of the FEP list.
+ * When the i-entry has reached the maximum number of pairs, a new
+ * i-entry for the same i-cluster is started.
  */
-const int max_nrj_fep = 40;
+static void fepListAddJEntry(NbnxnPairlistFep* nlist, int* numPairsInIEntry, const nbnxn_fep_cj_t& cjEntry)
+{
+    if (*numPairsInIEntry >= c_fepListMaxNumPairsPerIEntry)
+    {
+        const nbnxn_fep_ci_t& ciEntry = nlist->ci.back();
+        fepListOpenIEntry(nlist, ciEntry.ci, ciEntry.shift, ciEntry.gid);
+        *numPairsInIEntry = 0;
+    }
+
+    const int numPairs = numFepPairs(cjEntry.pairs);
+
+    nlist->cj.push_back(cjEntry);
+    nlist->ci.back().cj_ind_end++;
+    *numPairsInIEntry += numPairs;
+    nlist->numPairs += numPairs;
+}
 
 /* Exclude the perturbed pairs from the Verlet list. This is only done to avoid
  * singularities for overlapping particles (0/0), since the charges and
  * LJ parameters have been zeroed in the nbnxn data structure.
- * Simultaneously make a group pair list for the perturbed pairs.
+ * Simultaneously make a cluster pair list for the perturbed pairs,
+ * which contains the cluster pairs with perturbed atom pairs,
+ * with masks selecting those pairs.
  */
 static void make_fep_list(gmx::ArrayRef<const int> atomIndices,
                           const nbnxn_atomdata_t*  nbat,
@@ -1486,18 +1489,15 @@ static void make_fep_list(gmx::ArrayRef<const int> atomIndices,
                           real gmx_unused shy,
                           real gmx_unused shz,
                           real gmx_unused rlist_fep2,
-                          const Grid&     iGrid,
-                          const Grid&     jGrid,
-                          t_nblist*       nlist)
+                          const Grid&       iGrid,
+                          const Grid&       jGrid,
+                          NbnxnPairlistFep* nlist)
 {
-    int      ci, cj_ind_start, cj_ind_end, cja, cjr;
-    int      nri_max;
-    int      gid_i = 0, gid_j, gid;
-    int      egp_shift, egp_mask;
-    int      gid_cj = 0;
-    int      ind_i, ind_j, ai, aj;
-    int      nri;
-    gmx_bool bFEP_i, bFEP_i_all;
+    int          ci, cj_ind_start, cj_ind_end, cja, cjr;
+    int          egp_shift, egp_mask;
+    int          gid_cj = 0;
+    int          ind_i, ind_j, aj;
+    unsigned int fep_cj;
 
     if (nbl_ci->cj_ind_end == nbl_ci->cj_ind_start)
     {
@@ -1510,17 +1510,6 @@ static void make_fep_list(gmx::ArrayRef<const int> atomIndices,
     cj_ind_start = nbl_ci->cj_ind_start;
     cj_ind_end   = nbl_ci->cj_ind_end;
 
-    /* In worst case we have alternating energy groups
-     * and create #atom-pair lists, which means we need the size
-     * of a cluster pair (na_ci*na_cj) times the number of cj's.
-     */
-    nri_max = nbl->na_ci * nbl->na_cj * (cj_ind_end - cj_ind_start);
-    if (nlist->nri + nri_max > nlist->maxnri)
-    {
-        nlist->maxnri = over_alloc_large(nlist->nri + nri_max);
-        reallocate_nblist(nlist);
-    }
-
     const int numAtomsJCluster = jGrid.geometry().numAtomsJCluster;
 
     const nbnxn_atomdata_t::Params& nbatParams = nbat->params();
@@ -1541,129 +1530,187 @@ static void make_fep_list(gmx::ArrayRef<const int> atomIndices,
     egp_shift = nbatParams.neg_2log;
     egp_mask  = (1 << egp_shift) - 1;
 
-    /* Loop over the atoms in the i sub-cell */
-    bFEP_i_all = TRUE;
+    nlist->na_ci       = nbl->na_ci;
+    nlist->na_cj       = nbl->na_cj;
+    nlist->atomIndices = atomIndices;
+
+    /* Determine which atoms in the i-cluster are present and perturbed */
+    bool bAtom_i[c_nbnxnCpuIClusterSize];
+    bool bFEP_i[c_nbnxnCpuIClusterSize];
+    int  gid_i[c_nbnxnCpuIClusterSize] = { 0 };
+    bool bFEP_i_any                    = false;
+    bool bFEP_i_all                    = true;
     for (int i = 0; i < nbl->na_ci; i++)
     {
-        ind_i = ci * nbl->na_ci + i;
-        ai    = atomIndices[ind_i];
-        if (ai >= 0)
+        ind_i      = ci * nbl->na_ci + i;
+        bAtom_i[i] = (atomIndices[ind_i] >= 0);
+        bFEP_i[i]  = bAtom_i[i] && iGrid.atomIsPerturbed(ci - iGrid.cellOffset(), i);
+        if (bAtom_i[i])
         {
-            nri                    = nlist->nri;
-            nlist->jindex[nri + 1] = nlist->jindex[nri];
-            nlist->iinr[nri]       = ai;
-            /* The actual energy group pair index is set later */
-            nlist->gid[nri]   = 0;
-            nlist->shift[nri] = nbl_ci->shift & NBNXN_CI_SHIFT;
+            bFEP_i_any = bFEP_i_any || bFEP_i[i];
+            bFEP_i_all = bFEP_i_all && bFEP_i[i];
+            if (ngid > 1)
+            {
+                gid_i[i] = (nbatParams.energrp[ci] >> (egp_shift * i)) & egp_mask;
+            }
+        }
+    }
 
-            bFEP_i = iGrid.atomIsPerturbed(ci - iGrid.cellOffset(), i);
+    /* With energy groups we first collect all j-entries with their energy
+     * groups, afterwards we split them over i-entries per energy group pair.
+     */
+    std::vector<nbnxn_fep_cj_t> fepCjWithGroups;
+    std::vector<int>            fepCjEnergyGroups;
 
-            bFEP_i_all = bFEP_i_all && bFEP_i;
+    int numPairsInIEntry = 0;
+    if (ngid == 1)
+    {
+        fepListOpenIEntry(nlist, ci, nbl_ci->shift & NBNXN_CI_SHIFT, 0);
+    }
 
-            if (nlist->nrj + (cj_ind_end - cj_ind_start) * nbl->na_cj > nlist->maxnrj)
+    for (int cj_ind = cj_ind_start; cj_ind < cj_ind_end; cj_ind++)
+    {
+        cja = nbl->cj[cj_ind].cj;
+
+        if (numAtomsJCluster == jGrid.geometry().numAtomsICluster)
+        {
+            cjr    = cja - jGrid.cellOffset();
+            fep_cj = jGrid.fepBits(cjr);
+            if (ngid > 1)
             {
-                nlist->maxnrj = over_alloc_small(nlist->nrj + (cj_ind_end - cj_ind_start) * nbl->na_cj);
-                srenew(nlist->jjnr, nlist->maxnrj);
-                srenew(nlist->excl_fep, nlist->maxnrj);
+                gid_cj = nbatParams.energrp[cja];
             }
-
+        }
+        else if (2 * numAtomsJCluster == jGrid.geometry().numAtomsICluster)
+        {
+            cjr = cja - jGrid.cellOffset() * 2;
+            /* Extract half of the ci fep/energrp mask */
+            fep_cj = (jGrid.fepBits(cjr >> 1) >> ((cjr & 1) * numAtomsJCluster))
+                     & ((1 << numAtomsJCluster) - 1);
             if (ngid > 1)
             {
-                gid_i = (nbatParams.energrp[ci] >> (egp_shift * i)) & egp_mask;
+                gid_cj = nbatParams.energrp[cja >> 1] >> ((cja & 1) * numAtomsJCluster * egp_shift)
+                         & ((1 << (numAtomsJCluster * egp_shift)) - 1);
             }
-
-            for (int cj_ind = cj_ind_start; cj_ind < cj_ind_end; cj_ind++)
+        }
+        else
+        {
+            cjr = cja - (jGrid.cellOffset() >> 1);
+            /* Combine two ci fep masks/energrp */
+            fep_cj = jGrid.fepBits(cjr * 2)
+                     + (jGrid.fepBits(cjr * 2 + 1) << jGrid.geometry().numAtomsICluster);
+            if (ngid > 1)
             {
-                unsigned int fep_cj;
+                gid_cj = nbatParams.energrp[cja * 2]
+                         + (nbatParams.energrp[cja * 2 + 1]
+                            << (jGrid.geometry().numAtomsICluster * egp_shift));
+            }
+        }
 
-                cja = nbl->cj[cj_ind].cj;
+        if (!bFEP_i_any && fep_cj == 0)
+        {
+            continue;
+        }
 
-                if (numAtomsJCluster == jGrid.geometry().numAtomsICluster)
+        uint64_t pairs = 0;
+        for (int i = 0; i < nbl->na_ci; i++)
+        {
+            if (!bAtom_i[i])
+            {
+                continue;
+            }
+            ind_i = ci * nbl->na_ci + i;
+            for (int j = 0; j < nbl->na_cj; j++)
+            {
+                /* Is this interaction perturbed and not excluded? */
+                ind_j = cja * nbl->na_cj + j;
+                aj    = atomIndices[ind_j];
+                if (aj >= 0 && (bFEP_i[i] || (fep_cj & (1 << j))) && (!bDiagRemoved || ind_j >= ind_i))
                 {
-                    cjr    = cja - jGrid.cellOffset();
-                    fep_cj = jGrid.fepBits(cjr);
-                    if (ngid > 1)
-                    {
-                        gid_cj = nbatParams.energrp[cja];
-                    }
+                    pairs |= (uint64_t(1) << (i * nbl->na_cj + j));
                 }
-                else if (2 * numAtomsJCluster == jGrid.geometry().numAtomsICluster)
+            }
+        }
+
+        if (pairs == 0)
+        {
+            continue;
+        }
+
+        /* Add the pairs to the FEP list */
+        nbnxn_fep_cj_t cjEntry;
+        cjEntry.cj           = cja;
+        cjEntry.pairs        = pairs;
+        cjEntry.interactions = pairs & nbl->cj[cj_ind].excl;
+        if (ngid == 1)
+        {
+            fepListAddJEntry(nlist, &numPairsInIEntry, cjEntry);
+        }
+        else
+        {
+            fepCjWithGroups.push_back(cjEntry);
+            fepCjEnergyGroups.push_back(gid_cj);
+        }
+
+        /* Exclude the pairs from the normal list.
+         * Note that the charge has been set to zero,
+         * but we need to avoid 0/0, as perturbed atoms
+         * can be on top of each other.
+         */
+        nbl->cj[cj_ind].excl &= ~static_cast<unsigned int>(pairs);
+    }
+
+    if (ngid == 1)
+    {
+        fepListCloseIEntry(nlist);
+    }
+    else
+    {
+        /* Make one i-entry per energy group pair present */
+        for (int gi = 0; gi < ngid; gi++)
+        {
+            uint64_t iMask = 0;
+            for (int i = 0; i < nbl->na_ci; i++)
+            {
+                if (bAtom_i[i] && gid_i[i] == gi)
                 {
-                    cjr = cja - jGrid.cellOffset() * 2;
-                    /* Extract half of the ci fep/energrp mask */
-                    fep_cj = (jGrid.fepBits(cjr >> 1) >> ((cjr & 1) * numAtomsJCluster))
-                             & ((1 << numAtomsJCluster) - 1);
-                    if (ngid > 1)
-                    {
-                        gid_cj = nbatParams.energrp[cja >> 1] >> ((cja & 1) * numAtomsJCluster * egp_shift)
-                                 & ((1 << (numAtomsJCluster * egp_shift)) - 1);
-                    }
-                }
-                else
-                {
-                    cjr = cja - (jGrid.cellOffset() >> 1);
-                    /* Combine two ci fep masks/energrp */
-                    fep_cj = jGrid.fepBits(cjr * 2)
-                             + (jGrid.fepBits(cjr * 2 + 1) << jGrid.geometry().numAtomsICluster);
-                    if (ngid > 1)
-                    {
-                        gid_cj = nbatParams.energrp[cja * 2]
-                                 + (nbatParams.energrp[cja * 2 + 1]
-                                    << (jGrid.geometry().numAtomsICluster * egp_shift));
-                    }
+                    iMask |= ((uint64_t(1) << nbl->na_cj) - 1) << (i * nbl->na_cj);
                 }
+            }
+            if (iMask == 0)
+            {
+                continue;
+            }
 
-                if (bFEP_i || fep_cj != 0)
+            for (int gj = 0; gj < ngid; gj++)
+            {
+                fepListOpenIEntry(nlist, ci, nbl_ci->shift & NBNXN_CI_SHIFT, GID(gi, gj, ngid));
+                numPairsInIEntry = 0;
+
+                for (size_t e = 0; e < fepCjWithGroups.size(); e++)
                 {
+                    uint64_t jMask = 0;
                     for (int j = 0; j < nbl->na_cj; j++)
                     {
-                        /* Is this interaction perturbed and not excluded? */
-                        ind_j = cja * nbl->na_cj + j;
-                        aj    = atomIndices[ind_j];
-                        if (aj >= 0 && (bFEP_i || (fep_cj & (1 << j))) && (!bDiagRemoved || ind_j >= ind_i))
+                        if (((fepCjEnergyGroups[e] >> (j * egp_shift)) & egp_mask) == gj)
                         {
-                            if (ngid > 1)
+                            for (int i = 0; i < nbl->na_ci; i++)
                             {
-                                gid_j = (gid_cj >> (j * egp_shift)) & egp_mask;
-                                gid   = GID(gid_i, gid_j, ngid);
-
-                                if (nlist->nrj > nlist->jindex[nri] && nlist->gid[nri] != gid)
-                                {
-                                    /* Energy group pair changed: new list */
-                                    fep_list_new_nri_copy(nlist);
-                                    nri = nlist->nri;
-                                }
-                                nlist->gid[nri] = gid;
-                            }
-
-                            if (nlist->nrj - nlist->jindex[nri] >= max_nrj_fep)
-                            {
-                                fep_list_new_nri_copy(nlist);
-                                nri = nlist->nri;
+                                jMask |= uint64_t(1) << (i * nbl->na_cj + j);
                             }
-
-                            /* Add it to the FEP list */
-                            nlist->jjnr[nlist->nrj] = aj;
-                            nlist->excl_fep[nlist->nrj] =
-                                    (nbl->cj[cj_ind].excl >> (i * nbl->na_cj + j)) & 1;
-                            nlist->nrj++;
-
-                            /* Exclude it from the normal list.
-                             * Note that the charge has been set to zero,
-                             * but we need to avoid 0/0, as perturbed atoms
-                             * can be on top of each other.
-                             */
-                            nbl->cj[cj_ind].excl &= ~(1U << (i * nbl->na_cj + j));
                         }
                     }
+
+                    nbnxn_fep_cj_t cjEntry = fepCjWithGroups[e];
+                    cjEntry.pairs &= iMask & jMask;
+                    cjEntry.interactions &= cjEntry.pairs;
+                    if (cjEntry.pairs != 0)
+                    {
+                        fepListAddJEntry(nlist, &numPairsInIEntry, cjEntry);
+                    }
                 }
-            }
 
-            if (nlist->nrj > nlist->jindex[nri])
-            {
-                /* Actually add this new, non-empty, list */
-                nlist->nri++;
-                nlist->jindex[nlist->nri] = nlist->nrj;
+                fepListCloseIEntry(nlist);
             }
         }
     }
@@ -1706,14 +1753,10 @@ static void make_fep_list(gmx::ArrayRef<const int> atomIndices,
                           real                     rlist_fep2,
                           const Grid&              iGrid,
                           const Grid&              jGrid,
-                          t_nblist*                nlist)
+                          NbnxnPairlistFep*        nlist)
 {
-    int                nri_max;
     int                c_abs;
-    int                ind_i, ind_j, ai, aj;
-    int                nri;
-    gmx_bool           bFEP_i;
-    real               xi, yi, zi;
+    int                ind_i, ind_j, aj;
     const nbnxn_cj4_t* cj4;
 
     const int numJClusterGroups = nbl_sci->numJClusterGroups();
@@ -1728,140 +1771,140 @@ static void make_fep_list(gmx::ArrayRef<const int> atomIndices,
     const int cj4_ind_start = nbl_sci->cj4_ind_start;
     const int cj4_ind_end   = nbl_sci->cj4_ind_end;
 
+    GMX_ASSERT(nbl->na_ci * nbl->na_cj <= 64, "The cluster pair should fit in the FEP pair masks");
+
+    nlist->na_ci       = nbl->na_ci;
+    nlist->na_cj       = nbl->na_cj;
+    nlist->atomIndices = atomIndices;
+
     /* Here we process one super-cell, max #atoms na_sc, versus a list
      * cj4 entries, each with max c_nbnxnGpuJgroupSize cj's, each
      * of size na_cj atoms.
      * On the GPU we don't support energy groups (yet).
-     * So for each of the na_sc i-atoms, we need max one FEP list
-     * for each max_nrj_fep j-atoms.
+     * So for each of the clusters in the super-cluster we make
+     * one or more i-entries in the FEP list.
      */
-    nri_max = nbl->na_sc * nbl->na_cj * (1 + (numJClusterGroups * c_nbnxnGpuJgroupSize) / max_nrj_fep);
-    if (nlist->nri + nri_max > nlist->maxnri)
-    {
-        nlist->maxnri = over_alloc_large(nlist->nri + nri_max);
-        reallocate_nblist(nlist);
-    }
-
-    /* Loop over the atoms in the i super-cluster */
     for (int c = 0; c < c_gpuNumClusterPerCell; c++)
     {
         c_abs = sci * c_gpuNumClusterPerCell + c;
 
+        bool bAtom_i[c_nbnxnGpuClusterSize];
+        bool bFEP_i[c_nbnxnGpuClusterSize];
+        real xi[c_nbnxnGpuClusterSize], yi[c_nbnxnGpuClusterSize], zi[c_nbnxnGpuClusterSize];
+        bool bFEP_i_any = false;
         for (int i = 0; i < nbl->na_ci; i++)
         {
-            ind_i = c_abs * nbl->na_ci + i;
-            ai    = atomIndices[ind_i];
-            if (ai >= 0)
-            {
-                nri                    = nlist->nri;
-                nlist->jindex[nri + 1] = nlist->jindex[nri];
-                nlist->iinr[nri]       = ai;
-                /* With GPUs, energy groups are not supported */
-                nlist->gid[nri]   = 0;
-                nlist->shift[nri] = nbl_sci->shift & NBNXN_CI_SHIFT;
+            ind_i      = c_abs * nbl->na_ci + i;
+            bAtom_i[i] = (atomIndices[ind_i] >= 0);
+            bFEP_i[i]  = bAtom_i[i]
+                        && iGrid.atomIsPerturbed(c_abs - iGrid.cellOffset() * c_gpuNumClusterPerCell, i);
+            bFEP_i_any = bFEP_i_any || bFEP_i[i];
+
+            xi[i] = nbat->x()[ind_i * nbat->xstride + XX] + shx;
+            yi[i] = nbat->x()[ind_i * nbat->xstride + YY] + shy;
+            zi[i] = nbat->x()[ind_i * nbat->xstride + ZZ] + shz;
+        }
 
-                bFEP_i = iGrid.atomIsPerturbed(c_abs - iGrid.cellOffset() * c_gpuNumClusterPerCell, i);
+        /* With GPUs, energy groups are not supported */
+        fepListOpenIEntry(nlist, c_abs, nbl_sci->shift & NBNXN_CI_SHIFT, 0);
+        int numPairsInIEntry = 0;
 
-                xi = nbat->x()[ind_i * nbat->xstride + XX] + shx;
-                yi = nbat->x()[ind_i * nbat->xstride + YY] + shy;
-                zi = nbat->x()[ind_i * nbat->xstride + ZZ] + shz;
+        for (int cj4_ind = cj4_ind_start; cj4_ind < cj4_ind_end; cj4_ind++)
+        {
+            cj4 = &nbl->cj4[cj4_ind];
 
-                const int nrjMax = nlist->nrj + numJClusterGroups * c_nbnxnGpuJgroupSize * nbl->na_cj;
-                if (nrjMax > nlist->maxnrj)
+            for (int gcj = 0; gcj < c_nbnxnGpuJgroupSize; gcj++)
+            {
+                if ((cj4->imei[0].imask & (1U << (gcj * c_gpuNumClusterPerCell + c))) == 0)
                 {
-                    nlist->maxnrj = over_alloc_small(nrjMax);
-                    srenew(nlist->jjnr, nlist->maxnrj);
-                    srenew(nlist->excl_fep, nlist->maxnrj);
+                    /* Skip this ci for this cj */
+                    continue;
                 }
 
-                for (int cj4_ind = cj4_ind_start; cj4_ind < cj4_ind_end; cj4_ind++)
-                {
-                    cj4 = &nbl->cj4[cj4_ind];
+                const int cjr = cj4->cj[gcj] - jGrid.cellOffset() * c_gpuNumClusterPerCell;
 
-                    for (int gcj = 0; gcj < c_nbnxnGpuJgroupSize; gcj++)
-                    {
-                        if ((cj4->imei[0].imask & (1U << (gcj * c_gpuNumClusterPerCell + c))) == 0)
-                        {
-                            /* Skip this ci for this cj */
-                            continue;
-                        }
+                if (!bFEP_i_any && !jGrid.clusterIsPerturbed(cjr))
+                {
+                    continue;
+                }
 
-                        const int cjr = cj4->cj[gcj] - jGrid.cellOffset() * c_gpuNumClusterPerCell;
+                nbnxn_fep_cj_t cjEntry;
+                cjEntry.cj           = cj4->cj[gcj];
+                cjEntry.pairs        = 0;
+                cjEntry.interactions = 0;
 
-                        if (bFEP_i || jGrid.clusterIsPerturbed(cjr))
+                for (int i = 0; i < nbl->na_ci; i++)
+                {
+                    if (!bAtom_i[i])
+                    {
+                        continue;
+                    }
+                    ind_i = c_abs * nbl->na_ci + i;
+                    for (int j = 0; j < nbl->na_cj; j++)
+                    {
+                        /* Is this interaction perturbed and not excluded? */
+                        ind_j = (jGrid.cellOffset() * c_gpuNumClusterPerCell + cjr) * nbl->na_cj + j;
+                        aj    = atomIndices[ind_j];
+                        if (aj >= 0 && (bFEP_i[i] || jGrid.atomIsPerturbed(cjr, j))
+                            && (!bDiagRemoved || ind_j >= ind_i))
                         {
-                            for (int j = 0; j < nbl->na_cj; j++)
+                            int          excl_pair;
+                            unsigned int excl_bit;
+                            real         dx, dy, dz;
+
+                            const int jHalf = j / (c_nbnxnGpuClusterSize / c_nbnxnGpuClusterpairSplit);
+                            nbnxn_excl_t& excl = get_exclusion_mask(nbl, cj4_ind, jHalf);
+
+                            excl_pair = a_mod_wj(j) * nbl->na_ci + i;
+                            excl_bit  = (1U << (gcj * c_gpuNumClusterPerCell + c));
+
+                            dx = nbat->x()[ind_j * nbat->xstride + XX] - xi[i];
+                            dy = nbat->x()[ind_j * nbat->xstride + YY] - yi[i];
+                            dz = nbat->x()[ind_j * nbat->xstride + ZZ] - zi[i];
+
+                            /* The unpruned GPU list has more than 2/3
+                             * of the atom pairs beyond rlist. Using
+                             * this list will cause a lot of overhead
+                             * in the CPU FEP kernels, especially
+                             * relative to the fast GPU kernels.
+                             * So we prune the FEP list here.
+                             */
+                            if (dx * dx + dy * dy + dz * dz < rlist_fep2)
                             {
-                                /* Is this interaction perturbed and not excluded? */
-                                ind_j = (jGrid.cellOffset() * c_gpuNumClusterPerCell + cjr) * nbl->na_cj + j;
-                                aj = atomIndices[ind_j];
-                                if (aj >= 0 && (bFEP_i || jGrid.atomIsPerturbed(cjr, j))
-                                    && (!bDiagRemoved || ind_j >= ind_i))
+                                /* Add it to the FEP list */
+                                const uint64_t pairBit = uint64_t(1) << (i * nbl->na_cj + j);
+                                cjEntry.pairs |= pairBit;
+                                if (excl.pair[excl_pair] & excl_bit)
                                 {
-                                    int          excl_pair;
-                                    unsigned int excl_bit;
-                                    real         dx, dy, dz;
-
-                                    const int jHalf =
-                                            j / (c_nbnxnGpuClusterSize / c_nbnxnGpuClusterpairSplit);
-                                    nbnxn_excl_t& excl = get_exclusion_mask(nbl, cj4_ind, jHalf);
-
-                                    excl_pair = a_mod_wj(j) * nbl->na_ci + i;
-                                    excl_bit  = (1U << (gcj * c_gpuNumClusterPerCell + c));
-
-                                    dx = nbat->x()[ind_j * nbat->xstride + XX] - xi;
-                                    dy = nbat->x()[ind_j * nbat->xstride + YY] - yi;
-                                    dz = nbat->x()[ind_j * nbat->xstride + ZZ] - zi;
-
-                                    /* The unpruned GPU list has more than 2/3
-                                     * of the atom pairs beyond rlist. Using
-                                     * this list will cause a lot of overhead
-                                     * in the CPU FEP kernels, especially
-                                     * relative to the fast GPU kernels.
-                                     * So we prune the FEP list here.
-                                     */
-                                    if (dx * dx + dy * dy + dz * dz < rlist_fep2)
-                                    {
-                                        if (nlist->nrj - nlist->jindex[nri] >= max_nrj_fep)
-                                        {
-                                            fep_list_new_nri_copy(nlist);
-                                            nri = nlist->nri;
-                                        }
-
-                                        /* Add it to the FEP list */
-                                        nlist->jjnr[nlist->nrj] = aj;
-                                        nlist->excl_fep[nlist->nrj] =
-                                                (excl.pair[excl_pair] & excl_bit) ? 1 : 0;
-                                        nlist->nrj++;
-                                    }
-
-                                    /* Exclude it from the normal list.
-                                     * Note that the charge and LJ parameters have
-                                     * been set to zero, but we need to avoid 0/0,
-                                     * as perturbed atoms can be on top of each other.
-                                     */
-                                    excl.pair[excl_pair] &= ~excl_bit;
+                                    cjEntry.interactions |= pairBit;
                                 }
                             }
 
-                            /* Note that we could mask out this pair in imask
-                             * if all i- and/or all j-particles are perturbed.
-                             * But since the perturbed pairs on the CPU will
-                             * take an order of magnitude more time, the GPU
-                             * will finish before the CPU and there is no gain.
+                            /* Exclude it from the normal list.
+                             * Note that the charge and LJ parameters have
+                             * been set to zero, but we need to avoid 0/0,
+                             * as perturbed atoms can be on top of each other.
                              */
+                            excl.pair[excl_pair] &= ~excl_bit;
                         }
                     }
                 }
 
-                if (nlist->nrj > nlist->jindex[nri])
+                if (cjEntry.pairs != 0)
                 {
-                    /* Actually add this new, non-empty, list */
-                    nlist->nri++;
-                    nlist->jindex[nlist->nri] = nlist->nrj;
+                    fepListAddJEntry(nlist, &numPairsInIEntry, cjEntry);
                 }
+
+                /* Note that we could mask out this pair in imask
+                 * if all i- and/or all j-particles are perturbed.
+                 * But since the perturbed pairs on the CPU will
+                 * take an order of magnitude more time, the GPU
+                 * will finish before the CPU and there is no gain.
+                 */
             }
         }
+
+        fepListCloseIEntry(nlist);
     }
 }
 
@@ -2224,16 +2267,12 @@ static void clear_pairlist(NbnxnPairlistGpu* nbl)
     nbl->nci_tot = 0;
 }
 
-/* Clears an atom-atom-style pair list */
-static void clear_pairlist_fep(t_nblist* nl)
+/* Clears a free-energy pair list */
+static void clear_pairlist_fep(NbnxnPairlistFep* nl)
 {
-    nl->nri = 0;
-    nl->nrj = 0;
-    if (nl->jindex == nullptr)
-    {
-        snew(nl->jindex, 1);
-    }
-    nl->jindex[0] = 0;
+    nl->ci.clear();
+    nl->cj.clear();
+    nl->numPairs = 0;
 }
 
 /* Sets a simple list i-cell bounding box, including PBC shift */
@@ -2700,8 +2739,8 @@ static void combine_nblists(gmx::ArrayRef<const NbnxnPairlistGpu> nbls, NbnxnPai
     }
 }
 
-static void balance_fep_lists(gmx::ArrayRef<std::unique_ptr<t_nblist>> fepLists,
-                              gmx::ArrayRef<PairsearchWork>            work)
+static void balance_fep_lists(gmx::ArrayRef<std::unique_ptr<NbnxnPairlistFep>> fepLists,
+                              gmx::ArrayRef<PairsearchWork>                    work)
 {
     const int numLists = fepLists.ssize();
 
@@ -2711,16 +2750,18 @@ static void balance_fep_lists(gmx::ArrayRef<std::unique_ptr<t_nblist>> fepLists,
         return;
     }
 
-    /* Count the total i-lists and pairs */
-    int nri_tot = 0;
-    int nrj_tot = 0;
+    /* Count the total i-entries, j-entries and pairs */
+    size_t numCiTotal    = 0;
+    size_t numCjTotal    = 0;
+    int    numPairsTotal = 0;
     for (const auto& list : fepLists)
     {
-        nri_tot += list->nri;
-        nrj_tot += list->nrj;
+        numCiTotal += list->ci.size();
+        numCjTotal += list->cj.size();
+        numPairsTotal += list->numPairs;
     }
 
-    const int nrj_target = (nrj_tot + numLists - 1) / numLists;
+    const int numPairsTarget = (numPairsTotal + numLists - 1) / numLists;
 
     GMX_ASSERT(gmx_omp_nthreads_get(emntNonbonded) == numLists,
                "We should have as many work objects as FEP lists");
@@ -2730,22 +2771,13 @@ static void balance_fep_lists(gmx::ArrayRef<std::unique_ptr<t_nblist>> fepLists,
     {
         try
         {
-            t_nblist* nbl = work[th].nbl_fep.get();
+            NbnxnPairlistFep* nbl = work[th].nbl_fep.get();
 
             /* Note that here we allocate for the total size, instead of
              * a per-thread esimate (which is hard to obtain).
              */
-            if (nri_tot > nbl->maxnri)
-            {
-                nbl->maxnri = over_alloc_large(nri_tot);
-                reallocate_nblist(nbl);
-            }
-            if (nri_tot > nbl->maxnri || nrj_tot > nbl->maxnrj)
-            {
-                nbl->maxnrj = over_alloc_small(nrj_tot);
-                srenew(nbl->jjnr, nbl->maxnrj);
-                srenew(nbl->excl_fep, nbl->maxnrj);
-            }
+            nbl->ci.reserve(numCiTotal);
+            nbl->cj.reserve(numCjTotal);
 
             clear_pairlist_fep(nbl);
         }
@@ -2753,41 +2785,40 @@ static void balance_fep_lists(gmx::ArrayRef<std::unique_ptr<t_nblist>> fepLists,
     }
 
     /* Loop over the source lists and assign and copy i-entries */
-    int       th_dest = 0;
-    t_nblist* nbld    = work[th_dest].nbl_fep.get();
+    int               th_dest = 0;
+    NbnxnPairlistFep* nbld    = work[th_dest].nbl_fep.get();
     for (int th = 0; th < numLists; th++)
     {
-        const t_nblist* nbls = fepLists[th].get();
+        const NbnxnPairlistFep* nbls = fepLists[th].get();
 
-        for (int i = 0; i < nbls->nri; i++)
+        for (const nbnxn_fep_ci_t& ciEntry : nbls->ci)
         {
-            int nrj;
-
             /* The number of pairs in this i-entry */
-            nrj = nbls->jindex[i + 1] - nbls->jindex[i];
+            int numPairs = 0;
+            for (int cj_ind = ciEntry.cj_ind_start; cj_ind < ciEntry.cj_ind_end; cj_ind++)
+            {
+                numPairs += numFepPairs(nbls->cj[cj_ind].pairs);
+            }
 
             /* Decide if list th_dest is too large and we should procede
              * to the next destination list.
              */
-            if (th_dest + 1 < numLists && nbld->nrj > 0
-                && nbld->nrj + nrj - nrj_target > nrj_target - nbld->nrj)
+            if (th_dest + 1 < numLists && nbld->numPairs > 0
+                && nbld->numPairs + numPairs - numPairsTarget > numPairsTarget - nbld->numPairs)
             {
                 th_dest++;
                 nbld = work[th_dest].nbl_fep.get();
             }
 
-            nbld->iinr[nbld->nri]  = nbls->iinr[i];
-            nbld->gid[nbld->nri]   = nbls->gid[i];
-            nbld->shift[nbld->nri] = nbls->shift[i];
+            nbld->na_ci       = nbls->na_ci;
+            nbld->na_cj       = nbls->na_cj;
+            nbld->atomIndices = nbls->atomIndices;
 
-            for (int j = nbls->jindex[i]; j < nbls->jindex[i + 1]; j++)
-            {
-                nbld->jjnr[nbld->nrj]     = nbls->jjnr[j];
-                nbld->excl_fep[nbld->nrj] = nbls->excl_fep[j];
-                nbld->nrj++;
-            }
-            nbld->nri++;
-            nbld->jindex[nbld->nri] = nbld->nrj;
+            fepListOpenIEntry(nbld, ciEntry.ci, ciEntry.shift, ciEntry.gid);
+            nbld->cj.insert(nbld->cj.end(), nbls->cj.begin() + ciEntry.cj_ind_start,
+                            nbls->cj.begin() + ciEntry.cj_ind_end);
+            nbld->ci.back().cj_ind_end = nbld->cj.size();
+            nbld->numPairs += numPairs;
         }
     }
 
@@ -2798,7 +2829,8 @@ static void balance_fep_lists(gmx::ArrayRef<std::unique_ptr<t_nblist>> fepLists,
 
         if (debug)
         {
-            fprintf(debug, "nbl_fep[%d] nri %4d nrj %4d\n", th, fepLists[th]->nri, fepLists[th]->nrj);
+            fprintf(debug, "nbl_fep[%d] nci %4zu npair %4d\n", th, fepLists[th]->ci.size(),
+                    fepLists[th]->numPairs);
         }
     }
 }
@@ -3088,7 +3120,7 @@ static void nbnxn_make_pairlist_part(const Nbnxm::GridSet&   gridSet,
                                      int                     th,
                                      int                     nth,
                                      T*                      nbl,
-                                     t_nblist*               nbl_fep)
+                                     NbnxnPairlistFep*       nbl_fep)
 {
     int            na_cj_2log;
     matrix         box;
@@ -3563,7 +3595,7 @@ static void nbnxn_make_pairlist_part(const Nbnxm::GridSet&   gridSet,
         }
     }
 
-    work->ndistc = numDistanceChecks;
+    work->ndistc += numDistanceChecks;
 
     checkListSizeConsistency(*nbl, haveFep);
 
@@ -3575,7 +3607,7 @@ static void nbnxn_make_pairlist_part(const Nbnxm::GridSet&   gridSet,
 
         if (haveFep)
         {
-            fprintf(debug, "nbl FEP list pairs: %d\n", nbl_fep->nrj);
+            fprintf(debug, "nbl FEP list pairs: %d\n", nbl_fep->numPairs);
         }
     }
 }
@@ -3917,22 +3949,8 @@ static Range<int> getJZoneRange(const gmx_domdec_zones_t& ddZones,
 //! Prepares CPU lists produced by the search for dynamic pruning
 static void prepareListsForDynamicPruning(gmx::ArrayRef<NbnxnPairlistCpu> lists);
 
-void PairlistSet::constructPairlists(const Nbnxm::GridSet&         gridSet,
-                                     gmx::ArrayRef<PairsearchWork> searchWork,
-                                     nbnxn_atomdata_t*             nbat,
-                                     const ListOfLists<int>&       exclusions,
-                                     const int                     minimumIlistCountForGpuBalancing,
-                                     t_nrnb*                       nrnb,
-                                     SearchCycleCounting*          searchCycleCounting)
+void PairlistSet::prepareSearch(nbnxn_atomdata_t* nbat)
 {
-    const real rlist = params_.rlistOuter;
-
-    int      nsubpair_target;
-    float    nsubpair_tot_est;
-    int      ci_block;
-    gmx_bool progBal;
-    int      np_tot, np_noq, np_hlj, nap;
-
     const int numLists = (isCpuType_ ? cpuLists_.size() : gpuLists_.size());
 
     if (debug)
@@ -3947,17 +3965,6 @@ void PairlistSet::constructPairlists(const Nbnxm::GridSet&         gridSet,
         resizeAndZeroBufferFlags(&nbat->buffer_flags, nbat->numAtoms());
     }
 
-    if (!isCpuType_ && minimumIlistCountForGpuBalancing > 0)
-    {
-        get_nsubpair_target(gridSet, locality_, rlist, minimumIlistCountForGpuBalancing,
-                            &nsubpair_target, &nsubpair_tot_est);
-    }
-    else
-    {
-        nsubpair_target  = 0;
-        nsubpair_tot_est = 0;
-    }
-
     /* Clear all pair-lists */
     for (int th = 0; th < numLists; th++)
     {
@@ -3975,6 +3982,122 @@ void PairlistSet::constructPairlists(const Nbnxm::GridSet&         gridSet,
             clear_pairlist_fep(fepLists_[th].get());
         }
     }
+}
+
+void PairlistSet::searchCpuListsPart(const Nbnxm::GridSet&   gridSet,
+                                     PairsearchWork*         work,
+                                     const nbnxn_atomdata_t* nbat,
+                                     const ListOfLists<int>& exclusions,
+                                     const int               th)
+{
+    GMX_ASSERT(isCpuType_, "Only CPU lists can be constructed per thread over all zones");
+
+    const int numLists = cpuLists_.size();
+
+    const gmx_domdec_zones_t& ddZones = *gridSet.domainSetup().zones;
+
+    for (const int iZone : getIZoneRange(gridSet.domainSetup(), locality_))
+    {
+        const Grid& iGrid = gridSet.grids()[iZone];
+
+        for (int jZone : getJZoneRange(ddZones, locality_, iZone))
+        {
+            const Grid& jGrid = gridSet.grids()[jZone];
+
+            /* Re-init the thread-local work flag data before making
+             * the first list (not an elegant conditional).
+             */
+            if (nbat->bUseBufferFlags && (iZone == 0 && jZone == 0))
+            {
+                resizeAndZeroBufferFlags(&work->buffer_flags, nbat->numAtoms());
+            }
+
+            const int ci_block =
+                    get_ci_block_size(iGrid, gridSet.domainSetup().haveMultipleDomains, numLists);
+
+            NbnxnPairlistFep* fepListPtr = (fepLists_.empty() ? nullptr : fepLists_[th].get());
+
+            /* Divide the i cells equally over the pairlists */
+            nbnxn_make_pairlist_part(gridSet, iGrid, jGrid, work, nbat, exclusions, params_.rlistOuter,
+                                     params_.pairlistType, ci_block, nbat->bUseBufferFlags, 0,
+                                     FALSE, 0, th, numLists, &cpuLists_[th], fepListPtr);
+        }
+    }
+}
+
+void PairlistSet::constructPairlists(const Nbnxm::GridSet&         gridSet,
+                                     gmx::ArrayRef<PairsearchWork> searchWork,
+                                     nbnxn_atomdata_t*             nbat,
+                                     const ListOfLists<int>&       exclusions,
+                                     const int                     minimumIlistCountForGpuBalancing,
+                                     t_nrnb*                       nrnb,
+                                     SearchCycleCounting*          searchCycleCounting)
+{
+    const int numLists = (isCpuType_ ? cpuLists_.size() : gpuLists_.size());
+
+    prepareSearch(nbat);
+
+    if (isCpuType_)
+    {
+        /* With CPU lists there is no processing needed between zone pairs,
+         * so we let each thread search all its zone pairs without barriers.
+         */
+        searchCycleCounting->start(enbsCCsearch);
+
+#pragma omp parallel for num_threads(numLists) schedule(static)
+        for (int th = 0; th < numLists; th++)
+        {
+            try
+            {
+                PairsearchWork& work = searchWork[th];
+
+                work.cycleCounter.start();
+
+                searchCpuListsPart(gridSet, &work, nbat, exclusions, th);
+
+                work.cycleCounter.stop();
+            }
+            GMX_CATCH_ALL_AND_EXIT_WITH_FATAL_ERROR
+        }
+        searchCycleCounting->stop(enbsCCsearch);
+    }
+    else
+    {
+        constructGpuPairlists(gridSet, searchWork, nbat, exclusions,
+                              minimumIlistCountForGpuBalancing, nrnb, searchCycleCounting);
+    }
+
+    finalizeSearch(gridSet, searchWork, nbat, nrnb);
+}
+
+void PairlistSet::constructGpuPairlists(const Nbnxm::GridSet&         gridSet,
+                                        gmx::ArrayRef<PairsearchWork> searchWork,
+                                        nbnxn_atomdata_t*             nbat,
+                                        const ListOfLists<int>&       exclusions,
+                                        const int                     minimumIlistCountForGpuBalancing,
+                                        t_nrnb*                       nrnb,
+                                        SearchCycleCounting*          searchCycleCounting)
+{
+    const real rlist = params_.rlistOuter;
+
+    int      nsubpair_target;
+    float    nsubpair_tot_est;
+    int      ci_block;
+    gmx_bool progBal;
+    int      np_tot, nap;
+
+    const int numLists = gpuLists_.size();
+
+    if (minimumIlistCountForGpuBalancing > 0)
+    {
+        get_nsubpair_target(gridSet, locality_, rlist, minimumIlistCountForGpuBalancing,
+                            &nsubpair_target, &nsubpair_tot_est);
+    }
+    else
+    {
+        nsubpair_target  = 0;
+        nsubpair_tot_est = 0;
+    }
 
     const gmx_domdec_zones_t& ddZones = *gridSet.domainSetup().zones;
 
@@ -4019,8 +4142,6 @@ void PairlistSet::constructPairlists(const Nbnxm::GridSet&         gridSet,
 
                     if (combineLists_ && th > 0)
                     {
-                        GMX_ASSERT(!isCpuType_, "Can only combine GPU lists");
-
                         clear_pairlist(&gpuLists_[th]);
                     }
 
@@ -4028,23 +4149,14 @@ void PairlistSet::constructPairlists(const Nbnxm::GridSet&         gridSet,
 
                     work.cycleCounter.start();
 
-                    t_nblist* fepListPtr = (fepLists_.empty() ? nullptr : fepLists_[th].get());
+                    NbnxnPairlistFep* fepListPtr =
+                            (fepLists_.empty() ? nullptr : fepLists_[th].get());
 
                     /* Divide the i cells equally over the pairlists */
-                    if (isCpuType_)
-                    {
-                        nbnxn_make_pairlist_part(gridSet, iGrid, jGrid, &work, nbat, exclusions, rlist,
-                                                 params_.pairlistType, ci_block, nbat->bUseBufferFlags,
-                                                 nsubpair_target, progBal, nsubpair_tot_est, th,
-                                                 numLists, &cpuLists_[th], fepListPtr);
-                    }
-                    else
-                    {
-                        nbnxn_make_pairlist_part(gridSet, iGrid, jGrid, &work, nbat, exclusions, rlist,
-                                                 params_.pairlistType, ci_block, nbat->bUseBufferFlags,
-                                                 nsubpair_target, progBal, nsubpair_tot_est, th,
-                                                 numLists, &gpuLists_[th], fepListPtr);
-                    }
+                    nbnxn_make_pairlist_part(gridSet, iGrid, jGrid, &work, nbat, exclusions, rlist,
+                                             params_.pairlistType, ci_block, nbat->bUseBufferFlags,
+                                             nsubpair_target, progBal, nsubpair_tot_est, th,
+                                             numLists, &gpuLists_[th], fepListPtr);
 
                     work.cycleCounter.stop();
                 }
@@ -4053,42 +4165,21 @@ void PairlistSet::constructPairlists(const Nbnxm::GridSet&         gridSet,
             searchCycleCounting->stop(enbsCCsearch);
 
             np_tot = 0;
-            np_noq = 0;
-            np_hlj = 0;
             for (int th = 0; th < numLists; th++)
             {
                 inc_nrnb(nrnb, eNR_NBNXN_DIST2, searchWork[th].ndistc);
+                searchWork[th].ndistc = 0;
 
-                if (isCpuType_)
-                {
-                    const NbnxnPairlistCpu& nbl = cpuLists_[th];
-                    np_tot += nbl.cj.size();
-                    np_noq += nbl.work->ncj_noq;
-                    np_hlj += nbl.work->ncj_hlj;
-                }
-                else
-                {
-                    const NbnxnPairlistGpu& nbl = gpuLists_[th];
-                    /* This count ignores potential subsequent pair pruning */
-                    np_tot += nbl.nci_tot;
-                }
-            }
-            if (isCpuType_)
-            {
-                nap = cpuLists_[0].na_ci * cpuLists_[0].na_cj;
-            }
-            else
-            {
-                nap = gmx::square(gpuLists_[0].na_ci);
+                /* This count ignores potential subsequent pair pruning */
+                np_tot += gpuLists_[th].nci_tot;
             }
-            natpair_ljq_ = (np_tot - np_noq) * nap - np_hlj * nap / 2;
-            natpair_lj_  = np_noq * nap;
-            natpair_q_   = np_hlj * nap / 2;
+            nap          = gmx::square(gpuLists_[0].na_ci);
+            natpair_ljq_ = np_tot * nap;
+            natpair_lj_  = 0;
+            natpair_q_   = 0;
 
             if (combineLists_ && numLists > 1)
             {
-                GMX_ASSERT(!isCpuType_, "Can only combine GPU lists");
-
                 searchCycleCounting->start(enbsCCcombine);
 
                 combine_nblists(gmx::constArrayRefFromArray(&gpuLists_[1], numLists - 1), &gpuLists_[0]);
@@ -4097,9 +4188,37 @@ void PairlistSet::constructPairlists(const Nbnxm::GridSet&         gridSet,
             }
         }
     }
+}
+
+void PairlistSet::finalizeSearch(const Nbnxm::GridSet&         gridSet,
+                                 gmx::ArrayRef<PairsearchWork> searchWork,
+                                 nbnxn_atomdata_t*             nbat,
+                                 t_nrnb*                       nrnb)
+{
+    const real rlist = params_.rlistOuter;
+
+    const int numLists = (isCpuType_ ? cpuLists_.size() : gpuLists_.size());
 
     if (isCpuType_)
     {
+        int np_tot = 0;
+        int np_noq = 0;
+        int np_hlj = 0;
+        for (int th = 0; th < numLists; th++)
+        {
+            inc_nrnb(nrnb, eNR_NBNXN_DIST2, searchWork[th].ndistc);
+            searchWork[th].ndistc = 0;
+
+            const NbnxnPairlistCpu& nbl = cpuLists_[th];
+            np_tot += nbl.cj.size();
+            np_noq += nbl.work->ncj_noq;
+            np_hlj += nbl.work->ncj_hlj;
+        }
+        const int nap = cpuLists_[0].na_ci * cpuLists_[0].na_cj;
+        natpair_ljq_  = (np_tot - np_noq) * nap - np_hlj * nap / 2;
+        natpair_lj_   = np_noq * nap;
+        natpair_q_    = np_hlj * nap / 2;
+
         if (numLists > 1 && checkRebalanceSimpleLists(cpuLists_))
         {
             rebalanceSimpleLists(cpuLists_, cpuListsWork_, searchWork);
@@ -4195,14 +4314,9 @@ void PairlistSet::constructPairlists(const Nbnxm::GridSet&         gridSet,
     }
 }
 
-void PairlistSets::construct(const InteractionLocality iLocality,
-                             PairSearch*               pairSearch,
-                             nbnxn_atomdata_t*         nbat,
-                             const ListOfLists<int>&   exclusions,
-                             const int64_t             step,
-                             t_nrnb*                   nrnb)
+//! Checks that the exclusions match the i-atoms in \p gridSet
+static void checkExclusionsForSearch(const Nbnxm::GridSet& gridSet, const ListOfLists<int>& exclusions)
 {
-    const auto& gridSet = pairSearch->gridSet();
     const auto* ddZones = gridSet.domainSetup().zones;
 
     /* The Nbnxm code can also work with more exclusions than those in i-zones only
@@ -4213,6 +4327,18 @@ void PairlistSets::construct(const InteractionLocality iLocality,
                     || (ddZones && exclusions.ssize() == ddZones->cg_range[ddZones->iZones.size()]),
             "exclusions should either be empty or the number of lists should match the number of "
             "local i-atoms");
+}
+
+void PairlistSets::construct(const InteractionLocality iLocality,
+                             PairSearch*               pairSearch,
+                             nbnxn_atomdata_t*         nbat,
+                             const ListOfLists<int>&   exclusions,
+                             const int64_t             step,
+                             t_nrnb*                   nrnb)
+{
+    const auto& gridSet = pairSearch->gridSet();
+
+    checkExclusionsForSearch(gridSet, exclusions);
 
     pairlistSet(iLocality).constructPairlists(gridSet, pairSearch->work(), nbat, exclusions,
                                               minimumIlistCountForGpuBalancing_, nrnb,
@@ -4241,6 +4367,62 @@ void PairlistSets::construct(const InteractionLocality iLocality,
     }
 }
 
+void PairlistSets::constructLocalAndNonLocal(PairSearch*             pairSearch,
+                                             nbnxn_atomdata_t*       nbat,
+                                             const ListOfLists<int>& exclusions,
+                                             const int64_t           step,
+                                             t_nrnb*                 nrnb)
+{
+    GMX_RELEASE_ASSERT(nonlocalSet_, "Need a non-local set to construct it together with the local set");
+    GMX_RELEASE_ASSERT(!localSet_->cpuLists().empty(),
+                       "Only CPU lists can be constructed in a single parallel region");
+
+    const auto&                   gridSet    = pairSearch->gridSet();
+    gmx::ArrayRef<PairsearchWork> searchWork = pairSearch->work();
+
+    checkExclusionsForSearch(gridSet, exclusions);
+
+    localSet_->prepareSearch(nbat);
+    nonlocalSet_->prepareSearch(nbat);
+
+    const int numLists = localSet_->cpuLists().ssize();
+
+    pairSearch->cycleCounting_.start(enbsCCsearch);
+
+#pragma omp parallel for num_threads(numLists) schedule(static)
+    for (int th = 0; th < numLists; th++)
+    {
+        try
+        {
+            PairsearchWork& work = searchWork[th];
+
+            work.cycleCounter.start();
+
+            localSet_->searchCpuListsPart(gridSet, &work, nbat, exclusions, th);
+            /* There is no dependency on the local lists of other threads,
+             * so we continue directly with the non-local part.
+             */
+            nonlocalSet_->searchCpuListsPart(gridSet, &work, nbat, exclusions, th);
+
+            work.cycleCounter.stop();
+        }
+        GMX_CATCH_ALL_AND_EXIT_WITH_FATAL_ERROR
+    }
+    pairSearch->cycleCounting_.stop(enbsCCsearch);
+
+    localSet_->finalizeSearch(gridSet, searchWork, nbat, nrnb);
+    nonlocalSet_->finalizeSearch(gridSet, searchWork, nbat, nrnb);
+
+    outerListCreationStep_ = step;
+
+    /* Special performance logging stuff (env.var. GMX_NBNXN_CYCLE) */
+    pairSearch->cycleCounting_.searchCount_++;
+    if (pairSearch->cycleCounting_.recordCycles_ && pairSearch->cycleCounting_.searchCount_ % 100 == 0)
+    {
+        pairSearch->cycleCounting_.printCycles(stderr, pairSearch->work());
+    }
+}
+
 void nonbonded_verlet_t::constructPairlist(const InteractionLocality iLocality,
                                            const ListOfLists<int>&   exclusions,
                                            int64_t                   step,
@@ -4258,6 +4440,15 @@ void nonbonded_verlet_t::constructPairlist(const InteractionLocality iLocality,
     }
 }
 
+void nonbonded_verlet_t::constructLocalAndNonLocalPairlists(const ListOfLists<int>& exclusions,
+                                                            int64_t                 step,
+                                                            t_nrnb*                 nrnb)
+{
+    GMX_ASSERT(!useGpu(), "Local and non-local lists are only constructed together on the CPU");
+
+    pairlistSets_->constructLocalAndNonLocal(pairSearch_.get(), nbat.get(), exclusions, step, nrnb);
+}
+
 static void prepareListsForDynamicPruning(gmx::ArrayRef<NbnxnPairlistCpu> lists)
 {
     /* TODO: Restructure the lists so we have actual outer and inner
@@ -38,11 +38,12 @@
 #define GMX_NBNXM_PAIRLIST_H
 
 #include <cstddef>
+#include <cstdint>
 
 #include "gromacs/gpu_utils/hostallocator.h"
 #include "gromacs/math/vectypes.h"
 #include "gromacs/mdtypes/locality.h"
-#include "gromacs/mdtypes/nblist.h"
+#include "gromacs/utility/arrayref.h"
 #include "gromacs/utility/basedefinitions.h"
 #include "gromacs/utility/defaultinitializationallocator.h"
 #include "gromacs/utility/enumerationhelpers.h"
@@ -299,7 +300,58 @@ struct NbnxnPairlistGpu
     gmx_cache_protect_t cp1;
 };
 
-//! Initializes a free-energy pair-list
-void nbnxn_init_pairlist_fep(t_nblist* nl);
+/*! \brief Free-energy pair-list j-entry
+ *
+ * The pair bits are indexed i-major, j-minor, as in nbnxn_cj_t,
+ * but use 64 bits to fit the 8x8 cluster pairs of GPU lists.
+ */
+struct nbnxn_fep_cj_t
+{
+    //! The j-cluster
+    int cj;
+    //! The perturbed atom pairs in this cluster pair that are in the list
+    uint64_t pairs;
+    //! The interaction bits, pairs in \p pairs that are not set here are excluded
+    uint64_t interactions;
+};
+
+//! Free-energy pair-list i-entry
+struct nbnxn_fep_ci_t
+{
+    //! i-cluster
+    int ci;
+    //! Shift vector index
+    int shift;
+    //! Energy group pair index for all pairs in this entry
+    int gid;
+    //! Start index into cj
+    int cj_ind_start;
+    //! End index into cj
+    int cj_ind_end;
+};
+
+/*! \brief Cluster pairlist for the perturbed atom pairs
+ *
+ * The perturbed atom pairs are taken out of the normal cluster pair
+ * lists and stored here with the same i- and j-cluster structure,
+ * with bit masks selecting the perturbed pairs in each cluster pair.
+ * The atoms of cluster c are given by atomIndices[c*clusterSize + a],
+ * which has -1 for filler particles, which never occur in the masks.
+ */
+struct NbnxnPairlistFep
+{
+    //! The number of atoms per i-cluster
+    int na_ci = 0;
+    //! The number of atoms per j-cluster
+    int na_cj = 0;
+    //! Atom indices for all clusters, set when the list is constructed
+    gmx::ArrayRef<const int> atomIndices;
+    //! The i-cluster list
+    FastVector<nbnxn_fep_ci_t> ci;
+    //! The j-cluster list with perturbed pair masks
+    FastVector<nbnxn_fep_cj_t> cj;
+    //! The total number of atom pairs in the list
+    int numPairs = 0;
+};
 
 #endif
@@ -46,6 +46,7 @@
 #include "pairlist_tuning.h"
 
 #include <cassert>
+#include <cinttypes>
 #include <cmath>
 #include <cstdlib>
 
@@ -54,13 +55,17 @@
 
 #include "gromacs/domdec/domdec.h"
 #include "gromacs/hardware/cpuinfo.h"
+#include "gromacs/math/functions.h"
 #include "gromacs/math/vec.h"
 #include "gromacs/mdlib/calc_verletbuf.h"
 #include "gromacs/mdtypes/commrec.h"
+#include "gromacs/mdtypes/forcerec.h"
 #include "gromacs/mdtypes/inputrec.h"
 #include "gromacs/mdtypes/interaction_const.h"
 #include "gromacs/mdtypes/state.h"
+#include "gromacs/nbnxm/nbnxm.h"
 #include "gromacs/pbcutil/pbc.h"
+#include "gromacs/timing/wallcycle.h"
 #include "gromacs/topology/topology.h"
 #include "gromacs/utility/cstringutil.h"
 #include "gromacs/utility/fatalerror.h"
@@ -598,3 +603,253 @@ void setupDynamicPairlistPruning(const gmx::MDLogger&       mdlog,
 
     GMX_LOG(mdlog.info).asParagraph().appendText(mesg);
 }
+
+/*! \brief The minimum number of steps in a window for measuring the cost of a pair-list setup
+ *
+ * A window ends at the first search step after this number of steps.
+ * This should be large enough to average out fluctuations due to
+ * steps with energy computation and other infrequent work.
+ */
+static const int c_tuningWindowNumSteps = 1000;
+//! A measured cost is used instead of the predicted cost for this number of windows after the measurement
+static const int c_measuredSetupLifetimeInWindows = 10;
+//! Only change the setup when the cost decreases at least by this fraction, avoids switching due to noise
+static const double c_minRelativeCostDecrease = 0.05;
+/*! \brief Estimate of the cost per pair of the pruning kernel relative to the non-bonded kernel
+ *
+ * Only used for predicting the pruning cost before pruning has been measured.
+ */
+static const double c_pruneToKernelCostPerPairEstimate = 0.25;
+//! The pruning intervals considered during tuning
+static const int c_nstlistPruneTry[] = { 2, 3, 4, 5, 6, 8, 10, 12, 15, 20, 25, 30, 40, 50 };
+
+bool pairlistSetupCanBeTuned(const t_inputrec& ir, const nonbonded_verlet_t& nbv)
+{
+    return supportsDynamicPairlistGenerationInterval(ir) && ir.nstlist > 1 && nbv.pairlistIsSimple()
+           && wallcycle_have_counter() && getenv("GMX_NSTLIST_DYNAMICPRUNING") == nullptr;
+}
+
+PairlistSetupTuner::PairlistSetupTuner(const gmx::MDLogger&       mdlog,
+                                       const t_inputrec&          ir,
+                                       const gmx_mtop_t&          mtop,
+                                       const interaction_const_t& ic,
+                                       const nonbonded_verlet_t&  nbv) :
+    mdlog_(mdlog),
+    ir_(ir),
+    mtop_(mtop),
+    interactionCutoff_(std::max(ic.rcoulomb, ic.rvdw)),
+    allowDynamicPruning_(getenv("GMX_DISABLE_DYNAMICPRUNING") == nullptr),
+    nstlist_(ir.nstlist)
+{
+    GMX_RELEASE_ASSERT(pairlistSetupCanBeTuned(ir, nbv), "Can only tune supported setups");
+
+    const PairlistParams& params = nbv.pairlistSets().params();
+
+    iClusterSize_ = IClusterSizePerListType[params.pairlistType];
+    jClusterSize_ = JClusterSizePerListType[params.pairlistType];
+    nstlistPrune_ = (params.useDynamicPruning ? params.nstlistPrune : 0);
+
+    GMX_LOG(mdlog.info)
+            .asParagraph()
+            .appendTextFormatted(
+                    "The pair-list update and pruning intervals will be tuned during the run\n"
+                    "using the cycle counts measured over windows of %d steps",
+                    c_tuningWindowNumSteps);
+}
+
+real PairlistSetupTuner::listVolume(real rlist) const
+{
+    return gmx::power3(rlist + rlistEffectiveInc_);
+}
+
+void PairlistSetupTuner::tune(int64_t step, const matrix box, gmx_wallcycle* wcycle, t_forcerec* fr)
+{
+    const NbnxmCpuKernelCycles& kernelCycles = fr->nbv->cpuKernelCycles();
+
+    rlistEffectiveInc_ = nbnxn_get_rlist_effective_inc(jClusterSize_, mtop_.natoms / det(box));
+
+    int    numSearches;
+    double searchCycles;
+    wallcycle_get(wcycle, ewcNS, &numSearches, &searchCycles);
+
+    const bool windowIsComplete =
+            (windowIndex_ >= 0 && step - windowStartStep_ >= c_tuningWindowNumSteps);
+
+    if (windowIsComplete)
+    {
+        const int    numSteps                = static_cast<int>(step - windowStartStep_);
+        const int    numSearchesInWindow     = numSearches - windowStartNumSearches_;
+        const double searchCyclesInWindow    = searchCycles - windowStartSearchCycles_;
+        const int64_t numPruneCallsInWindow  = kernelCycles.numPruneCalls - windowStartNumPruneCalls_;
+        const double pruneCyclesInWindow     = kernelCycles.pruneCycles - windowStartPruneCycles_;
+        const double kernelCyclesInWindow    = kernelCycles.kernelCycles - windowStartKernelCycles_;
+
+        /* The wallcycle counters might have been reset during the window,
+         * in that case we skip this window. We also skip the first window,
+         * as that contains the initial steps which are often slower.
+         */
+        if (windowIndex_ > 0 && numSearchesInWindow > 0 && searchCyclesInWindow >= 0)
+        {
+            const real rlistOuter = fr->nbv->pairlistOuterRadius();
+            const real rlistInner = fr->nbv->pairlistInnerRadius();
+
+            searchCoefficient_ = searchCyclesInWindow / (numSearchesInWindow * listVolume(rlistOuter));
+            if (numPruneCallsInWindow > 0)
+            {
+                pruneCoefficient_ = pruneCyclesInWindow / (numPruneCallsInWindow * listVolume(rlistOuter));
+            }
+            kernelCoefficient_ = kernelCyclesInWindow / (numSteps * listVolume(rlistInner));
+
+            const double cyclesPerStep =
+                    (searchCyclesInWindow + pruneCyclesInWindow + kernelCyclesInWindow) / numSteps;
+
+            measuredSetups_.erase(std::remove_if(measuredSetups_.begin(), measuredSetups_.end(),
+                                                 [this](const MeasuredSetup& setup) {
+                                                     return (setup.nstlist == nstlist_
+                                                             && setup.nstlistPrune == nstlistPrune_)
+                                                            || windowIndex_ - setup.windowIndex
+                                                                       >= c_measuredSetupLifetimeInWindows;
+                                                 }),
+                                  measuredSetups_.end());
+            measuredSetups_.push_back({ nstlist_, nstlistPrune_, cyclesPerStep, windowIndex_ });
+
+            if (debug)
+            {
+                fprintf(debug,
+                        "pair-list tuning step %" PRId64
+                        ": nstlist %d nstlistPrune %d, Mcycles/step: search %.3f prune %.3f "
+                        "kernel %.3f\n",
+                        step, nstlist_, nstlistPrune_, searchCyclesInWindow * 1e-6 / numSteps,
+                        pruneCyclesInWindow * 1e-6 / numSteps, kernelCyclesInWindow * 1e-6 / numSteps);
+            }
+
+            selectSetup(step, box, cyclesPerStep, fr);
+        }
+    }
+
+    if (windowIndex_ < 0 || windowIsComplete)
+    {
+        windowIndex_++;
+        windowStartStep_          = step;
+        windowStartNumSearches_   = numSearches;
+        windowStartSearchCycles_  = searchCycles;
+        windowStartNumPruneCalls_ = kernelCycles.numPruneCalls;
+        windowStartPruneCycles_   = kernelCycles.pruneCycles;
+        windowStartKernelCycles_  = kernelCycles.kernelCycles;
+    }
+}
+
+void PairlistSetupTuner::selectSetup(int64_t step, const matrix box, double cyclesPerStep, t_forcerec* fr)
+{
+    const VerletbufListSetup listSetup = { iClusterSize_, jClusterSize_ };
+    const real               volume    = det(box);
+
+    std::vector<int> nstlistCandidates = { ir_.nstlist, nbnxnReferenceNstlist };
+    nstlistCandidates.insert(nstlistCandidates.end(), std::begin(nstlist_try), std::end(nstlist_try));
+
+    std::vector<int>  nstlistPruneCandidates;
+    std::vector<real> rlistInnerCandidates;
+    if (allowDynamicPruning_)
+    {
+        for (int nstlistPrune : c_nstlistPruneTry)
+        {
+            nstlistPruneCandidates.push_back(nstlistPrune);
+            rlistInnerCandidates.push_back(calcVerletBufferSize(mtop_, volume, ir_, nstlistPrune,
+                                                                nstlistPrune - 1, -1, listSetup));
+        }
+    }
+
+    const double pruneCoefficient = (pruneCoefficient_ >= 0 ? pruneCoefficient_
+                                                            : c_pruneToKernelCostPerPairEstimate
+                                                                      * kernelCoefficient_);
+
+    // The current setup is our reference
+    int    bestNstlist      = nstlist_;
+    int    bestNstlistPrune = nstlistPrune_;
+    real   bestRlistOuter   = fr->nbv->pairlistOuterRadius();
+    real   bestRlistInner   = fr->nbv->pairlistInnerRadius();
+    double bestCost         = cyclesPerStep;
+
+    for (int nstlist : nstlistCandidates)
+    {
+        const real rlistOuter =
+                calcVerletBufferSize(mtop_, volume, ir_, nstlist, nstlist - 1, -1, listSetup);
+        if (gmx::square(rlistOuter) >= max_cutoff2(ir_.pbcType, box))
+        {
+            continue;
+        }
+
+        // Index -1 is without dynamic pruning
+        for (int pruneIndex = -1; pruneIndex < gmx::ssize(nstlistPruneCandidates); pruneIndex++)
+        {
+            const int  nstlistPrune = (pruneIndex >= 0 ? nstlistPruneCandidates[pruneIndex] : 0);
+            const real rlistInner   = (pruneIndex >= 0 ? rlistInnerCandidates[pruneIndex] : rlistOuter);
+            /* As in setDynamicPairlistPruningParameters(), pruning is only
+             * useful with a shorter inner list and when not pruning at the last step.
+             */
+            if (pruneIndex >= 0 && !(nstlistPrune < nstlist - 1 && rlistInner < rlistOuter))
+            {
+                continue;
+            }
+            if (nstlist == nstlist_ && nstlistPrune == nstlistPrune_)
+            {
+                continue;
+            }
+
+            double cost;
+            const auto measuredSetup = std::find_if(
+                    measuredSetups_.begin(), measuredSetups_.end(), [=](const MeasuredSetup& setup) {
+                        return setup.nstlist == nstlist && setup.nstlistPrune == nstlistPrune;
+                    });
+            if (measuredSetup != measuredSetups_.end())
+            {
+                cost = measuredSetup->cyclesPerStep;
+            }
+            else
+            {
+                const int numPrunesPerList = (nstlistPrune > 0 ? (nstlist + nstlistPrune - 1) / nstlistPrune : 0);
+
+                cost = searchCoefficient_ * listVolume(rlistOuter) / nstlist
+                       + pruneCoefficient * listVolume(rlistOuter) * numPrunesPerList / nstlist
+                       + kernelCoefficient_ * listVolume(rlistInner);
+            }
+
+            if (cost < bestCost)
+            {
+                bestNstlist      = nstlist;
+                bestNstlistPrune = nstlistPrune;
+                bestRlistOuter   = rlistOuter;
+                bestRlistInner   = rlistInner;
+                bestCost         = cost;
+            }
+        }
+    }
+
+    if (bestCost >= (1 - c_minRelativeCostDecrease) * cyclesPerStep)
+    {
+        return;
+    }
+
+    std::string mesg = gmx::formatString(
+            "Step %" PRId64
+            ": changing the pair-list setup, the search and non-bonded kernels are expected to\n"
+            "use %.0f%% less time, %.2f instead of %.2f Mcycles per step:\n",
+            step, 100 * (1 - bestCost / cyclesPerStep), bestCost * 1e-6, cyclesPerStep * 1e-6);
+    if (bestNstlistPrune > 0)
+    {
+        mesg += formatListSetup("outer", bestNstlist, bestNstlist, bestRlistOuter, interactionCutoff_);
+        mesg += formatListSetup("inner", bestNstlistPrune, bestNstlist, bestRlistInner, interactionCutoff_);
+    }
+    else
+    {
+        mesg += formatListSetup("", bestNstlist, bestNstlist, bestRlistOuter, interactionCutoff_);
+    }
+    GMX_LOG(mdlog_.info).asParagraph().appendText(mesg);
+
+    nstlist_      = bestNstlist;
+    nstlistPrune_ = bestNstlistPrune;
+    fr->nbv->changePairlistRadii(bestRlistOuter, bestRlistInner);
+    fr->nbv->changePairlistIntervals(nstlist_, nstlistPrune_);
+    /* Update deprecated rlist in forcerec to stay in sync with fr->nbv */
+    fr->rlist = bestRlistOuter;
+}
@@ -48,7 +48,12 @@
 
 #include <stdio.h>
 
+#include <cstdint>
+
+#include <vector>
+
 #include "gromacs/math/vectypes.h"
+#include "gromacs/utility/real.h"
 
 namespace gmx
 {
@@ -57,9 +62,12 @@ class MDLogger;
 } // namespace gmx
 
 struct gmx_mtop_t;
+struct gmx_wallcycle;
 struct interaction_const_t;
+struct nonbonded_verlet_t;
 struct PairlistParams;
 struct t_commrec;
+struct t_forcerec;
 struct t_inputrec;
 
 /*! \brief Try to increase nstlist when using the Verlet cut-off scheme
@@ -98,4 +106,126 @@ void setupDynamicPairlistPruning(const gmx::MDLogger&       mdlog,
                                  const interaction_const_t* ic,
                                  PairlistParams*            listParams);
 
+/*! \brief Returns whether the pair-list setup can be tuned at run time by PairlistSetupTuner
+ *
+ * This requires dynamics with a Verlet buffer tolerance, CPU pair lists,
+ * nstlist > 1, a cycle counter and that the user did not set
+ * the dynamic pruning interval.
+ *
+ * \param[in] ir   The input parameter record
+ * \param[in] nbv  The non-bonded setup
+ */
+bool pairlistSetupCanBeTuned(const t_inputrec& ir, const nonbonded_verlet_t& nbv);
+
+/*! \libinternal
+ * \brief Tunes nstlist, the pair-list radii and the dynamic pruning interval at run time
+ *
+ * Over windows of steps the cycles spent in the pair search are taken
+ * from the wallcycle counters and those spent in the CPU pruning and
+ * non-bonded kernels from the counters in Nbnxm. These are used to set up
+ * a cost model where the cost of each part is proportional to the number
+ * of pairs in the (outer or inner) list it processes. Out of a set of
+ * nstlist and pruning interval values, the setup with the lowest predicted
+ * cost, or measured cost when that setup was used recently, is selected.
+ * All radii are set by the Verlet buffer tolerance for the current box,
+ * so the accuracy is the same for all setups.
+ *
+ * Only supports runs without domain decomposition and without PME tuning.
+ */
+class PairlistSetupTuner
+{
+public:
+    /*! \brief Constructor
+     *
+     * \param[in] mdlog  MD logger
+     * \param[in] ir     The input parameter record, nstlist should be the value used initially
+     * \param[in] mtop   The global topology
+     * \param[in] ic     The nonbonded interactions constants
+     * \param[in] nbv    The non-bonded setup
+     */
+    PairlistSetupTuner(const gmx::MDLogger&       mdlog,
+                       const t_inputrec&          ir,
+                       const gmx_mtop_t&          mtop,
+                       const interaction_const_t& ic,
+                       const nonbonded_verlet_t&  nbv);
+
+    //! Returns the current pair-search interval
+    int nstlist() const { return nstlist_; }
+
+    /*! \brief Measures the cycles and possibly changes the pair-list setup
+     *
+     * Should be called at every search step, before the search,
+     * so changes apply to the pair list constructed at \p step.
+     *
+     * \param[in]     step    The MD step
+     * \param[in]     box     The unit cell
+     * \param[in]     wcycle  The wallcycle counters
+     * \param[in,out] fr      The force record, fr->nbv and fr->rlist are updated
+     */
+    void tune(int64_t step, const matrix box, gmx_wallcycle* wcycle, t_forcerec* fr);
+
+private:
+    //! The measured cost per step of a pair-list setup
+    struct MeasuredSetup
+    {
+        //! The pair-search interval
+        int nstlist;
+        //! The pruning interval, 0 means no dynamic pruning
+        int nstlistPrune;
+        //! Cycles per step spent in the search and kernels
+        double cyclesPerStep;
+        //! The index of the window in which this was measured
+        int windowIndex;
+    };
+
+    //! Returns the volume, including the cluster overhead, of a list with radius \p rlist
+    real listVolume(real rlist) const;
+
+    //! Selects and applies the setup with the lowest cost, \p cyclesPerStep is the cost of the current setup
+    void selectSetup(int64_t step, const matrix box, double cyclesPerStep, t_forcerec* fr);
+
+    //! The logger
+    const gmx::MDLogger& mdlog_;
+    //! The input parameter record
+    const t_inputrec& ir_;
+    //! The global topology
+    const gmx_mtop_t& mtop_;
+    //! The maximum of the Coulomb and VdW cut-off distances
+    real interactionCutoff_;
+    //! The i-cluster size of the pair list
+    int iClusterSize_;
+    //! The j-cluster size of the pair list
+    int jClusterSize_;
+    //! Whether dynamic pruning is allowed
+    bool allowDynamicPruning_;
+    //! The increase of the effective list radius due to the cluster setup, set for the current box
+    real rlistEffectiveInc_ = 0;
+    //! The current pair-search interval
+    int nstlist_;
+    //! The current pruning interval, 0 means no dynamic pruning
+    int nstlistPrune_;
+    //! The index of the current measurement window, -1 before the first call
+    int windowIndex_ = -1;
+    //! The step at the start of the current window
+    int64_t windowStartStep_ = 0;
+    //! The number of search steps at the start of the current window
+    int windowStartNumSearches_ = 0;
+    //! The search cycles at the start of the current window
+    double windowStartSearchCycles_ = 0;
+    //! The pruning kernel calls at the start of the current window
+    int64_t windowStartNumPruneCalls_ = 0;
+    //! The pruning kernel cycles at the start of the current window
+    double windowStartPruneCycles_ = 0;
+    //! The non-bonded kernel cycles at the start of the current window
+    double windowStartKernelCycles_ = 0;
+    //! Search cycles per unit list volume per search
+    double searchCoefficient_ = 0;
+    //! Pruning cycles per unit list volume per pruning call, < 0 when not measured
+    double pruneCoefficient_ = -1;
+    //! Kernel cycles per unit list volume per step
+    double kernelCoefficient_ = 0;
+    //! Setups used recently with their measured costs
+    std::vector<MeasuredSetup> measuredSetups_;
+};
+
 #endif /* NBNXM_PAIRLIST_TUNING_H */
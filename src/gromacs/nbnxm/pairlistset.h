@@ -96,6 +96,26 @@ public:
                             t_nrnb*                       nrnb,
                             SearchCycleCounting*          searchCycleCounting);
 
+    /*! \brief Prepares the set for a new search, clears the lists
+     *
+     * The search phases below are exposed to allow searching multiple
+     * sets of CPU lists within a single OpenMP parallel region.
+     */
+    void prepareSearch(nbnxn_atomdata_t* nbat);
+
+    //! Searches all zone pairs for the part of the CPU pairlist assigned to thread \p th
+    void searchCpuListsPart(const Nbnxm::GridSet&        gridSet,
+                            PairsearchWork*              work,
+                            const nbnxn_atomdata_t*      nbat,
+                            const gmx::ListOfLists<int>& exclusions,
+                            int                          th);
+
+    //! Finalizes the lists after all threads completed their search
+    void finalizeSearch(const Nbnxm::GridSet&         gridSet,
+                        gmx::ArrayRef<PairsearchWork> searchWork,
+                        nbnxn_atomdata_t*             nbat,
+                        t_nrnb*                       nrnb);
+
     //! Dispatch the kernel for dynamic pairlist pruning
     void dispatchPruneKernel(const nbnxn_atomdata_t* nbat, const rvec* shift_vec);
 
@@ -119,9 +139,18 @@ public:
     }
 
     //! Returns the lists of free-energy pairlists, empty when nonbonded interactions are not perturbed
-    gmx::ArrayRef<const std::unique_ptr<t_nblist>> fepLists() const { return fepLists_; }
+    gmx::ArrayRef<const std::unique_ptr<NbnxnPairlistFep>> fepLists() const { return fepLists_; }
 
 private:
+    //! Searches all zone pairs for GPU lists, requires processing between zone pairs
+    void constructGpuPairlists(const Nbnxm::GridSet&         gridSet,
+                               gmx::ArrayRef<PairsearchWork> searchWork,
+                               nbnxn_atomdata_t*             nbat,
+                               const gmx::ListOfLists<int>&  exclusions,
+                               int                           minimumIlistCountForGpuBalancing,
+                               t_nrnb*                       nrnb,
+                               SearchCycleCounting*          searchCycleCounting);
+
     //! The locality of the pairlist set
     gmx::InteractionLocality locality_;
     //! List of pairlists in CPU layout
@@ -136,8 +165,8 @@ private:
     bool combineLists_;
     //! Tells whether the lists is of CPU type, otherwise GPU type
     gmx_bool isCpuType_;
-    //! Lists for perturbed interactions in simple atom-atom layout
-    std::vector<std::unique_ptr<t_nblist>> fepLists_;
+    //! Lists for perturbed interactions in cluster pair layout
+    std::vector<std::unique_ptr<NbnxnPairlistFep>> fepLists_;
 
 public:
     /* Pair counts for flop counting */
@@ -83,6 +83,18 @@ public:
                    int64_t                      step,
                    t_nrnb*                      nrnb);
 
+    /*! \brief Construct the local and non-local CPU pairlist sets together
+     *
+     * Both sets are searched within one OpenMP parallel region, so threads
+     * proceed with their part of the non-local search without waiting for
+     * the other threads to finish their part of the local search.
+     */
+    void constructLocalAndNonLocal(PairSearch*                  pairSearch,
+                                   nbnxn_atomdata_t*            nbat,
+                                   const gmx::ListOfLists<int>& exclusions,
+                                   int64_t                      step,
+                                   t_nrnb*                      nrnb);
+
     //! Dispatches the dynamic pruning kernel for the given locality
     void dispatchPruneKernel(gmx::InteractionLocality iLocality,
                              const nbnxn_atomdata_t*  nbat,
@@ -119,6 +131,14 @@ public:
         params_.rlistInner = rlistInner;
     }
 
+    //! Changes the pair-list lifetime and the dynamic pruning interval, no pruning when \p nstlistPrune <= 0
+    void changePairlistIntervals(int nstlist, int nstlistPrune)
+    {
+        params_.lifetime          = nstlist - 1;
+        params_.useDynamicPruning = (nstlistPrune > 0);
+        params_.nstlistPrune      = (nstlistPrune > 0 ? nstlistPrune : -1);
+    }
+
     //! Returns the pair-list set for the given locality
     const PairlistSet& pairlistSet(gmx::InteractionLocality iLocality) const
     {
@@ -45,7 +45,7 @@
 
 #include "pairsearch.h"
 
-#include "gromacs/utility/smalloc.h"
+#include <memory>
 
 #include "pairlist.h"
 
@@ -71,30 +71,19 @@ void SearchCycleCounting::printCycles(FILE* fp, gmx::ArrayRef<const PairsearchWo
     fprintf(fp, "\n");
 }
 
-/*! \brief Frees the contents of a legacy t_nblist struct */
-static void free_nblist(t_nblist* nl)
-{
-    sfree(nl->iinr);
-    sfree(nl->gid);
-    sfree(nl->shift);
-    sfree(nl->jindex);
-    sfree(nl->jjnr);
-    sfree(nl->excl_fep);
-}
-
 #ifndef DOXYGEN
 
-PairsearchWork::PairsearchWork() : cp0({ { 0 } }), ndistc(0), nbl_fep(new t_nblist), cp1({ { 0 } })
+PairsearchWork::PairsearchWork() :
+    cp0({ { 0 } }),
+    ndistc(0),
+    nbl_fep(std::make_unique<NbnxnPairlistFep>()),
+    cp1({ { 0 } })
 {
-    nbnxn_init_pairlist_fep(nbl_fep.get());
 }
 
 #endif // !DOXYGEN
 
-PairsearchWork::~PairsearchWork()
-{
-    free_nblist(nbl_fep.get());
-}
+PairsearchWork::~PairsearchWork() = default;
 
 PairSearch::PairSearch(const PbcType             pbcType,
                        const bool                doTestParticleInsertion,
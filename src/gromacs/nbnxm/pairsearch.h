@@ -160,12 +160,12 @@ struct PairsearchWork
     //! Flags for force buffer access
     std::vector<gmx_bitmask_t> buffer_flags;
 
-    //! Number of distance checks for flop counting
+    //! Number of distance checks for flop counting, accumulated until counted after the search
     int ndistc;
 
 
     //! Temporary FEP list for load balancing
-    std::unique_ptr<t_nblist> nbl_fep;
+    std::unique_ptr<NbnxnPairlistFep> nbl_fep;
 
     //! Counter for thread-local cycles
     nbnxn_cycle_t cycleCounter;
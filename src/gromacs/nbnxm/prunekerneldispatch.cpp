@@ -37,6 +37,7 @@
 
 #include "gromacs/mdlib/gmx_omp_nthreads.h"
 #include "gromacs/nbnxm/nbnxm.h"
+#include "gromacs/timing/cyclecounter.h"
 #include "gromacs/timing/wallcycle.h"
 #include "gromacs/utility/gmxassert.h"
 
@@ -93,7 +94,10 @@ void PairlistSet::dispatchPruneKernel(const nbnxn_atomdata_t* nbat, const rvec*
 
 void nonbonded_verlet_t::dispatchPruneKernelCpu(const gmx::InteractionLocality iLocality, const rvec* shift_vec)
 {
+    const gmx_cycles_t cycles = gmx_cycles_read();
     pairlistSets_->dispatchPruneKernel(iLocality, nbat.get(), shift_vec);
+    cpuKernelCycles_.numPruneCalls++;
+    cpuKernelCycles_.pruneCycles += static_cast<double>(gmx_cycles_read() - cycles);
 }
 
 void nonbonded_verlet_t::dispatchPruneKernelGpu(int64_t step)
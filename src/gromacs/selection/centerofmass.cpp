@@ -45,13 +45,19 @@
 #include "centerofmass.h"
 
 #include <cmath>
+#include <cstdint>
+
+#include <algorithm>
 
 #include "gromacs/math/vec.h"
 #include "gromacs/pbcutil/pbc.h"
+#include "gromacs/simd/simd.h"
 #include "gromacs/topology/block.h"
 #include "gromacs/topology/mtop_lookup.h"
 #include "gromacs/topology/topology.h"
+#include "gromacs/utility/exceptions.h"
 #include "gromacs/utility/gmxassert.h"
+#include "gromacs/utility/gmxomp.h"
 
 void gmx_calc_cog(const gmx_mtop_t* /* top */, rvec x[], int nrefat, const int index[], rvec xout)
 {
@@ -484,6 +490,143 @@ void gmx_calc_comg_f_block(const gmx_mtop_t* top,
     }
 }
 
+//! Minimum number of blocks for which gmx_calc_weighted_block() uses threads.
+static const int c_minBlocksPerThread = 1000;
+
+/*! \brief
+ * Computes weighted centers for blocks \p begin to \p end.
+ *
+ * See gmx_calc_weighted_block() for the parameters.
+ * Groups of consecutive blocks that all have the same size, which is the
+ * common case for, e.g., solvent residues, are processed with one block
+ * per SIMD lane; other blocks use a scalar loop with the same arithmetic.
+ * The SIMD gather loads can read up to a SIMD width of reals starting at
+ * each atom, and \p x is not padded, so groups that contain any of the
+ * last atoms of \p x also use the scalar loop.
+ */
+static void calc_weighted_block_range(const rvec     x[],
+                                      int            numAtoms,
+                                      const t_block* block,
+                                      const int      index[],
+                                      const real     weight[],
+                                      const real     blockScale[],
+                                      int            begin,
+                                      int            end,
+                                      rvec           xout[])
+{
+#if GMX_SIMD_HAVE_REAL
+    using namespace gmx;
+
+    alignas(GMX_SIMD_ALIGNMENT) std::int32_t atomOffset[GMX_SIMD_REAL_WIDTH];
+    alignas(GMX_SIMD_ALIGNMENT) std::int32_t outOffset[GMX_SIMD_REAL_WIDTH];
+    alignas(GMX_SIMD_ALIGNMENT) real         w[GMX_SIMD_REAL_WIDTH];
+    alignas(GMX_SIMD_ALIGNMENT) real         scale[GMX_SIMD_REAL_WIDTH];
+
+    /* Last atom for which a load of GMX_SIMD_REAL_WIDTH reals stays within x */
+    const int lastSimdSafeAtom = numAtoms - (GMX_SIMD_REAL_WIDTH + DIM - 1) / DIM;
+#endif
+    int b = begin;
+    while (b < end)
+    {
+#if GMX_SIMD_HAVE_REAL
+        const int blockSize = block->index[b + 1] - block->index[b];
+        bool      bUniform  = (b + GMX_SIMD_REAL_WIDTH <= end);
+        for (int l = 1; l < GMX_SIMD_REAL_WIDTH && bUniform; ++l)
+        {
+            bUniform = (block->index[b + l + 1] - block->index[b + l] == blockSize);
+        }
+        for (int i = block->index[b]; bUniform && i < block->index[b + GMX_SIMD_REAL_WIDTH]; ++i)
+        {
+            bUniform = (index[i] <= lastSimdSafeAtom);
+        }
+        if (bUniform)
+        {
+            SimdReal sumX = setZero();
+            SimdReal sumY = setZero();
+            SimdReal sumZ = setZero();
+            for (int k = 0; k < blockSize; ++k)
+            {
+                for (int l = 0; l < GMX_SIMD_REAL_WIDTH; ++l)
+                {
+                    const int i   = block->index[b + l] + k;
+                    atomOffset[l] = index[i];
+                    w[l]          = weight[i];
+                }
+                SimdReal xS, yS, zS;
+                gatherLoadUTranspose<3>(x[0], atomOffset, &xS, &yS, &zS);
+                const SimdReal wS = load<SimdReal>(w);
+                sumX              = fma(wS, xS, sumX);
+                sumY              = fma(wS, yS, sumY);
+                sumZ              = fma(wS, zS, sumZ);
+            }
+            for (int l = 0; l < GMX_SIMD_REAL_WIDTH; ++l)
+            {
+                outOffset[l] = b + l;
+                scale[l]     = blockScale[b + l];
+            }
+            const SimdReal scaleS = load<SimdReal>(scale);
+            transposeScatterStoreU<3>(xout[0], outOffset, sumX * scaleS, sumY * scaleS,
+                                      sumZ * scaleS);
+            b += GMX_SIMD_REAL_WIDTH;
+            continue;
+        }
+#endif
+        rvec xb;
+        clear_rvec(xb);
+        for (int i = block->index[b]; i < block->index[b + 1]; ++i)
+        {
+            const int ai = index[i];
+            for (int d = 0; d < DIM; ++d)
+            {
+                xb[d] += weight[i] * x[ai][d];
+            }
+        }
+        svmul(blockScale[b], xb, xout[b]);
+        ++b;
+    }
+}
+
+/*!
+ * \param[in]  x          Position vectors of all atoms.
+ * \param[in]  numAtoms   Number of atoms in \p x.
+ * \param[in]  block      t_block structure that divides \p index into blocks.
+ * \param[in]  index      Indices of atoms.
+ * \param[in]  weight     Weight for each atom in \p index.
+ * \param[in]  blockScale Factor to multiply the weighted sum of each block.
+ * \param[out] xout       \p block->nr weighted centers.
+ *
+ * Computes `blockScale[b] * sum(weight[i] * x[index[i]])` over the atoms in
+ * each block.  With weights that are the masses (or one) and scales that are
+ * the inverse total masses (or inverse atom counts), this computes the same
+ * as gmx_calc_comg_block(), but the weights can be computed once for static
+ * blocks instead of looking up the masses for every frame.
+ * Blocks of equal size are processed with SIMD, and large numbers of blocks
+ * are divided between OpenMP threads.
+ */
+void gmx_calc_weighted_block(const rvec     x[],
+                             int            numAtoms,
+                             const t_block* block,
+                             const int      index[],
+                             const real     weight[],
+                             const real     blockScale[],
+                             rvec           xout[])
+{
+    const int nthreads = std::max(1, std::min(gmx_omp_get_max_threads(),
+                                              block->nr / c_minBlocksPerThread));
+#pragma omp parallel num_threads(nthreads)
+    {
+        try
+        {
+            const int thread = gmx_omp_get_thread_num();
+            const int begin  = (block->nr * thread) / nthreads;
+            const int end    = (block->nr * (thread + 1)) / nthreads;
+            calc_weighted_block_range(x, numAtoms, block, index, weight, blockScale, begin, end,
+                                      xout);
+        }
+        GMX_CATCH_ALL_AND_EXIT_WITH_FATAL_ERROR
+    }
+}
+
 /*!
  * \param[in]  top   Topology structure with masses
  *   (can be NULL if \p bMASS==false).
@@ -162,6 +162,14 @@ void gmx_calc_comg_f_block(const gmx_mtop_t* top,
                            const int         index[],
                            bool              bMass,
                            rvec              fout[]);
+/** Calculate weighted centers for a blocked index with precomputed weights. */
+void gmx_calc_weighted_block(const rvec     x[],
+                             int            numAtoms,
+                             const t_block* block,
+                             const int      index[],
+                             const real     weight[],
+                             const real     blockScale[],
+                             rvec           xout[]);
 /** Calculate centers of mass/geometry for a set of blocks; */
 void gmx_calc_comg_blocka(const gmx_mtop_t* top, rvec x[], const t_blocka* block, bool bMass, rvec xout[]);
 /** Calculate forces on centers of mass/geometry for a set of blocks; */
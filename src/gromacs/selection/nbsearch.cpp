@@ -59,11 +59,14 @@
 #include <cstring>
 
 #include <algorithm>
+#include <limits>
 #include <vector>
 
 #include "gromacs/math/functions.h"
 #include "gromacs/math/vec.h"
 #include "gromacs/pbcutil/pbc.h"
+#include "gromacs/simd/simd.h"
+#include "gromacs/utility/alignedallocator.h"
 #include "gromacs/utility/arrayref.h"
 #include "gromacs/utility/exceptions.h"
 #include "gromacs/utility/gmxassert.h"
@@ -79,6 +82,22 @@ namespace gmx
 namespace
 {
 
+#if GMX_SIMD_HAVE_REAL
+//! Number of reference positions in a cluster in the grid cell storage.
+constexpr int c_clusterSize = GMX_SIMD_REAL_WIDTH;
+#else
+//! Number of reference positions in a cluster in the grid cell storage.
+constexpr int c_clusterSize = 1;
+#endif
+
+/*! \brief
+ * Coordinate used for padding the clusters in the grid cells.
+ *
+ * Needs to be far enough from any real position that the padding is never
+ * within the cutoff, but small enough that its square does not overflow.
+ */
+constexpr real c_paddingCoordinate = 1e10;
+
 /*! \brief
  * Computes the bounding box for a set of positions.
  *
@@ -123,7 +142,6 @@ class AnalysisNeighborhoodSearchImpl
 public:
     typedef AnalysisNeighborhoodPairSearch::ImplPointer PairSearchImplPointer;
     typedef std::vector<PairSearchImplPointer>          PairSearchList;
-    typedef std::vector<std::vector<int>>               CellList;
 
     explicit AnalysisNeighborhoodSearchImpl(real cutoff);
     ~AnalysisNeighborhoodSearchImpl();
@@ -144,6 +162,17 @@ public:
                                const AnalysisNeighborhoodPositions& positions);
     PairSearchImplPointer getPairSearch();
 
+    /*! \brief
+     * Whether the last init() used the given reference positions.
+     *
+     * This is a cheap check used to pick a search object that is likely to
+     * be able to reuse its grid; init() does the full comparison.
+     */
+    bool wasInitializedWith(const AnalysisNeighborhoodPositions& positions) const
+    {
+        return bInputCached_ && cachedX_ == positions.x_ && nref_ == positions.count_;
+    }
+
     real cutoffSquared() const { return cutoff2_; }
     bool usesGridSearch() const { return bGrid_; }
 
@@ -197,16 +226,34 @@ private:
      */
     int getGridCellIndex(const rvec cell) const;
     /*! \brief
-     * Adds an index into a grid cell.
+     * Sorts the reference positions into the grid cells.
+     *
+     * \param[in]  cellIndices Linear grid cell index for each reference
+     *     position.
+     *
+     * Fills \p cellStart_, \p cellPositionCount_, \p cellRefIndices_, and
+     * \p cellX_ such that the positions in each cell are contiguous, in
+     * increasing index order, and each cell is padded to a multiple of
+     * the cluster size.
+     * \p xrefAlloc_ should contain the in-unit-cell reference positions.
+     */
+    void sortToGridCells(ArrayRef<const int> cellIndices);
+    /*! \brief
+     * Checks whether init() can reuse the grid from the previous call.
      *
-     * \param[in]  cell Fractional cell coordinates into which \p i should
-     *     be added.
-     * \param[in]  i    Index to add.
+     * \param[in] mode      Search mode to use.
+     * \param[in] bXY       Whether to use 2D searching.
+     * \param[in] pbc       PBC information for the new search.
+     * \param[in] positions Set of reference positions.
      *
-     * \p cell should satisfy the conditions that \p mapPointToGridCell()
-     * produces.
+     * Compares the input against values stored by storeInputCache().
      */
-    void addToGridCell(const rvec cell, int i);
+    bool canReuseGrid(AnalysisNeighborhood::SearchMode     mode,
+                      bool                                 bXY,
+                      const t_pbc&                         pbc,
+                      const AnalysisNeighborhoodPositions& positions) const;
+    //! Stores the input of init() for canReuseGrid().
+    void storeInputCache(AnalysisNeighborhood::SearchMode mode, const AnalysisNeighborhoodPositions& positions);
     /*! \brief
      * Initializes a cell pair loop for a dimension.
      *
@@ -317,8 +364,35 @@ private:
     real cellShiftYX_;
     //! Number of cells along each dimension.
     ivec ncelldim_;
-    //! Data structure to hold the grid cell contents.
-    CellList cells_;
+    /*! \brief
+     * Start of each grid cell in \p cellRefIndices_ and \p cellX_.
+     *
+     * Has one more element than there are cells.  The starts are multiples
+     * of the cluster size, such that SIMD loads from them are aligned.
+     */
+    std::vector<int> cellStart_;
+    //! Number of reference positions in each grid cell.
+    std::vector<int> cellPositionCount_;
+    //! Reference position indices sorted by grid cell (-1 for padding).
+    std::vector<int> cellRefIndices_;
+    /*! \brief
+     * In-unit-cell reference positions sorted by grid cell.
+     *
+     * Stored separately for each dimension, and padded with
+     * \c c_paddingCoordinate at the end of each cell.
+     */
+    std::vector<real, AlignedAllocator<real>> cellX_[DIM];
+
+    //! Whether the input to the previous init() is stored in the cache.
+    bool bInputCached_;
+    //! Search mode used in the previous init().
+    AnalysisNeighborhood::SearchMode cachedMode_;
+    //! Reference position array used in the previous init().
+    const rvec* cachedX_;
+    //! Reference positions (before mapping to the grid) in the previous init().
+    std::vector<RVec> cachedRefX_;
+    //! Reference position indices in the previous init() (empty if none).
+    std::vector<int> cachedRefIndices_;
 
     Mutex          createPairSearchMutex_;
     PairSearchList pairSearchList_;
@@ -353,6 +427,14 @@ public:
     //! Searches for the next neighbor.
     template<class Action>
     bool searchNext(Action action);
+    /*! \brief
+     * Finds all pairs for at most \p maxTestPositionCount of the remaining
+     * test positions.
+     *
+     * Found pairs are appended to \p pairs.
+     * Returns false if there were no test positions left.
+     */
+    bool searchAll(std::vector<AnalysisNeighborhoodPair>* pairs, int maxTestPositionCount);
     //! Initializes a pair representing the pair found by searchNext().
     void initFoundPair(AnalysisNeighborhoodPair* pair) const;
     //! Advances to the next test position, skipping any remaining pairs.
@@ -363,6 +445,14 @@ private:
     void reset(int testIndex);
     //! Checks whether a reference positiong should be excluded.
     bool isExcluded(int j);
+    /*! \brief
+     * Finds all pairs between the current test position and a grid cell.
+     *
+     * \param[in]     ci    Index of the grid cell to search.
+     * \param[in]     shift Periodic shift to apply to the cell positions.
+     * \param[in,out] pairs Found pairs are appended here.
+     */
+    void searchCell(int ci, const rvec shift, std::vector<AnalysisNeighborhoodPair>* pairs);
 
     //! Parent search object.
     const AnalysisNeighborhoodSearchImpl& search_;
@@ -438,6 +528,10 @@ AnalysisNeighborhoodSearchImpl::AnalysisNeighborhoodSearchImpl(real cutoff)
     clear_rvec(cellSize_);
     clear_rvec(invCellSize_);
     clear_ivec(ncelldim_);
+
+    bInputCached_ = false;
+    cachedMode_   = AnalysisNeighborhood::eSearchMode_Automatic;
+    cachedX_      = nullptr;
 }
 
 AnalysisNeighborhoodSearchImpl::~AnalysisNeighborhoodSearchImpl()
@@ -536,17 +630,7 @@ bool AnalysisNeighborhoodSearchImpl::initGridCells(const matrix box, bool bSingl
     {
         return false;
     }
-    // Never decrease the size of the cell vector to avoid reallocating
-    // memory for the nested vectors.  The actual size of the vector is not
-    // used outside this function.
-    if (cells_.size() < static_cast<size_t>(totalCellCount))
-    {
-        cells_.resize(totalCellCount);
-    }
-    for (int ci = 0; ci < totalCellCount; ++ci)
-    {
-        cells_[ci].clear();
-    }
+    cellPositionCount_.assign(totalCellCount, 0);
     return true;
 }
 
@@ -708,10 +792,106 @@ int AnalysisNeighborhoodSearchImpl::getGridCellIndex(const rvec cell) const
     return getGridCellIndex(icell);
 }
 
-void AnalysisNeighborhoodSearchImpl::addToGridCell(const rvec cell, int i)
+void AnalysisNeighborhoodSearchImpl::sortToGridCells(ArrayRef<const int> cellIndices)
 {
-    const int ci = getGridCellIndex(cell);
-    cells_[ci].push_back(i);
+    // Counting sort: count the positions in each cell, compute the start of
+    // each cell, and then scatter the positions in index order.
+    for (const int ci : cellIndices)
+    {
+        ++cellPositionCount_[ci];
+    }
+    const int cellCount = ssize(cellPositionCount_);
+    cellStart_.resize(cellCount + 1);
+    cellStart_[0] = 0;
+    for (int ci = 0; ci < cellCount; ++ci)
+    {
+        const int paddedCount =
+                (cellPositionCount_[ci] + c_clusterSize - 1) / c_clusterSize * c_clusterSize;
+        cellStart_[ci + 1] = cellStart_[ci] + paddedCount;
+    }
+    const int paddedTotal = cellStart_[cellCount];
+    cellRefIndices_.assign(paddedTotal, -1);
+    for (int d = 0; d < DIM; ++d)
+    {
+        cellX_[d].assign(paddedTotal, c_paddingCoordinate);
+    }
+    std::vector<int> cellFill(cellStart_.begin(), cellStart_.end() - 1);
+    for (int i = 0; i < nref_; ++i)
+    {
+        const int dest        = cellFill[cellIndices[i]]++;
+        cellRefIndices_[dest] = i;
+        cellX_[XX][dest]      = xrefAlloc_[i][XX];
+        cellX_[YY][dest]      = xrefAlloc_[i][YY];
+        cellX_[ZZ][dest]      = xrefAlloc_[i][ZZ];
+    }
+}
+
+bool AnalysisNeighborhoodSearchImpl::canReuseGrid(AnalysisNeighborhood::SearchMode     mode,
+                                                  bool                                 bXY,
+                                                  const t_pbc&                         pbc,
+                                                  const AnalysisNeighborhoodPositions& positions) const
+{
+    if (!bInputCached_ || mode != cachedMode_ || bXY != bXY_ || pbc.pbcType != pbc_.pbcType
+        || positions.count_ != nref_ || positions.x_ != cachedX_
+        || (positions.indices_ != nullptr) != !cachedRefIndices_.empty())
+    {
+        return false;
+    }
+    for (int d = 0; d < DIM; ++d)
+    {
+        for (int e = 0; e < DIM; ++e)
+        {
+            if (pbc.box[d][e] != pbc_.box[d][e])
+            {
+                return false;
+            }
+        }
+    }
+    for (int i = 0; i < nref_; ++i)
+    {
+        int ii = i;
+        if (positions.indices_ != nullptr)
+        {
+            ii = positions.indices_[i];
+            if (ii != cachedRefIndices_[i])
+            {
+                return false;
+            }
+        }
+        const rvec& x = positions.x_[ii];
+        if (x[XX] != cachedRefX_[i][XX] || x[YY] != cachedRefX_[i][YY] || x[ZZ] != cachedRefX_[i][ZZ])
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+void AnalysisNeighborhoodSearchImpl::storeInputCache(AnalysisNeighborhood::SearchMode     mode,
+                                                     const AnalysisNeighborhoodPositions& positions)
+{
+    // Without a grid or indices, init() does no work that could be saved.
+    bInputCached_ = (bGrid_ || positions.indices_ != nullptr);
+    if (!bInputCached_)
+    {
+        return;
+    }
+    cachedMode_ = mode;
+    cachedX_    = positions.x_;
+    cachedRefX_.resize(nref_);
+    if (positions.indices_ != nullptr)
+    {
+        cachedRefIndices_.assign(positions.indices_, positions.indices_ + nref_);
+    }
+    else
+    {
+        cachedRefIndices_.clear();
+    }
+    for (int i = 0; i < nref_; ++i)
+    {
+        const int ii = (positions.indices_ != nullptr) ? positions.indices_[i] : i;
+        copy_rvec(positions.x_[ii], cachedRefX_[i]);
+    }
 }
 
 void AnalysisNeighborhoodSearchImpl::initCellRange(const rvec centerCell, ivec currCell, ivec upperBound, int dim) const
@@ -866,8 +1046,8 @@ void AnalysisNeighborhoodSearchImpl::init(AnalysisNeighborhood::SearchMode     m
 {
     GMX_RELEASE_ASSERT(positions.index_ == -1,
                        "Individual indexed positions not supported as reference");
-    bXY_ = bXY;
-    if (bXY_ && pbc != nullptr && pbc->pbcType != PbcType::No)
+    t_pbc searchPbc;
+    if (bXY && pbc != nullptr && pbc->pbcType != PbcType::No)
     {
         if (pbc->pbcType != PbcType::XY && pbc->pbcType != PbcType::Xyz)
         {
@@ -888,51 +1068,63 @@ void AnalysisNeighborhoodSearchImpl::init(AnalysisNeighborhood::SearchMode     m
         matrix box;
         copy_mat(pbc->box, box);
         clear_rvec(box[ZZ]);
-        set_pbc(&pbc_, PbcType::XY, box);
+        set_pbc(&searchPbc, PbcType::XY, box);
     }
     else if (pbc != nullptr)
     {
-        pbc_ = *pbc;
+        searchPbc = *pbc;
     }
     else
     {
-        pbc_.pbcType = PbcType::No;
-        clear_mat(pbc_.box);
+        std::memset(&searchPbc, 0, sizeof(searchPbc));
+        searchPbc.pbcType = PbcType::No;
     }
-    nref_ = positions.count_;
-    if (mode == AnalysisNeighborhood::eSearchMode_Simple)
+    // Several searches within a frame often use the same reference positions
+    // (e.g., multiple selections referring to the same group), in which case
+    // the grid from the previous call is still valid.
+    const bool bReuseGrid = canReuseGrid(mode, bXY, searchPbc, positions);
+    bXY_                  = bXY;
+    pbc_                  = searchPbc;
+    nref_                 = positions.count_;
+    refIndices_           = positions.indices_;
+    if (!bReuseGrid)
     {
-        bGrid_ = false;
-    }
-    else if (bTryGrid_)
-    {
-        bGrid_ = initGrid(pbc_, positions.count_, positions.x_,
-                          mode == AnalysisNeighborhood::eSearchMode_Grid);
-    }
-    refIndices_ = positions.indices_;
-    if (bGrid_)
-    {
-        xrefAlloc_.resize(nref_);
-        xref_ = as_rvec_array(xrefAlloc_.data());
-
-        for (int i = 0; i < nref_; ++i)
+        if (mode == AnalysisNeighborhood::eSearchMode_Simple)
         {
-            const int ii = (refIndices_ != nullptr) ? refIndices_[i] : i;
-            rvec      refcell;
-            mapPointToGridCell(positions.x_[ii], refcell, xrefAlloc_[i]);
-            addToGridCell(refcell, i);
+            bGrid_ = false;
         }
-    }
-    else if (refIndices_ != nullptr)
-    {
-        xrefAlloc_.resize(nref_);
-        xref_ = as_rvec_array(xrefAlloc_.data());
-        for (int i = 0; i < nref_; ++i)
+        else if (bTryGrid_)
         {
-            copy_rvec(positions.x_[refIndices_[i]], xrefAlloc_[i]);
+            bGrid_ = initGrid(pbc_, positions.count_, positions.x_,
+                              mode == AnalysisNeighborhood::eSearchMode_Grid);
         }
+        if (bGrid_)
+        {
+            xrefAlloc_.resize(nref_);
+            xref_ = as_rvec_array(xrefAlloc_.data());
+
+            std::vector<int> cellIndices(nref_);
+            for (int i = 0; i < nref_; ++i)
+            {
+                const int ii = (refIndices_ != nullptr) ? refIndices_[i] : i;
+                rvec      refcell;
+                mapPointToGridCell(positions.x_[ii], refcell, xrefAlloc_[i]);
+                cellIndices[i] = getGridCellIndex(refcell);
+            }
+            sortToGridCells(cellIndices);
+        }
+        else if (refIndices_ != nullptr)
+        {
+            xrefAlloc_.resize(nref_);
+            xref_ = as_rvec_array(xrefAlloc_.data());
+            for (int i = 0; i < nref_; ++i)
+            {
+                copy_rvec(positions.x_[refIndices_[i]], xrefAlloc_[i]);
+            }
+        }
+        storeInputCache(mode, positions);
     }
-    else
+    if (!bGrid_ && refIndices_ == nullptr)
     {
         xref_ = positions.x_;
     }
@@ -1078,10 +1270,17 @@ bool AnalysisNeighborhoodPairSearchImpl::searchNext(Action action)
                 {
                     continue;
                 }
-                const int cellSize = ssize(search_.cells_[ci]);
+                const int cellStart = search_.cellStart_[ci];
+                const int cellSize  = search_.cellPositionCount_[ci];
+                // The positions in a cell are stored contiguously, so the
+                // loop reads the coordinates linearly.
+                const int*  cellRefIndices = search_.cellRefIndices_.data() + cellStart;
+                const real* cellX          = search_.cellX_[XX].data() + cellStart;
+                const real* cellY          = search_.cellX_[YY].data() + cellStart;
+                const real* cellZ          = search_.cellX_[ZZ].data() + cellStart;
                 for (; cai < cellSize; ++cai)
                 {
-                    const int i = search_.cells_[ci][cai];
+                    const int i = cellRefIndices[cai];
                     if (selfSearchMode_ && ci == testCellIndex_ && i >= testIndex_)
                     {
                         continue;
@@ -1090,8 +1289,8 @@ bool AnalysisNeighborhoodPairSearchImpl::searchNext(Action action)
                     {
                         continue;
                     }
-                    rvec dx;
-                    rvec_sub(search_.xref_[i], xtest_, dx);
+                    rvec dx = { cellX[cai] - xtest_[XX], cellY[cai] - xtest_[YY],
+                                cellZ[cai] - xtest_[ZZ] };
                     rvec_sub(dx, shift, dx);
                     const real r2 = search_.bXY_ ? dx[XX] * dx[XX] + dx[YY] * dx[YY] : norm2(dx);
                     if (r2 <= search_.cutoff2_)
@@ -1145,6 +1344,114 @@ bool AnalysisNeighborhoodPairSearchImpl::searchNext(Action action)
     return false;
 }
 
+void AnalysisNeighborhoodPairSearchImpl::searchCell(int                                    ci,
+                                                    const rvec                             shift,
+                                                    std::vector<AnalysisNeighborhoodPair>* pairs)
+{
+    const int   cellStart  = search_.cellStart_[ci];
+    const int   cellEnd    = cellStart + search_.cellPositionCount_[ci];
+    const int*  refIndices = search_.cellRefIndices_.data();
+    const real* cellX      = search_.cellX_[XX].data();
+    const real* cellY      = search_.cellX_[YY].data();
+    const real* cellZ      = search_.cellX_[ZZ].data();
+    const real  cutoff2    = search_.cutoff2_;
+    // The positions of a cell are processed a cluster at a time, as in the
+    // nbnxm pair search; the distance tests are done in SIMD, and only
+    // clusters with some positions within the cutoff are processed further.
+#if GMX_SIMD_HAVE_REAL
+    const SimdReal xtestX(xtest_[XX]);
+    const SimdReal xtestY(xtest_[YY]);
+    const SimdReal xtestZ(xtest_[ZZ]);
+    const SimdReal shiftX(shift[XX]);
+    const SimdReal shiftY(shift[YY]);
+    const SimdReal shiftZ(shift[ZZ]);
+    const SimdReal cutoff2S(cutoff2);
+    alignas(GMX_SIMD_ALIGNMENT) real r2Buf[GMX_SIMD_REAL_WIDTH];
+    alignas(GMX_SIMD_ALIGNMENT) real dxBuf[DIM][GMX_SIMD_REAL_WIDTH];
+    for (int c = cellStart; c < cellEnd; c += c_clusterSize)
+    {
+        const SimdReal dx = (load<SimdReal>(cellX + c) - xtestX) - shiftX;
+        const SimdReal dy = (load<SimdReal>(cellY + c) - xtestY) - shiftY;
+        const SimdReal dz = (load<SimdReal>(cellZ + c) - xtestZ) - shiftZ;
+        SimdReal       r2 = dx * dx + dy * dy;
+        if (!search_.bXY_)
+        {
+            r2 = r2 + dz * dz;
+        }
+        if (!anyTrue(r2 <= cutoff2S))
+        {
+            continue;
+        }
+        store(r2Buf, r2);
+        store(dxBuf[XX], dx);
+        store(dxBuf[YY], dy);
+        store(dxBuf[ZZ], dz);
+        const int clusterEnd = std::min(c_clusterSize, cellEnd - c);
+        for (int l = 0; l < clusterEnd; ++l)
+        {
+            const int i = refIndices[c + l];
+            if (r2Buf[l] <= cutoff2 && !isExcluded(i))
+            {
+                const rvec pairDx = { dxBuf[XX][l], dxBuf[YY][l], dxBuf[ZZ][l] };
+                pairs->emplace_back(i, testIndex_, r2Buf[l], pairDx);
+            }
+        }
+    }
+#else
+    for (int c = cellStart; c < cellEnd; ++c)
+    {
+        rvec dx = { cellX[c] - xtest_[XX], cellY[c] - xtest_[YY], cellZ[c] - xtest_[ZZ] };
+        rvec_sub(dx, shift, dx);
+        const real r2 = search_.bXY_ ? dx[XX] * dx[XX] + dx[YY] * dx[YY] : norm2(dx);
+        if (r2 <= cutoff2 && !isExcluded(refIndices[c]))
+        {
+            pairs->emplace_back(refIndices[c], testIndex_, r2, dx);
+        }
+    }
+#endif
+}
+
+bool AnalysisNeighborhoodPairSearchImpl::searchAll(std::vector<AnalysisNeighborhoodPair>* pairs,
+                                                   int maxTestPositionCount)
+{
+    GMX_RELEASE_ASSERT(!selfSearchMode_, "Batch search not implemented for self pairs");
+    if (testIndex_ >= testPosCount_)
+    {
+        return false;
+    }
+    const int endIndex = testPosCount_ - testIndex_ > maxTestPositionCount
+                                 ? testIndex_ + maxTestPositionCount
+                                 : testPosCount_;
+    if (!search_.bGrid_)
+    {
+        // The simple search uses pbc_dx(), which is not vectorized, so this
+        // just collects the pairs from the scalar loop, limited to the
+        // requested test positions.
+        const auto collectPair = [this, pairs](int i, real r2, const rvec dx) {
+            pairs->emplace_back(i, testIndex_, r2, dx);
+            return false;
+        };
+        const int testPosCount = testPosCount_;
+        testPosCount_          = endIndex;
+        searchNext(collectPair);
+        testPosCount_ = testPosCount;
+        reset(testIndex_);
+        return true;
+    }
+    while (testIndex_ < endIndex)
+    {
+        do
+        {
+            rvec      shift;
+            const int ci = search_.shiftCell(currCell_, shift);
+            searchCell(ci, shift, pairs);
+            exclind_ = 0;
+        } while (search_.nextCell(testcell_, currCell_, cellBound_));
+        nextTestPosition();
+    }
+    return true;
+}
+
 void AnalysisNeighborhoodPairSearchImpl::initFoundPair(AnalysisNeighborhoodPair* pair) const
 {
     if (previ_ < 0)
@@ -1252,7 +1559,7 @@ public:
         }
     }
 
-    SearchImplPointer getSearch();
+    SearchImplPointer getSearch(const AnalysisNeighborhoodPositions& positions);
 
     Mutex                   createSearchMutex_;
     SearchList              searchList_;
@@ -1262,19 +1569,34 @@ public:
     bool                    bXY_;
 };
 
-AnalysisNeighborhood::Impl::SearchImplPointer AnalysisNeighborhood::Impl::getSearch()
+AnalysisNeighborhood::Impl::SearchImplPointer
+AnalysisNeighborhood::Impl::getSearch(const AnalysisNeighborhoodPositions& positions)
 {
     lock_guard<Mutex> lock(createSearchMutex_);
     // TODO: Consider whether this needs to/can be faster, e.g., by keeping a
     // separate pool of unused search objects.
+    // Prefer an unused search that was last initialized with the same
+    // positions, as it may be able to reuse its grid.
+    SearchList::const_iterator unused = searchList_.end();
     SearchList::const_iterator i;
     for (i = searchList_.begin(); i != searchList_.end(); ++i)
     {
         if (i->unique())
         {
-            return *i;
+            if ((*i)->wasInitializedWith(positions))
+            {
+                return *i;
+            }
+            if (unused == searchList_.end())
+            {
+                unused = i;
+            }
         }
     }
+    if (unused != searchList_.end())
+    {
+        return *unused;
+    }
     SearchImplPointer search(new internal::AnalysisNeighborhoodSearchImpl(cutoff_));
     searchList_.push_back(search);
     return search;
@@ -1320,7 +1642,7 @@ AnalysisNeighborhood::SearchMode AnalysisNeighborhood::mode() const
 AnalysisNeighborhoodSearch AnalysisNeighborhood::initSearch(const t_pbc* pbc,
                                                             const AnalysisNeighborhoodPositions& positions)
 {
-    Impl::SearchImplPointer search(impl_->getSearch());
+    Impl::SearchImplPointer search(impl_->getSearch(positions));
     search->init(mode(), impl_->bXY_, impl_->excls_, pbc, positions);
     return AnalysisNeighborhoodSearch(search);
 }
@@ -1387,6 +1709,16 @@ AnalysisNeighborhoodPairSearch AnalysisNeighborhoodSearch::startSelfPairSearch()
     return AnalysisNeighborhoodPairSearch(pairSearch);
 }
 
+void AnalysisNeighborhoodSearch::findAllPairs(const AnalysisNeighborhoodPositions& positions,
+                                              std::vector<AnalysisNeighborhoodPair>* pairs) const
+{
+    GMX_RELEASE_ASSERT(impl_, "Accessing an invalid search object");
+    pairs->clear();
+    internal::AnalysisNeighborhoodPairSearchImpl pairSearch(*impl_);
+    pairSearch.startSearch(positions);
+    pairSearch.searchAll(pairs, std::numeric_limits<int>::max());
+}
+
 AnalysisNeighborhoodPairSearch
 AnalysisNeighborhoodSearch::startPairSearch(const AnalysisNeighborhoodPositions& positions) const
 {
@@ -1412,6 +1744,14 @@ bool AnalysisNeighborhoodPairSearch::findNextPair(AnalysisNeighborhoodPair* pair
     return bFound;
 }
 
+bool AnalysisNeighborhoodPairSearch::findNextPairBlock(int maxTestPositionCount,
+                                                       std::vector<AnalysisNeighborhoodPair>* pairs)
+{
+    GMX_RELEASE_ASSERT(maxTestPositionCount > 0, "Block must contain at least one test position");
+    pairs->clear();
+    return impl_->searchAll(pairs, maxTestPositionCount);
+}
+
 void AnalysisNeighborhoodPairSearch::skipRemainingPairsForTestPosition()
 {
     impl_->nextTestPosition();
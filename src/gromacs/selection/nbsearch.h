@@ -533,6 +533,30 @@ public:
      * It can be up to 50% faster.
      */
     AnalysisNeighborhoodPairSearch startPairSearch(const AnalysisNeighborhoodPositions& positions) const;
+    /*! \brief
+     * Finds all reference positions within a cutoff of a set of test positions.
+     *
+     * \param[in]  positions  Set of test positions to use.
+     * \param[out] pairs      All pairs within the configured cutoff.
+     * \throws     std::bad_alloc if out of memory.
+     *
+     * Returns the same pairs, in the same order, as a loop over
+     * AnalysisNeighborhoodPairSearch::findNextPair() for a search started
+     * with startPairSearch(), but processes a cluster of reference
+     * positions at a time using SIMD when grid searching is used.
+     * This is faster when most of the pairs are needed anyway.
+     * Exclusions and the XY mode are handled as in startPairSearch().
+     * Any previous contents of \p pairs are discarded; passing the same
+     * vector for each call avoids repeated memory allocation.
+     *
+     * All pairs for all the test positions are stored at once, so the
+     * memory use grows with the number of test positions times the number
+     * of reference positions within the cutoff.  For large sets of test
+     * positions, use AnalysisNeighborhoodPairSearch::findNextPairBlock()
+     * instead.
+     */
+    void findAllPairs(const AnalysisNeighborhoodPositions& positions,
+                      std::vector<AnalysisNeighborhoodPair>* pairs) const;
 
 private:
     typedef internal::AnalysisNeighborhoodSearchImpl Impl;
@@ -602,6 +626,26 @@ public:
      * \see AnalysisNeighborhoodSearch::startPairSearch()
      */
     bool findNextPair(AnalysisNeighborhoodPair* pair);
+    /*! \brief
+     * Finds all pairs within the cutoff for the next block of test positions.
+     *
+     * \param[in]  maxTestPositionCount  Maximum number of test positions
+     *     to process in this block.
+     * \param[out] pairs  All pairs within the cutoff for the test positions
+     *     in the block.
+     * \returns    false if there were no more test positions.
+     * \throws     std::bad_alloc if out of memory.
+     *
+     * Works as AnalysisNeighborhoodSearch::findAllPairs(), but only for
+     * the next \p maxTestPositionCount test positions, so that the memory
+     * needed for \p pairs stays bounded for large sets of test positions.
+     * Looping over the blocks until the method returns false returns the
+     * same pairs, in the same order, as findAllPairs().
+     * Any previous contents of \p pairs are discarded.
+     * Should not be mixed with findNextPair() for the same search, and is
+     * not implemented for searches from startSelfPairSearch().
+     */
+    bool findNextPairBlock(int maxTestPositionCount, std::vector<AnalysisNeighborhoodPair>* pairs);
     /*! \brief
      * Skip remaining pairs for a test position in the search.
      *
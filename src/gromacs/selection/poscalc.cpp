@@ -72,6 +72,8 @@
 
 #include "gromacs/math/vec.h"
 #include "gromacs/selection/indexutil.h"
+#include "gromacs/topology/mtop_lookup.h"
+#include "gromacs/topology/topology.h"
 #include "gromacs/trajectory/trajectoryframe.h"
 #include "gromacs/utility/arrayref.h"
 #include "gromacs/utility/exceptions.h"
@@ -211,6 +213,19 @@ struct gmx_ana_poscalc_t
      * Maximum evaluation group.
      */
     gmx_ana_index_t gmax;
+    /*! \brief
+     * Weight of each atom in \p b for computing the positions.
+     *
+     * Computed on the first evaluation for static calculations of
+     * residue/molecule centers, NULL otherwise.
+     */
+    real* weight;
+    /*! \brief
+     * Factor to multiply the weighted sum of each block in \p b.
+     *
+     * Allocated together with \p weight.
+     */
+    real* blockScale;
 
     /** Position storage for calculations that are used as a base. */
     gmx_ana_pos_t* p;
@@ -1153,9 +1168,47 @@ void gmx_ana_poscalc_free(gmx_ana_poscalc_t* pc)
         gmx_ana_poscalc_free(pc->sbase);
         sfree(pc->baseid);
     }
+    sfree(pc->weight);
+    sfree(pc->blockScale);
     sfree(pc);
 }
 
+/*! \brief
+ * Computes the per-atom weights for a static block calculation.
+ *
+ * \param[in,out] pc  Position calculation data.
+ *
+ * The weights are the atom masses for center-of-mass calculations and one
+ * for center-of-geometry calculations, and the block scales are the
+ * inverses of their sums.  Since the blocks of static calculations do not
+ * change, this is done only once instead of looking up the masses in the
+ * topology for every frame.
+ */
+static void init_poscalc_weights(gmx_ana_poscalc_t* pc)
+{
+    if (pc->weight != nullptr)
+    {
+        return;
+    }
+    const gmx_mtop_t* top   = pc->coll->top_;
+    const bool        bMass = (pc->flags & POS_MASS) != 0;
+    GMX_RELEASE_ASSERT(!bMass || gmx_mtop_has_masses(top),
+                       "No masses available while mass weighting was requested");
+    snew(pc->weight, pc->b.nra);
+    snew(pc->blockScale, pc->b.nr);
+    int molb = 0;
+    for (int b = 0; b < pc->b.nr; ++b)
+    {
+        real sum = 0;
+        for (int i = pc->b.index[b]; i < pc->b.index[b + 1]; ++i)
+        {
+            pc->weight[i] = bMass ? mtopGetAtomMass(top, pc->b.a[i], &molb) : 1;
+            sum += pc->weight[i];
+        }
+        pc->blockScale[b] = 1.0 / sum;
+    }
+}
+
 gmx::PositionCalculationCollection::RequiredTopologyInfo gmx_ana_poscalc_required_topology_info(gmx_ana_poscalc_t* pc)
 {
     return gmx::requiredTopologyInfo(pc->type, pc->flags);
@@ -1341,12 +1394,27 @@ void gmx_ana_poscalc_update(gmx_ana_poscalc_t* pc,
                 break;
             default:
                 // TODO: It would probably be better to do this without the type casts.
-                gmx_calc_comg_block(top, fr->x, reinterpret_cast<t_block*>(&pc->b), index.data(),
-                                    bMass, p->x);
-                if (p->v && fr->bV)
+                if (!(pc->flags & POS_DYNAMIC))
                 {
-                    gmx_calc_comg_block(top, fr->v, reinterpret_cast<t_block*>(&pc->b),
-                                        index.data(), bMass, p->v);
+                    init_poscalc_weights(pc);
+                    gmx_calc_weighted_block(fr->x, fr->natoms, reinterpret_cast<t_block*>(&pc->b),
+                                            index.data(), pc->weight, pc->blockScale, p->x);
+                    if (p->v && fr->bV)
+                    {
+                        gmx_calc_weighted_block(fr->v, fr->natoms,
+                                                reinterpret_cast<t_block*>(&pc->b), index.data(),
+                                                pc->weight, pc->blockScale, p->v);
+                    }
+                }
+                else
+                {
+                    gmx_calc_comg_block(top, fr->x, reinterpret_cast<t_block*>(&pc->b),
+                                        index.data(), bMass, p->x);
+                    if (p->v && fr->bV)
+                    {
+                        gmx_calc_comg_block(top, fr->v, reinterpret_cast<t_block*>(&pc->b),
+                                            index.data(), bMass, p->v);
+                    }
                 }
                 if (p->f && fr->bF)
                 {
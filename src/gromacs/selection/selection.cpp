@@ -45,6 +45,7 @@
 
 #include "selection.h"
 
+#include <algorithm>
 #include <string>
 
 #include "gromacs/selection/nbsearch.h"
@@ -150,6 +151,20 @@ bool SelectionData::initCoveredFraction(e_coverfrac_t type)
     return type == CFRAC_NONE || coveredFractionType_ != CFRAC_NONE;
 }
 
+
+void SelectionData::copyCompiledSettings(const SelectionData& source)
+{
+    GMX_RELEASE_ASSERT(rawPositions_.m.b.nr == source.rawPositions_.m.b.nr
+                               && rawPositions_.m.mapb.nr == source.rawPositions_.m.mapb.nr,
+                       "Selections compiled from the same text should have the same positions");
+    flags_ = source.flags_;
+    initCoveredFraction(source.coveredFractionType_);
+    std::copy(source.rawPositions_.m.orgid, source.rawPositions_.m.orgid + source.rawPositions_.m.b.nr,
+              rawPositions_.m.orgid);
+    std::copy(source.rawPositions_.m.mapid,
+              source.rawPositions_.m.mapid + source.rawPositions_.m.mapb.nr, rawPositions_.m.mapid);
+}
+
 namespace
 {
 
@@ -121,11 +121,26 @@ public:
 
     //! Returns true if the given flag is set.
     bool hasFlag(SelectionFlag flag) const { return flags_.test(flag); }
+    //! Returns the flags for this selection.
+    SelectionFlags flags() const { return flags_; }
     //! Sets the flags for this selection.
     void setFlags(SelectionFlags flags) { flags_ = flags; }
 
     //! \copydoc Selection::initCoveredFraction()
     bool initCoveredFraction(e_coverfrac_t type);
+    /*! \brief
+     * Copies settings made after compilation from another selection.
+     *
+     * \param[in] source  Compiled selection with the same selection text.
+     *
+     * Copies the flags, the covered fraction type and the original
+     * IDs of the positions, so that a selection parsed and compiled from
+     * the same text in another collection evaluates in the same way.
+     * Both selections should not have been evaluated yet.
+     *
+     * This function is called by the SelectionCollection copy constructor.
+     */
+    void copyCompiledSettings(const SelectionData& source);
 
     /*! \brief
      * Updates the name of the selection if missing.
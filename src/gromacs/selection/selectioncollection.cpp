@@ -87,7 +87,9 @@ namespace gmx
 SelectionCollection::Impl::Impl() :
     debugLevel_(DebugLevel::None),
     bExternalGroupsSet_(false),
-    grps_(nullptr)
+    grps_(nullptr),
+    bCompiled_(false),
+    source_(nullptr)
 {
     sc_.nvars   = 0;
     sc_.varstrs = nullptr;
@@ -471,7 +473,7 @@ void SelectionCollection::Impl::resolveExternalGroups(const SelectionTreeElement
     {
         try
         {
-            root->resolveIndexGroupReference(grps_, sc_.gall.isize);
+            root->resolveIndexGroupReference(grps_, sc_.gall.isize, &sc_.resolvedGroups);
         }
         catch (const UserInputError&)
         {
@@ -489,6 +491,33 @@ void SelectionCollection::Impl::resolveExternalGroups(const SelectionTreeElement
 }
 
 
+void SelectionCollection::Impl::resolveExternalGroups(const SelectionTreeElementPointer& root,
+                                                      const std::vector<SelectionIndexGroupReference>& groups,
+                                                      ExceptionInitializer* errors)
+{
+
+    if (root->type == SEL_GROUPREF)
+    {
+        try
+        {
+            root->resolveIndexGroupReference(groups, sc_.gall.isize);
+        }
+        catch (const UserInputError&)
+        {
+            errors->addCurrentExceptionAsNested();
+        }
+    }
+
+    SelectionTreeElementPointer child = root->child;
+    while (child)
+    {
+        resolveExternalGroups(child, groups, errors);
+        root->flags |= (child->flags & SEL_UNSORTED);
+        child = child->next;
+    }
+}
+
+
 bool SelectionCollection::Impl::areForcesRequested() const
 {
     for (const auto& sel : sc_.sel)
@@ -530,6 +559,58 @@ SelectionCollection::Impl::requiredTopologyPropertiesForPositionType(const std::
 SelectionCollection::SelectionCollection() : impl_(new Impl) {}
 
 
+SelectionCollection::SelectionCollection(const SelectionCollection& other) : impl_(new Impl)
+{
+    const Impl& source = *other.impl_;
+    impl_->source_     = &other;
+    impl_->rpost_      = source.rpost_;
+    impl_->spost_      = source.spost_;
+    if (source.sc_.top != nullptr || source.sc_.gall.isize > 0)
+    {
+        setTopology(const_cast<gmx_mtop_t*>(source.sc_.top), source.sc_.gall.isize);
+    }
+    for (int i = 0; i < source.sc_.nvars; ++i)
+    {
+        parseFromString(source.sc_.varstrs[i]);
+    }
+    for (const auto& sel : source.sc_.sel)
+    {
+        parseFromString(sel->selectionText());
+    }
+    GMX_RELEASE_ASSERT(impl_->sc_.sel.size() == source.sc_.sel.size(),
+                       "Copied selection text should parse to the same number of selections");
+
+    // Resolve index group references to the groups used in the source.
+    ExceptionInitializer        errors("Invalid index group reference(s)");
+    SelectionTreeElementPointer root = impl_->sc_.root;
+    while (root)
+    {
+        impl_->resolveExternalGroups(root, source.sc_.resolvedGroups, &errors);
+        root = root->next;
+    }
+    if (errors.hasNestedExceptions())
+    {
+        GMX_THROW(InconsistentInputError(errors));
+    }
+    impl_->sc_.resolvedGroups  = source.sc_.resolvedGroups;
+    impl_->bExternalGroupsSet_ = true;
+    for (size_t i = 0; i < impl_->sc_.sel.size(); ++i)
+    {
+        impl_->sc_.sel[i]->refreshName();
+        impl_->sc_.sel[i]->setFlags(source.sc_.sel[i]->flags());
+    }
+
+    if (source.bCompiled_)
+    {
+        compile();
+        for (size_t i = 0; i < impl_->sc_.sel.size(); ++i)
+        {
+            impl_->sc_.sel[i]->copyCompiledSettings(*source.sc_.sel[i]);
+        }
+    }
+}
+
+
 SelectionCollection::~SelectionCollection() {}
 
 
@@ -655,10 +736,15 @@ SelectionTopologyProperties SelectionCollection::requiredTopologyProperties() co
 {
     SelectionTopologyProperties props;
 
-    // These should not throw, because has been checked earlier.
-    props.merge(impl_->requiredTopologyPropertiesForPositionType(impl_->rpost_, false));
-    const bool forcesRequested = impl_->areForcesRequested();
-    props.merge(impl_->requiredTopologyPropertiesForPositionType(impl_->spost_, forcesRequested));
+    // The default position types only matter for selections that are still
+    // to be parsed; they are kept after compilation only for copying.
+    if (!impl_->bCompiled_)
+    {
+        // These should not throw, because has been checked earlier.
+        props.merge(impl_->requiredTopologyPropertiesForPositionType(impl_->rpost_, false));
+        const bool forcesRequested = impl_->areForcesRequested();
+        props.merge(impl_->requiredTopologyPropertiesForPositionType(impl_->spost_, forcesRequested));
+    }
 
     SelectionTreeElementPointer sel = impl_->sc_.root;
     while (sel && !props.hasAll())
@@ -821,8 +907,7 @@ void SelectionCollection::compile()
             }
         }
     }
-    impl_->rpost_.clear();
-    impl_->spost_.clear();
+    impl_->bCompiled_ = true;
 }
 
 
@@ -877,6 +962,22 @@ void SelectionCollection::evaluateFinal(int nframes)
 }
 
 
+Selection SelectionCollection::correspondingSelection(const Selection& selection) const
+{
+    const SelectionDataList& selections = impl_->sc_.sel;
+    for (size_t i = 0; i < selections.size(); ++i)
+    {
+        if (Selection(selections[i].get()) == selection
+            || (impl_->source_ != nullptr
+                && Selection(impl_->source_->impl_->sc_.sel[i].get()) == selection))
+        {
+            return Selection(selections[i].get());
+        }
+    }
+    return selection;
+}
+
+
 void SelectionCollection::printTree(FILE* fp, bool bValues) const
 {
     SelectionTreeElementPointer sel = impl_->sc_.root;
@@ -136,6 +136,26 @@ public:
      * \throws  std::bad_alloc if out of memory.
      */
     SelectionCollection();
+    /*! \brief
+     * Creates a copy of a selection collection for concurrent evaluation.
+     *
+     * \param[in] other  Collection to copy.
+     * \throws  std::bad_alloc if out of memory.
+     *
+     * The variables and selections of \p other are parsed again from
+     * their text, with the same topology, default position types and
+     * selection flags, and index group references resolve to the same
+     * groups as in \p other.  If \p other has been compiled, the copy is
+     * also compiled, and settings made on the selections of \p other
+     * after compilation (original IDs and covered fraction types) are
+     * copied.  The copy can then be evaluated for a different frame
+     * concurrently with \p other; correspondingSelection() maps the
+     * selections of \p other to the copies.
+     *
+     * \p other should not have been evaluated yet, and must remain
+     * valid as long as this object is used.
+     */
+    SelectionCollection(const SelectionCollection& other);
     ~SelectionCollection();
 
     /*! \brief
@@ -389,6 +409,19 @@ public:
      */
     void evaluateFinal(int nframes);
 
+    /*! \brief
+     * Returns the selection in this collection that corresponds to a
+     * selection in this collection or in the collection it was copied from.
+     *
+     * \param[in] selection  Selection to look up.
+     * \returns   Selection in this collection, or \p selection if it
+     *     does not belong to this collection or to the one this was
+     *     copied from.
+     *
+     * Does not throw.
+     */
+    Selection correspondingSelection(const Selection& selection) const;
+
     /*! \brief
      * Prints a human-readable version of the internal selection element
      * tree.
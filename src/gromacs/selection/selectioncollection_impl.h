@@ -106,6 +106,8 @@ struct gmx_ana_selcollection_t
     gmx_ana_index_t gall;
     /** Memory pool used for selection evaluation. */
     gmx_sel_mempool_t* mempool;
+    //! Index groups that group references in the selections resolved to.
+    std::vector<gmx::SelectionIndexGroupReference> resolvedGroups;
     //! Parser symbol table.
     // Never releases ownership.
     std::unique_ptr<gmx::SelectionParserSymbolTable> symtab;
@@ -154,6 +156,20 @@ public:
      * resolve references are reported to \p errors.
      */
     void resolveExternalGroups(const gmx::SelectionTreeElementPointer& root, ExceptionInitializer* errors);
+    /*! \brief
+     * Replace group references by groups that they resolved to earlier.
+     *
+     * \param[in]    root    Root of selection tree to process.
+     * \param[in]    groups  Previously resolved group references.
+     * \param        errors  Object for reporting any error messages.
+     * \throws std::bad_alloc if out of memory.
+     *
+     * Works as resolveExternalGroups() above, but takes the groups from
+     * \p groups instead of \a grps_.  Used when copying a collection.
+     */
+    void resolveExternalGroups(const gmx::SelectionTreeElementPointer&          root,
+                               const std::vector<SelectionIndexGroupReference>& groups,
+                               ExceptionInitializer*                            errors);
 
     //! Whether forces have been requested for some selection.
     bool areForcesRequested() const;
@@ -194,6 +210,10 @@ public:
     bool bExternalGroupsSet_;
     //! External index groups (can be NULL).
     gmx_ana_indexgrps_t* grps_;
+    //! Whether compile() has been called.
+    bool bCompiled_;
+    //! Collection that this collection was copied from (can be NULL).
+    const SelectionCollection* source_;
 };
 
 /*! \internal
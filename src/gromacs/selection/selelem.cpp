@@ -47,6 +47,8 @@
 
 #include <cstring>
 
+#include <algorithm>
+
 #include "gromacs/selection/indexutil.h"
 #include "gromacs/utility/exceptions.h"
 #include "gromacs/utility/fatalerror.h"
@@ -411,7 +413,9 @@ bool SelectionTreeElement::requiresIndexGroups() const
     return false;
 }
 
-void SelectionTreeElement::resolveIndexGroupReference(gmx_ana_indexgrps_t* grps, int natoms)
+void SelectionTreeElement::resolveIndexGroupReference(gmx_ana_indexgrps_t* grps,
+                                                      int                  natoms,
+                                                      std::vector<SelectionIndexGroupReference>* resolvedGroups)
 {
     GMX_RELEASE_ASSERT(type == SEL_GROUPREF,
                        "Should only be called for index group reference elements");
@@ -443,6 +447,16 @@ void SelectionTreeElement::resolveIndexGroupReference(gmx_ana_indexgrps_t* grps,
         }
     }
 
+    if (resolvedGroups != nullptr)
+    {
+        SelectionIndexGroupReference reference;
+        reference.referenceName = (u.gref.name != nullptr ? u.gref.name : "");
+        reference.referenceId   = u.gref.id;
+        reference.name          = foundName;
+        reference.atoms.assign(foundGroup.index, foundGroup.index + foundGroup.isize);
+        resolvedGroups->push_back(std::move(reference));
+    }
+
     if (!gmx_ana_index_check_sorted(&foundGroup))
     {
         flags |= SEL_UNSORTED;
@@ -459,6 +473,45 @@ void SelectionTreeElement::resolveIndexGroupReference(gmx_ana_indexgrps_t* grps,
     }
 }
 
+void SelectionTreeElement::resolveIndexGroupReference(const std::vector<SelectionIndexGroupReference>& resolvedGroups,
+                                                      int natoms)
+{
+    GMX_RELEASE_ASSERT(type == SEL_GROUPREF,
+                       "Should only be called for index group reference elements");
+    const std::string referenceName = (u.gref.name != nullptr ? u.gref.name : "");
+    const auto        reference     = std::find_if(
+            resolvedGroups.begin(), resolvedGroups.end(),
+            [this, &referenceName](const SelectionIndexGroupReference& group) {
+                return group.referenceName == referenceName && group.referenceId == u.gref.id;
+            });
+    if (reference == resolvedGroups.end())
+    {
+        std::string message = formatString(
+                "Cannot match '%s', because no such index group can be found.", name().c_str());
+        GMX_THROW(InconsistentInputError(message));
+    }
+
+    gmx_ana_index_t foundGroup;
+    gmx_ana_index_clear(&foundGroup);
+    gmx_ana_index_reserve(&foundGroup, reference->atoms.size());
+    foundGroup.isize = reference->atoms.size();
+    std::copy(reference->atoms.begin(), reference->atoms.end(), foundGroup.index);
+    if (!gmx_ana_index_check_sorted(&foundGroup))
+    {
+        flags |= SEL_UNSORTED;
+    }
+
+    sfree(u.gref.name);
+    type = SEL_CONST;
+    gmx_ana_index_set(&u.cgrp, foundGroup.isize, foundGroup.index, foundGroup.nalloc_index);
+    setName(reference->name);
+
+    if (natoms > 0)
+    {
+        checkIndexGroup(natoms);
+    }
+}
+
 void SelectionTreeElement::checkIndexGroup(int natoms)
 {
     GMX_RELEASE_ASSERT(type == SEL_CONST && v.type == GROUP_VALUE,
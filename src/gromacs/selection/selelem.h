@@ -52,6 +52,7 @@
 
 #include <memory>
 #include <string>
+#include <vector>
 
 #include "gromacs/selection/indexutil.h"
 #include "gromacs/utility/classhelpers.h"
@@ -272,6 +273,25 @@ struct SelectionLocation
     int endIndex;
 };
 
+/*! \internal
+ * \brief
+ * Index group that an index group reference in the selections resolved to.
+ *
+ * Kept so that the references can be resolved again when a selection
+ * collection is copied after the index groups have been released.
+ */
+struct SelectionIndexGroupReference
+{
+    //! Name used in the reference, or empty if the group was referenced by number.
+    std::string referenceName;
+    //! Number used in the reference, or -1 if the group was referenced by name.
+    int referenceId;
+    //! Name of the group that the reference resolved to.
+    std::string name;
+    //! Atoms in the group.
+    std::vector<int> atoms;
+};
+
 /*! \internal \brief
  * Represents an element of a selection expression.
  */
@@ -387,11 +407,28 @@ public:
      * \param[in] grps   Index groups to use to resolve the reference.
      * \param[in] natoms Maximum number of atoms the selections can evaluate to
      *     (zero if the topology/atom count is not set yet).
+     * \param[in,out] resolvedGroups  If not NULL, the resolved group is
+     *     appended to this list.
      * \throws    std::bad_alloc if out of memory.
      * \throws    InconsistentInputError if the reference cannot be
      *     resolved.
      */
-    void resolveIndexGroupReference(gmx_ana_indexgrps_t* grps, int natoms);
+    void resolveIndexGroupReference(gmx_ana_indexgrps_t*                       grps,
+                                    int                                        natoms,
+                                    std::vector<SelectionIndexGroupReference>* resolvedGroups = nullptr);
+    /*! \brief
+     * Resolves an unresolved reference to an index group from groups that
+     * the same reference resolved to earlier.
+     *
+     * \param[in] resolvedGroups  Previously resolved references.
+     * \param[in] natoms Maximum number of atoms the selections can evaluate to
+     *     (zero if the topology/atom count is not set yet).
+     * \throws    std::bad_alloc if out of memory.
+     * \throws    InconsistentInputError if the reference is not found in
+     *     \p resolvedGroups.
+     */
+    void resolveIndexGroupReference(const std::vector<SelectionIndexGroupReference>& resolvedGroups,
+                                    int                                              natoms);
     /*! \brief
      * Checks that an index group has valid atom indices.
      *
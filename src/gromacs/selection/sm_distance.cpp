@@ -46,7 +46,13 @@
  */
 #include "gmxpre.h"
 
+#include <cmath>
+
+#include <algorithm>
+#include <vector>
+
 #include "gromacs/math/vec.h"
+#include "gromacs/pbcutil/pbc.h"
 #include "gromacs/selection/nbsearch.h"
 #include "gromacs/utility/arraysize.h"
 #include "gromacs/utility/exceptions.h"
@@ -55,6 +61,66 @@
 #include "selmethod.h"
 #include "selmethod_impl.h"
 
+/*! \brief
+ * Buffer added to the cutoff for the candidate list of the \p within method.
+ *
+ * Pairs of positions that are further apart than the cutoff plus this
+ * buffer when the list is built are not tested again until the positions
+ * and the box have changed by more than the buffer in total.
+ */
+static const real c_withinCandidateSkin = 0.1;
+
+//! Number of test positions searched at a time when building the \p within candidate list.
+static const int c_withinSearchBlockSize = 1024;
+
+/*! \internal
+ * \brief
+ * Verlet-style list of candidate pairs for the \p within method.
+ *
+ * Stores, for each test position that was within the cutoff plus
+ * \c c_withinCandidateSkin of some reference position when the list was
+ * built, the reference positions within that distance, together with what
+ * is needed to check whether the list is still valid: the box, the atoms
+ * that make up the test and reference positions, and the coordinates at the
+ * time of the build.  The list remains valid as long as the largest
+ * displacement of a test position plus the largest displacement of a
+ * reference position plus the change of the periodic images due to a box
+ * change does not exceed the skin, since no other pair can then have come
+ * within the cutoff.  While the list is valid, the candidate pairs are
+ * tested directly, without a neighborhood search.
+ *
+ * \ingroup module_selection
+ */
+struct t_within_candidates
+{
+    t_within_candidates() : bValid(false), bPbc(false) { clear_mat(box); }
+
+    /** Whether the list has been built. */
+    bool bValid;
+    /** Whether the list was built with periodic boundary conditions. */
+    bool bPbc;
+    /** Box for which the list was built. */
+    matrix box;
+    /** Atoms (and blocks) of the test positions used for the build. */
+    std::vector<int> testAtoms;
+    /** Atoms (and blocks) of the reference positions used for the build. */
+    std::vector<int> refAtoms;
+    /** Test positions at the time of the build. */
+    std::vector<gmx::RVec> testX;
+    /** Reference positions at the time of the build. */
+    std::vector<gmx::RVec> refX;
+    /** Indices of the test positions that may be within the cutoff. */
+    std::vector<int> candidates;
+    /*! \brief
+     * Start of the reference positions of each candidate in \p candidateRefs.
+     *
+     * Has one more element than \p candidates.
+     */
+    std::vector<int> candidateRefStart;
+    /** Reference positions that may be within the cutoff of each candidate. */
+    std::vector<int> candidateRefs;
+};
+
 /*! \internal
  * \brief
  * Data structure for distance-based selection method.
@@ -73,8 +139,16 @@ struct t_methoddata_distance
     gmx_ana_pos_t p;
     /** Neighborhood search data. */
     gmx::AnalysisNeighborhood nb;
-    /** Neighborhood search for an invididual frame. */
+    /*! \brief
+     * Neighborhood search for an invididual frame.
+     *
+     * Not used by \p within, which uses \p candidates instead.
+     */
     gmx::AnalysisNeighborhoodSearch nbsearch;
+    /** Neighborhood search data with the candidate list skin (\p within). */
+    gmx::AnalysisNeighborhood nbSkin;
+    /** Candidate list for the \p within method. */
+    t_within_candidates candidates;
 };
 
 /*! \brief
@@ -127,7 +201,7 @@ static void evaluate_distance(const gmx::SelMethodEvalContext& /*context*/,
                               gmx_ana_selvalue_t* out,
                               void*               data);
 /** Evaluates the \p within selection method. */
-static void evaluate_within(const gmx::SelMethodEvalContext& /*context*/,
+static void evaluate_within(const gmx::SelMethodEvalContext& context,
                             gmx_ana_pos_t*      pos,
                             gmx_ana_selvalue_t* out,
                             void*               data);
@@ -221,7 +295,7 @@ gmx_ana_selmethod_t sm_within = {
     &init_common,
     nullptr,
     &free_data_common,
-    &init_frame_common,
+    nullptr,
     nullptr,
     &evaluate_within,
     { "within REAL of POS_EXPR", helptitle_distance, asize(help_distance), help_distance },
@@ -244,6 +318,7 @@ static void init_common(const gmx_mtop_t* /* top */, int /* npar */, gmx_ana_sel
         GMX_THROW(gmx::InvalidInputError("Distance cutoff should be > 0"));
     }
     d->nb.setCutoff(d->cutoff);
+    d->nbSkin.setCutoff(d->cutoff + c_withinCandidateSkin);
 }
 
 /*!
@@ -287,26 +362,214 @@ static void evaluate_distance(const gmx::SelMethodEvalContext& /*context*/,
     }
 }
 
+/*! \brief
+ * Stores the atoms and blocks that make up a set of positions.
+ *
+ * \param[in]  pos   Positions.
+ * \param[out] atoms Atoms and blocks in \p pos.
+ */
+static void store_position_atoms(const gmx_ana_pos_t& pos, std::vector<int>* atoms)
+{
+    const t_blocka& b = pos.m.mapb;
+    atoms->assign(b.a, b.a + b.nra);
+    atoms->insert(atoms->end(), b.index, b.index + b.nr + 1);
+}
+
+/*! \brief
+ * Checks whether a set of positions consists of the same atoms as before.
+ *
+ * \param[in] pos   Positions.
+ * \param[in] atoms Atoms and blocks stored with store_position_atoms().
+ */
+static bool has_same_position_atoms(const gmx_ana_pos_t& pos, const std::vector<int>& atoms)
+{
+    const t_blocka& b = pos.m.mapb;
+    if (atoms.size() != static_cast<size_t>(b.nra + b.nr + 1))
+    {
+        return false;
+    }
+    return std::equal(b.a, b.a + b.nra, atoms.begin())
+           && std::equal(b.index, b.index + b.nr + 1, atoms.begin() + b.nra);
+}
+
+/*! \brief
+ * Returns the largest displacement of a set of positions.
+ *
+ * \param[in] x     Current positions.
+ * \param[in] xprev Positions to compare against (same count as \p x).
+ */
+static real max_displacement(const rvec* x, const std::vector<gmx::RVec>& xprev)
+{
+    real maxd2 = 0;
+    for (size_t i = 0; i < xprev.size(); ++i)
+    {
+        maxd2 = std::max(maxd2, distance2(x[i], xprev[i]));
+    }
+    return std::sqrt(maxd2);
+}
+
+/*! \brief
+ * Returns how much the periodic images of a position can have moved due to
+ * a change of the box.
+ *
+ * \param[in] box     Current box.
+ * \param[in] boxPrev Box to compare against.
+ *
+ * The cutoff plus the skin is below half the box size, so only the images
+ * shifted by at most one box vector along each dimension can be within it.
+ */
+static real max_image_displacement(const matrix box, const matrix boxPrev)
+{
+    real displacement = 0;
+    for (int d = 0; d < DIM; ++d)
+    {
+        rvec dbox;
+        rvec_sub(box[d], boxPrev[d], dbox);
+        displacement += norm(dbox);
+    }
+    return displacement;
+}
+
+/*! \brief
+ * Checks whether the \p within candidate list can be used for a frame.
+ *
+ * \param[in] d       Method data.
+ * \param[in] pbc     PBC information for the frame (can be NULL).
+ * \param[in] pos     Test positions.
+ *
+ * Displacements are computed without PBC, so a position that is wrapped
+ * into the box simply triggers a rebuild.
+ */
+static bool can_use_within_candidates(const t_methoddata_distance& d, const t_pbc* pbc, const gmx_ana_pos_t& pos)
+{
+    const t_within_candidates& c = d.candidates;
+    if (!c.bValid || c.bPbc != (pbc != nullptr) || !has_same_position_atoms(pos, c.testAtoms)
+        || !has_same_position_atoms(d.p, c.refAtoms))
+    {
+        return false;
+    }
+    real displacement = 0;
+    if (pbc != nullptr)
+    {
+        displacement = max_image_displacement(pbc->box, c.box);
+    }
+    displacement += max_displacement(pos.x, c.testX);
+    if (displacement > c_withinCandidateSkin)
+    {
+        return false;
+    }
+    return displacement + max_displacement(d.p.x, c.refX) <= c_withinCandidateSkin;
+}
+
+/*! \brief
+ * Builds the \p within candidate list for the current frame.
+ *
+ * \param[in,out] d   Method data.
+ * \param[in]     pbc PBC information for the frame (can be NULL).
+ * \param[in]     pos Test positions.
+ * \param[out]    out Positions within the cutoff in the current frame.
+ *
+ * The positions within the cutoff are found from the same search that
+ * builds the list.
+ */
+static void build_within_candidates(t_methoddata_distance* d,
+                                    const t_pbc*           pbc,
+                                    gmx_ana_pos_t*         pos,
+                                    gmx_ana_index_t*       out)
+{
+    t_within_candidates& c = d->candidates;
+    c.bValid               = false;
+    c.bPbc                 = (pbc != nullptr);
+    store_position_atoms(*pos, &c.testAtoms);
+    store_position_atoms(d->p, &c.refAtoms);
+    c.testX.assign(pos->x, pos->x + pos->count());
+    c.refX.assign(d->p.x, d->p.x + d->p.count());
+    if (pbc != nullptr)
+    {
+        copy_mat(pbc->box, c.box);
+    }
+    else
+    {
+        clear_mat(c.box);
+    }
+    gmx::AnalysisNeighborhoodPositions refPos(d->p.x, d->p.count());
+    gmx::AnalysisNeighborhoodSearch    search  = d->nbSkin.initSearch(pbc, refPos);
+    const real                         cutoff2 = d->cutoff * d->cutoff;
+    c.candidates.clear();
+    c.candidateRefStart.assign(1, 0);
+    c.candidateRefs.clear();
+    // The pairs are returned ordered by the test position.
+    gmx::AnalysisNeighborhoodPositions         testPos(pos->x, pos->count());
+    gmx::AnalysisNeighborhoodPairSearch        pairSearch = search.startPairSearch(testPos);
+    std::vector<gmx::AnalysisNeighborhoodPair> pairs;
+    int                                        lastWithin = -1;
+    while (pairSearch.findNextPairBlock(c_withinSearchBlockSize, &pairs))
+    {
+        for (const gmx::AnalysisNeighborhoodPair& pair : pairs)
+        {
+            const int b = pair.testIndex();
+            if (c.candidates.empty() || c.candidates.back() != b)
+            {
+                c.candidates.push_back(b);
+                c.candidateRefStart.push_back(c.candidateRefStart.back());
+            }
+            c.candidateRefs.push_back(pair.refIndex());
+            ++c.candidateRefStart.back();
+            if (pair.distance2() <= cutoff2 && lastWithin != b)
+            {
+                gmx_ana_pos_add_to_group(out, pos, b);
+                lastWithin = b;
+            }
+        }
+    }
+    c.bValid = true;
+}
+
 /*!
  * See sel_updatefunc() for description of the parameters.
  * \p data should point to a \c t_methoddata_distance.
  *
  * Finds the atoms that are closer than the defined cutoff to
  * \c t_methoddata_distance::xref and puts them in \p out.g.
+ *
+ * Only the pairs in the candidate list
+ * (\c t_methoddata_distance::candidates) are tested; the list is rebuilt
+ * when the positions or the box have changed too much since it was built.
  */
-static void evaluate_within(const gmx::SelMethodEvalContext& /*context*/,
-                            gmx_ana_pos_t*      pos,
-                            gmx_ana_selvalue_t* out,
-                            void*               data)
+static void evaluate_within(const gmx::SelMethodEvalContext& context,
+                            gmx_ana_pos_t*                   pos,
+                            gmx_ana_selvalue_t*              out,
+                            void*                            data)
 {
     t_methoddata_distance* d = static_cast<t_methoddata_distance*>(data);
 
     out->u.g->isize = 0;
-    for (int b = 0; b < pos->count(); ++b)
+    if (!can_use_within_candidates(*d, context.pbc, *pos))
+    {
+        build_within_candidates(d, context.pbc, pos, out->u.g);
+        return;
+    }
+    const t_within_candidates& c       = d->candidates;
+    const real                 cutoff2 = d->cutoff * d->cutoff;
+    for (size_t i = 0; i < c.candidates.size(); ++i)
     {
-        if (d->nbsearch.isWithin(pos->x[b]))
+        const int b = c.candidates[i];
+        for (int j = c.candidateRefStart[i]; j < c.candidateRefStart[i + 1]; ++j)
         {
-            gmx_ana_pos_add_to_group(out->u.g, pos, b);
+            rvec dx;
+            if (context.pbc != nullptr)
+            {
+                pbc_dx(context.pbc, d->p.x[c.candidateRefs[j]], pos->x[b], dx);
+            }
+            else
+            {
+                rvec_sub(d->p.x[c.candidateRefs[j]], pos->x[b], dx);
+            }
+            if (norm2(dx) <= cutoff2)
+            {
+                gmx_ana_pos_add_to_group(out->u.g, pos, b);
+                break;
+            }
         }
     }
 }
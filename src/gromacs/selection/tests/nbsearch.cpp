@@ -407,6 +407,8 @@ public:
                                    const gmx::ArrayRef<const int>&           refIndices,
                                    const gmx::ArrayRef<const int>&           testIndices,
                                    bool                                      selfPairs);
+    static void testAllPairs(gmx::AnalysisNeighborhoodSearch*          search,
+                             const gmx::AnalysisNeighborhoodPositions& pos);
 
     gmx::AnalysisNeighborhood nb_;
 };
@@ -642,6 +644,62 @@ void NeighborhoodSearchTest::testPairSearchFull(gmx::AnalysisNeighborhoodSearch*
     }
 }
 
+/*! \brief
+ * Checks that findAllPairs() and a findNextPairBlock() loop return the same
+ * pairs as a findNextPair() loop.
+ */
+void NeighborhoodSearchTest::testAllPairs(gmx::AnalysisNeighborhoodSearch*          search,
+                                          const gmx::AnalysisNeighborhoodPositions& pos)
+{
+    std::vector<gmx::AnalysisNeighborhoodPair> expected;
+    {
+        gmx::AnalysisNeighborhoodPairSearch pairSearch = search->startPairSearch(pos);
+        gmx::AnalysisNeighborhoodPair       pair;
+        while (pairSearch.findNextPair(&pair))
+        {
+            expected.push_back(pair);
+        }
+    }
+    const auto checkPairs = [&expected](const std::vector<gmx::AnalysisNeighborhoodPair>& pairs) {
+        ASSERT_EQ(expected.size(), pairs.size());
+        for (size_t i = 0; i < pairs.size(); ++i)
+        {
+            SCOPED_TRACE(gmx::formatString("Pair %d", static_cast<int>(i)));
+            EXPECT_EQ(expected[i].refIndex(), pairs[i].refIndex());
+            EXPECT_EQ(expected[i].testIndex(), pairs[i].testIndex());
+            EXPECT_REAL_EQ_TOL(expected[i].distance2(), pairs[i].distance2(),
+                               gmx::test::ulpTolerance(64));
+        }
+    };
+    std::vector<gmx::AnalysisNeighborhoodPair> pairs;
+    {
+        SCOPED_TRACE("findAllPairs()");
+        search->findAllPairs(pos, &pairs);
+        checkPairs(pairs);
+    }
+    {
+        SCOPED_TRACE("findNextPairBlock()");
+        std::vector<gmx::AnalysisNeighborhoodPair> blockPairs;
+        gmx::AnalysisNeighborhoodPairSearch pairSearch = search->startPairSearch(pos);
+        pairs.clear();
+        int prevTestIndex = -1;
+        while (pairSearch.findNextPairBlock(2, &blockPairs))
+        {
+            for (const auto& pair : blockPairs)
+            {
+                EXPECT_LE(prevTestIndex, pair.testIndex());
+                prevTestIndex = pair.testIndex();
+            }
+            if (!blockPairs.empty())
+            {
+                EXPECT_LE(blockPairs.back().testIndex() - blockPairs.front().testIndex(), 1);
+            }
+            pairs.insert(pairs.end(), blockPairs.begin(), blockPairs.end());
+        }
+        checkPairs(pairs);
+    }
+}
+
 /********************************************************************
  * Test data generation
  */
@@ -1042,6 +1100,46 @@ TEST_F(NeighborhoodSearchTest, HandlesConcurrentSearches)
     }
 }
 
+TEST_F(NeighborhoodSearchTest, HandlesRepeatedInitialization)
+{
+    const NeighborhoodSearchTestData& data = RandomBoxFullPBCData::get();
+
+    nb_.setCutoff(data.cutoff_);
+    nb_.setMode(gmx::AnalysisNeighborhood::eSearchMode_Grid);
+    std::vector<gmx::RVec>             refPos(data.refPos_);
+    gmx::AnalysisNeighborhoodPositions refPositions(refPos);
+    {
+        gmx::AnalysisNeighborhoodSearch search = nb_.initSearch(&data.pbc_, refPositions);
+        testPairSearch(&search, data);
+    }
+    // The same positions should reuse the grid.
+    {
+        gmx::AnalysisNeighborhoodSearch search = nb_.initSearch(&data.pbc_, refPositions);
+        ASSERT_EQ(gmx::AnalysisNeighborhood::eSearchMode_Grid, search.mode());
+        testPairSearch(&search, data);
+    }
+    // Modified positions in the same array should not reuse the grid.
+    for (gmx::RVec& x : refPos)
+    {
+        x[XX] += data.cutoff_;
+    }
+    {
+        gmx::AnalysisNeighborhoodSearch     search = nb_.initSearch(&data.pbc_, refPositions);
+        gmx::AnalysisNeighborhoodPairSearch pairSearch = search.startPairSearch(data.testPositions());
+        gmx::AnalysisNeighborhoodPair       pair;
+        int                                 pairCount = 0;
+        while (pairSearch.findNextPair(&pair))
+        {
+            rvec dx;
+            pbc_dx(&data.pbc_, refPos[pair.refIndex()], data.testPositions_[pair.testIndex()].x, dx);
+            EXPECT_REAL_EQ_TOL(norm2(dx), pair.distance2(),
+                               gmx::test::relativeToleranceAsFloatingPoint(1.0, 1e-5));
+            ++pairCount;
+        }
+        EXPECT_GT(pairCount, 0);
+    }
+}
+
 TEST_F(NeighborhoodSearchTest, HandlesNoPBC)
 {
     const NeighborhoodSearchTestData& data = TrivialNoPBCTestData::get();
@@ -1133,4 +1231,69 @@ TEST_F(NeighborhoodSearchTest, GridSearchExclusions)
                        helper.exclusions(), {}, {}, false);
 }
 
+TEST_F(NeighborhoodSearchTest, SimpleSearchAllPairs)
+{
+    const NeighborhoodSearchTestData& data = RandomBoxFullPBCData::get();
+
+    nb_.setCutoff(data.cutoff_);
+    nb_.setMode(gmx::AnalysisNeighborhood::eSearchMode_Simple);
+    gmx::AnalysisNeighborhoodSearch search = nb_.initSearch(&data.pbc_, data.refPositions());
+    ASSERT_EQ(gmx::AnalysisNeighborhood::eSearchMode_Simple, search.mode());
+
+    testAllPairs(&search, data.testPositions());
+}
+
+TEST_F(NeighborhoodSearchTest, GridSearchAllPairs)
+{
+    const NeighborhoodSearchTestData& data = RandomBoxFullPBCData::get();
+
+    nb_.setCutoff(data.cutoff_);
+    nb_.setMode(gmx::AnalysisNeighborhood::eSearchMode_Grid);
+    gmx::AnalysisNeighborhoodSearch search = nb_.initSearch(&data.pbc_, data.refPositions());
+    ASSERT_EQ(gmx::AnalysisNeighborhood::eSearchMode_Grid, search.mode());
+
+    testAllPairs(&search, data.testPositions());
+    testAllPairs(&search, data.testPosition(0));
+}
+
+TEST_F(NeighborhoodSearchTest, GridSearchAllPairsTriclinic)
+{
+    const NeighborhoodSearchTestData& data = RandomTriclinicFullPBCData::get();
+
+    nb_.setCutoff(data.cutoff_);
+    gmx::AnalysisNeighborhoodSearch search = nb_.initSearch(&data.pbc_, data.refPositions());
+    ASSERT_EQ(gmx::AnalysisNeighborhood::eSearchMode_Grid, search.mode());
+
+    testAllPairs(&search, data.testPositions());
+}
+
+TEST_F(NeighborhoodSearchTest, GridSearchAllPairsXY)
+{
+    const NeighborhoodSearchTestData& data = RandomBoxXYFullPBCData::get();
+
+    nb_.setCutoff(data.cutoff_);
+    nb_.setXYMode(true);
+    gmx::AnalysisNeighborhoodSearch search = nb_.initSearch(&data.pbc_, data.refPositions());
+    ASSERT_EQ(gmx::AnalysisNeighborhood::eSearchMode_Grid, search.mode());
+
+    testAllPairs(&search, data.testPositions());
+}
+
+TEST_F(NeighborhoodSearchTest, GridSearchAllPairsExclusions)
+{
+    const NeighborhoodSearchTestData& data = RandomBoxFullPBCData::get();
+
+    ExclusionsHelper helper(data.refPosCount_, data.testPositions_.size());
+    helper.generateExclusions();
+
+    nb_.setCutoff(data.cutoff_);
+    nb_.setTopologyExclusions(helper.exclusions());
+    nb_.setMode(gmx::AnalysisNeighborhood::eSearchMode_Grid);
+    gmx::AnalysisNeighborhoodSearch search =
+            nb_.initSearch(&data.pbc_, data.refPositions().exclusionIds(helper.refPosIds()));
+    ASSERT_EQ(gmx::AnalysisNeighborhood::eSearchMode_Grid, search.mode());
+
+    testAllPairs(&search, data.testPositions().exclusionIds(helper.testPosIds()));
+}
+
 } // namespace
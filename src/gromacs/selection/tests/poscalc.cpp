@@ -45,6 +45,7 @@
 #include "gromacs/selection/poscalc.h"
 
 #include <memory>
+#include <numeric>
 #include <vector>
 
 #include <gtest/gtest.h>
@@ -58,6 +59,7 @@
 #include "gromacs/utility/smalloc.h"
 
 #include "testutils/refdata.h"
+#include "testutils/testasserts.h"
 
 #include "toputils.h"
 
@@ -491,6 +493,103 @@ TEST_F(PositionCalculationTest, HandlesOverlappingStaticCalculations)
     }
 }
 
+/*! \brief
+ * Checks that \p p holds the centers of mass of its blocks, for both
+ * positions and velocities, computed in the straightforward way.
+ */
+void checkCentersOfMass(const gmx_ana_pos_t& p, const t_atoms& atoms, const t_trxframe& frame)
+{
+    for (int b = 0; b < p.count(); ++b)
+    {
+        rvec x, v;
+        clear_rvec(x);
+        clear_rvec(v);
+        real mtot = 0;
+        for (int i = p.m.mapb.index[b]; i < p.m.mapb.index[b + 1]; ++i)
+        {
+            const int  ai   = p.m.mapb.a[i];
+            const real mass = atoms.atom[ai].m;
+            for (int d = 0; d < DIM; ++d)
+            {
+                x[d] += mass * frame.x[ai][d];
+                v[d] += mass * frame.v[ai][d];
+            }
+            mtot += mass;
+        }
+        for (int d = 0; d < DIM; ++d)
+        {
+            const real expectedX = x[d] / mtot;
+            const real expectedV = v[d] / mtot;
+            EXPECT_REAL_EQ_TOL(expectedX, p.x[b][d],
+                               gmx::test::relativeToleranceAsFloatingPoint(expectedX, 1e-5));
+            EXPECT_REAL_EQ_TOL(expectedV, p.v[b][d],
+                               gmx::test::relativeToleranceAsFloatingPoint(expectedV, 1e-5));
+        }
+    }
+}
+
+TEST_F(PositionCalculationTest, ComputesManyResidueCOMPositions)
+{
+    // Enough residues for the SIMD and threaded code paths, with some
+    // residues only partially included such that the block sizes vary.
+    const int        residueCount = 2500;
+    std::vector<int> group;
+    for (int i = 0; i < 3 * residueCount; ++i)
+    {
+        if (i % 11 != 5)
+        {
+            group.push_back(i);
+        }
+    }
+    topManager_.requestVelocities();
+    topManager_.initAtoms(3 * residueCount);
+    topManager_.initUniformResidues(3);
+
+    gmx_ana_poscalc_t* pc = createCalculation(POS_RES, POS_MASS | POS_VELOCITIES);
+    setMaximumGroup(pc, group);
+    gmx_ana_pos_t* p = initPositions(pc, nullptr);
+    generateCoordinates();
+    pcc_.initEvaluation();
+    pcc_.initFrame(topManager_.frame());
+    gmx_ana_index_t g;
+    g.isize = group.size();
+    g.index = group.data();
+    gmx_ana_poscalc_update(pc, p, &g, topManager_.frame(), nullptr);
+
+    checker_.checkInteger(p->count(), "Count");
+    ASSERT_EQ(residueCount, p->count());
+    checkCentersOfMass(*p, topManager_.atoms(), *topManager_.frame());
+}
+
+TEST_F(PositionCalculationTest, ComputesResidueCOMPositionsUpToLastAtom)
+{
+    // Equal-sized residues that fill whole SIMD batches for any SIMD width,
+    // up to and including the last atom of the exactly-sized coordinate
+    // array of the frame, so reading beyond the end of the coordinates
+    // in the batched path would show up under a memory checker.
+    const int        residueCount = 64;
+    std::vector<int> group(3 * residueCount);
+    std::iota(group.begin(), group.end(), 0);
+    topManager_.requestVelocities();
+    topManager_.initAtoms(3 * residueCount);
+    topManager_.initUniformResidues(3);
+
+    gmx_ana_poscalc_t* pc = createCalculation(POS_RES, POS_MASS | POS_VELOCITIES);
+    setMaximumGroup(pc, group);
+    gmx_ana_pos_t* p = initPositions(pc, nullptr);
+    generateCoordinates();
+    pcc_.initEvaluation();
+    pcc_.initFrame(topManager_.frame());
+    gmx_ana_index_t g;
+    g.isize = group.size();
+    g.index = group.data();
+    gmx_ana_poscalc_update(pc, p, &g, topManager_.frame(), nullptr);
+
+    checker_.checkInteger(p->count(), "Count");
+    ASSERT_EQ(residueCount, p->count());
+    checkCentersOfMass(*p, topManager_.atoms(), *topManager_.frame());
+}
+
 // TODO: Check for handling of more multiple calculation cases
 
 } // namespace
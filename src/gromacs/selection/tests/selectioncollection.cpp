@@ -46,8 +46,12 @@
 
 #include <gtest/gtest.h>
 
+#include "gromacs/math/vec.h"
 #include "gromacs/options/basicoptions.h"
 #include "gromacs/options/ioptionscontainer.h"
+#include "gromacs/pbcutil/pbc.h"
+#include "gromacs/random/threefry.h"
+#include "gromacs/random/uniformrealdistribution.h"
 #include "gromacs/selection/indexutil.h"
 #include "gromacs/selection/selection.h"
 #include "gromacs/topology/topology.h"
@@ -635,6 +639,125 @@ TEST_F(SelectionCollectionTest, HandlesFramesWithTooSmallAtomSubsets4)
 
 // TODO: Tests for more evaluation errors
 
+TEST_F(SelectionCollectionTest, CopiesEvaluateLikeOriginal)
+{
+    ASSERT_NO_THROW_GMX(loadIndexGroups("simple.ndx"));
+    ASSERT_NO_THROW_GMX(sel_ = sc_.parseFromString(
+                                "sel = atomnr 1 to 10 and not group \"GrpA\"; "
+                                "sel and x < 2.5; res_cog of group 1"));
+    ASSERT_NO_FATAL_FAILURE(loadTopology("simple.gro"));
+    ASSERT_NO_THROW_GMX(sc_.compile());
+    // Copies must not depend on the index groups staying available.
+    gmx_ana_indexgrps_free(grps_);
+    grps_ = nullptr;
+
+    gmx::SelectionCollection copy(sc_);
+    ASSERT_NO_THROW_GMX(sc_.evaluate(topManager_.frame(), nullptr));
+    ASSERT_NO_THROW_GMX(copy.evaluate(topManager_.frame(), nullptr));
+    ASSERT_EQ(2U, sel_.size());
+    for (const gmx::Selection& sel : sel_)
+    {
+        const gmx::Selection copySel = copy.correspondingSelection(sel);
+        EXPECT_NE(sel, copySel);
+        EXPECT_STREQ(sel.selectionText(), copySel.selectionText());
+        ASSERT_EQ(sel.posCount(), copySel.posCount());
+        ASSERT_EQ(sel.atomCount(), copySel.atomCount());
+        for (int i = 0; i < sel.atomCount(); ++i)
+        {
+            EXPECT_EQ(sel.atomIndices()[i], copySel.atomIndices()[i]);
+        }
+        for (int i = 0; i < sel.posCount(); ++i)
+        {
+            EXPECT_EQ(sel.position(i).mappedId(), copySel.position(i).mappedId());
+            EXPECT_REAL_EQ_TOL(sel.position(i).x()[XX], copySel.position(i).x()[XX],
+                               gmx::test::defaultRealTolerance());
+        }
+    }
+}
+
+TEST_F(SelectionCollectionTest, EvaluatesWithinOverMovingFrames)
+{
+    ASSERT_NO_THROW_GMX(sel_ = sc_.parseFromString("within 1.2 of resnr 2"));
+    ASSERT_NO_FATAL_FAILURE(loadTopology("simple.gro"));
+    ASSERT_NO_THROW_GMX(sc_.compile());
+
+    // Move the atoms by small random steps, such that the candidate list of
+    // the within keyword is both reused and rebuilt, and check each frame
+    // against a direct calculation.
+    t_trxframe*                        frame = topManager_.frame();
+    gmx::DefaultRandomEngine           rng(12345);
+    gmx::UniformRealDistribution<real> dist(-0.04, 0.04);
+    for (int step = 0; step < 20; ++step)
+    {
+        SCOPED_TRACE(gmx::formatString("Frame %d", step));
+        ASSERT_NO_THROW_GMX(sc_.evaluate(frame, nullptr));
+        std::vector<int> expected;
+        for (int i = 0; i < frame->natoms; ++i)
+        {
+            for (int j = 3; j < 6; ++j)
+            {
+                if (distance2(frame->x[i], frame->x[j]) <= 1.2 * 1.2)
+                {
+                    expected.push_back(i);
+                    break;
+                }
+            }
+        }
+        const gmx::ArrayRef<const int> atoms = sel_[0].atomIndices();
+        EXPECT_EQ(expected, std::vector<int>(atoms.begin(), atoms.end()));
+        for (int i = 0; i < frame->natoms; ++i)
+        {
+            for (int d = 0; d < DIM; ++d)
+            {
+                frame->x[i][d] += dist(rng);
+            }
+        }
+    }
+}
+
+TEST_F(SelectionCollectionTest, EvaluatesWithinOverChangingPeriodicBox)
+{
+    ASSERT_NO_THROW_GMX(sel_ = sc_.parseFromString("within 1.2 of resnr 2"));
+    ASSERT_NO_FATAL_FAILURE(loadTopology("simple.gro"));
+    ASSERT_NO_THROW_GMX(sc_.compile());
+
+    // Shrink the box a little in each frame, as with pressure coupling,
+    // such that the candidate list of the within keyword is both reused and
+    // rebuilt only because of the box changes, and check each frame against
+    // a direct calculation.  Atom 13 comes within the cutoff of atom 4
+    // through the periodic boundaries once the box is small enough.
+    t_trxframe* frame = topManager_.frame();
+    clear_mat(frame->box);
+    frame->bBox = TRUE;
+    for (int step = 0; step < 50; ++step)
+    {
+        SCOPED_TRACE(gmx::formatString("Frame %d", step));
+        const real boxSize = 4.3 - 0.01 * step;
+        frame->box[XX][XX] = boxSize;
+        frame->box[YY][YY] = boxSize;
+        frame->box[ZZ][ZZ] = boxSize;
+        t_pbc pbc;
+        set_pbc(&pbc, PbcType::Xyz, frame->box);
+        ASSERT_NO_THROW_GMX(sc_.evaluate(frame, &pbc));
+        std::vector<int> expected;
+        for (int i = 0; i < frame->natoms; ++i)
+        {
+            for (int j = 3; j < 6; ++j)
+            {
+                rvec dx;
+                pbc_dx(&pbc, frame->x[i], frame->x[j], dx);
+                if (norm2(dx) <= 1.2 * 1.2)
+                {
+                    expected.push_back(i);
+                    break;
+                }
+            }
+        }
+        const gmx::ArrayRef<const int> atoms = sel_[0].atomIndices();
+        EXPECT_EQ(expected, std::vector<int>(atoms.begin(), atoms.end()));
+    }
+}
+
 /********************************************************************
  * Tests for interactive selection input
  */
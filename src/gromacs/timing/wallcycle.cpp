@@ -159,6 +159,7 @@ static const char* wcsn[ewcsNR] = {
     "NS grid non-loc.",
     "NS search local",
     "NS search non-loc.",
+    "NS search all",
     "Bonded F",
     "Bonded-FEP F",
     "Restraints F",
@@ -111,6 +111,7 @@ enum
     ewcsNBS_GRID_NONLOCAL,
     ewcsNBS_SEARCH_LOCAL,
     ewcsNBS_SEARCH_NONLOCAL,
+    ewcsNBS_SEARCH_LOCAL_NONLOCAL,
     ewcsLISTED,
     ewcsLISTED_FEP,
     ewcsRESTRAINTS,
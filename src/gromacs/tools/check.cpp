@@ -58,6 +58,7 @@
 #include "gromacs/mdtypes/md_enums.h"
 #include "gromacs/mdtypes/state.h"
 #include "gromacs/pbcutil/pbc.h"
+#include "gromacs/timing/walltime_accounting.h"
 #include "gromacs/topology/atomprop.h"
 #include "gromacs/topology/block.h"
 #include "gromacs/topology/ifunc.h"
@@ -333,6 +334,7 @@ static void chk_trj(const gmx_output_env_t* oenv, const char* fn, const char* tp
     last.bF      = 0;
     last.bBox    = 0;
 
+    const double startTime = gmx_gettime();
     read_first_frame(oenv, &status, fn, &fr, TRX_READ_X | TRX_READ_V | TRX_READ_F);
 
     do
@@ -407,6 +409,18 @@ static void chk_trj(const gmx_output_env_t* oenv, const char* fn, const char* tp
 
     close_trx(status);
 
+    /* Report the reading throughput, which is dominated by decompression for XTC */
+    const double elapsedTime = gmx_gettime() - startTime;
+    FILE*        fp          = gmx_ffopen(fn, "rb");
+    gmx_fseek(fp, 0, SEEK_END);
+    const double megaBytes = gmx_ftell(fp) / (1024.0 * 1024.0);
+    gmx_ffclose(fp);
+    if (elapsedTime > 0)
+    {
+        fprintf(stderr, "\nRead %d frames (%.1f MB) in %.3f s: %.1f frames/s, %.1f MB/s\n", j,
+                megaBytes, elapsedTime, j / elapsedTime, megaBytes / elapsedTime);
+    }
+
     fprintf(stderr, "\nItem        #frames");
     if (bShowTimestep)
     {
@@ -128,6 +128,17 @@ public:
          * \see setRmPBC()
          */
         efNoUserRmPBC = 1 << 5,
+        /*! \brief
+         * Declares that frames can be analyzed concurrently.
+         *
+         * If set, TrajectoryAnalysisModule::analyzeFrame() may be called
+         * for several frames at the same time from different threads when
+         * the user requests it with the -nt option.  The module must then
+         * access selections and data handles only through the
+         * TrajectoryAnalysisModuleData object passed to analyzeFrame(),
+         * and not modify its own state in that method.
+         */
+        efFrameParallel = 1 << 6,
     };
 
     //! Initializes default settings.
@@ -44,9 +44,16 @@
 
 #include "cmdlinerunner.h"
 
+#include <cstdio>
+
+#include <memory>
+#include <utility>
+#include <vector>
+
 #include "gromacs/analysisdata/paralleloptions.h"
 #include "gromacs/commandline/cmdlinemodulemanager.h"
 #include "gromacs/commandline/cmdlineoptionsmodule.h"
+#include "gromacs/options/basicoptions.h"
 #include "gromacs/options/ioptionscontainer.h"
 #include "gromacs/options/timeunitmanager.h"
 #include "gromacs/pbcutil/pbc.h"
@@ -59,6 +66,8 @@
 #include "gromacs/utility/exceptions.h"
 #include "gromacs/utility/filestream.h"
 #include "gromacs/utility/gmxassert.h"
+#include "gromacs/utility/gmxomp.h"
+#include "gromacs/utility/smalloc.h"
 
 #include "runnercommon.h"
 
@@ -77,7 +86,8 @@ class RunnerModule : public ICommandLineOptionsModule
 public:
     explicit RunnerModule(TrajectoryAnalysisModulePointer module) :
         module_(std::move(module)),
-        common_(&settings_)
+        common_(&settings_),
+        threadCount_(1)
     {
     }
 
@@ -86,10 +96,23 @@ public:
     void optionsFinished() override;
     int  run() override;
 
+    /*! \brief
+     * Analyzes the frames with \p threadCount frames concurrently.
+     *
+     * Returns the number of frames analyzed.  The frames are read,
+     * and PBC removed, serially, after which a batch of frames is
+     * evaluated and analyzed in parallel, each thread using its own copy
+     * of the selections and its own module data.  The frames are then
+     * finished in order.
+     */
+    int analyzeFramesInParallel(int threadCount);
+
     TrajectoryAnalysisModulePointer module_;
     TrajectoryAnalysisSettings      settings_;
     TrajectoryAnalysisRunnerCommon  common_;
     SelectionCollection             selections_;
+    //! Number of frames to analyze concurrently (-nt).
+    int threadCount_;
 };
 
 void RunnerModule::initOptions(IOptionsContainer* options, ICommandLineOptionsModuleSettings* settings)
@@ -106,6 +129,8 @@ void RunnerModule::initOptions(IOptionsContainer* options, ICommandLineOptionsMo
     module_->initOptions(&moduleOptions, &settings_);
     settings_.setOptionsModuleSettings(nullptr);
     common_.initOptions(&commonOptions, timeUnitBehavior.get());
+    commonOptions.addOption(IntegerOption("nt").store(&threadCount_).description(
+            "Number of frames to analyze concurrently (0 is the number of OpenMP threads)"));
     selectionOptionBehavior->initOptions(&commonOptions);
 }
 
@@ -113,6 +138,25 @@ void RunnerModule::optionsFinished()
 {
     common_.optionsFinished();
     module_->optionsFinished(&settings_);
+    if (threadCount_ < 0)
+    {
+        GMX_THROW(InvalidInputError("The number of threads (-nt) cannot be negative"));
+    }
+    if (threadCount_ == 0)
+    {
+        threadCount_ = gmx_omp_get_max_threads();
+    }
+    if (threadCount_ > 1 && !settings_.hasFlag(TrajectoryAnalysisSettings::efFrameParallel))
+    {
+        std::fprintf(stderr,
+                     "NOTE: This tool cannot analyze frames concurrently, "
+                     "frames are analyzed with one thread.\n");
+        threadCount_ = 1;
+    }
+    if (!GMX_OPENMP)
+    {
+        threadCount_ = 1;
+    }
 }
 
 int RunnerModule::run()
@@ -126,33 +170,40 @@ int RunnerModule::run()
     common_.initFrameIndexGroup();
     module_->initAfterFirstFrame(settings_, common_.frame());
 
-    t_pbc  pbc;
-    t_pbc* ppbc = settings_.hasPBC() ? &pbc : nullptr;
-
-    int                                 nframes = 0;
-    AnalysisDataParallelOptions         dataOptions;
-    TrajectoryAnalysisModuleDataPointer pdata(module_->startFrames(dataOptions, selections_));
-    do
+    int nframes = 0;
+    if (threadCount_ > 1)
+    {
+        nframes = analyzeFramesInParallel(threadCount_);
+    }
+    else
     {
-        common_.initFrame();
-        t_trxframe& frame = common_.frame();
-        if (ppbc != nullptr)
+        t_pbc  pbc;
+        t_pbc* ppbc = settings_.hasPBC() ? &pbc : nullptr;
+
+        AnalysisDataParallelOptions         dataOptions;
+        TrajectoryAnalysisModuleDataPointer pdata(module_->startFrames(dataOptions, selections_));
+        do
         {
-            set_pbc(ppbc, topology.pbcType(), frame.box);
-        }
+            common_.initFrame();
+            t_trxframe& frame = common_.frame();
+            if (ppbc != nullptr)
+            {
+                set_pbc(ppbc, topology.pbcType(), frame.box);
+            }
 
-        selections_.evaluate(&frame, ppbc);
-        module_->analyzeFrame(nframes, frame, ppbc, pdata.get());
-        module_->finishFrameSerial(nframes);
+            selections_.evaluate(&frame, ppbc);
+            module_->analyzeFrame(nframes, frame, ppbc, pdata.get());
+            module_->finishFrameSerial(nframes);
 
-        ++nframes;
-    } while (common_.readNextFrame());
-    module_->finishFrames(pdata.get());
-    if (pdata.get() != nullptr)
-    {
-        pdata->finish();
+            ++nframes;
+        } while (common_.readNextFrame());
+        module_->finishFrames(pdata.get());
+        if (pdata.get() != nullptr)
+        {
+            pdata->finish();
+        }
+        pdata.reset();
     }
-    pdata.reset();
 
     if (common_.hasTrajectory())
     {
@@ -172,6 +223,105 @@ int RunnerModule::run()
     return 0;
 }
 
+int RunnerModule::analyzeFramesInParallel(int threadCount)
+{
+    const TopologyInformation& topology = common_.topologyInformation();
+
+    // The first thread uses the original selections.
+    std::vector<std::unique_ptr<SelectionCollection>> selectionCopies;
+    std::vector<SelectionCollection*>                 selections = { &selections_ };
+    for (int i = 1; i < threadCount; ++i)
+    {
+        selectionCopies.push_back(std::make_unique<SelectionCollection>(selections_));
+        selections.push_back(selectionCopies.back().get());
+    }
+    AnalysisDataParallelOptions                      dataOptions(threadCount);
+    std::vector<TrajectoryAnalysisModuleDataPointer> pdata;
+    for (int i = 0; i < threadCount; ++i)
+    {
+        pdata.push_back(module_->startFrames(dataOptions, *selections[i]));
+    }
+
+    // Frames are swapped with the frame read by common_, so the buffers
+    // need arrays of the same size.
+    const t_trxframe&       firstFrame = common_.frame();
+    std::vector<t_trxframe> frames(threadCount, firstFrame);
+    for (t_trxframe& frame : frames)
+    {
+        frame.x = nullptr;
+        frame.v = nullptr;
+        frame.f = nullptr;
+        if (firstFrame.x != nullptr)
+        {
+            snew(frame.x, firstFrame.natoms);
+        }
+        if (firstFrame.v != nullptr)
+        {
+            snew(frame.v, firstFrame.natoms);
+        }
+        if (firstFrame.f != nullptr)
+        {
+            snew(frame.f, firstFrame.natoms);
+        }
+    }
+    std::vector<t_pbc> pbc(threadCount);
+
+    int  nframes    = 0;
+    int  frameCount = 0;
+    bool bMore      = true;
+    while (bMore)
+    {
+        frameCount = 0;
+        while (bMore && frameCount < threadCount)
+        {
+            common_.initFrame();
+            std::swap(frames[frameCount], common_.frame());
+            ++frameCount;
+            bMore = common_.readNextFrame();
+        }
+
+#pragma omp parallel for num_threads(frameCount) schedule(static, 1)
+        for (int i = 0; i < frameCount; ++i)
+        {
+            try
+            {
+                t_pbc* ppbc = settings_.hasPBC() ? &pbc[i] : nullptr;
+                if (ppbc != nullptr)
+                {
+                    set_pbc(ppbc, topology.pbcType(), frames[i].box);
+                }
+                selections[i]->evaluate(&frames[i], ppbc);
+                module_->analyzeFrame(nframes + i, frames[i], ppbc, pdata[i].get());
+            }
+            GMX_CATCH_ALL_AND_EXIT_WITH_FATAL_ERROR
+        }
+        for (int i = 0; i < frameCount; ++i)
+        {
+            module_->finishFrameSerial(nframes + i);
+        }
+        nframes += frameCount;
+    }
+    for (TrajectoryAnalysisModuleDataPointer& data : pdata)
+    {
+        module_->finishFrames(data.get());
+        if (data != nullptr)
+        {
+            data->finish();
+        }
+    }
+    pdata.clear();
+
+    // Leave the last analyzed frame in common_ as in serial analysis.
+    std::swap(frames[frameCount - 1], common_.frame());
+    for (t_trxframe& frame : frames)
+    {
+        sfree(frame.x);
+        sfree(frame.v);
+        sfree(frame.f);
+    }
+    return nframes;
+}
+
 } // namespace
 
 /********************************************************************
@@ -417,7 +417,7 @@ void Angle::initOptions(IOptionsContainer* options, TrajectoryAnalysisSettings*
 }
 
 
-void Angle::optionsFinished(TrajectoryAnalysisSettings* /* settings */)
+void Angle::optionsFinished(TrajectoryAnalysisSettings* settings)
 {
     const bool bSingle = (g1type_ == Group1Type::Angle || g1type_ == Group1Type::Dihedral);
 
@@ -466,6 +466,12 @@ void Angle::optionsFinished(TrajectoryAnalysisSettings* /* settings */)
     }
     // TODO: If bSingle is not set, the second selection option should be
     // required.
+
+    // The vectors at time zero are only known after the first frame.
+    if (g2type_ != Group2Type::TimeZero)
+    {
+        settings->setFlag(TrajectoryAnalysisSettings::efFrameParallel);
+    }
 }
 
 
@@ -684,8 +690,8 @@ void calc_vec(int natoms, rvec x[], t_pbc* pbc, rvec xout, rvec cout)
 void Angle::analyzeFrame(int frnr, const t_trxframe& fr, t_pbc* pbc, TrajectoryAnalysisModuleData* pdata)
 {
     AnalysisDataHandle   dh   = pdata->dataHandle(angles_);
-    const SelectionList& sel1 = TrajectoryAnalysisModuleData::parallelSelections(sel1_);
-    const SelectionList& sel2 = TrajectoryAnalysisModuleData::parallelSelections(sel2_);
+    const SelectionList& sel1 = pdata->parallelSelections(sel1_);
+    const SelectionList& sel2 = pdata->parallelSelections(sel2_);
 
     checkSelections(sel1, sel2);
 
@@ -710,7 +716,7 @@ void Angle::analyzeFrame(int frnr, const t_trxframe& fr, t_pbc* pbc, TrajectoryA
         switch (g2type_)
         {
             case Group2Type::Z: v2[ZZ] = 1.0; break;
-            case Group2Type::SphereNormal: copy_rvec(sel2_[g].position(0).x(), c2); break;
+            case Group2Type::SphereNormal: copy_rvec(sel2[g].position(0).x(), c2); break;
             default:
                 // do nothing
                 break;
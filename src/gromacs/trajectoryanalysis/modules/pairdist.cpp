@@ -398,8 +398,17 @@ public:
      * would need to be recomputed for each selection.
      */
     std::vector<int> refCountArray_;
+    /*! \brief
+     * Pairs found for a block of test positions.
+     *
+     * Kept here so that the memory is reused across frames.
+     */
+    std::vector<AnalysisNeighborhoodPair> pairs_;
 };
 
+//! Number of test positions for which pairs are searched at a time.
+const int c_pairSearchBlockSize = 1024;
+
 TrajectoryAnalysisModuleDataPointer PairDistance::startFrames(const AnalysisDataParallelOptions& opt,
                                                               const SelectionCollection& selections)
 {
@@ -410,8 +419,8 @@ TrajectoryAnalysisModuleDataPointer PairDistance::startFrames(const AnalysisData
 void PairDistance::analyzeFrame(int frnr, const t_trxframe& fr, t_pbc* pbc, TrajectoryAnalysisModuleData* pdata)
 {
     AnalysisDataHandle      dh         = pdata->dataHandle(distances_);
-    const Selection&        refSel     = TrajectoryAnalysisModuleData::parallelSelection(refSel_);
-    const SelectionList&    sel        = TrajectoryAnalysisModuleData::parallelSelections(sel_);
+    const Selection&        refSel     = pdata->parallelSelection(refSel_);
+    const SelectionList&    sel        = pdata->parallelSelections(sel_);
     PairDistanceModuleData& frameData  = *static_cast<PairDistanceModuleData*>(pdata);
     std::vector<real>&      distArray  = frameData.distArray_;
     std::vector<int>&       countArray = frameData.countArray_;
@@ -428,7 +437,8 @@ void PairDistance::analyzeFrame(int frnr, const t_trxframe& fr, t_pbc* pbc, Traj
     }
     const std::vector<int>& refCountArray = frameData.refCountArray_;
 
-    AnalysisNeighborhoodSearch nbsearch = nb_.initSearch(pbc, refSel);
+    AnalysisNeighborhoodSearch             nbsearch = nb_.initSearch(pbc, refSel);
+    std::vector<AnalysisNeighborhoodPair>& pairs    = frameData.pairs_;
     dh.startFrame(frnr, fr.time);
     for (size_t g = 0; g < sel.size(); ++g)
     {
@@ -438,31 +448,35 @@ void PairDistance::analyzeFrame(int frnr, const t_trxframe& fr, t_pbc* pbc, Traj
 
         // Accumulate the number of position pairs within the cutoff and the
         // min/max distance for each group pair.
+        // The pairs are processed a block of test positions at a time to
+        // keep the memory for the pairs bounded.
         AnalysisNeighborhoodPairSearch pairSearch = nbsearch.startPairSearch(sel[g]);
-        AnalysisNeighborhoodPair       pair;
-        while (pairSearch.findNextPair(&pair))
+        while (pairSearch.findNextPairBlock(c_pairSearchBlockSize, &pairs))
         {
-            const SelectionPosition& refPos   = refSel.position(pair.refIndex());
-            const SelectionPosition& selPos   = sel[g].position(pair.testIndex());
-            const int                refIndex = refPos.mappedId();
-            const int                selIndex = selPos.mappedId();
-            const int                index    = selIndex * refGroupCount_ + refIndex;
-            const real               r2       = pair.distance2();
-            if (distanceType_ == DistanceType::Min)
+            for (const AnalysisNeighborhoodPair& pair : pairs)
             {
-                if (distArray[index] > r2)
+                const SelectionPosition& refPos   = refSel.position(pair.refIndex());
+                const SelectionPosition& selPos   = sel[g].position(pair.testIndex());
+                const int                refIndex = refPos.mappedId();
+                const int                selIndex = selPos.mappedId();
+                const int                index    = selIndex * refGroupCount_ + refIndex;
+                const real               r2       = pair.distance2();
+                if (distanceType_ == DistanceType::Min)
                 {
-                    distArray[index] = r2;
+                    if (distArray[index] > r2)
+                    {
+                        distArray[index] = r2;
+                    }
                 }
-            }
-            else
-            {
-                if (distArray[index] < r2)
+                else
                 {
-                    distArray[index] = r2;
+                    if (distArray[index] < r2)
+                    {
+                        distArray[index] = r2;
+                    }
                 }
+                ++countArray[index];
             }
-            ++countArray[index];
         }
 
         // If it is possible that positions outside the cutoff (or lack of
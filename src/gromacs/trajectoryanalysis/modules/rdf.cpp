@@ -284,6 +284,7 @@ void Rdf::initOptions(IOptionsContainer* options, TrajectoryAnalysisSettings* se
     };
 
     settings->setHelpText(desc);
+    settings->setFlag(TrajectoryAnalysisSettings::efFrameParallel);
 
     options->addOption(FileNameOption("o")
                                .filetype(eftPlot)
@@ -466,8 +467,17 @@ public:
      * the RDF from these numbers.
      */
     std::vector<real> surfaceDist2_;
+    /*! \brief
+     * Pairs found for a block of test positions.
+     *
+     * Kept here so that the memory is reused across frames.
+     */
+    std::vector<AnalysisNeighborhoodPair> pairs_;
 };
 
+//! Number of test positions for which pairs are searched at a time.
+const int c_pairSearchBlockSize = 1024;
+
 TrajectoryAnalysisModuleDataPointer Rdf::startFrames(const AnalysisDataParallelOptions& opt,
                                                      const SelectionCollection&         selections)
 {
@@ -478,8 +488,8 @@ void Rdf::analyzeFrame(int frnr, const t_trxframe& fr, t_pbc* pbc, TrajectoryAna
 {
     AnalysisDataHandle   dh        = pdata->dataHandle(pairDist_);
     AnalysisDataHandle   nh        = pdata->dataHandle(normFactors_);
-    const Selection&     refSel    = TrajectoryAnalysisModuleData::parallelSelection(refSel_);
-    const SelectionList& sel       = TrajectoryAnalysisModuleData::parallelSelections(sel_);
+    const Selection&     refSel    = pdata->parallelSelection(refSel_);
+    const SelectionList& sel       = pdata->parallelSelections(sel_);
     RdfModuleData&       frameData = *static_cast<RdfModuleData*>(pdata);
     const bool           bSurface  = !frameData.surfaceDist2_.empty();
 
@@ -526,7 +536,8 @@ void Rdf::analyzeFrame(int frnr, const t_trxframe& fr, t_pbc* pbc, TrajectoryAna
     }
 
     dh.startFrame(frnr, fr.time);
-    AnalysisNeighborhoodSearch nbsearch = nb_.initSearch(pbc, refSel);
+    AnalysisNeighborhoodSearch             nbsearch = nb_.initSearch(pbc, refSel);
+    std::vector<AnalysisNeighborhoodPair>& pairs    = frameData.pairs_;
     for (size_t g = 0; g < sel.size(); ++g)
     {
         dh.selectDataSet(g);
@@ -569,18 +580,21 @@ void Rdf::analyzeFrame(int frnr, const t_trxframe& fr, t_pbc* pbc, TrajectoryAna
         else
         {
             // Standard neighborhood search over all pairs within the cutoff
-            // for the -surf no case.
+            // for the -surf no case, a block of test positions at a time to
+            // keep the memory for the pairs bounded.
             AnalysisNeighborhoodPairSearch pairSearch = nbsearch.startPairSearch(sel[g]);
-            AnalysisNeighborhoodPair       pair;
-            while (pairSearch.findNextPair(&pair))
+            while (pairSearch.findNextPairBlock(c_pairSearchBlockSize, &pairs))
             {
-                const real r2 = pair.distance2();
-                if (r2 > cut2_)
+                for (const AnalysisNeighborhoodPair& pair : pairs)
                 {
-                    // TODO: Consider whether the histogramming could be done with
-                    // less overhead (after first measuring the overhead).
-                    dh.setPoint(0, std::sqrt(r2));
-                    dh.finishPointSet();
+                    const real r2 = pair.distance2();
+                    if (r2 > cut2_)
+                    {
+                        // TODO: Consider whether the histogramming could be done with
+                        // less overhead (after first measuring the overhead).
+                        dh.setPoint(0, std::sqrt(r2));
+                        dh.finishPointSet();
+                    }
                 }
             }
         }
@@ -52,8 +52,12 @@
 #include "gromacs/math/vec.h"
 #include "gromacs/pbcutil/pbc.h"
 #include "gromacs/selection/nbsearch.h"
+#include "gromacs/simd/simd.h"
+#include "gromacs/utility/alignedallocator.h"
+#include "gromacs/utility/exceptions.h"
 #include "gromacs/utility/fatalerror.h"
 #include "gromacs/utility/gmxassert.h"
+#include "gromacs/utility/gmxomp.h"
 #include "gromacs/utility/smalloc.h"
 
 using namespace gmx;
@@ -67,52 +71,52 @@ using namespace gmx;
 
 static real safe_asin(real f)
 {
-    if ((fabs(f) < 1.00))
+    if ((std::fabs(f) < 1.00))
     {
-        return (asin(f));
+        return (std::asin(f));
     }
-    GMX_ASSERT(fabs(f) - 1.0 > DP_TOL, "Invalid argument");
+    GMX_ASSERT(std::fabs(f) - 1.0 > DP_TOL, "Invalid argument");
     return (M_PI_2);
 }
 
 /* routines for dot distributions on the surface of the unit sphere */
 static real icosaeder_vertices(real* xus)
 {
-    const real rh = std::sqrt(1. - 2. * cos(TORAD(72.))) / (1. - cos(TORAD(72.)));
-    const real rg = cos(TORAD(72.)) / (1. - cos(TORAD(72.)));
+    const real rh = std::sqrt(1. - 2. * std::cos(TORAD(72.))) / (1. - std::cos(TORAD(72.)));
+    const real rg = std::cos(TORAD(72.)) / (1. - std::cos(TORAD(72.)));
     /* icosaeder vertices */
     xus[0]  = 0.;
     xus[1]  = 0.;
     xus[2]  = 1.;
-    xus[3]  = rh * cos(TORAD(72.));
-    xus[4]  = rh * sin(TORAD(72.));
+    xus[3]  = rh * std::cos(TORAD(72.));
+    xus[4]  = rh * std::sin(TORAD(72.));
     xus[5]  = rg;
-    xus[6]  = rh * cos(TORAD(144.));
-    xus[7]  = rh * sin(TORAD(144.));
+    xus[6]  = rh * std::cos(TORAD(144.));
+    xus[7]  = rh * std::sin(TORAD(144.));
     xus[8]  = rg;
-    xus[9]  = rh * cos(TORAD(216.));
-    xus[10] = rh * sin(TORAD(216.));
+    xus[9]  = rh * std::cos(TORAD(216.));
+    xus[10] = rh * std::sin(TORAD(216.));
     xus[11] = rg;
-    xus[12] = rh * cos(TORAD(288.));
-    xus[13] = rh * sin(TORAD(288.));
+    xus[12] = rh * std::cos(TORAD(288.));
+    xus[13] = rh * std::sin(TORAD(288.));
     xus[14] = rg;
     xus[15] = rh;
     xus[16] = 0;
     xus[17] = rg;
-    xus[18] = rh * cos(TORAD(36.));
-    xus[19] = rh * sin(TORAD(36.));
+    xus[18] = rh * std::cos(TORAD(36.));
+    xus[19] = rh * std::sin(TORAD(36.));
     xus[20] = -rg;
-    xus[21] = rh * cos(TORAD(108.));
-    xus[22] = rh * sin(TORAD(108.));
+    xus[21] = rh * std::cos(TORAD(108.));
+    xus[22] = rh * std::sin(TORAD(108.));
     xus[23] = -rg;
     xus[24] = -rh;
     xus[25] = 0;
     xus[26] = -rg;
-    xus[27] = rh * cos(TORAD(252.));
-    xus[28] = rh * sin(TORAD(252.));
+    xus[27] = rh * std::cos(TORAD(252.));
+    xus[28] = rh * std::sin(TORAD(252.));
     xus[29] = -rg;
-    xus[30] = rh * cos(TORAD(324.));
-    xus[31] = rh * sin(TORAD(324.));
+    xus[30] = rh * std::cos(TORAD(324.));
+    xus[31] = rh * std::sin(TORAD(324.));
     xus[32] = -rg;
     xus[33] = 0.;
     xus[34] = 0.;
@@ -141,8 +145,8 @@ divarc(real x1, real y1, real z1, real x2, real y2, real z2, int div1, int div2,
 
     phi  = safe_asin(dd / std::sqrt(d1 * d2));
     phi  = phi * (static_cast<real>(div1)) / (static_cast<real>(div2));
-    sphi = sin(phi);
-    cphi = cos(phi);
+    sphi = std::sin(phi);
+    cphi = std::cos(phi);
     s    = (x1 * xd + y1 * yd + z1 * zd) / dd;
 
     x   = xd * s * (1. - cphi) / dd + x1 * cphi + (yd * z1 - y1 * zd) * sphi / dd;
@@ -166,7 +170,7 @@ static std::vector<real> ico_dot_arc(int densit)
 
     /* calculate tessalation level */
     a              = std::sqrt(((static_cast<real>(densit)) - 2.) / 10.);
-    const int tess = static_cast<int>(ceil(a));
+    const int tess = static_cast<int>(std::ceil(a));
     const int ndot = 10 * tess * tess + 2;
     GMX_RELEASE_ASSERT(ndot >= densit, "Inconsistent surface dot formula");
 
@@ -176,7 +180,7 @@ static std::vector<real> ico_dot_arc(int densit)
     if (tess > 1)
     {
         tn = 12;
-        a  = rh * rh * 2. * (1. - cos(TORAD(72.)));
+        a  = rh * rh * 2. * (1. - std::cos(TORAD(72.)));
         /* calculate tessalation of icosaeder edges */
         for (i = 0; i < 11; i++)
         {
@@ -283,7 +287,7 @@ static std::vector<real> ico_dot_dod(int densit)
 
     /* calculate tesselation level */
     a              = std::sqrt(((static_cast<real>(densit)) - 2.) / 30.);
-    tess           = std::max(static_cast<int>(ceil(a)), 1);
+    tess           = std::max(static_cast<int>(std::ceil(a)), 1);
     const int ndot = 30 * tess * tess + 2;
     GMX_RELEASE_ASSERT(ndot >= densit, "Inconsistent surface dot formula");
 
@@ -292,7 +296,7 @@ static std::vector<real> ico_dot_dod(int densit)
 
     tn = 12;
     /* square of the edge of an icosaeder */
-    a = rh * rh * 2. * (1. - cos(TORAD(72.)));
+    a = rh * rh * 2. * (1. - std::cos(TORAD(72.)));
     /* dodecaeder vertices */
     for (i = 0; i < 10; i++)
     {
@@ -340,7 +344,7 @@ static std::vector<real> ico_dot_dod(int densit)
     {
         tn = 32;
         /* square of the edge of an dodecaeder */
-        adod = 4. * (cos(TORAD(108.)) - cos(TORAD(120.))) / (1. - cos(TORAD(120.)));
+        adod = 4. * (std::cos(TORAD(108.)) - std::cos(TORAD(120.))) / (1. - std::cos(TORAD(120.)));
         /* square of the distance of two adjacent vertices of ico- and dodecaeder */
         ai_d = 2. * (1. - std::sqrt(1. - a / 3.));
 
@@ -512,17 +516,17 @@ static std::vector<real> make_unsp(int densit, int cubus)
     snew(work, ndot);
     for (l = 0; l < ndot; l++)
     {
-        i = std::max(static_cast<int>(floor((1. + xus[3 * l]) / del_cube)), 0);
+        i = std::max(static_cast<int>(std::floor((1. + xus[3 * l]) / del_cube)), 0);
         if (i >= ico_cube)
         {
             i = ico_cube - 1;
         }
-        j = std::max(static_cast<int>(floor((1. + xus[1 + 3 * l]) / del_cube)), 0);
+        j = std::max(static_cast<int>(std::floor((1. + xus[1 + 3 * l]) / del_cube)), 0);
         if (j >= ico_cube)
         {
             j = ico_cube - 1;
         }
-        k = std::max(static_cast<int>(floor((1. + xus[2 + 3 * l]) / del_cube)), 0);
+        k = std::max(static_cast<int>(std::floor((1. + xus[2 + 3 * l]) / del_cube)), 0);
         if (k >= ico_cube)
         {
             k = ico_cube - 1;
@@ -581,11 +585,101 @@ static std::vector<real> make_unsp(int densit, int cubus)
     return xus;
 }
 
+//! Number of atoms in a block of the parallelized atom loop.
+static const int c_surfaceAtomBlockSize = 32;
+
+/*! \internal \brief
+ * Unit sphere dots stored separately for each dimension.
+ *
+ * The arrays are padded with zeros to a multiple of the SIMD width, so that
+ * the occlusion test can process a full SIMD register of dots at a time.
+ */
+struct PaddedUnitSphereDots
+{
+    //! Number of actual dots.
+    int count = 0;
+    //! Number of dots including the padding.
+    int paddedCount = 0;
+    //! X coordinates of the dots.
+    std::vector<real, AlignedAllocator<real>> x;
+    //! Y coordinates of the dots.
+    std::vector<real, AlignedAllocator<real>> y;
+    //! Z coordinates of the dots.
+    std::vector<real, AlignedAllocator<real>> z;
+};
+
+//! Converts dots stored as x,y,z triplets to a padded SoA layout.
+static PaddedUnitSphereDots makePaddedDots(const std::vector<real>& xus)
+{
+#if GMX_SIMD_HAVE_REAL
+    const int simdWidth = GMX_SIMD_REAL_WIDTH;
+#else
+    const int simdWidth = 1;
+#endif
+    PaddedUnitSphereDots dots;
+    dots.count       = ssize(xus) / 3;
+    dots.paddedCount = ((dots.count + simdWidth - 1) / simdWidth) * simdWidth;
+    dots.x.resize(dots.paddedCount, 0.0_real);
+    dots.y.resize(dots.paddedCount, 0.0_real);
+    dots.z.resize(dots.paddedCount, 0.0_real);
+    for (int j = 0; j < dots.count; ++j)
+    {
+        dots.x[j] = xus[3 * j];
+        dots.y[j] = xus[3 * j + 1];
+        dots.z[j] = xus[3 * j + 2];
+    }
+    return dots;
+}
+
+/*! \brief
+ * Marks the dots of an atom covered by a neighbor.
+ *
+ * \param[in]     dots     Unit sphere dots.
+ * \param[in]     dx       Vector from the atom to the neighbor.
+ * \param[in]     refdot   A dot is covered if its projection to \p dx
+ *     exceeds this value.
+ * \param[in,out] exposed  1 for each dot that is still exposed, 0 otherwise
+ *     (dots.paddedCount values, zero for the padding).
+ * \returns       Number of dots that remain exposed.
+ */
+static int markCoveredDots(const PaddedUnitSphereDots& dots, const rvec dx, real refdot, real* exposed)
+{
+#if GMX_SIMD_HAVE_REAL
+    const SimdReal dxS(dx[XX]);
+    const SimdReal dyS(dx[YY]);
+    const SimdReal dzS(dx[ZZ]);
+    const SimdReal refdotS(refdot);
+    SimdReal       exposedSum = setZero();
+    for (int j = 0; j < dots.paddedCount; j += GMX_SIMD_REAL_WIDTH)
+    {
+        SimdReal proj = dxS * load<SimdReal>(dots.x.data() + j);
+        proj          = fma(dyS, load<SimdReal>(dots.y.data() + j), proj);
+        proj          = fma(dzS, load<SimdReal>(dots.z.data() + j), proj);
+        const SimdReal exposedS = selectByNotMask(load<SimdReal>(exposed + j), refdotS < proj);
+        store(exposed + j, exposedS);
+        exposedSum = exposedSum + exposedS;
+    }
+    return static_cast<int>(reduce(exposedSum));
+#else
+    int exposedCount = 0;
+    for (int j = 0; j < dots.count; ++j)
+    {
+        if (exposed[j] != 0
+            && dots.x[j] * dx[XX] + dots.y[j] * dx[YY] + dots.z[j] * dx[ZZ] > refdot)
+        {
+            exposed[j] = 0;
+        }
+        exposedCount += static_cast<int>(exposed[j]);
+    }
+    return exposedCount;
+#endif
+}
+
 static void nsc_dclm_pbc(const rvec*                 coords,
                          const ArrayRef<const real>& radius,
                          int                         nat,
                          const real*                 xus,
-                         int                         n_dot,
+                         const PaddedUnitSphereDots& paddedDots,
                          int                         mode,
                          real*                       value_of_area,
                          real**                      at_area,
@@ -594,8 +688,10 @@ static void nsc_dclm_pbc(const rvec*                 coords,
                          int*                        nu_dots,
                          int                         index[],
                          AnalysisNeighborhood*       nb,
-                         const t_pbc*                pbc)
+                         const t_pbc*                pbc,
+                         int                         nthreads)
 {
+    const int  n_dot   = paddedDots.count;
     const real dotarea = FOURPI / static_cast<real>(n_dot);
 
     if (debug)
@@ -609,23 +705,6 @@ static void nsc_dclm_pbc(const rvec*                 coords,
     {
         return;
     }
-    real  area = 0.0, vol = 0.0;
-    real *dots = nullptr, *atom_area = nullptr;
-    int   lfnr = 0, maxdots = 0;
-    if (mode & FLAG_VOLUME)
-    {
-        vol = 0.;
-    }
-    if (mode & FLAG_DOTS)
-    {
-        maxdots = (3 * n_dot * nat) / 10;
-        snew(dots, maxdots);
-        lfnr = 0;
-    }
-    if (mode & FLAG_ATOM_AREA)
-    {
-        snew(atom_area, nat);
-    }
 
     // Compute the center of the molecule for volume calculation.
     // In principle, the center should not influence the results, but that is
@@ -650,107 +729,125 @@ static void nsc_dclm_pbc(const rvec*                 coords,
     pos.indexed(constArrayRefFromArray(index, nat));
     AnalysisNeighborhoodSearch nbsearch(nb->initSearch(pbc, pos));
 
-    std::vector<int> wkdot(n_dot);
+    // The atoms are processed in blocks, and the per-atom contributions and
+    // the surface dots of each block are stored separately, such that they
+    // can be combined in the original atom order independent of the number
+    // of threads.
+    const int                      blockCount = (nat + c_surfaceAtomBlockSize - 1) / c_surfaceAtomBlockSize;
+    std::vector<real>              atomArea(nat);
+    std::vector<real>              atomVolume((mode & FLAG_VOLUME) ? nat : 0);
+    std::vector<std::vector<real>> blockDots((mode & FLAG_DOTS) ? blockCount : 0);
+    nthreads = std::max(std::min(nthreads, blockCount), 1);
 
-    for (int i = 0; i < nat; ++i)
+#pragma omp parallel num_threads(nthreads)
     {
-        const int                      iat  = index[i];
-        const real                     ai   = radius[iat];
-        const real                     aisq = ai * ai;
-        AnalysisNeighborhoodPairSearch pairSearch(nbsearch.startPairSearch(coords[iat]));
-        AnalysisNeighborhoodPair       pair;
-        std::fill(wkdot.begin(), wkdot.end(), 1);
-        int currDotCount = n_dot;
-        while (currDotCount > 0 && pairSearch.findNextPair(&pair))
+        try
         {
-            const int  jat = index[pair.refIndex()];
-            const real aj  = radius[jat];
-            const real d2  = pair.distance2();
-            if (iat == jat || d2 > gmx::square(ai + aj))
-            {
-                continue;
-            }
-            const rvec& dx     = pair.dx();
-            const real  refdot = (d2 + aisq - aj * aj) / (2 * ai);
-            // TODO: Consider whether micro-optimizations from the old
-            // implementation would be useful, compared to the complexity that
-            // they bring: instead of this direct loop, the neighbors were
-            // stored into a temporary array, the loop order was
-            // reversed (first over dots, then over neighbors), and for each
-            // dot, it was first checked whether the same neighbor that
-            // resulted in marking the previous dot covered would also cover
-            // this dot. This presumably plays together with sorting of the
-            // surface dots (done in make_unsp) to avoid some of the looping.
-            // Alternatively, we could keep a skip list here to avoid
-            // repeatedly looping over dots that have already marked as
-            // covered.
-            for (int j = 0; j < n_dot; ++j)
+            std::vector<real, AlignedAllocator<real>> exposed(paddedDots.paddedCount, 0.0_real);
+#pragma omp for schedule(dynamic)
+            for (int block = 0; block < blockCount; ++block)
             {
-                if (wkdot[j] && iprod(&xus[3 * j], dx) > refdot)
+                const int blockEnd = std::min(nat, (block + 1) * c_surfaceAtomBlockSize);
+                for (int i = block * c_surfaceAtomBlockSize; i < blockEnd; ++i)
                 {
-                    --currDotCount;
-                    wkdot[j] = 0;
-                }
-            }
-        }
+                    const int                      iat  = index[i];
+                    const real                     ai   = radius[iat];
+                    const real                     aisq = ai * ai;
+                    AnalysisNeighborhoodPairSearch pairSearch(nbsearch.startPairSearch(coords[iat]));
+                    AnalysisNeighborhoodPair       pair;
+                    std::fill(exposed.begin(), exposed.begin() + n_dot, 1.0_real);
+                    int currDotCount = n_dot;
+                    while (currDotCount > 0 && pairSearch.findNextPair(&pair))
+                    {
+                        const int  jat = index[pair.refIndex()];
+                        const real aj  = radius[jat];
+                        const real d2  = pair.distance2();
+                        if (iat == jat || d2 > gmx::square(ai + aj))
+                        {
+                            continue;
+                        }
+                        const real refdot = (d2 + aisq - aj * aj) / (2 * ai);
+                        currDotCount = markCoveredDots(paddedDots, pair.dx(), refdot, exposed.data());
+                    }
 
-        const real a = aisq * dotarea * currDotCount;
-        area         = area + a;
-        if (mode & FLAG_ATOM_AREA)
-        {
-            atom_area[i] = a;
-        }
-        const real xi = coords[iat][XX];
-        const real yi = coords[iat][YY];
-        const real zi = coords[iat][ZZ];
-        if (mode & FLAG_DOTS)
-        {
-            for (int l = 0; l < n_dot; l++)
-            {
-                if (wkdot[l])
-                {
-                    lfnr++;
-                    if (maxdots <= 3 * lfnr + 1)
+                    atomArea[i]   = aisq * dotarea * currDotCount;
+                    const real xi = coords[iat][XX];
+                    const real yi = coords[iat][YY];
+                    const real zi = coords[iat][ZZ];
+                    if (mode & FLAG_DOTS)
                     {
-                        maxdots = maxdots + n_dot * 3;
-                        srenew(dots, maxdots);
+                        std::vector<real>& dots = blockDots[block];
+                        for (int l = 0; l < n_dot; l++)
+                        {
+                            if (exposed[l] != 0)
+                            {
+                                dots.push_back(ai * xus[3 * l] + xi);
+                                dots.push_back(ai * xus[1 + 3 * l] + yi);
+                                dots.push_back(ai * xus[2 + 3 * l] + zi);
+                            }
+                        }
+                    }
+                    if (mode & FLAG_VOLUME)
+                    {
+                        real dx = 0.0, dy = 0.0, dz = 0.0;
+                        for (int l = 0; l < n_dot; l++)
+                        {
+                            if (exposed[l] != 0)
+                            {
+                                dx = dx + xus[3 * l];
+                                dy = dy + xus[1 + 3 * l];
+                                dz = dz + xus[2 + 3 * l];
+                            }
+                        }
+                        atomVolume[i] = aisq
+                                        * (dx * (xi - xs) + dy * (yi - ys) + dz * (zi - zs)
+                                           + ai * currDotCount);
                     }
-                    dots[3 * lfnr - 3] = ai * xus[3 * l] + xi;
-                    dots[3 * lfnr - 2] = ai * xus[1 + 3 * l] + yi;
-                    dots[3 * lfnr - 1] = ai * xus[2 + 3 * l] + zi;
-                }
-            }
-        }
-        if (mode & FLAG_VOLUME)
-        {
-            real dx = 0.0, dy = 0.0, dz = 0.0;
-            for (int l = 0; l < n_dot; l++)
-            {
-                if (wkdot[l])
-                {
-                    dx = dx + xus[3 * l];
-                    dy = dy + xus[1 + 3 * l];
-                    dz = dz + xus[2 + 3 * l];
                 }
             }
-            vol = vol + aisq * (dx * (xi - xs) + dy * (yi - ys) + dz * (zi - zs) + ai * currDotCount);
         }
+        GMX_CATCH_ALL_AND_EXIT_WITH_FATAL_ERROR
     }
 
+    real area = 0.0;
+    for (int i = 0; i < nat; ++i)
+    {
+        area = area + atomArea[i];
+    }
     if (mode & FLAG_VOLUME)
     {
+        real vol = 0.0;
+        for (int i = 0; i < nat; ++i)
+        {
+            vol = vol + atomVolume[i];
+        }
         *value_of_vol = vol * FOURPI / (3. * n_dot);
     }
     if (mode & FLAG_DOTS)
     {
+        size_t dotValueCount = 0;
+        for (const auto& dots : blockDots)
+        {
+            dotValueCount += dots.size();
+        }
+        real* dots = nullptr;
+        snew(dots, std::max<size_t>(dotValueCount, 1));
+        real* dotsEnd = dots;
+        for (const auto& block : blockDots)
+        {
+            dotsEnd = std::copy(block.begin(), block.end(), dotsEnd);
+        }
         GMX_RELEASE_ASSERT(nu_dots != nullptr, "Must have valid nu_dots pointer");
-        *nu_dots = lfnr;
+        *nu_dots = dotValueCount / 3;
         GMX_RELEASE_ASSERT(lidots != nullptr, "Must have valid lidots pointer");
         *lidots = dots;
     }
     if (mode & FLAG_ATOM_AREA)
     {
         GMX_RELEASE_ASSERT(at_area != nullptr, "Must have valid at_area pointer");
+        real* atom_area = nullptr;
+        snew(atom_area, nat);
+        std::copy(atomArea.begin(), atomArea.end(), atom_area);
         *at_area = atom_area;
     }
     *value_of_area = area;
@@ -767,11 +864,13 @@ namespace gmx
 class SurfaceAreaCalculator::Impl
 {
 public:
-    Impl() : flags_(0) {}
+    Impl() : flags_(0), threadCount_(0) {}
 
     std::vector<real>            unitSphereDots_;
+    PaddedUnitSphereDots         paddedDots_;
     ArrayRef<const real>         radius_;
     int                          flags_;
+    int                          threadCount_;
     mutable AnalysisNeighborhood nb_;
 };
 
@@ -782,6 +881,7 @@ SurfaceAreaCalculator::~SurfaceAreaCalculator() {}
 void SurfaceAreaCalculator::setDotCount(int dotCount)
 {
     impl_->unitSphereDots_ = make_unsp(dotCount, 4);
+    impl_->paddedDots_     = makePaddedDots(impl_->unitSphereDots_);
 }
 
 void SurfaceAreaCalculator::setRadii(const ArrayRef<const real>& radius)
@@ -830,6 +930,11 @@ void SurfaceAreaCalculator::setCalculateSurfaceDots(bool bDots)
     }
 }
 
+void SurfaceAreaCalculator::setThreadCount(int threadCount)
+{
+    impl_->threadCount_ = threadCount;
+}
+
 void SurfaceAreaCalculator::calculate(const rvec*  x,
                                       const t_pbc* pbc,
                                       int          nat,
@@ -875,8 +980,9 @@ void SurfaceAreaCalculator::calculate(const rvec*  x,
     {
         *n_dots = 0;
     }
-    nsc_dclm_pbc(x, impl_->radius_, nat, &impl_->unitSphereDots_[0], impl_->unitSphereDots_.size() / 3,
-                 flags, area, at_area, volume, lidots, n_dots, index, &impl_->nb_, pbc);
+    const int threadCount = impl_->threadCount_ > 0 ? impl_->threadCount_ : gmx_omp_get_max_threads();
+    nsc_dclm_pbc(x, impl_->radius_, nat, impl_->unitSphereDots_.data(), impl_->paddedDots_, flags,
+                 area, at_area, volume, lidots, n_dots, index, &impl_->nb_, pbc, threadCount);
 }
 
 } // namespace gmx
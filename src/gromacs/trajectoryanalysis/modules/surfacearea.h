@@ -71,6 +71,9 @@ namespace gmx
  * original documentation of the method, a density of 600-700 dots gives an
  * accuracy of 1.5 A^2 per atom.
  *
+ * The atoms are processed in blocks on multiple OpenMP threads, and the dots
+ * of an atom are tested against each neighbor using SIMD when available.
+ *
  * \ingroup module_trajectoryanalysis
  */
 class SurfaceAreaCalculator
@@ -133,6 +136,16 @@ public:
      * Does not throw.
      */
     void setCalculateSurfaceDots(bool bDots);
+    /*! \brief
+     * Sets the number of OpenMP threads to use for the atom loop.
+     *
+     * If not called, or \p threadCount is zero, the number of threads
+     * available to OpenMP is used.  The results do not depend on the
+     * number of threads.
+     *
+     * Does not throw.
+     */
+    void setThreadCount(int threadCount);
 
     /*! \brief
      * Calculates the surface area for a set of positions.
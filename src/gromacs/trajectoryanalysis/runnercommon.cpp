@@ -44,14 +44,17 @@
 
 #include "runnercommon.h"
 
+#include <cstdlib>
 #include <cstring>
 
 #include <algorithm>
+#include <memory>
 #include <string>
 
 #include "gromacs/fileio/oenv.h"
 #include "gromacs/fileio/timecontrol.h"
 #include "gromacs/fileio/trxio.h"
+#include "gromacs/fileio/trxprefetcher.h"
 #include "gromacs/math/vec.h"
 #include "gromacs/options/basicoptions.h"
 #include "gromacs/options/filenameoption.h"
@@ -135,6 +138,8 @@ public:
     //! Used to store the status variable from read_first_frame().
     t_trxstatus*      status_;
     gmx_output_env_t* oenv_;
+    //! Reads frames ahead of the analysis, or \p NULL if not used.
+    std::unique_ptr<TrajectoryFramePrefetcher> prefetcher_;
 };
 
 
@@ -225,7 +230,7 @@ void TrajectoryAnalysisRunnerCommon::Impl::initFirstFrame()
 
         if (topInfo_.hasTopology())
         {
-            const int topologyAtomCount = topInfo_.mtop()->natoms;
+            const int topologyAtomCount = topInfo_.mtop_->natoms;
             if (fr->natoms > topologyAtomCount)
             {
                 const std::string message =
@@ -242,7 +247,7 @@ void TrajectoryAnalysisRunnerCommon::Impl::initFirstFrame()
         {
             GMX_THROW(InvalidInputError("Forces cannot be read from a topology"));
         }
-        fr->natoms = topInfo_.mtop()->natoms;
+        fr->natoms = topInfo_.mtop_->natoms;
         fr->bX     = TRUE;
         snew(fr->x, fr->natoms);
         memcpy(fr->x, topInfo_.xtop_.data(), sizeof(*fr->x) * fr->natoms);
@@ -290,6 +295,8 @@ void TrajectoryAnalysisRunnerCommon::Impl::initFrameIndexGroup()
 
 void TrajectoryAnalysisRunnerCommon::Impl::finishTrajectory()
 {
+    // The prefetcher may be reading from the status
+    prefetcher_.reset();
     if (bTrajOpen_)
     {
         close_trx(status_);
@@ -441,7 +448,25 @@ bool TrajectoryAnalysisRunnerCommon::readNextFrame()
     bool bContinue = false;
     if (hasTrajectory())
     {
-        bContinue = read_next_frame(impl_->oenv_, impl_->status_, impl_->fr);
+        if (impl_->prefetcher_ == nullptr && impl_->bTrajOpen_)
+        {
+            /* Read frames ahead on a separate thread when requested */
+            const char* env = getenv("GMX_TRAJECTORY_PREFETCH_FRAMES");
+            const int numFrames = (env != nullptr) ? static_cast<int>(std::strtol(env, nullptr, 10)) : 0;
+            if (numFrames > 0 && TrajectoryFramePrefetcher::supportsFile(impl_->trjfile_.c_str()))
+            {
+                impl_->prefetcher_ = std::make_unique<TrajectoryFramePrefetcher>(
+                        impl_->oenv_, impl_->status_, *impl_->fr, numFrames);
+            }
+        }
+        if (impl_->prefetcher_ != nullptr)
+        {
+            bContinue = impl_->prefetcher_->readNextFrame(impl_->fr);
+        }
+        else
+        {
+            bContinue = read_next_frame(impl_->oenv_, impl_->status_, impl_->fr);
+        }
     }
     if (!bContinue)
     {
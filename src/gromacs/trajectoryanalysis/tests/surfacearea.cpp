@@ -72,6 +72,7 @@ class SurfaceAreaTest : public ::testing::Test
 public:
     SurfaceAreaTest() :
         box_(),
+        threadCount_(1),
         rng_(12345),
         area_(0.0),
         volume_(0.0),
@@ -147,6 +148,7 @@ public:
         gmx::SurfaceAreaCalculator calculator;
         calculator.setDotCount(ndots);
         calculator.setRadii(radius_);
+        calculator.setThreadCount(threadCount_);
         calculator.calculate(as_rvec_array(x_.data()), bPBC ? &pbc : nullptr, index_.size(),
                              index_.data(), flags, &area_, &volume_, &atomArea_, &dots_, &dotCount_);
     }
@@ -185,6 +187,7 @@ public:
 
     gmx::test::TestReferenceData data_;
     matrix                       box_;
+    int                          threadCount_;
 
 private:
     static int dotComparer(const void* a, const void* b)
@@ -299,6 +302,21 @@ TEST_F(SurfaceAreaTest, Computes100Points)
     checkReference(&checker, "100Points", false);
 }
 
+TEST_F(SurfaceAreaTest, Computes100PointsWithMultipleThreads)
+{
+    // The reference data is the same as for Computes100Points: the results
+    // should not depend on the number of threads.
+    gmx::test::TestReferenceChecker checker(data_.rootChecker());
+    checker.setDefaultTolerance(gmx::test::absoluteTolerance(0.001));
+    box_[XX][XX] = 10.0;
+    box_[YY][YY] = 10.0;
+    box_[ZZ][ZZ] = 10.0;
+    generateRandomPositions(100);
+    threadCount_ = 4;
+    ASSERT_NO_FATAL_FAILURE(calculate(24, FLAG_VOLUME | FLAG_ATOM_AREA | FLAG_DOTS, false));
+    checkReference(&checker, "100Points", false);
+}
+
 TEST_F(SurfaceAreaTest, Computes100PointsWithRectangularPBC)
 {
     // TODO: It would be nice to check that this produces the same result as
@@ -45,9 +45,11 @@
 
 #include <gtest/gtest.h>
 
+#include "gromacs/fileio/tpxio.h"
 #include "gromacs/gmxpreprocess/grompp.h"
 #include "gromacs/math/vectypes.h"
 #include "gromacs/pbcutil/pbc.h"
+#include "gromacs/topology/ifunc.h"
 #include "gromacs/topology/topology.h"
 #include "gromacs/utility/arrayref.h"
 #include "gromacs/utility/exceptions.h"
@@ -194,26 +196,29 @@ TEST(TopologyInformation, WorksWithPdbFile)
     EXPECT_EQ('B', atoms->resinfo[4].chainid);
 }
 
-TEST(TopologyInformation, WorksWithTprFromPdbFile)
+//! Makes a tpr file of lysozyme with \p fileManager and returns its name
+std::string makeLysozymeTpr(TestFileManager* fileManager)
 {
-    TestFileManager fileManager;
-
-    // Make the tpr file to use
     std::string       name             = "lysozyme";
-    const std::string mdpInputFileName = fileManager.getTemporaryFilePath(name + ".mdp");
+    const std::string mdpInputFileName = fileManager->getTemporaryFilePath(name + ".mdp");
     // Ensure the seeds have a value so that the resulting .tpr dump
     // is reproducible.
     TextWriter::writeFileFromString(mdpInputFileName, "");
-    std::string tprName = fileManager.getTemporaryFilePath(name + ".tpr");
-    {
-        CommandLine caller;
-        caller.append("grompp");
-        caller.addOption("-f", mdpInputFileName);
-        caller.addOption("-p", TestFileManager::getInputFilePath(name));
-        caller.addOption("-c", TestFileManager::getInputFilePath(name + ".pdb"));
-        caller.addOption("-o", tprName);
-        ASSERT_EQ(0, gmx_grompp(caller.argc(), caller.argv()));
-    }
+    std::string tprName = fileManager->getTemporaryFilePath(name + ".tpr");
+    CommandLine caller;
+    caller.append("grompp");
+    caller.addOption("-f", mdpInputFileName);
+    caller.addOption("-p", TestFileManager::getInputFilePath(name));
+    caller.addOption("-c", TestFileManager::getInputFilePath(name + ".pdb"));
+    caller.addOption("-o", tprName);
+    EXPECT_EQ(0, gmx_grompp(caller.argc(), caller.argv()));
+    return tprName;
+}
+
+TEST(TopologyInformation, WorksWithTprFromPdbFile)
+{
+    TestFileManager   fileManager;
+    const std::string tprName = makeLysozymeTpr(&fileManager);
 
     const int           numAtoms = 156;
     TopologyInformation topInfo;
@@ -246,6 +251,42 @@ TEST(TopologyInformation, WorksWithTprFromPdbFile)
     EXPECT_EQ(0, atoms->resinfo[4].chainid);
 }
 
+TEST(TopologyInformation, ReadsInteractionListsOfTprWhenNeeded)
+{
+    TestFileManager   fileManager;
+    const std::string tprName = makeLysozymeTpr(&fileManager);
+
+    gmx_mtop_t completeMtop;
+    read_tpx(tprName.c_str(), nullptr, nullptr, nullptr, nullptr, nullptr, &completeMtop);
+    ASSERT_EQ(1U, completeMtop.moltype.size());
+    const InteractionLists& completeIlists = completeMtop.moltype[0].ilist;
+    ASSERT_FALSE(completeIlists[F_BONDS].empty());
+
+    gmx_mtop_t mtop;
+    read_tpx(tprName.c_str(), nullptr, nullptr, nullptr, nullptr, nullptr, &mtop,
+             TpxTopologyContent::WithoutInteractions);
+    EXPECT_EQ(completeMtop.natoms, mtop.natoms);
+    ASSERT_EQ(1U, mtop.moltype.size());
+    EXPECT_EQ(completeMtop.moltype[0].atoms.nr, mtop.moltype[0].atoms.nr);
+    for (int ftype = 0; ftype < F_NRE; ftype++)
+    {
+        EXPECT_TRUE(mtop.moltype[0].ilist[ftype].empty());
+    }
+
+    read_tpx_interactions(tprName.c_str(), &mtop);
+    for (int ftype = 0; ftype < F_NRE; ftype++)
+    {
+        EXPECT_EQ(completeIlists[ftype].iatoms, mtop.moltype[0].ilist[ftype].iatoms);
+    }
+
+    // The topology information also provides the interactions
+    TopologyInformation topInfo;
+    topInfo.fillFromInputFile(tprName);
+    EXPECT_EQ(completeIlists[F_ANGLES].iatoms, topInfo.mtop()->moltype[0].ilist[F_ANGLES].iatoms);
+    ASSERT_TRUE(topInfo.expandedTopology());
+    EXPECT_EQ(completeIlists[F_BONDS].size(), topInfo.expandedTopology()->idef.il[F_BONDS].size());
+}
+
 } // namespace
 } // namespace test
 } // namespace gmx
@@ -46,6 +46,7 @@
 #include <memory>
 
 #include "gromacs/fileio/confio.h"
+#include "gromacs/fileio/tpxio.h"
 #include "gromacs/math/vec.h"
 #include "gromacs/pbcutil/pbc.h"
 #include "gromacs/pbcutil/rmpbc.h"
@@ -81,12 +82,31 @@ void TopologyInformation::fillFromInputFile(const std::string& filename)
     // t_atoms that we'd keep, which we currently can't do.
     // TODO Once there are fewer callers of the file-reading
     // functionality, make them read directly into std::vector.
-    rvec *x, *v;
-    readConfAndTopology(filename.c_str(), &bTop_, mtop_.get(), &pbcType_, &x, &v, boxtop_);
-    xtop_.assign(x, x + mtop_->natoms);
-    vtop_.assign(v, v + mtop_->natoms);
-    sfree(x);
-    sfree(v);
+    if (fn2bTPX(filename.c_str()))
+    {
+        // The interaction lists are only needed by some tools, so they
+        // are read when first needed by mtop() or expandedTopology().
+        TpxFileHeader header = readTpxHeader(filename.c_str(), true);
+        xtop_.resize(header.natoms);
+        vtop_.resize(header.natoms);
+        pbcType_ = read_tpx(filename.c_str(), nullptr, boxtop_, nullptr, as_rvec_array(xtop_.data()),
+                            as_rvec_array(vtop_.data()), mtop_.get(),
+                            TpxTopologyContent::WithoutInteractions);
+        bTop_ = true;
+        if (header.bTop)
+        {
+            interactionsFileName_ = filename;
+        }
+    }
+    else
+    {
+        rvec *x, *v;
+        readConfAndTopology(filename.c_str(), &bTop_, mtop_.get(), &pbcType_, &x, &v, boxtop_);
+        xtop_.assign(x, x + mtop_->natoms);
+        vtop_.assign(v, v + mtop_->natoms);
+        sfree(x);
+        sfree(v);
+    }
     hasLoadedMtop_ = true;
     // TODO: Only load this here if the tool actually needs it; selections
     // take care of themselves.
@@ -100,13 +120,24 @@ void TopologyInformation::fillFromInputFile(const std::string& filename)
     }
 }
 
+gmx_mtop_t* TopologyInformation::mtop() const
+{
+    // Do lazy reading of the interaction lists
+    if (!interactionsFileName_.empty())
+    {
+        read_tpx_interactions(interactionsFileName_.c_str(), mtop_.get());
+        interactionsFileName_.clear();
+    }
+    return mtop_.get();
+}
+
 const gmx_localtop_t* TopologyInformation::expandedTopology() const
 {
     // Do lazy initialization
     if (expandedTopology_ == nullptr && hasTopology())
     {
-        expandedTopology_ = std::make_unique<gmx_localtop_t>(mtop_->ffparams);
-        gmx_mtop_generate_local_top(*mtop_, expandedTopology_.get(), false);
+        expandedTopology_ = std::make_unique<gmx_localtop_t>(mtop()->ffparams);
+        gmx_mtop_generate_local_top(*mtop(), expandedTopology_.get(), false);
     }
 
     return expandedTopology_.get();
@@ -115,13 +146,13 @@ const gmx_localtop_t* TopologyInformation::expandedTopology() const
 namespace
 {
 
-//! Helps implement lazy initialization.
-AtomsDataPtr makeAtoms(const TopologyInformation& top_)
+//! Helps implement lazy initialization, \p mtop does not need interaction lists.
+AtomsDataPtr makeAtoms(const gmx_mtop_t* mtop)
 {
     AtomsDataPtr atoms(new t_atoms);
-    if (top_.hasTopology())
+    if (mtop != nullptr)
     {
-        *atoms = gmx_mtop_global_atoms(top_.mtop());
+        *atoms = gmx_mtop_global_atoms(mtop);
     }
     else
     {
@@ -137,7 +168,7 @@ const t_atoms* TopologyInformation::atoms() const
     // Do lazy initialization
     if (atoms_ == nullptr)
     {
-        atoms_ = makeAtoms(*this);
+        atoms_ = makeAtoms(mtop_.get());
     }
 
     return atoms_.get();
@@ -149,7 +180,7 @@ AtomsDataPtr TopologyInformation::copyAtoms() const
     // whether the user has already used it, or will use it in the
     // future, any transformation operations on the data structure
     // returned here cannot have unintended effects.
-    return makeAtoms(*this);
+    return makeAtoms(mtop_.get());
 }
 
 ArrayRef<const RVec> TopologyInformation::x() const
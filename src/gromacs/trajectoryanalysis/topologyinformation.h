@@ -124,8 +124,11 @@ public:
      * \todo This should throw upon error but currently does
      * not. */
     void fillFromInputFile(const std::string& filename);
-    /*! \brief Returns the loaded topology, or nullptr if not loaded. */
-    gmx_mtop_t* mtop() const { return mtop_.get(); }
+    /*! \brief Returns the loaded topology, or nullptr if not loaded.
+     *
+     * When the topology was read from a run input file, its
+     * interaction lists are read on the first call. */
+    gmx_mtop_t* mtop() const;
     //! Returns the loaded topology fully expanded, or nullptr if no topology is available.
     const gmx_localtop_t* expandedTopology() const;
     /*! \brief Returns a read-only handle to the fully expanded
@@ -175,6 +178,8 @@ private:
     std::unique_ptr<gmx_mtop_t> mtop_;
     //! Whether a topology has been loaded.
     bool hasLoadedMtop_;
+    //! File to read the interaction lists of mtop_ from, empty when they are present.
+    mutable std::string interactionsFileName_;
     //! The fully expanded topology structure, nullptr if not yet constructed.
     mutable ExpandedTopologyPtr expandedTopology_;
     //! The fully expanded atoms data structure, nullptr if not yet constructed.
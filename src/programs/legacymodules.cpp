@@ -386,6 +386,7 @@ void registerLegacyModules(gmx::CommandLineModuleManager* manager)
         group.addModule("trjorder");
         group.addModule("xpm2ps");
         group.addModule("report-methods");
+        group.addModule("nonbonded-benchmark");
     }
     {
         gmx::CommandLineModuleGroup group = manager->addModuleGroup("Distances between structures");
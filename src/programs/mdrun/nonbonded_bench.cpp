@@ -54,6 +54,7 @@
 #include "gromacs/selection/selectionoptionbehavior.h"
 #include "gromacs/utility/arraysize.h"
 #include "gromacs/utility/enumerationhelpers.h"
+#include "gromacs/utility/futil.h"
 
 namespace gmx
 {
@@ -74,7 +75,9 @@ public:
     int  run() override;
 
 private:
-    int                       sizeFactor_ = 1;
+    std::vector<int>          sizeFactors_ = { 1 };
+    std::vector<int>          numThreads_  = { 1 };
+    std::string               dataFileName_;
     Nbnxm::KernelBenchOptions benchmarkOptions_;
 };
 
@@ -94,7 +97,7 @@ void NonbondedBenchmark::initOptions(IOptionsContainer* options, ICommandLineOpt
         "in this tool, as that is by far the most common treatment.",
         "And finally, while force output is always necessary, energy output",
         "is only required at certain steps. In total there are",
-        "12 relevant combinations of options. The combinations double to 24",
+        "24 relevant combinations of options. The combinations double to 48",
         "when two different SIMD setups are supported. These combinations",
         "can be run with a single invocation using the [TT]-all[tt] option.",
         "The behavior of each kernel is affected by caching behavior,",
@@ -110,6 +113,8 @@ void NonbondedBenchmark::initOptions(IOptionsContainer* options, ICommandLineOpt
         "parallel region per iteration. Additionally, threads interact",
         "through sharing and evicting data from shared caches.",
         "The number of threads to use is set with the [TT]-nt[tt] option.",
+        "Multiple values can be given to [TT]-nt[tt] and [TT]-size[tt]",
+        "to run the benchmarks for all combinations of these values.",
         "Thread affinity is important, especially with SMT and shared",
         "caches. Affinities can be set through the OpenMP library using",
         "the GOMP_CPU_AFFINITY environment variable.[PAR]",
@@ -136,6 +141,20 @@ void NonbondedBenchmark::initOptions(IOptionsContainer* options, ICommandLineOpt
         "The most relevant regime is between 0.1 to 1 millisecond per",
         "iteration. Thus it is useful to run with system sizes that cover",
         "both ends of this regime.[PAR]",
+        "With [TT]-step[tt], all the non-bonded work of MD steps is timed",
+        "instead of only the kernel: putting atoms on the search grid and",
+        "building the pair list every [TT]-nstlist[tt] steps, coordinate",
+        "conversion at the other steps, dynamic pruning of a list with",
+        "a buffer of [TT]-rlistbuf[tt] every [TT]-nstlistprune[tt] steps,",
+        "the kernel and the reduction of the forces. The wall-clock time",
+        "per step of each part is reported, together with the performance",
+        "in ns/day that the non-bonded work alone would allow with",
+        "time step [TT]-dt[tt], and the number of pairs within the cut-off",
+        "processed per second. Free-energy and listed interactions are",
+        "not included.[PAR]",
+        "With [TT]-o[tt], the timings are also written to file as",
+        "comma-separated values with one line per benchmark and timed part,",
+        "which is convenient for comparing the performance of builds.[PAR]",
         "The [TT]-simd[tt] and [TT]-table[tt] options select different",
         "implementations to compute the same physics. The choice of these",
         "options should ideally be optimized for the target hardware.",
@@ -167,10 +186,14 @@ void NonbondedBenchmark::initOptions(IOptionsContainer* options, ICommandLineOpt
         { "ewald", "reaction-field" }
     };
 
-    options->addOption(
-            IntegerOption("size").store(&sizeFactor_).description("The system size is 3000 atoms times this value"));
-    options->addOption(
-            IntegerOption("nt").store(&benchmarkOptions_.numThreads).description("The number of OpenMP threads to use"));
+    options->addOption(IntegerOption("size")
+                               .storeVector(&sizeFactors_)
+                               .multiValue()
+                               .description("The system size is 3000 atoms times this value"));
+    options->addOption(IntegerOption("nt")
+                               .storeVector(&numThreads_)
+                               .multiValue()
+                               .description("The number of OpenMP threads to use"));
     options->addOption(EnumOption<Nbnxm::BenchMarkKernels>("simd")
                                .store(&benchmarkOptions_.nbnxmSimd)
                                .enumValue(c_nbnxmSimdStrings)
@@ -195,7 +218,7 @@ void NonbondedBenchmark::initOptions(IOptionsContainer* options, ICommandLineOpt
                                .store(&benchmarkOptions_.computeVirialAndEnergy)
                                .description("Compute energies in addition to forces"));
     options->addOption(
-            BooleanOption("all").store(&benchmarkOptions_.doAll).description("Run all 12 combinations of options for coulomb, halflj, combrule"));
+            BooleanOption("all").store(&benchmarkOptions_.doAll).description("Run all 24 combinations of options for coulomb, halflj, combrule, energy"));
     options->addOption(RealOption("cutoff")
                                .store(&benchmarkOptions_.pairlistCutoff)
                                .description("Pair-list and interaction cut-off distance"));
@@ -208,6 +231,25 @@ void NonbondedBenchmark::initOptions(IOptionsContainer* options, ICommandLineOpt
     options->addOption(BooleanOption("cycles")
                                .store(&benchmarkOptions_.cyclesPerPair)
                                .description("Report cycles/pair instead of pairs/cycle"));
+    options->addOption(BooleanOption("step")
+                               .store(&benchmarkOptions_.timeSteps)
+                               .description("Time all non-bonded parts of MD steps"));
+    options->addOption(IntegerOption("nstlist")
+                               .store(&benchmarkOptions_.nstlist)
+                               .description("The pair-search interval with -step"));
+    options->addOption(IntegerOption("nstlistprune")
+                               .store(&benchmarkOptions_.nstlistPrune)
+                               .description("The dynamic pruning interval with -step, 0 is no pruning"));
+    options->addOption(RealOption("rlistbuf")
+                               .store(&benchmarkOptions_.pairlistBuffer)
+                               .description("The pair-list buffer for dynamic pruning with -step"));
+    options->addOption(RealOption("dt").store(&benchmarkOptions_.timeStep).description("The time step in ps, for reporting ns/day"));
+    options->addOption(FileNameOption("o")
+                               .filetype(eftGenericData)
+                               .outputFile()
+                               .store(&dataFileName_)
+                               .defaultBasename("nonbonded-benchmark")
+                               .description("Timings as comma-separated values"));
 }
 
 void NonbondedBenchmark::optionsFinished()
@@ -219,7 +261,28 @@ void NonbondedBenchmark::optionsFinished()
 
 int NonbondedBenchmark::run()
 {
-    Nbnxm::bench(sizeFactor_, benchmarkOptions_);
+    FILE* dataFile = nullptr;
+    if (!dataFileName_.empty())
+    {
+        dataFile = gmx_ffopen(dataFileName_, "w");
+        Nbnxm::printBenchDataHeader(dataFile);
+    }
+
+    for (int sizeFactor : sizeFactors_)
+    {
+        for (int numThreads : numThreads_)
+        {
+            Nbnxm::KernelBenchOptions options = benchmarkOptions_;
+            options.numThreads                = numThreads;
+
+            Nbnxm::bench(sizeFactor, options, dataFile);
+        }
+    }
+
+    if (dataFile)
+    {
+        gmx_ffclose(dataFile);
+    }
 
     return 0;
 }
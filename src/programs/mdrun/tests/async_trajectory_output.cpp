@@ -0,0 +1,253 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2020, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \internal \file
+ * \brief
+ * Tests that writing trajectory frames on a separate thread, as
+ * enabled by GMX_ASYNC_TRAJECTORY_OUTPUT, produces the same files
+ * as writing them from the simulation thread.
+ *
+ * \ingroup module_mdrun_integration_tests
+ */
+#include "gmxpre.h"
+
+#include <fstream>
+#include <iterator>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "testutils/cmdlinetest.h"
+#include "testutils/setenv.h"
+
+#include "moduletest.h"
+
+namespace gmx
+{
+namespace test
+{
+namespace
+{
+
+//! Environment variable that enables writing trajectory frames on a separate thread
+const char* const c_asyncOutputVariable = "GMX_ASYNC_TRAJECTORY_OUTPUT";
+
+/*! \brief Run parameters where the last step writes every kind of
+ * trajectory frame, so mdrun ends right after writing them.
+ *
+ * The spc-and-methanol system has enough atoms for the .xtc frames
+ * to be compressed. */
+const char* const c_mdpContents = R"(integrator           = md
+                                     nsteps               = 12
+                                     nstcalcenergy        = 1
+                                     nstenergy            = 3
+                                     nstxout              = 2
+                                     nstvout              = 3
+                                     nstfout              = 4
+                                     nstxout-compressed   = 1
+                                     tcoupl               = v-rescale
+                                     tc-grps              = System
+                                     tau-t                = 0.1
+                                     ref-t                = 298
+                                     )";
+
+//! Returns the whole contents of \p filename as bytes
+std::string readFileBytes(const std::string& filename)
+{
+    std::ifstream stream(filename, std::ios::binary);
+    EXPECT_TRUE(stream.is_open()) << "Could not open " << filename;
+    return std::string(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
+}
+
+//! Sets or unsets GMX_ASYNC_TRAJECTORY_OUTPUT and restores it on destruction
+class ScopedAsyncOutputSetting
+{
+public:
+    //! Enables asynchronous writing with \p numBuffers buffers, or disables it when nullptr
+    explicit ScopedAsyncOutputSetting(const char* numBuffers)
+    {
+        const char* previous = getenv(c_asyncOutputVariable);
+        if (previous != nullptr)
+        {
+            previousValue_ = previous;
+            hadValue_      = true;
+        }
+        if (numBuffers != nullptr)
+        {
+            gmxSetenv(c_asyncOutputVariable, numBuffers, true);
+        }
+        else
+        {
+            gmxUnsetenv(c_asyncOutputVariable);
+        }
+    }
+    ~ScopedAsyncOutputSetting()
+    {
+        if (hadValue_)
+        {
+            gmxSetenv(c_asyncOutputVariable, previousValue_.c_str(), true);
+        }
+        else
+        {
+            gmxUnsetenv(c_asyncOutputVariable);
+        }
+    }
+
+private:
+    //! Value of the variable before construction
+    std::string previousValue_;
+    //! Whether the variable was set before construction
+    bool hadValue_ = false;
+};
+
+//! Test fixture comparing asynchronous with synchronous trajectory writing
+class AsyncTrajectoryOutputTest : public MdrunTestFixture
+{
+public:
+    //! Output files of one way of running the simulation
+    struct OutputFiles
+    {
+        //! The .trr file name
+        std::string trr;
+        //! The .xtc file name
+        std::string xtc;
+    };
+
+    //! Prepares the run input, shared by all runs of a test
+    void prepareRunInput()
+    {
+        runner_.useStringAsMdpFile(c_mdpContents);
+        runner_.useTopGroAndNdxFromDatabase("spc-and-methanol");
+        ASSERT_EQ(0, runner_.callGrompp());
+    }
+
+    //! Directs the trajectory output of the runner to files with \p suffix
+    OutputFiles useOutputFiles(const std::string& suffix)
+    {
+        OutputFiles files;
+        files.trr = fileManager_.getTemporaryFilePath(suffix + ".trr");
+        files.xtc = fileManager_.getTemporaryFilePath(suffix + ".xtc");
+        runner_.fullPrecisionTrajectoryFileName_    = files.trr;
+        runner_.reducedPrecisionTrajectoryFileName_ = files.xtc;
+        runner_.logFileName_                        = fileManager_.getTemporaryFilePath(suffix + ".log");
+        runner_.cptFileName_                        = fileManager_.getTemporaryFilePath(suffix + ".cpt");
+        return files;
+    }
+
+    //! Runs all steps in a single mdrun call
+    void runInOnePart()
+    {
+        CommandLine caller;
+        caller.append("-reprod");
+        ASSERT_EQ(0, runner_.callMdrun(caller));
+    }
+
+    /*! \brief Runs half of the steps, writing a checkpoint at the
+     * last step, and then appends the other half after restarting
+     * from that checkpoint */
+    void runInTwoParts()
+    {
+        CommandLine firstPart;
+        firstPart.append("-reprod");
+        firstPart.addOption("-nsteps", 6);
+        firstPart.addOption("-cpo", runner_.cptFileName_);
+        ASSERT_EQ(0, runner_.callMdrun(firstPart));
+
+        CommandLine secondPart;
+        secondPart.append("-reprod");
+        secondPart.addOption("-cpi", runner_.cptFileName_);
+        secondPart.addOption("-cpo", runner_.cptFileName_);
+        ASSERT_EQ(0, runner_.callMdrun(secondPart));
+    }
+
+    //! Checks that both sets of output files have identical contents
+    static void compareOutputFiles(const OutputFiles& reference, const OutputFiles& test)
+    {
+        std::string referenceTrr = readFileBytes(reference.trr);
+        std::string referenceXtc = readFileBytes(reference.xtc);
+        EXPECT_FALSE(referenceTrr.empty());
+        EXPECT_FALSE(referenceXtc.empty());
+        EXPECT_TRUE(referenceTrr == readFileBytes(test.trr))
+                << ".trr files written synchronously and asynchronously differ";
+        EXPECT_TRUE(referenceXtc == readFileBytes(test.xtc))
+                << ".xtc files written synchronously and asynchronously differ";
+    }
+};
+
+TEST_F(AsyncTrajectoryOutputTest, WritesSameFilesAsSynchronousOutput)
+{
+    prepareRunInput();
+
+    OutputFiles synchronousFiles = useOutputFiles("sync");
+    {
+        ScopedAsyncOutputSetting setting(nullptr);
+        runInOnePart();
+    }
+    OutputFiles asynchronousFiles = useOutputFiles("async");
+    {
+        ScopedAsyncOutputSetting setting("2");
+        runInOnePart();
+    }
+    compareOutputFiles(synchronousFiles, asynchronousFiles);
+}
+
+TEST_F(AsyncTrajectoryOutputTest, WritesSameFilesAcrossCheckpointAndRestart)
+{
+    prepareRunInput();
+
+    OutputFiles synchronousFiles = useOutputFiles("sync");
+    {
+        ScopedAsyncOutputSetting setting(nullptr);
+        runInTwoParts();
+    }
+    OutputFiles asynchronousFiles = useOutputFiles("async");
+    {
+        ScopedAsyncOutputSetting setting("2");
+        runInTwoParts();
+    }
+    compareOutputFiles(synchronousFiles, asynchronousFiles);
+
+    // A restart from the checkpoint of an asynchronous run should
+    // also give the same output as the uninterrupted synchronous run.
+    OutputFiles uninterruptedFiles = useOutputFiles("uninterrupted");
+    {
+        ScopedAsyncOutputSetting setting(nullptr);
+        runInOnePart();
+    }
+    compareOutputFiles(uninterruptedFiles, asynchronousFiles);
+}
+
+} // namespace
+} // namespace test
+} // namespace gmx
@@ -67,6 +67,18 @@ TEST(NonbondedBenchTest, BasicEndToEndTest)
                          &gmx::NonbondedBenchmarkInfo::create, &cmdline));
 }
 
+TEST(NonbondedBenchTest, StepEndToEndTest)
+{
+    const char* const command[] = { "nonbonded-benchmark" };
+    CommandLine       cmdline(command);
+    cmdline.addOption("-iter", 3);
+    cmdline.addOption("-nstlist", 2);
+    cmdline.addOption("-nstlistprune", 1);
+    cmdline.addOption("-step");
+    EXPECT_EQ(0, gmx::test::CommandLineTestHelper::runModuleFactory(
+                         &gmx::NonbondedBenchmarkInfo::create, &cmdline));
+}
+
 } // namespace
 } // namespace test
 } // namespace gmx